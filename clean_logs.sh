@@ -1,2 +1,4 @@
 #!/bin/bash
-find . -name "*.log" -exec rm -f {} +
\ No newline at end of file
+find . -name "*.log" -exec rm -f {} +
+# the tick-to-trade trace rings (utils/trace.h) too, they live in shared memory and outlast the processes that wrote them
+rm -f "${EXCHANGE_TRACE_DIR:-/dev/shm}"/exchange_trace.*
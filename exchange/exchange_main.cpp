@@ -1,11 +1,18 @@
 #include <csignal>
+#include <iostream>
 
 #include "matching_engine/matching_engine.h"
 #include "market_publisher/market_data_publisher.h"
 #include "order_gateway/order_server.h"
 #include "../utils/exchange_limits.h"
+#include "../utils/huge_page_arena.h"
+#include "../utils/numa_utils.h"
+#include "../utils/latency_histogram.h"
+#include "../utils/thread_placement.h"
 
 Common::Logger *logger = nullptr;
+Common::HugePageArena *arena = nullptr;
+Common::LatencyReporter *latency_reporter = nullptr;
 Exchange::MatchingEngine *matching_engine = nullptr;
 Exchange::MarketDataPublisher *market_data_publisher = nullptr;
 Exchange::OrderServer *order_server = nullptr;
@@ -17,6 +24,10 @@ void signal_handler(int) {
     delete logger;
     logger = nullptr;
 
+    // writes the last report before the components go away
+    delete latency_reporter;
+    latency_reporter = nullptr;
+
     delete matching_engine;
     matching_engine = nullptr;
 
@@ -26,68 +37,119 @@ void signal_handler(int) {
     delete order_server;
     order_server = nullptr;
 
+    // everything that was allocated from the arena is gone now
+    delete arena;
+    arena = nullptr;
+
     std::this_thread::sleep_for(10s);
 
     exit(EXIT_SUCCESS);
 }
 
 int main() {
+    // which core (and scheduling policy) each thread gets, from the file in THREAD_PLACEMENT_FILE (see utils/thread_placement.h)
+    // without one every thread is left unpinned
+    const std::string placement_warnings = Common::loadThreadPlacementFromEnvironment();
+    std::cout << placement_warnings << std::flush;
+    const Common::ThreadPlacementConfig &placement = Common::threadPlacementConfig();
+
+    // every component's logger is written out by one log service thread, start it on its own core
+    // note that this has to happen before the first Logger is created
+    Common::LogService::defaultService(placement.coreOf("log_service"));
+
     logger = new Common::Logger("exchange_main.log");
 
+    // every START_MEASURE()/END_MEASURE() tag's percentiles, written out every 10s
+    latency_reporter = new Common::LatencyReporter("exchange_latency.log", std::chrono::seconds(10), placement.coreOf("latency_reporter"));
+
     // whenever we do ctrl-c etc., it sends a signal to the program, like SIGINT
     // programs can define a handler of what to do if they receive such a signal
     std::signal(SIGINT, signal_handler);
 
     const int sleep_time = 100 * 1000;
 
-    Exchange::ClientRequestLFQueue client_requests(ME_MAX_CLIENT_UPDATES);
-    Exchange::ClientResponseLFQueue client_responses(ME_MAX_CLIENT_UPDATES);
-    Exchange::MEMarketUpdateLFQueue market_updates(ME_MAX_MARKET_UPDATES);
+    // cores each component's thread gets pinned to, -1 leaves a thread unpinned
+    // note that each component's memory goes on the numa node of its core, so pick cores on the same socket as the NIC
+    const int matching_engine_core = placement.coreOf("Exchange/MatchingEngine");
+    const int market_data_publisher_core = placement.coreOf("Exchange/MarketDataPublisher");
+    const int snapshot_synthesizer_core = placement.coreOf("Exchange/SnapshotSynthesizer");
+    const int order_server_core = placement.coreOf("Exchange/OrderServer");
+
+    // the order books and the queues into and out of the matching engine go on huge pages, if the machine has them
+    // turn on 'prefault' to pay for every page fault now instead of on the hot path (note that this touches all ~18GB)
+    const Common::ArenaConfig arena_config{.use_huge_pages = true, .prefault = false, .lock = false,
+                                           .numa_node = Common::numaNodeOfCore(matching_engine_core)};
+    arena = new Common::HugePageArena(ME_ARENA_SIZE, arena_config);
+
+    Exchange::ClientRequestLFQueue client_requests(ME_MAX_CLIENT_UPDATES, arena);
+    Exchange::ClientResponseLFQueue client_responses(ME_MAX_CLIENT_UPDATES, arena);
+    Exchange::MEMarketUpdateBroadcastQueue market_updates(ME_MAX_MARKET_UPDATES, Exchange::MDP_NUM_CONSUMERS, arena);
 
     std::string time_str;
-    logger->log("%:% %() % Starting Matching Engine... \n",
+    LOG_INFO(*logger, "%:% %() % Reserved % \n",
+        __FILE__, __LINE__, __FUNCTION__,
+        Common::getCurrentTimeStr(&time_str), arena->toString()
+    );
+
+    LOG_INFO(*logger, "%:% %() % Starting Matching Engine... \n",
         __FILE__, __LINE__, __FUNCTION__,
         Common::getCurrentTimeStr(&time_str)
     );
 
     // starting the matching engine
-    matching_engine = new Exchange::MatchingEngine(&client_requests, &client_responses, &market_updates); 
+    matching_engine = new Exchange::MatchingEngine(&client_requests, &client_responses, &market_updates, matching_engine_core, arena); 
+    LOG_INFO(*logger, "%:% %() % Order books allocated, % \n",
+        __FILE__, __LINE__, __FUNCTION__,
+        Common::getCurrentTimeStr(&time_str), arena->toString()
+    );
     matching_engine->start();
 
     // starting the publisher server
+    // MARKET_DATA_MTU sizes the incremental feed's packets (see exchange/market_publisher/market_data_packetizer.h)
     const std::string mkt_publisher_interface = "lo";
     const std::string snapshot_publisher_ip = "233.252.14.1", inc_publisher_ip = "233.252.14.3";
     const int snapshot_publisher_port = 20000, inc_publisher_port = 20001;
 
-    logger->log("%:% %() % Starting Publisher... \n",
+    LOG_INFO(*logger, "%:% %() % Starting Publisher... \n",
         __FILE__, __LINE__, __FUNCTION__,
         Common::getCurrentTimeStr(&time_str)
     );
     market_data_publisher = new Exchange::MarketDataPublisher(
         &market_updates, mkt_publisher_interface,
         snapshot_publisher_ip, snapshot_publisher_port,
-        inc_publisher_ip, inc_publisher_port
+        inc_publisher_ip, inc_publisher_port,
+        market_data_publisher_core, snapshot_synthesizer_core, Exchange::marketDataMTUFromEnvironment()
     );
     market_data_publisher->start();
 
     // starting the order server
+    // ORDER_TRANSPORT=shm serves clients on this host over shared memory instead of tcp (see exchange/order_gateway/order_transport.h)
     const std::string order_gateway_interface = "lo";
     const int order_gateway_port = 12345;
+    const Exchange::OrderTransport order_transport = Exchange::orderTransportFromEnvironment();
 
-    logger->log("%:% %() % Starting Gateway... \n",
+    LOG_INFO(*logger, "%:% %() % Starting Gateway over % ... \n",
         __FILE__, __LINE__, __FUNCTION__,
-        Common::getCurrentTimeStr(&time_str)
+        Common::getCurrentTimeStr(&time_str), Exchange::orderTransportToString(order_transport)
     );
     order_server = new Exchange::OrderServer(
         &client_requests, &client_responses, 
-        order_gateway_interface, order_gateway_port
+        order_gateway_interface, order_gateway_port, order_server_core, order_transport
     );
     order_server->start();
 
+    // every thread is up now, this is where they actually ended up
+    const std::string placement_report = Common::threadPlacementReport();
+    std::cout << placement_report << std::flush;
+    LOG_INFO(*logger, "%:% %() % % % \n",
+        __FILE__, __LINE__, __FUNCTION__,
+        Common::getCurrentTimeStr(&time_str), placement_warnings, placement_report
+    );
+
     // ---------
     // making this code run until it is explicitly killed by the user
     while (true) {
-        logger->log("%:% %() % Keeping exchange alive... \n",
+        LOG_INFO(*logger, "%:% %() % Keeping exchange alive... \n",
             __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str)
         );
         usleep(sleep_time * 1000);
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdlib>
+
+#include "market_update.h"
+#include "../../utils/multicast_socket.h"
+
+namespace Exchange {
+
+    // what goes around each datagram on the wire: a 20 byte IPv4 header and an 8 byte UDP header
+    constexpr size_t MDP_IP_UDP_OVERHEAD = 20 + 8;
+
+    // ethernet's MTU, a datagram that fits doesn't get fragmented on its way to the clients
+    constexpr size_t MDP_DEFAULT_MTU = 1500;
+
+    // from the MARKET_DATA_MTU environment variable (e.g. 9000 on a network with jumbo frames), MDP_DEFAULT_MTU if it isn't set
+    inline size_t marketDataMTUFromEnvironment() {
+        const char *mtu = std::getenv("MARKET_DATA_MTU");
+        return mtu ? static_cast<size_t>(std::strtoul(mtu, nullptr, 10)) : MDP_DEFAULT_MTU;
+    }
+
+    /*
+        Packs the incremental feed's updates into datagrams that fit in one MTU
+
+        A packet is an MDPPacketHeader followed by as many MEMarketUpdates as fit, the publisher add()s updates one by one
+        and the packet is finished when the next one wouldn't fit, or when the publisher flush()es at the end of each batch
+        it read from the matching engine, so a burst goes out as a few full packets and a quiet market doesn't wait for one to fill up
+
+        note that finishing a packet only hands it to the socket, the socket sends all of them with one sendmmsg() in sendAndRecv()
+    */
+    class MarketDataPacketizer final {
+        private:
+            Common::MulticastSocket * socket = nullptr;
+            const size_t max_updates_per_packet = 0;
+
+            // the packet being built, it lives in the socket's datagram so the updates are only ever copied once
+            MDPPacketHeader * header = nullptr;
+
+        public:
+            MarketDataPacketizer(Common::MulticastSocket * socket_param, size_t mtu
+                                ): socket(socket_param), max_updates_per_packet(updatesPerPacket(mtu)) {
+                ASSERT(mtu <= Common::McastMaxDatagramSize + MDP_IP_UDP_OVERHEAD && max_updates_per_packet >= 1,
+                    "MTU:" + std::to_string(mtu) + " has to fit at least one update and at most a " + std::to_string(Common::McastMaxDatagramSize) + " byte datagram");
+            }
+
+            MarketDataPacketizer() = delete;
+            MarketDataPacketizer(const MarketDataPacketizer &) = delete;
+            MarketDataPacketizer(const MarketDataPacketizer &&) = delete;
+            MarketDataPacketizer &operator=(const MarketDataPacketizer &) = delete;
+            MarketDataPacketizer &operator=(const MarketDataPacketizer &&) = delete;
+
+            static size_t updatesPerPacket(size_t mtu) noexcept {
+                return (mtu > MDP_IP_UDP_OVERHEAD + sizeof(MDPPacketHeader)) ? (mtu - MDP_IP_UDP_OVERHEAD - sizeof(MDPPacketHeader)) / sizeof(MEMarketUpdate) : 0;
+            }
+
+            // adds the update with sequence number 'seq_number' to the packet being built, the numbers have to be consecutive
+            void add(size_t seq_number, const MEMarketUpdate &update) noexcept {
+                if (!header) {
+                    header = reinterpret_cast<MDPPacketHeader *>(socket->reserve(sizeof(MDPPacketHeader)));
+                    header->first_seq_number = seq_number;
+                    header->num_updates = 0;
+                }
+
+                socket->send(&update, sizeof(MEMarketUpdate));
+                if (++header->num_updates == max_updates_per_packet) {
+                    flush();
+                }
+            }
+
+            // finishes the packet being built, if there is one
+            void flush() noexcept {
+                if (!header) {
+                    return;
+                }
+
+                header->send_time = getCurrentNanos();
+                socket->finishDatagram();
+                header = nullptr;
+            }
+    };
+
+}
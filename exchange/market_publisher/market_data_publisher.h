@@ -4,9 +4,14 @@
 
 #include "market_publisher/snapshot_synthesizer.h"
 #include "market_publisher/market_update.h"
+#include "market_publisher/market_data_packetizer.h"
 #include "../../utils/logger.h"
 #include "../../utils/multicast_socket.h"
+#include "../../utils/latency_histogram.h"
+#include "../../utils/trace.h"
 #include "../../utils/exchange_limits.h"
+#include "../../utils/huge_page_arena.h"
+#include "../../utils/numa_utils.h"
 
 namespace Exchange {
 
@@ -19,9 +24,7 @@ namespace Exchange {
 
         private:
             size_t next_inc_seq_number = 1;
-            MEMarketUpdateLFQueue * outgoing_md_updates = nullptr;
-
-            MDPMarketUpdateLFQueue snapshot_md_updates;
+            MEMarketUpdateBroadcastQueue * outgoing_md_updates = nullptr; // we read it as MDP_INCREMENTAL_CONSUMER, the synthesizer as MDP_SNAPSHOT_CONSUMER
 
             volatile bool running = false;
 
@@ -29,20 +32,47 @@ namespace Exchange {
             Logger logger;
 
             Common::MulticastSocket incremental_socket;
+            MarketDataPacketizer incremental_packetizer; // every datagram on the incremental feed is one of its packets
 
             SnapshotSynthesizer * snapshot_synthesizer = nullptr;
 
+            // the synthesizer's snapshot of every order (~70MB) lives here, on the numa node of the synthesizer's core
+            HugePageArena * snapshot_arena = nullptr;
+
+            const int core_id = -1;
+
+            ParkingSignal parking_signal; // the matching engine wakes us with it when we are parked
+
         public:
-            MarketDataPublisher(MEMarketUpdateLFQueue * market_updates, const std::string &interface,
+            // our thread gets pinned to 'core_id' and the snapshot synthesizer's to 'snapshot_core_id', -1 leaves a thread unpinned
+            // incremental packets are sized to fit in 'mtu' bytes, including the IP and UDP headers
+            MarketDataPublisher(MEMarketUpdateBroadcastQueue * market_updates, const std::string &interface,
                                 const std::string snapshot_ip, int snapshot_port, 
-                                const std::string &incremental_ip, int incremental_port
-                                ): outgoing_md_updates(market_updates), snapshot_md_updates(ME_MAX_MARKET_UPDATES),
-                                running(false), logger("exchange_market_data_publisher.log"), incremental_socket(logger) {
+                                const std::string &incremental_ip, int incremental_port,
+                                int core_id_param = -1, int snapshot_core_id = -1, size_t mtu = MDP_DEFAULT_MTU
+                                ): outgoing_md_updates(market_updates),
+                                running(false), logger("exchange_market_data_publisher.log"), incremental_socket(logger),
+                                incremental_packetizer(&incremental_socket, mtu), core_id(core_id_param) {
                 
                 ASSERT(incremental_socket.init(incremental_ip, interface, incremental_port, false) >= 0,
                         "Unable to create incremental multicast socket. error:" + std::string(std::strerror(errno))
                 );
-                snapshot_synthesizer = new SnapshotSynthesizer(&snapshot_md_updates, interface, snapshot_ip, snapshot_port);
+                outgoing_md_updates->setConsumerSignal(MDP_INCREMENTAL_CONSUMER, &parking_signal);
+
+                const ArenaConfig snapshot_arena_config{.use_huge_pages = true, .prefault = false, .lock = false, .numa_node = numaNodeOfCore(snapshot_core_id)};
+                snapshot_arena = new HugePageArena(SnapshotSynthesizer::arenaBytes(), snapshot_arena_config);
+                snapshot_synthesizer = arenaNew<SnapshotSynthesizer>(snapshot_arena, outgoing_md_updates, interface, snapshot_ip, snapshot_port,
+                                                                     snapshot_core_id, snapshot_arena);
+
+                LOG_INFO(logger, "%:% %() % Market data publisher core: % numa node: %, snapshot synthesizer core: % is on numa node % in % \n",
+                    __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+                    core_id, numaNodeToString(numaNodeOfCore(core_id)),
+                    snapshot_core_id, numaNodeToString(numaNodeOfAddress(snapshot_synthesizer)), snapshot_arena->toString()
+                );
+                LOG_INFO(logger, "%:% %() % Incremental packets fit in an MTU of % bytes, up to % updates each \n",
+                    __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+                    mtu, MarketDataPacketizer::updatesPerPacket(mtu)
+                );
             }
 
             ~MarketDataPublisher() {
@@ -51,13 +81,16 @@ namespace Exchange {
                 using namespace std::literals::chrono_literals;
                 std::this_thread::sleep_for(5s);
 
-                delete snapshot_synthesizer;
+                arenaDelete(snapshot_arena, snapshot_synthesizer);
                 snapshot_synthesizer = nullptr;
+
+                delete snapshot_arena;
+                snapshot_arena = nullptr;
             }
 
             void start() {
                 running = true;
-                ASSERT(Common::createAndStartThread(-1, "Exchange/MarketDataPublisher", [this]() { run(); }) != nullptr, 
+                ASSERT(Common::createAndStartThread(core_id, "Exchange/MarketDataPublisher", [this]() { run(); }) != nullptr, 
                         "Failed to start MarketData thread."
                 );
 
@@ -75,43 +108,53 @@ namespace Exchange {
             // 'drives' the publisher thread to send out updates to clients
             void run() noexcept {
                 // PART 1: fetch the update to be published
-                logger.log("%:% %() % Publisher running... \n", 
+                LOG_INFO(logger, "%:% %() % Publisher running... \n", 
                     __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str)
                 );
 
+                IdleStrategy idle_strategy(currentThreadPlacement().idle_mode, &parking_signal);
+
                 while(running) {
-                    for (const MEMarketUpdate * market_update = outgoing_md_updates->getNextRead();
-                        outgoing_md_updates->size() && market_update; market_update = outgoing_md_updates->getNextRead()
-                        ) {
+                    const MEMarketUpdate * market_updates = nullptr;
+                    const size_t num_updates = outgoing_md_updates->peekReads(MDP_INCREMENTAL_CONSUMER, Common::LFQueueDrainBatchSize, &market_updates);
+                    for (size_t i = 0; i < num_updates; ++i) {
+                        const MEMarketUpdate * market_update = &market_updates[i];
                         
                         // almost at the last step to sending out an update from a client request
-                        TTT_MEASURE(T5_MarketDataPublisher_LFQueue_read, logger);
+                        TRACE_HOP(T5_MarketDataPublisher_LFQueue_read, Common::TRACE_MARKET_DATA, next_inc_seq_number);
                         
-                        logger.log("%:% %() % Sending seq:% % \n", 
+                        LOG_DEBUG(logger, "%:% %() % Sending seq:% % \n", 
                             __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                            next_inc_seq_number, market_update->toString().c_str()
+                            next_inc_seq_number, *market_update
                         );
 
-                        // write the update to the socket buffer
+                        // pack the update into the current packet, a full one is finished and a new one started
                         START_MEASURE(Exchange_MulticastSocket_send);
-                        incremental_socket.send(&next_inc_seq_number, sizeof(next_inc_seq_number));
-                        incremental_socket.send(market_update, sizeof(MEMarketUpdate));
-                        END_MEASURE(Exchange_MulticastSocket_send, logger);
-                        outgoing_md_updates->updateReadIndex();
+                        incremental_packetizer.add(next_inc_seq_number, *market_update);
+                        END_MEASURE(Exchange_MulticastSocket_send);
 
                         // stop the clock! last time we do any processing on a market update
-                        TTT_MEASURE(T6_MarketDataPublisher_UDP_write, logger);
-
-                        // also send it to the synthesizer
-                        MDPMarketUpdate * next_write = snapshot_md_updates.getNextWriteTo();
-                        next_write->seq_number = next_inc_seq_number;
-                        next_write->me_market_update = *market_update;
-                        snapshot_md_updates.updateWriteIndex();
+                        TRACE_HOP(T6_MarketDataPublisher_UDP_write, Common::TRACE_MARKET_DATA, next_inc_seq_number);
 
+                        // note that we don't pass it on to the synthesizer, it reads the same update straight from the broadcast queue
                         ++next_inc_seq_number;
                     }
 
+                    // the end of the batch finishes the last packet even if it isn't full, then every packet of the batch goes out together
+                    // note that the updates were copied into the packets, so we can hand the whole batch back to the matching engine with one store
+                    if (num_updates) {
+                        incremental_packetizer.flush();
+                        outgoing_md_updates->releaseReads(MDP_INCREMENTAL_CONSUMER, num_updates);
+                    }
+
                     incremental_socket.sendAndRecv();
+
+                    // packets the kernel had no room for are still work, we don't go idle on them
+                    if (num_updates || incremental_socket.hasPendingDatagrams()) {
+                        idle_strategy.reset();
+                    } else {
+                        idle_strategy.idle([this]() { return outgoing_md_updates->size(MDP_INCREMENTAL_CONSUMER) > 0; });
+                    }
                 }
 
             }
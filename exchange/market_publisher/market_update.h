@@ -4,6 +4,9 @@
 
 #include "../../utils/orderinfo_types.h"
 #include "../../utils/lock_free_queue.h"
+#include "../../utils/broadcast_queue.h"
+#include "../../utils/logtype.h"
+#include "../../utils/time_utils.h"
 
 using namespace Common;
 
@@ -91,9 +94,55 @@ namespace Exchange {
         }
     };
 
+    // the front of every datagram on the incremental feed, it is followed by 'num_updates' MEMarketUpdates
+    // the i-th of which has sequence number first_seq_number + i, so the sequence number only goes out once per packet
+    // note that the snapshot feed still sends MDPMarketUpdates, one sequence number each
+    struct MDPPacketHeader {
+        size_t first_seq_number = 0;
+        uint16_t num_updates = 0;
+        Nanos send_time = 0; // when the publisher finished the packet, getCurrentNanos() on the exchange's clock
+
+        // the header of the packet in 'datagram', nullptr unless the datagram is exactly one whole packet
+        // we can't trust anything in a packet whose size doesn't match its header, so the consumer drops it
+        static const MDPPacketHeader *fromDatagram(const char *datagram, size_t length) noexcept {
+            const auto header = reinterpret_cast<const MDPPacketHeader *>(datagram);
+            if (length < sizeof(MDPPacketHeader) || length != sizeof(MDPPacketHeader) + header->num_updates * sizeof(MEMarketUpdate)) {
+                return nullptr;
+            }
+            return header;
+        }
+
+        std::string toString() const {
+            std::stringstream ss;
+
+            ss << "MDPPacketHeader ["
+            << " first_seq: " << first_seq_number
+            << " updates: " << num_updates
+            << " sent: " << send_time
+            << "]";
+
+            return ss.str();
+        }
+    };
+
 #pragma pack(pop) // puts our configuration back
 
     // queue for the engine to send status updates of orders to the market
     typedef LFQUEUE<MEMarketUpdate> MEMarketUpdateLFQueue;
-    typedef LFQUEUE<MDPMarketUpdate> MDPMarketUpdateLFQueue;
+
+    // on the exchange side, both the incremental publisher and the snapshot synthesizer read every update the engine makes
+    // so the engine writes them into a broadcast queue, and each of them reads it in place as its own consumer
+    typedef BroadcastQueue<MEMarketUpdate> MEMarketUpdateBroadcastQueue;
+    constexpr size_t MDP_INCREMENTAL_CONSUMER = 0;
+    constexpr size_t MDP_SNAPSHOT_CONSUMER = 1;
+    constexpr size_t MDP_NUM_CONSUMERS = 2;
+}
+
+namespace Common {
+    // market updates are logged on every hot path, so the logger copies their bytes and formats them later
+    template<> struct LogStruct<Exchange::MEMarketUpdate> : LogStructOf<LogStructId::ME_MARKET_UPDATE> {};
+    template<> struct LogStruct<Exchange::MDPMarketUpdate> : LogStructOf<LogStructId::MDP_MARKET_UPDATE> {};
+    template<> struct LogStruct<Exchange::MDPPacketHeader> : LogStructOf<LogStructId::MDP_PACKET_HEADER> {};
+    inline const bool market_update_log_structs = registerLogStruct<Exchange::MEMarketUpdate>() && registerLogStruct<Exchange::MDPMarketUpdate>() &&
+                                                  registerLogStruct<Exchange::MDPPacketHeader>();
 }
\ No newline at end of file
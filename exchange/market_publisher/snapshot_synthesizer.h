@@ -19,8 +19,8 @@ namespace Exchange {
     class SnapshotSynthesizer {
 
         private:
-            // LFQ from which the publisher is communicating with the synthesizer thread
-            MDPMarketUpdateLFQueue * snapshot_md_updates = nullptr;
+            // the matching engine's updates, we read them as MDP_SNAPSHOT_CONSUMER alongside the incremental publisher
+            MEMarketUpdateBroadcastQueue * snapshot_md_updates = nullptr;
 
             Logger logger;
             std::string time_str;
@@ -37,15 +37,27 @@ namespace Exchange {
 
             MemPool<MEMarketUpdate> order_pool;
 
+            const int core_id = -1;
+
+            ParkingSignal parking_signal; // the matching engine wakes us with it when we are parked
+
         public:
-            SnapshotSynthesizer(MDPMarketUpdateLFQueue *market_updates, 
-                                const std::string &interface, const std::string &snapshot_ip, int snapshot_port
+            // how much memory an arena needs to hold a SnapshotSynthesizer (created with arenaNew()) along with its order_pool
+            static constexpr size_t arenaBytes() noexcept {
+                return sizeof(SnapshotSynthesizer) + alignof(SnapshotSynthesizer) + ME_MAX_ORDER_IDs * (sizeof(MEMarketUpdate) + sizeof(uint32_t)) + CacheLineSize;
+            }
+
+            // the thread gets pinned to 'core_id' (-1 to leave it unpinned), and the order_pool goes in 'arena' if there is one
+            SnapshotSynthesizer(MEMarketUpdateBroadcastQueue *market_updates, 
+                                const std::string &interface, const std::string &snapshot_ip, int snapshot_port,
+                                int core_id_param = -1, HugePageArena *arena = nullptr
                                 ): snapshot_md_updates(market_updates), logger("exchange_snapshot_synthesizer.log"), 
-                                snapshot_socket(logger), order_pool(ME_MAX_ORDER_IDs) {
+                                snapshot_socket(logger), order_pool(ME_MAX_ORDER_IDs, arena), core_id(core_id_param) {
                 
                 ASSERT(snapshot_socket.init(snapshot_ip, interface, snapshot_port, false) >= 0,
                         "Unable to create snapshot multicast socket, error: " + std::string(std::strerror(errno))
                 );
+                snapshot_md_updates->setConsumerSignal(MDP_SNAPSHOT_CONSUMER, &parking_signal);
             }
 
             ~SnapshotSynthesizer() {
@@ -54,7 +66,7 @@ namespace Exchange {
 
             void start() {
                 running = true;
-                ASSERT(Common::createAndStartThread(-1, "Exchange/SnapshotSynthesizer", [this]() {run();}) != nullptr, 
+                ASSERT(Common::createAndStartThread(core_id, "Exchange/SnapshotSynthesizer", [this]() {run();}) != nullptr, 
                         "Failed to start snapshotSynthesizer thread"
                 );
             }
@@ -64,8 +76,9 @@ namespace Exchange {
             }
 
             // receives a market update object from the matching engine and updates the local copy of the order book
-            void addToSnapshot(const MDPMarketUpdate *market_update) {
-                const MEMarketUpdate &me_market_update = market_update->me_market_update;
+            // 'seq_number' is the incremental sequence number the publisher sent this update out with
+            void addToSnapshot(const MEMarketUpdate *market_update, size_t seq_number) {
+                const MEMarketUpdate &me_market_update = *market_update;
                 auto *orders = &ticker_orders.at(me_market_update.ticker_id); // copy of order book for this ticker 
                 
                 // now let's update our local copy depending on what the update is
@@ -109,8 +122,8 @@ namespace Exchange {
                 }
 
                 // let's record this sequence number so we make sure we preserve ordering
-                ASSERT(market_update->seq_number == last_inc_seq_num + 1, "Expected incremental seq numbers to increase");
-                last_inc_seq_num = market_update->seq_number;
+                ASSERT(seq_number == last_inc_seq_num + 1, "Expected incremental seq numbers to increase");
+                last_inc_seq_num = seq_number;
             }
 
             // we have START_MARKET_UPDATE and END_MARKET_UPDATE as sentinels to indicate the start and end of a snapshot
@@ -124,9 +137,9 @@ namespace Exchange {
                     snapshot_size++, 
                     {MarketUpdateType::SNAPSHOT_START, last_inc_seq_num}
                 };
-                logger.log("%:% %() % START SENTINEL % \n",
+                LOG_TRACE(logger, "%:% %() % START SENTINEL % \n",
                     __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str),
-                    start_market_update.toString()
+                    start_market_update
                 );
                 snapshot_socket.send(&start_market_update, sizeof(MDPMarketUpdate));
 
@@ -141,9 +154,9 @@ namespace Exchange {
                     me_market_update.ticker_id = ticker_i;
 
                     const MDPMarketUpdate clear_market_update{snapshot_size++, me_market_update};
-                    logger.log("%:% %() % CLEAR SENTINEL % \n",
+                    LOG_TRACE(logger, "%:% %() % CLEAR SENTINEL % \n",
                         __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str),
-                        clear_market_update.toString()
+                        clear_market_update
                     );
                     snapshot_socket.send(&clear_market_update, sizeof(MDPMarketUpdate));
                     
@@ -151,12 +164,14 @@ namespace Exchange {
                     for (const auto order: orders) {
                         if (order) {
                             const MDPMarketUpdate market_update{snapshot_size++, *order};
-                            logger.log("%:% %() % % \n",
+                            LOG_TRACE(logger, "%:% %() % % \n",
                                 __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str),
-                                market_update.toString()
+                                market_update
                             );
                             snapshot_socket.send(&market_update, sizeof(MDPMarketUpdate));
-                            snapshot_socket.sendAndRecv();
+
+                            // still one datagram per order, but they go out McastMaxBatchDatagrams at a time with one sendmmsg()
+                            snapshot_socket.finishDatagram();
                         }
                     }
                 }
@@ -166,37 +181,56 @@ namespace Exchange {
                     snapshot_size++, 
                     {MarketUpdateType::SNAPSHOT_END, last_inc_seq_num}
                 };
-                logger.log("%:% %() % END SENTINEL % \n",
+                LOG_TRACE(logger, "%:% %() % END SENTINEL % \n",
                     __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str),
-                    end_market_update.toString()
+                    end_market_update
                 );
                 snapshot_socket.send(&end_market_update, sizeof(MDPMarketUpdate));
                 snapshot_socket.sendAndRecv();
 
-                logger.log("%:% %() % Published snapshot of % orders. \n",
+                LOG_DEBUG(logger, "%:% %() % Published snapshot of % orders. \n",
                     __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str),
                     snapshot_size - 1
                 );
             }
 
             void run() {
-                logger.log("%:% %() % Synthesizer running... \n",
+                LOG_INFO(logger, "%:% %() % Synthesizer running... \n",
                     __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str)
                 );
 
+                // we are off the hot path, so this is a good thread to give a backoff or park idle mode (see utils/thread_placement.h)
+                // note that a parked thread still wakes up at least every millisecond, which is plenty for the snapshot timer below
+                IdleStrategy idle_strategy(currentThreadPlacement().idle_mode, &parking_signal);
+
                 while(running) {
-                    // iterate through all messages on the LFQ from the publisher
-                    for (const MDPMarketUpdate * market_update = snapshot_md_updates->getNextRead();
-                        snapshot_md_updates->size() && market_update; 
-                        market_update = snapshot_md_updates->getNextRead()
-                    ) {
-                        logger.log("%:% %() % Run is processing % \n",
+                    // iterate through all the engine's updates we haven't seen yet
+                    // the publisher numbers every update it reads starting from 1, so the position in the queue gives us the same seq number
+                    const MEMarketUpdate * market_updates = nullptr;
+                    const size_t num_updates = snapshot_md_updates->peekReads(MDP_SNAPSHOT_CONSUMER, LFQueueDrainBatchSize, &market_updates);
+                    const size_t first_seq_number = snapshot_md_updates->readCount(MDP_SNAPSHOT_CONSUMER) + 1;
+                    for (size_t i = 0; i < num_updates; ++i) {
+                        const MEMarketUpdate * market_update = &market_updates[i];
+                        LOG_TRACE(logger, "%:% %() % Run is processing seq:% % \n",
                             __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str),
-                            market_update->toString().c_str()
+                            first_seq_number + i, *market_update
                         );
 
-                        addToSnapshot(market_update);
-                        snapshot_md_updates->updateReadIndex();
+                        addToSnapshot(market_update, first_seq_number + i);
+                    }
+                    if (num_updates) {
+                        snapshot_md_updates->releaseReads(MDP_SNAPSHOT_CONSUMER, num_updates);
+                    }
+
+                    // the tail of a big snapshot can be more than the kernel takes at once, it goes out as soon as there is room
+                    if (UNLIKELY(snapshot_socket.hasPendingDatagrams())) {
+                        snapshot_socket.sendAndRecv();
+                    }
+
+                    if (num_updates || snapshot_socket.hasPendingDatagrams()) {
+                        idle_strategy.reset();
+                    } else {
+                        idle_strategy.idle([this]() { return snapshot_md_updates->size(MDP_SNAPSHOT_CONSUMER) > 0; });
                     }
 
                     // if it has been a while since the last update, let's publish another update
@@ -1,12 +1,29 @@
 #include "matching_engine.h"
 
 namespace Exchange {
-    MatchingEngine::MatchingEngine(ClientRequestLFQueue *client_requests, ClientResponseLFQueue *client_responses, MEMarketUpdateLFQueue *market_updates
-    ): incoming_requests(client_requests), outgoing_responses(client_responses), outgoing_market_updates(market_updates), logger("exchange_matching_engine.log") {
+    MatchingEngine::MatchingEngine(ClientRequestLFQueue *client_requests, ClientResponseLFQueue *client_responses, MEMarketUpdateBroadcastQueue *market_updates,
+                                    int core_id_param, HugePageArena *arena_param
+    ): incoming_requests(client_requests), outgoing_responses(client_responses), outgoing_market_updates(market_updates), arena(arena_param),
+    core_id(core_id_param), logger("exchange_matching_engine.log") {
+
+        incoming_requests->setConsumerSignal(&parking_signal);
 
         for(size_t i = 0; i < ticker_order_book.size(); ++i) {
             // ticker_order_book[i] = new MEOrderBook(i, &logger, this);
-            ticker_order_book[i] = new MEOrderBook(&logger, this);
+            // note that the whole book goes in the arena, so the cid_oid_to_order and price level hashmaps are on huge pages too
+            ticker_order_book[i] = arenaNew<MEOrderBook>(arena, &logger, this, arena);
+        }
+
+        // the books should be on the same numa node as the core our thread runs on, log where they actually landed
+        LOG_INFO(logger, "%:% %() % Matching engine core: % numa node: % \n",
+            __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+            core_id, numaNodeToString(numaNodeOfCore(core_id))
+        );
+        for(size_t i = 0; i < ticker_order_book.size(); ++i) {
+            LOG_INFO(logger, "%:% %() % Order book for ticker % is on numa node % \n",
+                __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+                i, numaNodeToString(numaNodeOfAddress(ticker_order_book[i]))
+            );
         }
 
     };
@@ -24,7 +41,7 @@ namespace Exchange {
         outgoing_market_updates = nullptr;
 
         for (auto &order_book : ticker_order_book) {
-            delete order_book;
+            arenaDelete(arena, order_book);
             order_book = nullptr;
         } 
     }
@@ -43,7 +60,7 @@ namespace Exchange {
                                 client_request->side, client_request->price,
                                 client_request->qty
                                 );
-                END_MEASURE(Exchange_MEOrderBook_add, logger);
+                END_MEASURE(Exchange_MEOrderBook_add);
             }
                 break;
 
@@ -51,7 +68,7 @@ namespace Exchange {
                 // notice how we don't provide more params than necessary to the func
                 START_MEASURE(Exchange_MEOrderBook_cancel);
                 order_book->cancel(client_request->client_id, client_request->order_id, client_request->ticker_id);
-                END_MEASURE(Exchange_MEOrderBook_cancel, logger);
+                END_MEASURE(Exchange_MEOrderBook_cancel);
             }
                 break;
 
@@ -4,6 +4,9 @@
 #include "../../utils/lock_free_queue.h"
 #include "../../utils/macros.h"
 #include "../../utils/logger.h"
+#include "../../utils/numa_utils.h"
+#include "../../utils/latency_histogram.h"
+#include "../../utils/trace.h"
 
 #include "../order_gateway/client_request.h"
 #include "../order_gateway/client_response.h"
@@ -15,7 +18,10 @@ namespace Exchange {
 
     class MatchingEngine final {
         public:
-            MatchingEngine(ClientRequestLFQueue *client_requests, ClientResponseLFQueue *client_responses, MEMarketUpdateLFQueue *market_updates);
+            // if an 'arena' is given, the order books (including their hashmaps and mempools) are allocated from it
+            // the thread gets pinned to 'core_id' (-1 to leave it unpinned), so the arena should be on numaNodeOfCore(core_id)
+            MatchingEngine(ClientRequestLFQueue *client_requests, ClientResponseLFQueue *client_responses, MEMarketUpdateBroadcastQueue *market_updates,
+                            int core_id_param = -1, HugePageArena *arena_param = nullptr);
             
             ~MatchingEngine();
 
@@ -29,7 +35,7 @@ namespace Exchange {
             void start() {
                 running = true;
 
-                ASSERT(createAndStartThread(-1, "Exchange/MatchingEngine", [this]() {run();}) != nullptr, "failed to start Matching Engine thread");
+                ASSERT(createAndStartThread(core_id, "Exchange/MatchingEngine", [this]() {run();}) != nullptr, "failed to start Matching Engine thread");
             }
 
             // stops the infinite loop that is listening for client requests from the gateway LFQ
@@ -39,27 +45,43 @@ namespace Exchange {
 
             // accepts incoming requests from the order gateway and sends them for processing
             void run() noexcept {
-                logger.log("%:% %() % \n",
+                LOG_INFO(logger, "%:% %() % \n",
                     __FILE__, __LINE__, __FUNCTION__,
                     Common::getCurrentTimeStr(&time_str)
                 );
 
+                // busy spins unless this thread's placement says otherwise (see utils/thread_placement.h)
+                IdleStrategy idle_strategy(currentThreadPlacement().idle_mode, &parking_signal);
+
                 while(running) {
-                    const MEClientRequest * me_client_request = incoming_requests->getNextRead();
-                    if (LIKELY(me_client_request)) {
+                    const MEClientRequest * me_client_requests = nullptr;
+                    const size_t num_requests = incoming_requests->peekReads(Common::LFQueueDrainBatchSize, &me_client_requests);
+                    for (size_t i = 0; i < num_requests; ++i) {
+                        const MEClientRequest * me_client_request = &me_client_requests[i];
 
                         // first time an order enters the matching engine
-                        TTT_MEASURE(T3_MatchingEngine_LFQueue_read, logger);
+                        TRACE_HOP(T3_MatchingEngine_LFQueue_read, me_client_request->client_id, me_client_request->order_id);
                         
-                        logger.log("%:% %() % Processing % \n",
+                        LOG_DEBUG(logger, "%:% %() % Processing % \n",
                             __FILE__, __LINE__, __FUNCTION__,
-                            Common::getCurrentTimeStr(&time_str), me_client_request->toString()
+                            Common::getCurrentTimeStr(&time_str), *me_client_request
                         );
 
                         START_MEASURE(Exchange_MatchingEngine_processClientRequest);
                         processClientRequest(me_client_request);
-                        END_MEASURE(Exchange_MatchingEngine_processClientRequest, logger);
-                        incoming_requests->updateReadIndex();
+                        END_MEASURE(Exchange_MatchingEngine_processClientRequest);
+
+                        // one request can produce a whole burst of responses and updates (think of an order sweeping the book)
+                        // they were only staged while we matched, now each queue publishes all of them with a single store
+                        outgoing_responses->commitWrites();
+                        outgoing_market_updates->commitWrites();
+                    }
+
+                    if (num_requests) {
+                        incoming_requests->releaseReads(num_requests);
+                        idle_strategy.reset();
+                    } else {
+                        idle_strategy.idle([this]() { return incoming_requests->size() > 0; });
                     }
                 }
             }
@@ -69,19 +91,20 @@ namespace Exchange {
 
             // once the order book is done producing a response, the engine sends the response to the gateway
             void sendClientResponse(const MEClientResponse * client_response) noexcept {
-                logger.log("%:% %() % Sending % \n",
+                LOG_DEBUG(logger, "%:% %() % Sending % \n",
                     __FILE__, __LINE__, __FUNCTION__,
-                    Common::getCurrentTimeStr(&time_str), client_response->toString()
+                    Common::getCurrentTimeStr(&time_str), *client_response
                 );
 
                 // notice how we have a pointer to an object instead of the obj itself
                 // therefore, we use a move instead of assigning the object directly
+                // note that this only stages the response, run() publishes it once the whole request is processed
                 MEClientResponse * next_write = outgoing_responses->getNextWriteTo();
                 *next_write = std::move(*client_response);
-                outgoing_responses->updateWriteIndex();
+                outgoing_responses->stageWriteIndex();
 
                 // the order receipt is leaving the matching engine
-                TTT_MEASURE(T4t_MatchingEngine_LFQueue_write, logger);
+                TRACE_HOP(T4t_MatchingEngine_LFQueue_write, next_write->client_id, next_write->client_order_id);
 
                 // note that now, client_response is pointing to free memory!
                 // it will go out of scope, but this is good practice
@@ -90,19 +113,21 @@ namespace Exchange {
             }
 
             void sendMarketUpdate(const MEMarketUpdate * market_update) {
-                logger.log("%:% %() % Sending % \n",
+                LOG_DEBUG(logger, "%:% %() % Sending % \n",
                     __FILE__, __LINE__, __FUNCTION__,
-                    Common::getCurrentTimeStr(&time_str), market_update->toString()
+                    Common::getCurrentTimeStr(&time_str), *market_update
                 );
 
                 // notice how we have a pointer to an object instead of the obj itself
                 // therefore, we use a move instead of assigning the object directly
                 MEMarketUpdate * next_write = outgoing_market_updates->getNextWriteTo();
                 *next_write = std::move(*market_update);
-                outgoing_market_updates->updateWriteIndex();
+                outgoing_market_updates->stageWriteIndex();
 
                 // the order update is leaving the matching engine
-                TTT_MEASURE(T4_MatchingEngine_LFQueue_write, logger);
+                // note that the publisher numbers the incremental updates in this same order, so our count is its sequence number
+                TRACE_HOP(T4_MatchingEngine_LFQueue_write, Common::TRACE_MARKET_DATA, next_market_update_seq_number);
+                ++next_market_update_seq_number;
 
                 // this is not necessary, but for learning purposes
                 market_update = nullptr; 
@@ -113,13 +138,19 @@ namespace Exchange {
             OrderBookHashMap ticker_order_book;
             ClientRequestLFQueue *incoming_requests = nullptr;
             ClientResponseLFQueue *outgoing_responses = nullptr;
-            MEMarketUpdateLFQueue *outgoing_market_updates = nullptr;
+            MEMarketUpdateBroadcastQueue *outgoing_market_updates = nullptr;
+            HugePageArena *arena = nullptr; // where the order books live, null means the regular heap
+            const int core_id = -1;
 
             volatile bool running = false;
 
             std::string time_str;
             Logger logger;
 
+            ParkingSignal parking_signal; // the order server's FIFO sequencer wakes us with it when we are parked
+
+            size_t next_market_update_seq_number = 1; // only used to trace the updates, see sendMarketUpdate()
+
     };
 
 }
\ No newline at end of file
@@ -2,9 +2,9 @@
 #include "matching_engine.h"
 
 namespace Exchange {
-    MEOrderBook::MEOrderBook(Logger *logger_param, MatchingEngine *matching_engine_param
-    ): matching_engine(matching_engine_param), orders_at_price_pool(ME_MAX_PRICE_LEVELS),
-    order_pool(ME_MAX_ORDER_IDs), logger(logger_param) {
+    MEOrderBook::MEOrderBook(Logger *logger_param, MatchingEngine *matching_engine_param, HugePageArena *arena
+    ): matching_engine(matching_engine_param), orders_at_price_pool(ME_MAX_PRICE_LEVELS, arena),
+    order_pool(ME_MAX_ORDER_IDs, arena), logger(logger_param) {
 
     }
 
@@ -15,7 +15,7 @@ namespace Exchange {
     // }
 
     MEOrderBook::~MEOrderBook() {
-        logger->log("%:% %() % OrderBook destructor \n % \n",
+        LOG_INFO(*logger, "%:% %() % OrderBook destructor \n % \n",
             __FILE__, __LINE__, __FUNCTION__, 
             Common::getCurrentTimeStr(&time_str),
             toString(false, true)
@@ -70,7 +70,7 @@ namespace Exchange {
             matching_engine->sendMarketUpdate(&market_update);
             START_MEASURE(Exchange_MEOrderBook_removeOrder);
             removeOrder(order);
-            END_MEASURE(Exchange_MEOrderBook_removeOrder, (*logger));
+            END_MEASURE(Exchange_MEOrderBook_removeOrder);
 
         } else {
             // we just tell the market about the modified amount
@@ -102,7 +102,7 @@ namespace Exchange {
                 match(instrument_id, client_id, side, client_order_id,
                     unique_market_order_id, ask_iterator, &leaves_qty
                     );
-                END_MEASURE(Exchange_MEOrderBook_match_buy, (*logger));
+                END_MEASURE(Exchange_MEOrderBook_match_buy);
             }
         }
 
@@ -118,7 +118,7 @@ namespace Exchange {
                 match(instrument_id, client_id, side, client_order_id,
                     unique_market_order_id, bid_iterator, &leaves_qty
                     );
-                END_MEASURE(Exchange_MEOrderBook_match_sell, (*logger));
+                END_MEASURE(Exchange_MEOrderBook_match_sell);
             }
         }
 
@@ -138,7 +138,7 @@ namespace Exchange {
         // 2. we need to find out if it can be executed, only if there is some qty left over do we add it to the order book
         START_MEASURE(Exchange_MEOrderBook_checkForMatch);
         const auto leaves_qty = checkForMatch(client_id, client_order_id, instrument_id, side, price, qty, unique_market_order_id);
-        END_MEASURE(Exchange_MEOrderBook_checkForMatch, (*logger));
+        END_MEASURE(Exchange_MEOrderBook_checkForMatch);
 
         if (LIKELY(leaves_qty)) {
             const Priority priority = getNextPriority(price);
@@ -148,7 +148,7 @@ namespace Exchange {
 
             START_MEASURE(Exchange_MEOrderBook_addOrder);
             addOrder(order);
-            END_MEASURE(Exchange_MEOrderBook_addOrder, (*logger));
+            END_MEASURE(Exchange_MEOrderBook_addOrder);
             
             // now that a new order has entered the order book, we need to notify the market about it
             market_update = {MarketUpdateType::ADD, unique_market_order_id, instrument_id, side,
@@ -185,7 +185,7 @@ namespace Exchange {
                             };
             START_MEASURE(Exchange_MEOrderBook_removeOrder);
             removeOrder(exchange_order);
-            END_MEASURE(Exchange_MEOrderBook_removeOrder, (*logger));
+            END_MEASURE(Exchange_MEOrderBook_removeOrder);
             matching_engine->sendMarketUpdate(&market_update);
         }
         
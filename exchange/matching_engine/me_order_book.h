@@ -3,6 +3,7 @@
 #include "../../utils/orderinfo_types.h"
 #include "../../utils/memory_pool.h"
 #include "../../utils/logger.h"
+#include "../../utils/latency_histogram.h"
 #include "../order_gateway/client_response.h"
 #include "../market_publisher/market_update.h"
 #include "matching_engine_order.h"
@@ -57,7 +58,8 @@ namespace Exchange {
             }
 
         public:
-            MEOrderBook(Logger *logger_param, MatchingEngine *matching_engine_param);
+            // with an 'arena', the mempools are put in it as well, see MatchingEngine for how the book itself gets there
+            MEOrderBook(Logger *logger_param, MatchingEngine *matching_engine_param, HugePageArena *arena = nullptr);
             MEOrderBook() = delete;
             MEOrderBook(const MEOrderBook &) = delete;
             MEOrderBook(const MEOrderBook &&) = delete;
@@ -4,6 +4,7 @@
 
 #include "../../utils/orderinfo_types.h"
 #include "../../utils/lock_free_queue.h"
+#include "../../utils/logtype.h"
 
 using namespace Common;
 
@@ -77,4 +78,11 @@ namespace Exchange {
     
     // queue for the engine to process orders and update the order book
     typedef LFQUEUE<MEClientRequest> ClientRequestLFQueue;
+}
+
+namespace Common {
+    // the logger copies these as they are and only calls toString() on the logger thread, see LogStruct in logtype.h
+    template<> struct LogStruct<Exchange::MEClientRequest> : LogStructOf<LogStructId::ME_CLIENT_REQUEST> {};
+    template<> struct LogStruct<Exchange::OMClientRequest> : LogStructOf<LogStructId::OM_CLIENT_REQUEST> {};
+    inline const bool client_request_log_structs = registerLogStruct<Exchange::MEClientRequest>() && registerLogStruct<Exchange::OMClientRequest>();
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 
 #include "../../utils/orderinfo_types.h"
 #include "../../utils/lock_free_queue.h"
+#include "../../utils/logtype.h"
 
 using namespace Common;
 
@@ -87,4 +88,11 @@ namespace Exchange {
 
     // queue for the engine to send status updates of orders to clients
     typedef LFQUEUE<MEClientResponse> ClientResponseLFQueue;
+}
+
+namespace Common {
+    // lets log() take responses by value, they only get turned into text on the logger thread (see LogStruct in logtype.h)
+    template<> struct LogStruct<Exchange::MEClientResponse> : LogStructOf<LogStructId::ME_CLIENT_RESPONSE> {};
+    template<> struct LogStruct<Exchange::OMClientResponse> : LogStructOf<LogStructId::OM_CLIENT_RESPONSE> {};
+    inline const bool client_response_log_structs = registerLogStruct<Exchange::MEClientResponse>() && registerLogStruct<Exchange::OMClientResponse>();
 }
\ No newline at end of file
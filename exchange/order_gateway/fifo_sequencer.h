@@ -3,6 +3,7 @@
 #include "utils/thread_utils.h"
 #include "utils/macros.h"
 #include "utils/logger.h"
+#include "utils/trace.h"
 
 #include "order_gateway/client_request.h"
 
@@ -55,7 +56,7 @@ namespace Exchange {
                     return;
                 }
 
-                logger->log("%:% %() % Processing % requests \n",
+                LOG_TRACE(*logger, "%:% %() % Processing % requests \n",
                     __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
                     pending_size
                 );
@@ -66,19 +67,22 @@ namespace Exchange {
                 // write all of them to the LFQ so the matching engine can process them
                 for (size_t i = 0; i < pending_size; ++i) {
                     const auto &client_request = pending_client_requests.at(i);
-                    logger->log("%:% %() % FIFO sending to M. E. RX:% Req:% \n",
+                    LOG_DEBUG(*logger, "%:% %() % FIFO sending to M. E. RX:% Req:% \n",
                         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                        client_request.recv_time, client_request.request.toString()
+                        client_request.recv_time, client_request.request
                     );
 
                     MEClientRequest * next_write = incoming_requests->getNextWriteTo();
                     *next_write = std::move(client_request.request);
-                    incoming_requests->updateWriteIndex();
+                    incoming_requests->stageWriteIndex();
 
                     // second stage a client request goes through in the exchange
-                    TTT_MEASURE(T2_OrderServer_LFQueue_write, (*logger));
+                    TRACE_HOP(T2_OrderServer_LFQueue_write, client_request.request.client_id, client_request.request.order_id);
                 } 
 
+                // the matching engine sees the whole sorted batch at once, with a single store
+                incoming_requests->commitWrites();
+
                 // empty our sequencer
                 pending_size = 0;
             }
@@ -5,11 +5,14 @@
 #include "utils/thread_utils.h"
 #include "utils/macros.h"
 #include "utils/tcp_server.h"
+#include "utils/latency_histogram.h"
+#include "utils/trace.h"
 
 #include "client_request.h"
 #include "client_response.h"
 #include "utils/exchange_limits.h"
 #include "fifo_sequencer.h"
+#include "order_transport.h"
 
 namespace Exchange {
 
@@ -21,6 +24,8 @@ namespace Exchange {
         private:
             const std::string interface;
             const int port = 0;
+            const int core_id = -1;
+            const OrderTransport transport = OrderTransport::TCP;
 
             ClientResponseLFQueue * outgoing_responses = nullptr; // from matching engine
             
@@ -34,10 +39,17 @@ namespace Exchange {
             std::array<size_t, ME_MAX_NUM_CLIENTS> cid_next_expected_seq_number; 
             std::array<Common::TCPSocket *, ME_MAX_NUM_CLIENTS> cid_tcp_socket;
 
+            // the sequence numbers of the responses in the batch we are sending, the sockets gather() them from here
+            // so they have to stay put until tcp_server.sendGathered(), the response bodies are gathered straight out of the LFQ
+            std::array<size_t, Common::LFQueueDrainBatchSize> batch_seq_numbers;
+
             Common::TCPServer tcp_server;
+            OrderSessionServer * session_server = nullptr; // only with OrderTransport::SHM, created in start()
 
             FIFOSequencer fifo_sequencer;
 
+            ParkingSignal parking_signal; // the matching engine wakes us with it when we are parked
+
         public:
 
             // this function defines what we want the server to do whenever it receives a message
@@ -45,24 +57,29 @@ namespace Exchange {
             void recvCallback(TCPSocket *socket, Nanos rx_time) noexcept {
                 
                 // start the clock! First time a client request hits the exchange
-                TTT_MEASURE(T1_OrderServer_TCP_read, logger);
+                // note that we only know which orders arrived once we've parsed them, so they all get this timestamp
+                const Nanos callback_time = Common::getCurrentNanosTSC();
 
-                logger.log("%:% %() % Received socket:% len% rx:% \n",
+                LOG_TRACE(logger, "%:% %() % Received socket:% len% rx:% \n",
                     __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                    socket->socket_file_descriptor, socket->next_receive_valid_index, rx_time
+                    socket->socket_file_descriptor, socket->receive_buffer.readable(), rx_time
                 );
 
                 // first we have to check if we received enough data for an OMClientRequest
-                if (socket->next_receive_valid_index >= sizeof(OMClientRequest)) {
+                const char * received = socket->receive_buffer.readPtr();
+                const size_t received_length = socket->receive_buffer.readable();
+                if (received_length >= sizeof(OMClientRequest)) {
 
                     // if we have, let's fetch all of them that we have and send them into the queue
+                    // note that the buffer is a mirrored ring, so a request that wraps around its end is still contiguous here
                     size_t i = 0;
-                    for (; i + sizeof(OMClientRequest) <= socket->next_receive_valid_index; i += sizeof(OMClientRequest)) {
-                        const OMClientRequest * request = reinterpret_cast<const OMClientRequest *>(socket->receive_buffer + i);
+                    for (; i + sizeof(OMClientRequest) <= received_length; i += sizeof(OMClientRequest)) {
+                        const OMClientRequest * request = reinterpret_cast<const OMClientRequest *>(received + i);
+                        TRACE_HOP_AT(T1_OrderServer_TCP_read, request->me_client_request.client_id, request->me_client_request.order_id, callback_time);
 
-                        logger.log("%:% %() % Gateway received OMClientRequest:% \n",
+                        LOG_DEBUG(logger, "%:% %() % Gateway received OMClientRequest:% \n",
                             __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                            request->toString()
+                            *request
                         );
 
                         // PART 1: Check that the request is valid
@@ -75,7 +92,7 @@ namespace Exchange {
                         // if there was an exisiting socket, but it doesn't match our current socket, throw an error
                         // unique clients must only communicate through their assigned socket from the server
                         if (cid_tcp_socket[request->me_client_request.client_id] != socket) {
-                            logger.log("%:% %() % Received ClientRequest from ClientId:% on a different socket:% but expected:% \n",
+                            LOG_WARN(logger, "%:% %() % Received ClientRequest from ClientId:% on a different socket:% but expected:% \n",
                                 __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
                                 request->me_client_request.client_id, socket->socket_file_descriptor,
                                 cid_tcp_socket[request->me_client_request.client_id]->socket_file_descriptor
@@ -83,29 +100,111 @@ namespace Exchange {
                             continue;
                         } 
 
-                        // now, lets make sure the sequence number is correct
-                        size_t &next_expected_sequence_number = cid_next_expected_seq_number[request->me_client_request.client_id];
-                        if (request->seq_number != next_expected_sequence_number) {
-                            logger.log("%:% %() % Incorrect sequence number. ClientId:% SeqNum expected:% but received:% \n",
+                        sequenceClientRequest(request, rx_time);
+                    }
+
+                    // after we have finished processing as many messages as we can, we give their bytes back to the socket's buffer
+                    // whatever is left of a partial request stays where it is until the rest of it arrives
+                    socket->receive_buffer.consume(i);
+                }
+            }
+
+            // the checks a request goes through after we know which client it came from, whichever transport it came in on
+            void sequenceClientRequest(const OMClientRequest * request, Nanos rx_time) noexcept {
+                // now, lets make sure the sequence number is correct
+                size_t &next_expected_sequence_number = cid_next_expected_seq_number[request->me_client_request.client_id];
+                if (request->seq_number != next_expected_sequence_number) {
+                    LOG_WARN(logger, "%:% %() % Incorrect sequence number. ClientId:% SeqNum expected:% but received:% \n",
+                        __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+                        request->me_client_request.client_id, next_expected_sequence_number,
+                        request->seq_number
+                    );
+                    return;
+                }
+
+                // PART 2: forward the request and time to the FIFO sequencer, so it can be sent to the m.e.
+                // note that we only send the me_client_request, in the type the m.e. expects
+                ++next_expected_sequence_number;
+                START_MEASURE(Exchange_FIFOSequencer_addClientRequest);
+                fifo_sequencer.addClientRequest(rx_time, request->me_client_request);
+                END_MEASURE(Exchange_FIFOSequencer_addClientRequest);
+            }
+
+            /*
+                the shared memory version of the tcp server's poll() + sendAndReceive() + recvCallback()
+                picks up new (and departed) sessions, then reads every session's request ring, returns whether we read anything
+            */
+            bool receiveFromSessions() noexcept {
+                if (UNLIKELY(!session_server->poll())) {
+                    LOG_WARN(logger, "%:% %() % Could not open a client session: % \n",
+                        __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), session_server->errorString()
+                    );
+                }
+
+                // a client that (re)connected is a fresh order gateway, it counts its requests from 1 and expects its responses from 1
+                for (const size_t session_client_id : session_server->openedClients()) {
+                    LOG_INFO(logger, "%:% %() % Opened a session for ClientId:%, resetting its sequence numbers \n",
+                        __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), session_client_id
+                    );
+                    cid_next_expected_seq_number[session_client_id] = 1;
+                    cid_next_outgoing_seq_number[session_client_id] = 1;
+                }
+
+                // start the clock! the same hop as a tcp read, so traces from both transports line up
+                const Nanos callback_time = Common::getCurrentNanosTSC();
+
+                // the sequencer can only hold so many requests at a time, whatever doesn't fit waits in its ring for the next pass
+                size_t budget = ME_MAX_PENDING_REQUESTS;
+                bool data_read = false;
+                for (const size_t session_client_id : session_server->connectedClients()) {
+                    auto &requests = session_server->session(session_client_id)->requests();
+                    for (auto request = requests.getNextRead(); request && budget; request = requests.getNextRead(), --budget) {
+                        TRACE_HOP_AT(T1_OrderServer_TCP_read, request->me_client_request.client_id, request->me_client_request.order_id, callback_time);
+
+                        LOG_DEBUG(logger, "%:% %() % Session received OMClientRequest:% \n",
+                            __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+                            *request
+                        );
+
+                        // a session belongs to one client id, the same as a socket does
+                        if (request->me_client_request.client_id != session_client_id) {
+                            LOG_WARN(logger, "%:% %() % Received ClientRequest from ClientId:% on the session of ClientId:% \n",
                                 __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                                request->me_client_request.client_id, next_expected_sequence_number,
-                                request->seq_number
+                                request->me_client_request.client_id, session_client_id
                             );
-                            continue;
+                        } else {
+                            sequenceClientRequest(request, Common::getCurrentNanos());
                         }
-
-                        // PART 2: forward the request and time to the FIFO sequencer, so it can be sent to the m.e.
-                        // note that we only send the me_client_request, in the type the m.e. expects
-                        ++next_expected_sequence_number;
-                        START_MEASURE(Exchange_FIFOSequencer_addClientRequest);
-                        fifo_sequencer.addClientRequest(rx_time, request->me_client_request);
-                        END_MEASURE(Exchange_FIFOSequencer_addClientRequest, logger);
+                        requests.updateReadIndex();
+                        data_read = true;
                     }
+                }
+
+                if (data_read) {
+                    recvFinishedCallback();
+                }
+                return data_read;
+            }
 
-                    // after we have finished processing as many messages as we can, we update the socket's buffer
-                    memcpy(socket->receive_buffer, socket->receive_buffer + i, socket->next_receive_valid_index - i);
-                    socket->next_receive_valid_index -= i;
+            // writes the response into its client's session, the shared memory version of the socket sends in run()
+            void sendToSession(size_t seq_number, const MEClientResponse * client_response) noexcept {
+                auto session = session_server->session(client_response->client_id);
+                OMClientResponse * next_write = session ? session->responses().getNextWriteTo() : nullptr;
+
+                // we can't wait for a client that stopped reading, it just sees a gap in its sequence numbers
+                if (UNLIKELY(!next_write)) {
+                    LOG_WARN(logger, "%:% %() % Dropping response, ClientId:% has % \n",
+                        __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+                        client_response->client_id, (session ? "a full session" : "no session")
+                    );
+                    return;
                 }
+
+                START_MEASURE(Exchange_ShmSession_send);
+                next_write->seq_number = seq_number;
+                next_write->me_client_response = *client_response;
+                session->responses().updateWriteIndex();
+                END_MEASURE(Exchange_ShmSession_send);
             }
 
             // this is called by the server after it has called the recv callback on all available read sockets
@@ -113,18 +212,23 @@ namespace Exchange {
             void recvFinishedCallback() noexcept {
                 START_MEASURE(Exchange_FIFOSequencer_sequenceAndPublish);
                 fifo_sequencer.sequenceAndPublish();
-                END_MEASURE(Exchange_FIFOSequencer_sequenceAndPublish, logger);
+                END_MEASURE(Exchange_FIFOSequencer_sequenceAndPublish);
             }
 
 
+            // the server thread gets pinned to 'core_id' (-1 to leave it unpinned)
+            // note that the client sockets (and their buffers) are created by that thread when it accepts them, so they are already on its numa node
+            // with OrderTransport::SHM we don't listen on 'port' at all, it only names our session directory
             OrderServer(ClientRequestLFQueue * client_requests, ClientResponseLFQueue * client_responses,
-                        const std::string &interface_param, int port_param
-                        ): interface(interface_param), port(port_param), outgoing_responses(client_responses),
+                        const std::string &interface_param, int port_param, int core_id_param = -1,
+                        OrderTransport transport_param = OrderTransport::TCP
+                        ): interface(interface_param), port(port_param), core_id(core_id_param), transport(transport_param), outgoing_responses(client_responses),
                         logger("exchange_order_server.log"), tcp_server(logger), fifo_sequencer(client_requests, &logger) {
                 
                 cid_next_outgoing_seq_number.fill(1);
                 cid_next_expected_seq_number.fill(1);
                 cid_tcp_socket.fill(nullptr);
+                outgoing_responses->setConsumerSignal(&parking_signal);
 
                 tcp_server.receive_callback = [this] (auto socket, auto rx_time) {
                     recvCallback(socket, rx_time);
@@ -145,13 +249,21 @@ namespace Exchange {
                 // this is normal for thread-based applications to wait for some time to let any pending tasks finish
                 using namespace std::literals::chrono_literals;
                 std::this_thread::sleep_for(1s);
+
+                delete session_server;
+                session_server = nullptr;
             };
 
             void start() {
                 running = true;
-                tcp_server.listen(interface, port);
+                if (transport == OrderTransport::SHM) {
+                    session_server = new OrderSessionServer(orderSessionPath(port));
+                    ASSERT(session_server->isOpen(), "Unable to create the order session directory, error: " + session_server->errorString());
+                } else {
+                    tcp_server.listen(interface, port);
+                }
 
-                ASSERT(Common::createAndStartThread(-1, "Exchange/OrderServer", [this]() {run();}) != nullptr, 
+                ASSERT(Common::createAndStartThread(core_id, "Exchange/OrderServer", [this]() {run();}) != nullptr, 
                         "failed to start OrderServer thread");
             };
 
@@ -161,42 +273,83 @@ namespace Exchange {
 
             // runs the server that drives the order gateway
             void run() noexcept {
-                logger.log("%:% %() % Order server running... \n",
+                LOG_INFO(logger, "%:% %() % Order server running... \n",
                     __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str)
                 );
 
+                // note that nothing can wake us up when a client sends something, a parked server only notices it once its park times out
+                IdleStrategy idle_strategy(currentThreadPlacement().idle_mode, &parking_signal);
+
                 while(running) {
                     // run the server
-                    tcp_server.poll();
-                    tcp_server.sendAndReceive();
+                    bool data_read = false;
+                    if (transport == OrderTransport::SHM) {
+                        data_read = receiveFromSessions();
+                    } else {
+                        tcp_server.poll();
+                        data_read = tcp_server.sendAndReceive();
+                    }
 
                     // also want to send out the client responses to placed orders
-                    for (auto client_response = outgoing_responses->getNextRead(); outgoing_responses->size() && client_response; 
-                        client_response = outgoing_responses->getNextRead()) {
+                    const MEClientResponse * client_responses = nullptr;
+                    const size_t num_responses = outgoing_responses->peekReads(Common::LFQueueDrainBatchSize, &client_responses);
+                    for (size_t i = 0; i < num_responses; ++i) {
+                        const MEClientResponse * client_response = &client_responses[i];
 
                         // almost at the last step to delivering a receipt to the client
-                        TTT_MEASURE(T5t_OrderServer_LFQueue_read, logger);
+                        TRACE_HOP(T5t_OrderServer_LFQueue_read, client_response->client_id, client_response->client_order_id);
 
                         auto &next_outgoing_seq_number = cid_next_outgoing_seq_number[client_response->client_id];
-                        logger.log("%:% %() % Processing cid:% seq:% % \n",
+                        LOG_DEBUG(logger, "%:% %() % Processing cid:% seq:% % \n",
                             __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                            client_response->client_id, next_outgoing_seq_number, client_response->toString()
+                            client_response->client_id, next_outgoing_seq_number, *client_response
                         );
 
-                        // note that we effectively send OMClientResponse by stacking the sends
-                        ASSERT(cid_tcp_socket[client_response->client_id] != nullptr,
-                         "Don't have a TCPSocket for ClientId:" + std::to_string(client_response->client_id));
-
-                        START_MEASURE(Exchange_TCPSOCKET_send);
-                        cid_tcp_socket[client_response->client_id]->send(&next_outgoing_seq_number, sizeof(next_outgoing_seq_number));
-                        cid_tcp_socket[client_response->client_id]->send(client_response, sizeof(MEClientResponse));
-                        END_MEASURE(Exchange_TCPSOCKET_send, logger);
-                        outgoing_responses->updateReadIndex();
+                        if (transport == OrderTransport::SHM) {
+                            sendToSession(next_outgoing_seq_number, client_response);
+                        } else {
+                            // note that we effectively send OMClientResponse by stacking the sends
+                            ASSERT(cid_tcp_socket[client_response->client_id] != nullptr,
+                             "Don't have a TCPSocket for ClientId:" + std::to_string(client_response->client_id));
+
+                            // the same as a full session, we don't wait for a client whose socket isn't keeping up
+                            // note that it has been over its high water mark for a while by now, so we've already stopped taking its requests
+                            if (UNLIKELY(cid_tcp_socket[client_response->client_id]->sendBufferSpace() < sizeof(next_outgoing_seq_number) + sizeof(MEClientResponse))) {
+                                LOG_WARN(logger, "%:% %() % Dropping response, ClientId:% has a full send buffer \n",
+                                    __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), client_response->client_id
+                                );
+                                ++next_outgoing_seq_number;
+                                continue;
+                            }
+
+                            // nothing gets copied here, the header and the body go out together in sendGathered() below
+                            START_MEASURE(Exchange_TCPSOCKET_send);
+                            batch_seq_numbers[i] = next_outgoing_seq_number;
+                            cid_tcp_socket[client_response->client_id]->gather(&batch_seq_numbers[i], sizeof(size_t));
+                            cid_tcp_socket[client_response->client_id]->gather(client_response, sizeof(MEClientResponse));
+                            END_MEASURE(Exchange_TCPSOCKET_send);
+                        }
 
                         ++next_outgoing_seq_number;
 
                         // stop the clock! last time we process a client request
-                        TTT_MEASURE(T6t_OrderServer_TCP_write, logger);
+                        TRACE_HOP(T6t_OrderServer_TCP_write, client_response->client_id, client_response->client_order_id);
+                    }
+
+                    if (num_responses) {
+                        // one sendmsg() per client for the whole batch, and it has to happen before we hand the responses back to the LFQ
+                        if (transport == OrderTransport::TCP) {
+                            START_MEASURE(Exchange_TCPServer_sendGathered);
+                            tcp_server.sendGathered();
+                            END_MEASURE(Exchange_TCPServer_sendGathered);
+                        }
+                        outgoing_responses->releaseReads(num_responses);
+                    }
+
+                    if (data_read || num_responses) {
+                        idle_strategy.reset();
+                    } else {
+                        idle_strategy.idle([this]() { return outgoing_responses->size() > 0; });
                     }
                 }
             }
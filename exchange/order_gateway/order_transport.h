@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdlib>
+#include <string>
+
+#include "../../utils/shm_session.h"
+#include "../../utils/exchange_limits.h"
+
+#include "client_request.h"
+#include "client_response.h"
+
+namespace Exchange {
+
+    /*
+        How order requests and responses travel between a client's OrderGateway and the exchange's OrderServer
+
+        TCP works from anywhere, SHM only works for clients on the same host as the exchange, but skips the kernel
+        and the loopback stack on both sides of every round trip (see utils/shm_session.h)
+        the messages are the same OMClientRequest/OMClientResponse either way, with the same sequence number checks
+
+        note that the server only serves one transport at a time, so all of its clients have to pick the same one
+    */
+    enum class OrderTransport : uint8_t {
+        TCP = 0,
+        SHM = 1
+    };
+
+    inline std::string orderTransportToString(OrderTransport transport) {
+        switch (transport) {
+            case OrderTransport::TCP: return "tcp";
+            case OrderTransport::SHM: return "shm";
+        }
+        return "UNKNOWN";
+    }
+
+    // from the ORDER_TRANSPORT environment variable ("tcp" or "shm"), TCP if it isn't set
+    inline OrderTransport orderTransportFromEnvironment() {
+        const char *name = std::getenv("ORDER_TRANSPORT");
+        if (!name || std::string(name) == "tcp") {
+            return OrderTransport::TCP;
+        }
+        ASSERT(std::string(name) == "shm", "ORDER_TRANSPORT has to be 'tcp' or 'shm', not: " + std::string(name));
+        return OrderTransport::SHM;
+    }
+
+    typedef ShmSessionServer<OMClientRequest, OMClientResponse, ME_ORDER_SESSION_RING_SIZE, ME_MAX_NUM_CLIENTS> OrderSessionServer;
+    typedef ShmSessionClient<OMClientRequest, OMClientResponse, ME_ORDER_SESSION_RING_SIZE, ME_MAX_NUM_CLIENTS> OrderSessionClient;
+
+    // the server's session directory, the port tells apart exchanges running on the same host
+    inline std::string orderSessionPath(int port) {
+        return shmDirectory() + "/exchange_order_sessions." + std::to_string(port);
+    }
+
+}
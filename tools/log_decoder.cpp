@@ -0,0 +1,39 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "utils/log_decoder.h"
+
+// every struct the exchange or the trading client logs as is (see LogStruct in utils/logtype.h), so we can format them
+#include "exchange/order_gateway/client_request.h"
+#include "exchange/order_gateway/client_response.h"
+#include "exchange/market_publisher/market_update.h"
+#include "trading/strategy/om_order.h"
+#include "trading/strategy/market_order.h"
+
+/*
+    Turns a log file written by a Common::Logger in LogMode::BINARY into text
+
+    usage: log_decoder <binary log file> [--timestamps]
+    the text goes to stdout, '--timestamps' puts the nanoseconds since the epoch each line was logged at in front of it
+*/
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3 || (argc == 3 && std::string(argv[2]) != "--timestamps")) {
+        std::cerr << "usage: " << argv[0] << " <binary log file> [--timestamps]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::ifstream in(argv[1], std::ios::in | std::ios::binary);
+    if (!in.is_open()) {
+        std::cerr << "could not open " << argv[1] << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::string error;
+    if (!Common::decodeLogFile(in, std::cout, argc == 3, &error)) {
+        std::cerr << argv[1] << ": " << error << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
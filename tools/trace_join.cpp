@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "utils/trace_reader.h"
+
+/*
+    Joins the tick-to-trade trace rings (see utils/trace.h) of the exchange and every trading client
+    and prints how long each hop took, as percentiles over all the traced orders and market data updates
+
+    usage: trace_join [directory] [--orders] [--unlink] [--pid <pid>]... [--clean]
+    'directory' defaults to where the processes write their rings (EXCHANGE_TRACE_DIR, or /dev/shm),
+    '--orders' also prints every traced journey, and '--unlink' deletes the rings once they are read
+    '--pid' only joins the rings of the given processes (e.g. the exchange and clients of one run, when older runs' rings are still around)
+    '--clean' just deletes the rings (of the given pids, or all of them), run it before a run so its join doesn't pick up older ones
+*/
+int main(int argc, char **argv) {
+    std::string directory = Common::traceDirectory();
+    bool per_order = false;
+    bool unlink_rings = false;
+    bool clean = false;
+    std::vector<int64_t> pids;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--orders") {
+            per_order = true;
+        } else if (arg == "--unlink") {
+            unlink_rings = true;
+        } else if (arg == "--clean") {
+            clean = true;
+        } else if (arg == "--pid" && i + 1 < argc) {
+            pids.push_back(std::strtoll(argv[++i], nullptr, 10));
+        } else if (arg.rfind("--", 0) != 0) {
+            directory = arg;
+        } else {
+            std::cerr << "usage: " << argv[0] << " [directory] [--orders] [--unlink] [--pid <pid>]... [--clean]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::vector<std::string> paths = Common::findTraceRings(directory);
+    if (!pids.empty()) {
+        paths.erase(std::remove_if(paths.begin(), paths.end(), [&pids](const std::string &path) {
+            return std::find(pids.begin(), pids.end(), Common::traceRingPid(path)) == pids.end();
+        }), paths.end());
+    }
+
+    if (clean) {
+        for (const std::string &path : paths) {
+            ::unlink(path.c_str());
+        }
+        std::cout << "deleted " << paths.size() << " trace rings from " << directory << std::endl;
+        return EXIT_SUCCESS;
+    }
+
+    if (paths.empty()) {
+        std::cerr << "no trace rings in " << directory << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::vector<Common::TraceEvent> events;
+    for (const std::string &path : paths) {
+        std::string error;
+        if (!Common::readTraceRing(path, &events, &error)) {
+            std::cerr << path << ": " << error << std::endl;
+        }
+        if (unlink_rings) {
+            ::unlink(path.c_str());
+        }
+    }
+
+    std::cout << "read " << events.size() << " trace records from " << paths.size() << " rings" << std::endl;
+    Common::joinTraces(std::move(events), per_order, std::cout);
+
+    return EXIT_SUCCESS;
+}
@@ -36,12 +36,21 @@ namespace Trading {
     }
 
     void MarketDataConsumer::run() {
-        logger.log("%:% %() % \n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str));
+        LOG_INFO(logger, "%:% %() % \n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str));
         
+        // all of our work comes in off the sockets, so there is nobody to wake us up, 'park' gets treated like 'backoff'
+        IdleStrategy idle_strategy(currentThreadPlacement().idle_mode);
+
         while (running) {
             // check for updates from the market
-            incremental_mcast_socket.sendAndRecv();
-            snapshot_mcast_socket.sendAndRecv();
+            const bool incremental_read = incremental_mcast_socket.sendAndRecv();
+            const bool snapshot_read = snapshot_mcast_socket.sendAndRecv();
+
+            if (incremental_read || snapshot_read) {
+                idle_strategy.reset();
+            } else {
+                idle_strategy.idle();
+            }
         }
     }
 
@@ -52,8 +61,8 @@ namespace Trading {
     // else we will extract the MEMarketUpdate and send it to the client order book
     void MarketDataConsumer::recvCallback(MulticastSocket *socket) noexcept {
 
-        // first time data enters the client
-        TTT_MEASURE(T7_MarketDataConsumer_UDP_read, logger);
+        // first time data enters the client, the updates in this batch of datagrams all arrived at this time
+        const Nanos callback_time = Common::getCurrentNanosTSC();
         START_MEASURE(Trading_MarketDataConsumer_recvCallback);
 
         // we need to first determine if we are receiving snapshot recovery data or an incremental update
@@ -61,9 +70,7 @@ namespace Trading {
 
         // if we aren't in the recovery phase, we can just ignore any snapshot data
         if (UNLIKELY(is_snapshot && !in_recovery)) {
-            socket->next_receive_valid_index = 0;
-
-            logger.log("%:% %() % WARNING: Not expecting snapshot messages.\n",
+            LOG_WARN(logger, "%:% %() % WARNING: Not expecting snapshot messages.\n",
                 __FILE__, __LINE__, __FUNCTION__,
                 Common::getCurrentTimeStr(&time_str)
             );
@@ -71,66 +78,104 @@ namespace Trading {
             return;
         }
 
-        // otherwise lets read the data
-        if (socket->next_receive_valid_index >= sizeof(Exchange::MDPMarketUpdate)) {
-            size_t i = 0;
-            for (; i + sizeof(Exchange::MDPMarketUpdate) <= socket->next_receive_valid_index; i += sizeof(Exchange::MDPMarketUpdate)) {
-                auto request = reinterpret_cast<const Exchange::MDPMarketUpdate *>(socket->inbound_data.data() + i);
+        // otherwise lets read the data, the socket hands us a whole batch of datagrams and each one only holds whole updates
+        for (size_t datagram_i = 0; datagram_i < socket->num_received_datagrams; ++datagram_i) {
+            const char * datagram = socket->receivedDatagram(datagram_i);
+            const size_t datagram_length = socket->receivedDatagramLength(datagram_i);
 
-                logger.log("%:% %() % Received % socket len:% %\n",
-                    __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                    (is_snapshot ? "snapshot" : "incremental"), sizeof(Exchange::MDPMarketUpdate),
-                    request->toString()
+            // the snapshot feed is just MDPMarketUpdates back to back
+            if (is_snapshot) {
+                size_t i = 0;
+                for (; i + sizeof(Exchange::MDPMarketUpdate) <= datagram_length; i += sizeof(Exchange::MDPMarketUpdate)) {
+                    onMarketUpdate(is_snapshot, reinterpret_cast<const Exchange::MDPMarketUpdate *>(datagram + i), callback_time);
+                }
+
+                if (UNLIKELY(i != datagram_length)) {
+                    LOG_WARN(logger, "%:% %() % Ignoring % trailing bytes of a % byte snapshot datagram \n",
+                        __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+                        datagram_length - i, datagram_length
+                    );
+                }
+                continue;
+            }
+
+            // the incremental feed is one packet per datagram, a header and then that many updates, numbered from the header's first_seq_number
+            // if we drop a packet, the sequence numbers after it will show the gap
+            const auto header = Exchange::MDPPacketHeader::fromDatagram(datagram, datagram_length);
+            if (UNLIKELY(!header)) {
+                LOG_WARN(logger, "%:% %() % Dropping a % byte incremental datagram that isn't a whole packet \n",
+                    __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), datagram_length
                 );
+                continue;
+            }
 
-                // so it is possible we are already in recovery OR we saw a gap in the sequence nums
-                const bool already_in_recovery = in_recovery;
-                in_recovery = (already_in_recovery || request->seq_number != next_exp_inc_seq_num);
+            LOG_TRACE(logger, "%:% %() % Received % %ns after it was sent \n",
+                __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+                *header, Common::getCurrentNanos() - header->send_time
+            );
 
-                if (UNLIKELY(in_recovery)) {
+            const auto updates = reinterpret_cast<const Exchange::MEMarketUpdate *>(datagram + sizeof(Exchange::MDPPacketHeader));
+            for (size_t i = 0; i < header->num_updates; ++i) {
+                const Exchange::MDPMarketUpdate request{header->first_seq_number + i, updates[i]};
+                onMarketUpdate(is_snapshot, &request, callback_time);
+            }
+        }
 
-                    // if we were not in recovery before and we just saw a mismatch seq num
-                    // we now have to activate recovery mode and listen to the snapshot broadcast
-                    if(UNLIKELY(!already_in_recovery)) {
-                        logger.log("%:% %() % Packet drops on % socket! SeqNum expected:% received:% \n",
-                            __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                            (is_snapshot ? "snapshot" : "incremental"), next_exp_inc_seq_num, request->seq_number
-                        );
+        END_MEASURE(Trading_MarketDataConsumer_recvCallback);
+    }
 
-                        // begin recovery phase - subscribe to snapshot multicast
-                        startSnapshotSync();
-                    }
+    // one update off either feed, straight to the trading engine if it's the next one we expected, otherwise into recovery
+    void MarketDataConsumer::onMarketUpdate(bool is_snapshot, const Exchange::MDPMarketUpdate * request, Nanos callback_time) noexcept {
+        if (!is_snapshot) {
+            TRACE_HOP_AT(T7_MarketDataConsumer_UDP_read, Common::TRACE_MARKET_DATA, request->seq_number, callback_time);
+        }
 
-                    // we'll send this message to processing, it could be snapshot OR incremental data
-                    queueMessage(is_snapshot, request);
+        LOG_TRACE(logger, "%:% %() % Received % socket len:% %\n",
+            __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+            (is_snapshot ? "snapshot" : "incremental"), sizeof(Exchange::MDPMarketUpdate),
+            *request
+        );
 
-                } else if (!is_snapshot) { 
-                    // only care if it is incremental updates
-                    // note this is 'normal' operation when not in recovery
+        // so it is possible we are already in recovery OR we saw a gap in the sequence nums
+        const bool already_in_recovery = in_recovery;
+        in_recovery = (already_in_recovery || request->seq_number != next_exp_inc_seq_num);
 
-                    // acknowledge that we got an incremental update
-                    logger.log("%:% %() % Incremental Request: %\n",
-                        __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                        request->toString()
-                    );
-                    ++next_exp_inc_seq_num;
+        if (UNLIKELY(in_recovery)) {
 
-                    // great! let's send it to the client's order book
-                    Exchange::MEMarketUpdate * next_write = incoming_md_updates->getNextWriteTo();
-                    *next_write = std::move(request->me_market_update);
-                    incoming_md_updates->updateWriteIndex();
+            // if we were not in recovery before and we just saw a mismatch seq num
+            // we now have to activate recovery mode and listen to the snapshot broadcast
+            if(UNLIKELY(!already_in_recovery)) {
+                LOG_WARN(logger, "%:% %() % Packet drops on % socket! SeqNum expected:% received:% \n",
+                    __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+                    (is_snapshot ? "snapshot" : "incremental"), next_exp_inc_seq_num, request->seq_number
+                );
 
-                    // the update has been sent to the client's order book
-                    TTT_MEASURE(T8_MarketDataConsumer_LFQueue_write, logger);
-                }
+                // begin recovery phase - subscribe to snapshot multicast
+                startSnapshotSync();
             }
 
-            // let's update the socket's state based on how much we data we read
-            memcpy(socket->inbound_data.data(), socket->inbound_data.data() + i, socket->next_receive_valid_index - i);
-            socket->next_receive_valid_index -= i;
-        }
+            // we'll send this message to processing, it could be snapshot OR incremental data
+            queueMessage(is_snapshot, request);
+
+        } else if (!is_snapshot) { 
+            // only care if it is incremental updates
+            // note this is 'normal' operation when not in recovery
 
-        END_MEASURE(Trading_MarketDataConsumer_recvCallback, logger);
+            // acknowledge that we got an incremental update
+            LOG_DEBUG(logger, "%:% %() % Incremental Request: %\n",
+                __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+                *request
+            );
+            ++next_exp_inc_seq_num;
+
+            // great! let's send it to the client's order book
+            Exchange::MEMarketUpdate * next_write = incoming_md_updates->getNextWriteTo();
+            *next_write = std::move(request->me_market_update);
+            incoming_md_updates->updateWriteIndex();
+
+            // the update has been sent to the client's order book
+            TRACE_HOP(T8_MarketDataConsumer_LFQueue_write, Common::TRACE_MARKET_DATA, request->seq_number);
+        }
     }
 
     /*
@@ -154,7 +199,7 @@ namespace Trading {
         // let's check if we have a start message
         const auto &first_snapshot_message = snapshot_queued_messages.begin()->second;
         if (first_snapshot_message.type != Exchange::MarketUpdateType::SNAPSHOT_START) {
-            logger.log("%:% %() % Returning because we have not seen a SNAPSHOT_START yet.\n",
+            LOG_DEBUG(logger, "%:% %() % Returning because we have not seen a SNAPSHOT_START yet.\n",
                 __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str)
             );
 
@@ -171,16 +216,16 @@ namespace Trading {
         for (auto &snap_queue_entry : snapshot_queued_messages) {
 
             // log the map entry
-            logger.log("%:% %() % % => %\n",
+            LOG_TRACE(logger, "%:% %() % % => %\n",
                 __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                snap_queue_entry.first, snap_queue_entry.second.toString()
+                snap_queue_entry.first, snap_queue_entry.second
             );
 
             // check sequence number
             if (snap_queue_entry.first != next_snapshot_seq) {
-                logger.log("%:% %() % Detected gap in snapshot stream! Expected:% found:% %.\n",
+                LOG_WARN(logger, "%:% %() % Detected gap in snapshot stream! Expected:% found:% %.\n",
                     __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                    next_snapshot_seq, snap_queue_entry.first, snap_queue_entry.second.toString()
+                    next_snapshot_seq, snap_queue_entry.first, snap_queue_entry.second
                 );
 
                 have_complete_snapshot = false;
@@ -200,7 +245,7 @@ namespace Trading {
 
         // we might not have had a complete snapshot, let's check that
         if (!have_complete_snapshot) {
-            logger.log("%:% %() % Returning because found gaps in snapshot stream. \n",
+            LOG_DEBUG(logger, "%:% %() % Returning because found gaps in snapshot stream. \n",
                 __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str)
             );
             snapshot_queued_messages.clear();
@@ -210,7 +255,7 @@ namespace Trading {
         // Nice! So now let's check if the snapshot is over or not yet
         const auto &last_snapshot_msg = snapshot_queued_messages.rbegin()->second;
         if (last_snapshot_msg.type != Exchange::MarketUpdateType::SNAPSHOT_END) {
-            logger.log("%:% %() % Haven't seen a SNAPSHOT_END message yet! Returning... \n",
+            LOG_DEBUG(logger, "%:% %() % Haven't seen a SNAPSHOT_END message yet! Returning... \n",
                 __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str)            
             );
             
@@ -234,9 +279,9 @@ namespace Trading {
             ) {
             
             // log msg
-            logger.log("%:% %() % Next incremental message; next_exp: % vs. seq: % %.\n",
+            LOG_TRACE(logger, "%:% %() % Next incremental message; next_exp: % vs. seq: % %.\n",
                 __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                next_exp_inc_seq_num, incr_msg->first, incr_msg->second.toString()
+                next_exp_inc_seq_num, incr_msg->first, incr_msg->second
             );
 
             // let's skip those that are before the end of our snapshot, we can just forget about those
@@ -246,18 +291,18 @@ namespace Trading {
 
             // now let's make sure there are no gaps
             if (incr_msg->first != next_exp_inc_seq_num) {
-                logger.log("%:% %() % Detected gap in incremental stream! Expected: % Found: %. \n",
+                LOG_WARN(logger, "%:% %() % Detected gap in incremental stream! Expected: % Found: %. \n",
                     __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                    next_exp_inc_seq_num, incr_msg->first, incr_msg->second.toString()
+                    next_exp_inc_seq_num, incr_msg->first, incr_msg->second
                 );
                 have_complete_incremental = false;
                 break;
             }
 
             // cool, let's push this back onto our final_events as long it isn't accidentally a snapshot sentinel
-            logger.log("%:% %() % % => %\n",
+            LOG_TRACE(logger, "%:% %() % % => %\n",
                 __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                incr_msg->first, incr_msg->second.toString()
+                incr_msg->first, incr_msg->second
             );
             if (incr_msg->second.type != Exchange::MarketUpdateType::SNAPSHOT_START &&
                 incr_msg->second.type != Exchange::MarketUpdateType::SNAPSHOT_END
@@ -271,7 +316,7 @@ namespace Trading {
 
         // we might not have had a complete set of incrementals so let's catch that
         if (!have_complete_incremental) {
-            logger.log("%:% %() % Returning because we have gaps in queued incrementals.\n"
+            LOG_DEBUG(logger, "%:% %() % Returning because we have gaps in queued incrementals.\n"
                 __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str)
             );
 
@@ -288,7 +333,7 @@ namespace Trading {
         }
 
         // Cleanup time!
-        logger.log("%:% %() % Recovered % snapshot and % incremental orders. \n",
+        LOG_INFO(logger, "%:% %() % Recovered % snapshot and % incremental orders. \n",
             __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
             snapshot_queued_messages.size() - 2, num_incrementals
         );
@@ -330,9 +375,9 @@ namespace Trading {
         // this means that if we ever get duplicates in the map, we have moved onto the next snapshot
         if (is_snapshot) {
             if (snapshot_queued_messages.find(request->seq_number) != snapshot_queued_messages.end()) {
-                logger.log("%:% %() % Packet drops on snapshot socket. Received for a 2nd time:%\n",
+                LOG_WARN(logger, "%:% %() % Packet drops on snapshot socket. Received for a 2nd time:%\n",
                     __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                    request->toString()
+                    *request
                 );
                 snapshot_queued_messages.clear();
             }
@@ -343,9 +388,9 @@ namespace Trading {
             incremental_queued_msgs[request->seq_number] = request->me_market_update;
         }
 
-        logger.log("%:% %() % size snapshot:% incremental:% => %\n",
+        LOG_DEBUG(logger, "%:% %() % size snapshot:% incremental:% => %\n",
             __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-            snapshot_queued_messages.size(), request->seq_number, request->toString()
+            snapshot_queued_messages.size(), request->seq_number, *request
         );
 
         // at this point, we might be able to stop the recovery phase
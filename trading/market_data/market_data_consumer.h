@@ -5,6 +5,8 @@
 #include "utils/lock_free_queue.h"
 #include "utils/macros.h"
 #include "utils/multicast_socket.h"
+#include "utils/latency_histogram.h"
+#include "utils/trace.h"
 
 #include "exchange/market_publisher/market_update.h"
 
@@ -68,6 +70,7 @@ namespace Trading {
 
             void run();
             void recvCallback(MulticastSocket *socket) noexcept;
+            void onMarketUpdate(bool is_snapshot, const Exchange::MDPMarketUpdate * request, Nanos callback_time) noexcept;
             void checkSnapshotSync();
             void startSnapshotSync();
             void queueMessage(bool is_snapshot, const Exchange::MDPMarketUpdate * request);
@@ -2,15 +2,16 @@
 
 Trading::OrderGateway::OrderGateway(ClientId cliend_id_param, Exchange::ClientRequestLFQueue *client_requests, 
                                     Exchange::ClientResponseLFQueue *client_responses, std::string ip_param, 
-                                    const std::string &iface, int port_param
+                                    const std::string &iface, int port_param, Exchange::OrderTransport transport_param
                                     ): client_id(cliend_id_param), ip(ip_param), interface(iface),
-                                    port(port_param), outgoing_requests(client_requests),
+                                    port(port_param), transport(transport_param), outgoing_requests(client_requests),
                                     incoming_responses(client_responses), logger("trading_order_gateway" + std::to_string(client_id) + ".log"),
                                     tcp_socket(logger) {
     
     tcp_socket.receive_callback = [this](auto socket, auto rx_time) {
         recvCallback(socket, rx_time);
     };
+    outgoing_requests->setConsumerSignal(&parking_signal);
 
 }
 
@@ -19,16 +20,25 @@ Trading::OrderGateway::~OrderGateway() {
 
     using namespace std::literals::chrono_literals;
     std::this_thread::sleep_for(5s);
+
+    // tells the exchange we are gone
+    delete session;
+    session = nullptr;
 }
 
 void Trading::OrderGateway::start() {
     running = true;
 
-    // connect the socket
-    ASSERT(tcp_socket.connect(ip, interface, port, false) >= 0,
-            "Unable to connect to ip:" + ip + " port:" + std::to_string(port) + 
-            " on interface:" + interface + " error:" + std::string(std::strerror(errno))
-    );
+    // connect the socket, or with shared memory, open our session in the exchange's session directory
+    if (transport == Exchange::OrderTransport::SHM) {
+        session = new Exchange::OrderSessionClient(Exchange::orderSessionPath(port), client_id);
+        ASSERT(session->isConnected(), "Unable to open an order session error:" + session->errorString());
+    } else {
+        ASSERT(tcp_socket.connect(ip, interface, port, false) >= 0,
+                "Unable to connect to ip:" + ip + " port:" + std::to_string(port) + 
+                " on interface:" + interface + " error:" + std::string(std::strerror(errno))
+        );
+    }
 
     ASSERT(Common::createAndStartThread(-1, "Trading/OrderGateway", [this]{run();}) != nullptr,
             "Failed to start OrderGateway thread."
@@ -41,101 +51,157 @@ void Trading::OrderGateway::stop() {
 
 void Trading::OrderGateway::run() {
 
-    logger.log("%:% %() % \n",
+    LOG_INFO(logger, "%:% %() % \n",
         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str)
     );
 
+    // exchange receipts only get noticed once a park times out, so this thread should stay on busy_spin unless latency doesn't matter
+    IdleStrategy idle_strategy(currentThreadPlacement().idle_mode, &parking_signal);
+
     // infinite loop
     while (running) {
         // after this func call, we will have data stored in the socket receive buffer, we will read it
         // when the socket calls the recvCallback() from inside this function
-        tcp_socket.sendAndReceive();
+        bool did_work = (transport == Exchange::OrderTransport::SHM) ? receiveFromSession() : tcp_socket.sendAndReceive();
 
         // this sends any data pending on the outgoing client requests LFQ
         for (auto client_request = outgoing_requests->getNextRead(); client_request; client_request = outgoing_requests->getNextRead()) {
             
             // an order to be placed has been received from the trading engine
-            TTT_MEASURE(T11_OrderGateway_LFQueue_read, logger);
-
-            logger.log("%:% %() % Sending cid:% seq% %\n",
-                __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                client_id, next_outgoing_seq_number, client_request->toString()
-            );
+            TRACE_HOP(T11_OrderGateway_LFQueue_read, client_request->client_id, client_request->order_id);
 
-            START_MEASURE(Trading_TCPSocket_send);
-            tcp_socket.send(&next_outgoing_seq_number, sizeof(next_outgoing_seq_number));
-            tcp_socket.send(client_request, sizeof(Exchange::MEClientRequest));
-            END_MEASURE(Trading_TCPSocket_send, logger);
-            outgoing_requests->updateReadIndex();
+            // a full session (or send buffer) leaves the request in the queue, the exchange is behind so we wait for it
+            if (!sendClientRequest(client_request)) {
+                break;
+            }
 
             // the final stop for a new order in the client, the order has been sent to the exchange
-            TTT_MEASURE(T12_OrderGatewayTCP_write, logger);
+            // (traced before we give the slot back, the trade engine is free to overwrite it after that)
+            TRACE_HOP(T12_OrderGateway_TCP_write, client_request->client_id, client_request->order_id);
+            outgoing_requests->updateReadIndex();
 
             next_outgoing_seq_number++;
+            did_work = true;
+        }
+
+        if (did_work) {
+            idle_strategy.reset();
+        } else {
+            idle_strategy.idle([this]() { return outgoing_requests->size() > 0; });
         }
     }
 }
 
+bool Trading::OrderGateway::sendClientRequest(const Exchange::MEClientRequest *client_request) noexcept {
+    LOG_DEBUG(logger, "%:% %() % Sending cid:% seq% %\n",
+        __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+        client_id, next_outgoing_seq_number, *client_request
+    );
+
+    if (transport == Exchange::OrderTransport::SHM) {
+        Exchange::OMClientRequest *next_write = session->requests().getNextWriteTo();
+        if (UNLIKELY(!next_write)) {
+            return false;
+        }
+
+        START_MEASURE(Trading_ShmSession_send);
+        next_write->seq_number = next_outgoing_seq_number;
+        next_write->me_client_request = *client_request;
+        session->requests().updateWriteIndex();
+        END_MEASURE(Trading_ShmSession_send);
+        return true;
+    }
+
+    if (UNLIKELY(tcp_socket.sendBufferSpace() < sizeof(next_outgoing_seq_number) + sizeof(Exchange::MEClientRequest))) {
+        return false;
+    }
+
+    START_MEASURE(Trading_TCPSocket_send);
+    tcp_socket.send(&next_outgoing_seq_number, sizeof(next_outgoing_seq_number));
+    tcp_socket.send(client_request, sizeof(Exchange::MEClientRequest));
+    END_MEASURE(Trading_TCPSocket_send);
+    return true;
+}
+
+bool Trading::OrderGateway::receiveFromSession() noexcept {
+    // the same hop as a tcp read, so traces from both transports line up
+    const Nanos callback_time = Common::getCurrentNanosTSC();
+
+    bool data_read = false;
+    auto &responses = session->responses();
+    for (auto response = responses.getNextRead(); response; response = responses.getNextRead()) {
+        onClientResponse(response, callback_time);
+        responses.updateReadIndex();
+        data_read = true;
+    }
+    return data_read;
+}
+
 void Trading::OrderGateway::recvCallback(TCPSocket *socket, Nanos rx_time) noexcept {
 
     // a message from the exchange has just arrived at the client gateway
-    TTT_MEASURE(T7t_OrderGateway_TCP_read, logger);
+    const Nanos callback_time = Common::getCurrentNanosTSC();
     START_MEASURE(Trading_OrderGateway_recvCallback);
 
-    logger.log("%:% %() % Received socket:% len:% %\n",
+    LOG_TRACE(logger, "%:% %() % Received socket:% len:% %\n",
         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-        socket->socket_file_descriptor, socket->next_receive_valid_index, rx_time
+        socket->socket_file_descriptor, socket->receive_buffer.readable(), rx_time
     );
 
     // we decode the received market data
-    if (socket->next_receive_valid_index >= sizeof(Exchange::OMClientResponse)) {
+    const char *received = socket->receive_buffer.readPtr();
+    const size_t received_length = socket->receive_buffer.readable();
+    if (received_length >= sizeof(Exchange::OMClientResponse)) {
 
         size_t i = 0;
 
-        for(; i + sizeof(Exchange::OMClientResponse) <= socket->next_receive_valid_index; i += sizeof(Exchange::OMClientResponse)) {
-
-            const Exchange::OMClientResponse * response = reinterpret_cast<const Exchange::OMClientResponse *>(socket->receive_buffer + i);
-            logger.log("%:% %() % Received %\n",
-                __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                response->toString()
-            );
-
-            // need to make sure the response we get is for this client, else, we ifnore it
-            if (response->me_client_response.client_id != client_id) {
-                logger.log("%:% %() % ERROR Incorrect client id. ClientId expected:% received:%.\n",
-                    __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                    client_id, response->me_client_response.client_id
-                );
-                continue;
-            }
+        for(; i + sizeof(Exchange::OMClientResponse) <= received_length; i += sizeof(Exchange::OMClientResponse)) {
 
-            // now we have to verify the sequence number
-            if(response->seq_number != next_expected_sequence_number) {
-                logger.log("%:% %() % ERROR Incorrect sequence number. ClientId:%. SeqNum expected:% received:%.\n",
-                    __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                    client_id, next_expected_sequence_number, response->seq_number
-                );
-                continue;
-            }
+            const Exchange::OMClientResponse * response = reinterpret_cast<const Exchange::OMClientResponse *>(received + i);
+            onClientResponse(response, callback_time);
+        }
 
-            // now, it has passed all of our checks
-            // we increment our seq num and send it to the trading engine
-            ++next_expected_sequence_number;
+        // we have read as much information as we can, so we now update the socket buffer
+        // by 'erasing' the 'i' bytes we read, a partial response left behind stays in place (the buffer is a mirrored ring)
+        socket->receive_buffer.consume(i);
+    }
 
-            auto next_write = incoming_responses->getNextWriteTo();
-            *next_write = std::move(response->me_client_response);
-            incoming_responses->updateWriteIndex();
+    END_MEASURE(Trading_OrderGateway_recvCallback);
+}
 
-            // the exchange message has been sent to the trading engine
-            TTT_MEASURE(T8t_OrderGateway_LFQueue_write, logger);
-        }
+void Trading::OrderGateway::onClientResponse(const Exchange::OMClientResponse *response, Nanos callback_time) noexcept {
+    TRACE_HOP_AT(T7t_OrderGateway_TCP_read, response->me_client_response.client_id, response->me_client_response.client_order_id, callback_time);
+    LOG_DEBUG(logger, "%:% %() % Received %\n",
+        __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+        *response
+    );
 
-        // we have read as much information as we can, so we now update the socket buffer
-        // by 'erasing' what we read and shifting the data in the socket over
-        // remember, we just read 'i' bytes of data
-        memcpy(socket->receive_buffer, socket->receive_buffer + i, socket->next_receive_valid_index - i);
-        socket->next_receive_valid_index -= i;
+    // need to make sure the response we get is for this client, else, we ifnore it
+    if (response->me_client_response.client_id != client_id) {
+        LOG_WARN(logger, "%:% %() % ERROR Incorrect client id. ClientId expected:% received:%.\n",
+            __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+            client_id, response->me_client_response.client_id
+        );
+        return;
     }
 
-    END_MEASURE(Trading_OrderGateway_recvCallback, logger);
+    // now we have to verify the sequence number
+    if(response->seq_number != next_expected_sequence_number) {
+        LOG_WARN(logger, "%:% %() % ERROR Incorrect sequence number. ClientId:%. SeqNum expected:% received:%.\n",
+            __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+            client_id, next_expected_sequence_number, response->seq_number
+        );
+        return;
+    }
+
+    // now, it has passed all of our checks
+    // we increment our seq num and send it to the trading engine
+    ++next_expected_sequence_number;
+
+    auto next_write = incoming_responses->getNextWriteTo();
+    *next_write = std::move(response->me_client_response);
+    incoming_responses->updateWriteIndex();
+
+    // the exchange message has been sent to the trading engine
+    TRACE_HOP(T8t_OrderGateway_LFQueue_write, next_write->client_id, next_write->client_order_id);
 }
@@ -3,9 +3,12 @@
 #include "utils/thread_utils.h"
 #include "utils/macros.h"
 #include "utils/tcp_server.h"
+#include "utils/latency_histogram.h"
+#include "utils/trace.h"
 
 #include "exchange/order_gateway/client_request.h"
 #include "exchange/order_gateway/client_response.h"
+#include "exchange/order_gateway/order_transport.h"
 
 namespace Trading {
 
@@ -17,6 +20,7 @@ namespace Trading {
             std::string ip;
             const std::string interface;
             const int port = 0;
+            const Exchange::OrderTransport transport = Exchange::OrderTransport::TCP;
 
             Exchange::ClientRequestLFQueue * outgoing_requests = nullptr;
             Exchange::ClientResponseLFQueue * incoming_responses = nullptr;
@@ -29,11 +33,15 @@ namespace Trading {
             size_t next_outgoing_seq_number = 1;
             size_t next_expected_sequence_number = 1;
             Common::TCPSocket tcp_socket;
+            Exchange::OrderSessionClient * session = nullptr; // only with OrderTransport::SHM, created in start()
+
+            ParkingSignal parking_signal; // the trade engine wakes us with it when we are parked
 
         public:
             OrderGateway(ClientId cliend_id_param, Exchange::ClientRequestLFQueue *client_requests,
                         Exchange::ClientResponseLFQueue *client_responses, std::string ip_param,
-                        const std::string &iface, int port_param
+                        const std::string &iface, int port_param,
+                        Exchange::OrderTransport transport_param = Exchange::OrderTransport::TCP
                         );
             OrderGateway() = delete;
             OrderGateway(const OrderGateway &) = delete;
@@ -43,7 +51,7 @@ namespace Trading {
 
             ~OrderGateway();
 
-            // connects the socket to the exchange and spins up the run() thread
+            // connects the socket (or the shared memory session) to the exchange and spins up the run() thread
             void start();
 
             // stops the run() thread
@@ -55,6 +63,15 @@ namespace Trading {
             // socket will call this after receiving any data (with itself as the "socket" param)
             void recvCallback(TCPSocket *socket, Nanos rx_time) noexcept;
 
+            // the checks every response goes through, whichever transport it came in on
+            void onClientResponse(const Exchange::OMClientResponse *response, Nanos callback_time) noexcept;
+
+            // the shared memory version of sendAndReceive() + recvCallback(), returns whether we read anything
+            bool receiveFromSession() noexcept;
+
+            // sends one request to the exchange, returns false if the session (or the send buffer) is full and it has to wait
+            bool sendClientRequest(const Exchange::MEClientRequest *client_request) noexcept;
+
     };
 
 }
\ No newline at end of file
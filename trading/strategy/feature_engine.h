@@ -59,7 +59,7 @@ namespace Trading {
                     mkt_price = (bbo->bid_price * bbo->ask_qty + bbo->ask_price * bbo->bid_qty) / (static_cast<double>(bbo->bid_qty + bbo->ask_qty));
                 }
 
-                logger->log("%:% %() % ticker:% price:% side:% mkt-price:% aggr-trade-ratio:% \n",
+                LOG_TRACE(*logger, "%:% %() % ticker:% price:% side:% mkt-price:% aggr-trade-ratio:% \n",
                     __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
                     ticker_id, Common::priceToString(price).c_str(), Common::sideToString(side).c_str(),
                     mkt_price, aggr_trade_qty_ratio
@@ -79,9 +79,9 @@ namespace Trading {
                     aggr_trade_qty_ratio = static_cast<double>(market_update->qty) / (market_update->side == Side::BUY ? bbo->ask_qty : bbo->bid_qty);
                 }
 
-                logger->log("%:% %() % % mkt-price:% aggr-trade_ratio:% \n",
+                LOG_TRACE(*logger, "%:% %() % % mkt-price:% aggr-trade_ratio:% \n",
                     __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                    market_update->toString().c_str(), mkt_price, aggr_trade_qty_ratio
+                    *market_update, mkt_price, aggr_trade_qty_ratio
                 );
 
             }
@@ -25,7 +25,7 @@ Trading::LiquidityTaker::LiquidityTaker(Common::Logger *logger_param, TradeEngin
 // our liquidity taker does not react to order book updates, but rather the trades placed by other market participants
 void Trading::LiquidityTaker::onOrderBookUpdate(TickerId ticker_id, Price price, Side side, const MarketOrderBook *book) noexcept {
     
-    logger->log("%:% %() % ticker:% price:% side:% \n",
+    LOG_TRACE(*logger, "%:% %() % ticker:% price:% side:% \n",
         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
         ticker_id, Common::priceToString(price).c_str(), Common::sideToString(side).c_str()
     );
@@ -35,9 +35,9 @@ void Trading::LiquidityTaker::onOrderBookUpdate(TickerId ticker_id, Price price,
 // when the liquidity taker notices aggressive trades being made, it also places trades
 void Trading::LiquidityTaker::onTradeUpdate(const Exchange::MEMarketUpdate *market_update, const MarketOrderBook *book) noexcept {
 
-    logger->log("%:% %() % LiqTaker trade update -  % \n",
+    LOG_DEBUG(*logger, "%:% %() % LiqTaker trade update -  % \n",
         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-        market_update->toString().c_str()
+        *market_update
     );
 
     const BBO * bbo = book->getBBO();
@@ -45,9 +45,9 @@ void Trading::LiquidityTaker::onTradeUpdate(const Exchange::MEMarketUpdate *mark
 
     if (LIKELY(bbo->bid_price != Price_INVALID && bbo->ask_price != Price_INVALID && aggressive_qty_ratio != Feature_INVALID)) {
         
-        logger->log("%:% %() % LiqTaker BBO - % aggr-qty-ratio:% \n",
+        LOG_DEBUG(*logger, "%:% %() % LiqTaker BBO - % aggr-qty-ratio:% \n",
             __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-            bbo->toString().c_str(), aggressive_qty_ratio
+            *bbo, aggressive_qty_ratio
         );
 
         const Qty trade_size = ticker_configs_hashmap.at(market_update->ticker_id).trade_size;
@@ -63,7 +63,7 @@ void Trading::LiquidityTaker::onTradeUpdate(const Exchange::MEMarketUpdate *mark
                 order_manager->moveOrders(market_update->ticker_id, Price_INVALID, bbo->bid_price, trade_size);
             }
 
-            END_MEASURE(OrderManager_moveOrders, (*logger));
+            END_MEASURE(OrderManager_moveOrders);
         }
     }
 }
@@ -71,12 +71,12 @@ void Trading::LiquidityTaker::onTradeUpdate(const Exchange::MEMarketUpdate *mark
 // once we get an order receipt from the exchange, we'll just send it to our order manager
 void Trading::LiquidityTaker::onOrderUpdate(const Exchange::MEClientResponse *client_response) noexcept {
 
-    logger->log("%:% %() % LiqTaker forwarding order update - % \n",
+    LOG_DEBUG(*logger, "%:% %() % LiqTaker forwarding order update - % \n",
         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-        client_response->toString().c_str()
+        *client_response
     );
     
     START_MEASURE(Trading_OrderManager_onOrderUpdate);
     order_manager->onOrderUpdate(client_response);
-    END_MEASURE(Trading_OrderManager_onOrderUpdate, (*logger));
+    END_MEASURE(Trading_OrderManager_onOrderUpdate);
 }
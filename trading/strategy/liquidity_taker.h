@@ -2,6 +2,7 @@
 
 #include "utils/macros.h"
 #include "utils/logger.h"
+#include "utils/latency_histogram.h"
 
 #include "order_manager.h"
 #include "feature_engine.h"
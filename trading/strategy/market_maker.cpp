@@ -23,7 +23,7 @@ Trading::MarketMaker::MarketMaker(Common::Logger *logger_param, TradeEngine *tra
 
 void Trading::MarketMaker::onOrderBookUpdate(TickerId ticker_id, Price price, Side side, const MarketOrderBook *book) noexcept {
 
-    logger->log("%:% %() % ticker:% price:% side:% \n",
+    LOG_TRACE(*logger, "%:% %() % ticker:% price:% side:% \n",
         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
         ticker_id, Common::priceToString(price).c_str(), Common::sideToString(side).c_str()
     );
@@ -33,9 +33,9 @@ void Trading::MarketMaker::onOrderBookUpdate(TickerId ticker_id, Price price, Si
     const auto fair_price = feature_engine->getMktPrice();
 
     if (LIKELY(bbo->bid_price != Price_INVALID && bbo->ask_price != Price_INVALID && fair_price != Feature_INVALID)) {
-        logger->log("%:% %() % % fair-price:% \n",
+        LOG_TRACE(*logger, "%:% %() % % fair-price:% \n",
             __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-            bbo->toString().c_str(), fair_price
+            *bbo, fair_price
         );
 
         const Qty trade_size = ticker_configs_hashmap.at(ticker_id).trade_size;
@@ -49,7 +49,7 @@ void Trading::MarketMaker::onOrderBookUpdate(TickerId ticker_id, Price price, Si
 
         START_MEASURE(Trading_OrderManager_moveOrders);
         order_manager->moveOrders(ticker_id, bid_price, ask_price, trade_size);
-        END_MEASURE(Trading_OrderManager_moveOrders, (*logger));
+        END_MEASURE(Trading_OrderManager_moveOrders);
     }
 
 }
@@ -58,9 +58,9 @@ void Trading::MarketMaker::onOrderBookUpdate(TickerId ticker_id, Price price, Si
 // so we'll just write an acknowledgement log here
 void Trading::MarketMaker::onTradeUpdate(const Exchange::MEMarketUpdate *market_update, const MarketOrderBook *book) noexcept {
 
-    logger->log("%:% %() % MM trade ACK % \n",
+    LOG_DEBUG(*logger, "%:% %() % MM trade ACK % \n",
         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-        market_update->toString().c_str()
+        *market_update
     );
 
 }
@@ -68,12 +68,12 @@ void Trading::MarketMaker::onTradeUpdate(const Exchange::MEMarketUpdate *market_
 // once we get an order receipt from the exchange, we'll just send it to our order manager
 void Trading::MarketMaker::onOrderUpdate(const Exchange::MEClientResponse *client_response) noexcept {
 
-    logger->log("%:% %() % MM forwarding order update - % \n",
+    LOG_DEBUG(*logger, "%:% %() % MM forwarding order update - % \n",
         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-        client_response->toString().c_str()
+        *client_response
     );
 
     START_MEASURE(Trading_OrderManager_onOrderUpdate);
     order_manager->onOrderUpdate(client_response);
-    END_MEASURE(Trading_OrderManager_onOrderUpdate, (*logger));
+    END_MEASURE(Trading_OrderManager_onOrderUpdate);
 }
@@ -2,6 +2,7 @@
 
 #include "utils/logger.h"
 #include "utils/macros.h"
+#include "utils/latency_histogram.h"
 
 #include "order_manager.h"
 #include "feature_engine.h"
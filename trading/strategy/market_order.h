@@ -4,6 +4,7 @@
 #include <sstream>
 #include "../../utils/orderinfo_types.h"
 #include "../../utils/exchange_limits.h"
+#include "../../utils/logtype.h"
 
 using namespace Common;
 
@@ -78,4 +79,10 @@ namespace Trading {
         }
     };
 
+}
+
+namespace Common {
+    // logged by value, see LogStruct in utils/logtype.h
+    template<> struct LogStruct<Trading::BBO> : LogStructOf<LogStructId::BBO> {};
+    inline const bool bbo_log_structs = registerLogStruct<Trading::BBO>();
 }
\ No newline at end of file
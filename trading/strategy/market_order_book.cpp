@@ -12,7 +12,7 @@ Trading::MarketOrderBook::MarketOrderBook(TickerId ticker_id_param, Logger *logg
 }
 
 Trading::MarketOrderBook::~MarketOrderBook() {
-    logger->log("%:% %() % ~MarketOrderBook() \n % \n", 
+    LOG_INFO(*logger, "%:% %() % ~MarketOrderBook() \n % \n", 
         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
         toString(false, true)
     );
@@ -44,7 +44,7 @@ void Trading::MarketOrderBook::onMarketUpdate(const Exchange::MEMarketUpdate *ma
                                             );
             START_MEASURE(Trading_MarketOrderBook_addOrder);
             addOrder(order);
-            END_MEASURE(Trading_MarketOrderBook_addOrder, (*logger));
+            END_MEASURE(Trading_MarketOrderBook_addOrder);
         } 
             break;
 
@@ -58,7 +58,7 @@ void Trading::MarketOrderBook::onMarketUpdate(const Exchange::MEMarketUpdate *ma
             MarketOrder * order = oid_to_order.at(market_update->order_id);
             START_MEASURE(Trading_MarketOrderBook_removeOrder);
             removeOrder(order);
-            END_MEASURE(Trading_MarketOrderBook_removeOrder, (*logger));
+            END_MEASURE(Trading_MarketOrderBook_removeOrder);
         }
             break;
 
@@ -87,7 +87,7 @@ void Trading::MarketOrderBook::onMarketUpdate(const Exchange::MEMarketUpdate *ma
 
             if(asks_by_price) {
                 for (auto ask = asks_by_price->next_entry; ask != asks_by_price; ask = ask->next_entry) {
-                    orders_at_price_pool.deallocate(asks_by_price);
+                    orders_at_price_pool.deallocate(ask);
                 }
                 orders_at_price_pool.deallocate(asks_by_price);
             }
@@ -108,10 +108,10 @@ void Trading::MarketOrderBook::onMarketUpdate(const Exchange::MEMarketUpdate *ma
     // we can now ask the trading engine to 'react' to these updates
     START_MEASURE(Trading_MarketOrderBook_updateBBO);
     updateBBO(bid_updated, ask_updated);
-    END_MEASURE(Trading_MarketOrderBook_updateBBO, (*logger));
+    END_MEASURE(Trading_MarketOrderBook_updateBBO);
     trade_engine->onOrderBookUpdate(market_update->ticker_id, market_update->price, market_update->side, this);
 
-    logger->log("%:% %() % OrderBook \n % \n", 
+    LOG_TRACE(*logger, "%:% %() % OrderBook \n % \n", 
         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
         toString(false, true)
     );
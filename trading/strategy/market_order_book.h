@@ -3,6 +3,7 @@
 #include "../../utils/orderinfo_types.h"
 #include "../../utils/memory_pool.h"
 #include "../../utils/logger.h"
+#include "../../utils/latency_histogram.h"
 
 #include "market_order.h"
 #include "../../exchange/market_publisher/market_update.h"
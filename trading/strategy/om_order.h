@@ -4,6 +4,7 @@
 #include <sstream>
 #include "utils/orderinfo_types.h"
 #include "utils/exchange_limits.h"
+#include "utils/logtype.h"
 
 using namespace Common;
 
@@ -67,4 +68,10 @@ namespace Trading {
     // we store up to 1 buy order and 1 sell order per ticker
     typedef std::array<OMOrderSideHashMap, ME_MAX_TICKERS> OMOrderTickerSideHashMap;
 
+}
+
+namespace Common {
+    // logged by value, see LogStruct in utils/logtype.h
+    template<> struct LogStruct<Trading::OMOrder> : LogStructOf<LogStructId::OM_ORDER> {};
+    inline const bool om_order_log_structs = registerLogStruct<Trading::OMOrder>();
 }
\ No newline at end of file
@@ -12,9 +12,9 @@ void Trading::OrderManager::newOrder(OMOrder *order, TickerId ticker_id, Price p
     *order = {ticker_id, next_order_id, side, price, qty, OMOrderState::PENDING_NEW};
     ++next_order_id;
 
-    logger->log("%:% %() % Sent new order % for %\n",
+    LOG_DEBUG(*logger, "%:% %() % Sent new order % for %\n",
         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-        new_request.toString().c_str(), order->toString().c_str()
+        new_request, *order
     );
 
 }
@@ -30,9 +30,9 @@ void Trading::OrderManager::cancelOrder(OMOrder *order) noexcept
     // next, we update the order state in the OMOrder struct
     order->order_state = OMOrderState::PENDING_CANCEL;
 
-    logger->log("%:% %() % Sent cancel % for %\n",
+    LOG_DEBUG(*logger, "%:% %() % Sent cancel % for %\n",
         __FILE__, __LINE__, __FUNCTION__, getCurrentTimeStr(&time_str),
-        cancel_request.toString().c_str(), order->toString().c_str()
+        cancel_request, *order
     );
 
 }
@@ -48,7 +48,7 @@ void Trading::OrderManager::moveOrder(OMOrder *order, TickerId ticker_id, Price
             if (order->price != price || order->qty != qty) {
                 START_MEASURE(Trading_OrderManager_cancelOrder);
                 cancelOrder(order);
-                END_MEASURE(Trading_OrderManager_cancelOrder, (*logger));
+                END_MEASURE(Trading_OrderManager_cancelOrder);
             }
         } 
             break;
@@ -60,15 +60,15 @@ void Trading::OrderManager::moveOrder(OMOrder *order, TickerId ticker_id, Price
 
                 START_MEASURE(Trading_RiskManager_checkPreTradeRisk);
                 const RiskCheckResult risk_result = risk_manager.checkPreTradeRisk(ticker_id, side, qty);
-                END_MEASURE(Trading_RiskManager_checkPreTradeRisk, (*logger));
+                END_MEASURE(Trading_RiskManager_checkPreTradeRisk);
 
                 if (LIKELY(risk_result == RiskCheckResult::ALLOWED)) {
                     START_MEASURE(Trading_OrderManager_newOrder);
                     newOrder(order, ticker_id, price, side, qty);
-                    END_MEASURE(Trading_OrderManager_newOrder, (*logger));
+                    END_MEASURE(Trading_OrderManager_newOrder);
                     
                 } else {
-                    logger->log("%:% %() % Ticker:% Side:% Qty:% RiskCheckResult:% \n",
+                    LOG_DEBUG(*logger, "%:% %() % Ticker:% Side:% Qty:% RiskCheckResult:% \n",
                         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
                         tickerIdToString(ticker_id), sideToString(side), qtyToString(qty), riskCheckResultToString(risk_result)
                     );
@@ -2,6 +2,7 @@
 
 #include "utils/macros.h"
 #include "utils/logger.h"
+#include "utils/latency_histogram.h"
 
 #include "exchange/order_gateway/client_response.h"
 #include "exchange/order_gateway/client_request.h"
@@ -56,12 +57,12 @@ namespace Trading {
                 START_MEASURE(Trading_OrderManager_moveOrder_buy);
                 auto bid_order = &(ticker_order_hashmap.at(ticker_id).at(sideToIndex(Side::BUY)));
                 moveOrder(bid_order, ticker_id, bid_price, Side::BUY, trade_size);
-                END_MEASURE(Trading_OrderManager_moveOrder_buy, (*logger));
+                END_MEASURE(Trading_OrderManager_moveOrder_buy);
 
                 START_MEASURE(Trading_OrderManager_moveOrder_sell);
                 auto sell_order = &(ticker_order_hashmap.at(ticker_id).at(sideToIndex(Side::SELL)));
                 moveOrder(sell_order, ticker_id, ask_price, Side::SELL, trade_size);
-                END_MEASURE(Trading_OrderManager_moveOrder_sell, (*logger));
+                END_MEASURE(Trading_OrderManager_moveOrder_sell);
                 
                 return;
             }
@@ -69,16 +70,16 @@ namespace Trading {
             // handles incoming responses from the exchange
             void onOrderUpdate(const Exchange::MEClientResponse *client_response) noexcept {
 
-                logger->log("%:% %() % Incoming order update: %\n",
+                LOG_DEBUG(*logger, "%:% %() % Incoming order update: %\n",
                     __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                    client_response->toString().c_str()
+                    *client_response
                 );
 
                 // fetch the corresponding order
                 OMOrder * order = &(ticker_order_hashmap.at(client_response->ticker_id).at(sideToIndex(client_response->side)));
-                logger->log("%:% %() % Order in-map state: %\n",
+                LOG_DEBUG(*logger, "%:% %() % Order in-map state: %\n",
                     __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                    order->toString().c_str()
+                    *order
                 );
 
                 // update the order state
@@ -129,9 +129,9 @@ namespace Trading {
  
             // log the change made to our position
             std::string time_str;
-            logger->log("%:% %() % % %\n",
+            LOG_DEBUG(*logger, "%:% %() % % %\n",
                 __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                toString(), client_response->toString().c_str()
+                toString(), *client_response
             );
 
         } 
@@ -160,9 +160,9 @@ namespace Trading {
                 total_pnl = real_pnl + unreal_pnl;
 
                 if (total_pnl != old_total_pnl) {
-                    logger->log("%:% %() % % %\n",
+                    LOG_DEBUG(*logger, "%:% %() % % %\n",
                         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                        toString(), bbo->toString()
+                        toString(), *bbo
                     );
                 }
             }
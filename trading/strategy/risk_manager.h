@@ -33,10 +33,9 @@ namespace Trading {
             case RiskCheckResult::POSITION_TOO_LARGE: {return "POSITION_TOO_LARGE";}
             case RiskCheckResult::LOSS_TOO_LARGE: {return "LOSS_TOO_LARGE";}
             case RiskCheckResult::ALLOWED: {return "ALLOWED";}
-
-            return "";
         }
 
+        return "";
     }
 
     struct RiskInfo {
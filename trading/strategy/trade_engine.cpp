@@ -10,6 +10,9 @@ Trading::TradeEngine::TradeEngine(Common::ClientId client_id_param, AlgoType alg
                                 risk_manager(&logger, &position_keeper, ticker_cfg)
 {
 
+    incoming_responses->setConsumerSignal(&parking_signal);
+    incoming_md_updates->setConsumerSignal(&parking_signal);
+
     // initialize our order book
     for (size_t i = 0; i < ticker_order_book_hashmap.size(); ++i) {
         ticker_order_book_hashmap[i] = new MarketOrderBook(i, &logger);
@@ -36,7 +39,7 @@ Trading::TradeEngine::TradeEngine(Common::ClientId client_id_param, AlgoType alg
 
     // now let's log the starting state of the trade engine configuration for each instrument
     for (TickerId i = 0; i < ticker_cfg.size(); ++i) {
-        logger.log("%:% %() % TradeEngine Configs Initialized % Ticker: % %. \n",
+        LOG_INFO(logger, "%:% %() % TradeEngine Configs Initialized % Ticker: % %. \n",
             __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
             algoTypeToString(algo_type), i, ticker_cfg.at(i).toString()
         );
@@ -64,9 +67,9 @@ Trading::TradeEngine::~TradeEngine() {
 }
 
 void Trading::TradeEngine::sendClientRequest(const Exchange::MEClientRequest *client_request) noexcept {
-    logger.log("%:% %() % TradeEngine Sending %\n",
+    LOG_DEBUG(logger, "%:% %() % TradeEngine Sending %\n",
         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-        client_request->toString().c_str()
+        *client_request
     );
 
     Exchange::MEClientRequest * next_write = outgoing_requests->getNextWriteTo();
@@ -74,57 +77,72 @@ void Trading::TradeEngine::sendClientRequest(const Exchange::MEClientRequest *cl
     outgoing_requests->updateWriteIndex();
 
     // the order has been sent to the order gateway by the trading engine
-    TTT_MEASURE(T10_TradeEngine_LFQueue_write, logger);
+    TRACE_HOP(T10_TradeEngine_LFQueue_write, next_write->client_id, next_write->order_id);
 }
 
 void Trading::TradeEngine::run() noexcept {
 
-    logger.log("%:% %() % TradeEngine running! \n",
+    LOG_INFO(logger, "%:% %() % TradeEngine running! \n",
         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str)
     );
 
+    IdleStrategy idle_strategy(currentThreadPlacement().idle_mode, &parking_signal);
+
     while (running) {
 
         // process incoming receipts from the exchange
-        for (const Exchange::MEClientResponse *client_response = incoming_responses->getNextRead(); client_response; client_response = incoming_responses->getNextRead()) {
+        const Exchange::MEClientResponse *client_responses = nullptr;
+        const size_t num_responses = incoming_responses->peekReads(Common::LFQueueDrainBatchSize, &client_responses);
+        for (size_t i = 0; i < num_responses; ++i) {
+            const Exchange::MEClientResponse *client_response = &client_responses[i];
 
             // the receipt has been received by the trading engine
-            TTT_MEASURE(T9t_TradeEngine_LFQueue_read, logger);
+            TRACE_HOP(T9t_TradeEngine_LFQueue_read, client_response->client_id, client_response->client_order_id);
 
-            logger.log("%:% %() % Processing Exchange Receipt: %\n",
+            LOG_DEBUG(logger, "%:% %() % Processing Exchange Receipt: %\n",
                 __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                client_response->toString().c_str()
+                *client_response
             );
 
             onOrderUpdate(client_response);
-            incoming_responses->updateReadIndex();
             last_event_time = Common::getCurrentNanos();
         }
+        if (num_responses) {
+            incoming_responses->releaseReads(num_responses);
+        }
 
         // process all market data updates
-        for (const Exchange::MEMarketUpdate *market_update = incoming_md_updates->getNextRead(); market_update; market_update = incoming_md_updates->getNextRead()) {
-
-            // the market update has been received by the trading engine
-            TTT_MEASURE(T9_TradeEngine_LFQueue_read, logger);
+        const Exchange::MEMarketUpdate *market_updates = nullptr;
+        const size_t num_updates = incoming_md_updates->peekReads(Common::LFQueueDrainBatchSize, &market_updates);
+        for (size_t i = 0; i < num_updates; ++i) {
+            const Exchange::MEMarketUpdate *market_update = &market_updates[i];
 
-            logger.log("%:% %() % Processing Market Update % \n",
+            LOG_TRACE(logger, "%:% %() % Processing Market Update % \n",
                 __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                market_update->toString().c_str()
+                *market_update
             );
 
             ASSERT(market_update->ticker_id < ticker_order_book_hashmap.size(), "Unkown ticker-id on update:" + market_update->toString());
             ticker_order_book_hashmap[market_update->ticker_id]->onMarketUpdate(market_update);
 
-            incoming_md_updates->updateReadIndex();
             last_event_time = Common::getCurrentNanos();
         }
+        if (num_updates) {
+            incoming_md_updates->releaseReads(num_updates);
+        }
+
+        if (num_responses || num_updates) {
+            idle_strategy.reset();
+        } else {
+            idle_strategy.idle([this]() { return incoming_responses->size() || incoming_md_updates->size(); });
+        }
     }
 
 }
 
 void Trading::TradeEngine::onOrderBookUpdate(TickerId ticker_id, Price price, Side side, const MarketOrderBook *book) noexcept {
 
-    logger.log("%:% %() % TradeEngine reaction to orderbook change - ticker: % price: % side: % \n",
+    LOG_TRACE(logger, "%:% %() % TradeEngine reaction to orderbook change - ticker: % price: % side: % \n",
         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
         ticker_id, Common::priceToString(price).c_str(), Common::sideToString(side).c_str()
     );
@@ -135,48 +153,48 @@ void Trading::TradeEngine::onOrderBookUpdate(TickerId ticker_id, Price price, Si
 
     START_MEASURE(Trading_PositionKeeper_updateBBO);
     position_keeper.updateBBO(ticker_id, bbo);
-    END_MEASURE(Trading_PositionKeeper_updateBBO, logger);
+    END_MEASURE(Trading_PositionKeeper_updateBBO);
 
     START_MEASURE(Trading_FeatureEngine_onOrderBookUpdate);
     feature_engine.onOrderBookUpdate(ticker_id, price, side, book);
-    END_MEASURE(Trading_FeatureEngine_onOrderBookUpdate, logger);
+    END_MEASURE(Trading_FeatureEngine_onOrderBookUpdate);
 
     START_MEASURE(Trading_TradeEngine_algoOnOrderBookUpdate);
     algoOnOrderBookUpdate(ticker_id, price, side, book);
-    END_MEASURE(Trading_TradeEngine_algoOnOrderBookUpdate, logger);
+    END_MEASURE(Trading_TradeEngine_algoOnOrderBookUpdate);
 }
 
 void Trading::TradeEngine::onTradeUpdate(const Exchange::MEMarketUpdate *market_update, const MarketOrderBook *book) noexcept {
 
-    logger.log("%:% %() % TradeEngine reaction to trade - %\n",
+    LOG_DEBUG(logger, "%:% %() % TradeEngine reaction to trade - %\n",
         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-        market_update->toString().c_str()
+        *market_update
     );
 
     START_MEASURE(Trading_FeatureEngine_onTradeUpdate);
     feature_engine.onTradeUpdate(market_update, book);
-    END_MEASURE(Trading_FeatureEngine_onTradeUpdate, logger);
+    END_MEASURE(Trading_FeatureEngine_onTradeUpdate);
 
     START_MEASURE(Trading_TradeEngine_algoOnTradeUpdate);
     algoOnTradeUpdate(market_update, book);
-    END_MEASURE(Trading_TradeEngine_algoOnTradeUpdate, logger);
+    END_MEASURE(Trading_TradeEngine_algoOnTradeUpdate);
 }
 
 void Trading::TradeEngine::onOrderUpdate(const Exchange::MEClientResponse *client_response) noexcept {
 
-    logger.log("%:% %() % TradeEngine reaction to order update - % \n",
+    LOG_DEBUG(logger, "%:% %() % TradeEngine reaction to order update - % \n",
         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-        client_response->toString().c_str()
+        *client_response
     );
 
     // we'll update our PnL if an order has successfully gone through and we'll notify the algorithm of what happened
     if (UNLIKELY(client_response->type == Exchange::ClientResponseType::FILLED)) {
         START_MEASURE(Trading_PositionKeeper_addFill);
         position_keeper.addFill(client_response);
-        END_MEASURE(Trading_PositionKeeper_addFill, logger);
+        END_MEASURE(Trading_PositionKeeper_addFill);
     }
 
     START_MEASURE(Trading_TradeEngine_algoOnOrderUpdate);
     algoOnOrderUpdate(client_response);
-    END_MEASURE(Trading_TradeEngine_algoOnOrderUpdate, logger);
+    END_MEASURE(Trading_TradeEngine_algoOnOrderUpdate);
 }
@@ -7,6 +7,8 @@
 #include "utils/lock_free_queue.h"
 #include "utils/macros.h"
 #include "utils/logger.h"
+#include "utils/latency_histogram.h"
+#include "utils/trace.h"
 
 #include "exchange/order_gateway/client_request.h"
 #include "exchange/order_gateway/client_response.h"
@@ -50,6 +52,8 @@ namespace Trading {
             MarketMaker * mm_algo = nullptr;
             LiquidityTaker *taker_algo = nullptr;
 
+            // both the order gateway and the market data consumer wake us with it when we are parked
+            ParkingSignal parking_signal;
 
         public:
             std::function<void(TickerId ticker_id, Price price, Side side, const MarketOrderBook *book)> algoOnOrderBookUpdate;
@@ -57,23 +61,23 @@ namespace Trading {
             std::function<void(const Exchange::MEClientResponse *client_response)> algoOnOrderUpdate;
 
             void defaultAlgoOnOrderBookUpdate(TickerId ticker_id, Price price, Side side, const MarketOrderBook *book) noexcept {
-                logger.log("%:% %() % TradeEngine orderbook update default - ticker:% price:% side:% \n",
+                LOG_DEBUG(logger, "%:% %() % TradeEngine orderbook update default - ticker:% price:% side:% \n",
                     __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
                     ticker_id, Common::priceToString(price).c_str(), Common::sideToString(side).c_str()
                 );
             }
 
             void defaultAlgoOnTradeUpdate(const Exchange::MEMarketUpdate *market_update, const MarketOrderBook *book) noexcept {
-                logger.log("%:% %() % TradeEngine trade update default - % \n",
+                LOG_DEBUG(logger, "%:% %() % TradeEngine trade update default - % \n",
                     __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                    market_update->toString().c_str()
+                    *market_update
                 );
             }
 
             void defaultAlgoOnOrderUpdate(const Exchange::MEClientResponse *client_response) noexcept {
-                logger.log("%:% %() % TradeEngine order update default - % \n",
+                LOG_DEBUG(logger, "%:% %() % TradeEngine order update default - % \n",
                     __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                    client_response->toString().c_str()
+                    *client_response
                 );
             }
 
@@ -99,7 +103,7 @@ namespace Trading {
             void stop() {
 
                 while(incoming_responses->size() || incoming_md_updates->size()) {
-                    logger.log("%:% %() % Sleeping till all updates are consumed, exch-receipts-lfq-size: %, market-updates-lfq-size:% \n",
+                    LOG_INFO(logger, "%:% %() % Sleeping till all updates are consumed, exch-receipts-lfq-size: %, market-updates-lfq-size:% \n",
                         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
                         incoming_responses->size(), incoming_md_updates->size()
                     );
@@ -108,7 +112,7 @@ namespace Trading {
                     std::this_thread::sleep_for(10ms);
                 }
 
-                logger.log("%:% %() % POSITIONS \n % \n",
+                LOG_INFO(logger, "%:% %() % POSITIONS \n % \n",
                     __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
                     position_keeper.toString()
                 );
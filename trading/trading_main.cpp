@@ -6,8 +6,11 @@
 #include "market_data/market_data_consumer.h"
 
 #include "utils/logger.h"
+#include "utils/latency_histogram.h"
+#include "utils/thread_placement.h"
 
 Common::Logger *logger = nullptr;
+Common::LatencyReporter *latency_reporter = nullptr;
 Trading::TradeEngine *trade_engine = nullptr;
 Trading::MarketDataConsumer *market_data_consumer = nullptr;
 Trading::OrderGateway *order_gateway = nullptr;
@@ -46,7 +49,17 @@ int main(int argc, char **argv) {
     }
 
     // initialize support structures
+    // each client runs its own process, so each gets its own THREAD_PLACEMENT_FILE (see utils/thread_placement.h), or none to stay unpinned
+    const std::string placement_warnings = Common::loadThreadPlacementFromEnvironment();
+    std::cout << placement_warnings << std::flush;
+    const Common::ThreadPlacementConfig &placement = Common::threadPlacementConfig();
+
+    // every component's logger is written out by one log service thread, note that it has to start before the first Logger is created
+    Common::LogService::defaultService(placement.coreOf("log_service"));
+
     logger =  new Common::Logger("trading_main" + std::to_string(client_id) + ".log");
+    latency_reporter = new Common::LatencyReporter("trading_latency" + std::to_string(client_id) + ".log", std::chrono::seconds(10),
+                                                   placement.coreOf("latency_reporter"));
     const int sleep_time = 20 * 1000;
 
     Exchange::ClientRequestLFQueue client_requests(ME_MAX_CLIENT_UPDATES);
@@ -60,20 +73,23 @@ int main(int argc, char **argv) {
     std::string time_str;
 
     // start trading engine
-    logger->log("%:% %() % Starting Trade Engine... \n",
+    LOG_INFO(*logger, "%:% %() % Starting Trade Engine... \n",
         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str)
     );
     trade_engine = new Trading::TradeEngine(client_id, algo_type, ticker_configs_hashmap, &client_requests, &client_responses, &market_updates);
     trade_engine->start();
 
     // starting (client) order gateway
+    // ORDER_TRANSPORT has to match the exchange's, shm only works when we run on the same host as it
     const std::string order_gateway_ip = "127.0.0.1";
     const std::string order_gateway_interface = "lo";
     const int order_gateway_port = 12345;
-    logger->log("%:% %() % Starting Order Gateway... \n",
-        __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str)
+    const Exchange::OrderTransport order_transport = Exchange::orderTransportFromEnvironment();
+    LOG_INFO(*logger, "%:% %() % Starting Order Gateway over % ... \n",
+        __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), Exchange::orderTransportToString(order_transport)
     );
-    order_gateway = new Trading::OrderGateway(client_id, &client_requests, &client_responses, order_gateway_ip, order_gateway_interface, order_gateway_port);
+    order_gateway = new Trading::OrderGateway(client_id, &client_requests, &client_responses, order_gateway_ip, order_gateway_interface, order_gateway_port,
+                                              order_transport);
     order_gateway->start();
 
     // starting market data consumer
@@ -82,12 +98,19 @@ int main(int argc, char **argv) {
     const int snapshot_port = 20000;
     const std::string incremental_ip = "233.252.14.3";
     const int incremental_port = 20001;
-    logger->log("%:% %() % Starting Market Data Consumer... \n",
+    LOG_INFO(*logger, "%:% %() % Starting Market Data Consumer... \n",
         __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str)
     );
     market_data_consumer = new Trading::MarketDataConsumer(client_id, &market_updates, mkt_data_interface, snapshot_ip, snapshot_port, incremental_ip, incremental_port);
     market_data_consumer->start();
 
+    // the trade engine, order gateway and market data consumer find their cores in the placement config by their thread names
+    const std::string placement_report = Common::threadPlacementReport();
+    std::cout << placement_report << std::flush;
+    LOG_INFO(*logger, "%:% %() % % % \n",
+        __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), placement_warnings, placement_report
+    );
+
     std::cout << "sleeping to warm up the components..." << std::endl;
     // ----------------
     // SLEEP FOR WARM UP
@@ -143,7 +166,7 @@ int main(int argc, char **argv) {
     std::cout << "running, unless there is 45 seconds of inactivity in the market..." << std::endl;
     while (trade_engine->silentSeconds() < 45) {
 
-        logger->log("%:% %() % Waiting till no activity, been silent for % seconds... \n",
+        LOG_INFO(*logger, "%:% %() % Waiting till no activity, been silent for % seconds... \n",
             __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
             trade_engine->silentSeconds()
         );
@@ -164,6 +187,9 @@ int main(int argc, char **argv) {
     delete logger;
     logger = nullptr;
 
+    delete latency_reporter;
+    latency_reporter = nullptr;
+
     delete trade_engine;
     trade_engine = nullptr;
 
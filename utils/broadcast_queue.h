@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <string>
+#include <vector>
+
+#include "lock_free_queue.h"
+#include "macros.h"
+
+namespace Common {
+
+    /*
+        Single Producer Multi Consumer (SPMC) 'broadcast' queue, in the style of the LMAX Disruptor
+
+        With LFQUEUE, an element is gone once its one consumer reads it, so if two threads both need to see every element
+        the consumer has to copy each one into a second queue. Here, every consumer sees every element instead:
+        1. the producer writes into the ring exactly like it would with LFQUEUE
+        2. each consumer has its own read index (on its own cache line) and reads the elements in place, no copies
+        3. a slot is only free again once the slowest consumer has moved past it, so the producer 'gates' on the minimum
+           of all read indices, it keeps a cached copy of that minimum and only recomputes it when the ring looks full
+        4. consumers are numbered 0 .. num_consumers - 1 and the count is fixed when the queue is created
+
+        The producer side has the same functions as LFQUEUE (including staging and batched commits)
+        and the consumer side has the same functions, with the consumer's number as the first argument
+
+        Consumers that park when they run out of work register their ParkingSignal with setConsumerSignal() like with LFQUEUE,
+        every publish wakes each of them up
+
+        NOTE: a consumer that stops reading will eventually stall the producer, every consumer has to keep up
+    */
+    template<typename T>
+    class BroadcastQueue final {
+        private:
+            // each consumer's read index lives on its own cache line, so consumers never slow each other down
+            struct alignas(CacheLineSize) ConsumerIndex {
+                std::atomic<size_t> next_read_index = 0;
+                mutable size_t cached_write_index = 0; // this consumer's copy of next_write_index
+            };
+
+            // read-only after construction, shared by all threads
+            std::vector<T, ArenaAllocator<T>> queue;
+            size_t mask = 0;
+
+            // written by the producer
+            alignas(CacheLineSize) std::atomic<size_t> next_write_index = 0;
+            size_t local_write_index = 0; // includes staged writes the consumers can't see yet
+            size_t cached_min_read_index = 0; // producer's copy of the slowest consumer's read index
+            std::vector<ParkingSignal *> consumer_signals; // only the consumers that park, set before the threads start
+
+            std::vector<ConsumerIndex> consumers;
+
+            void wakeConsumers() noexcept {
+                for (ParkingSignal *signal : consumer_signals) {
+                    signal->wake();
+                }
+            }
+
+            // the slowest consumer decides how far the producer can go
+            size_t minReadIndex() const noexcept {
+                size_t min_read_index = consumers[0].next_read_index.load(std::memory_order_acquire);
+                for (size_t i = 1; i < consumers.size(); ++i) {
+                    min_read_index = std::min(min_read_index, consumers[i].next_read_index.load(std::memory_order_acquire));
+                }
+                return min_read_index;
+            }
+
+        public:
+            /* Constructors */
+
+            // note that the capacity gets rounded up to the next power of two, and the elements can live in an 'arena' like LFQUEUE's
+            BroadcastQueue(size_t num_elements, size_t num_consumers, HugePageArena *arena = nullptr): queue(std::bit_ceil(num_elements), T(), ArenaAllocator<T>(arena)),
+                                                                     mask(std::bit_ceil(num_elements) - 1), consumers(num_consumers) {
+                ASSERT(num_consumers > 0, "BroadcastQueue needs at least one consumer");
+            }
+
+            BroadcastQueue() = delete;
+            BroadcastQueue(const BroadcastQueue &) = delete;
+            BroadcastQueue &operator=(const BroadcastQueue &) = delete;
+            BroadcastQueue(const BroadcastQueue &&) = delete;
+            BroadcastQueue &operator=(const BroadcastQueue &&) = delete;
+
+            // 'consumer's signal, has to be set before the producer and consumer threads start
+            void setConsumerSignal(size_t consumer, ParkingSignal *signal) {
+                ASSERT(consumer < consumers.size(), "no consumer " + std::to_string(consumer));
+                consumer_signals.push_back(signal);
+            }
+
+
+
+            /* Producer functions */
+
+            // returns a pointer to the next object in the queue that the user can modify
+            // if the queue is full, this waits for the slowest consumer to free up a slot
+            T* getNextWriteTo() noexcept {
+                while (UNLIKELY(local_write_index - cached_min_read_index > mask)) {
+                    commitWrites(); // the consumers can't free up anything we haven't published yet
+                    cached_min_read_index = minReadIndex();
+                }
+                return &queue[local_write_index & mask];
+            }
+
+            // finalizes the current write object as complete, which publishes it to every consumer
+            void updateWriteIndex() noexcept {
+                ++local_write_index;
+                next_write_index.store(local_write_index, std::memory_order_release);
+                wakeConsumers();
+            }
+
+            // finalizes the current write object, but holds off on publishing it until the next commitWrites()
+            void stageWriteIndex() noexcept {
+                ++local_write_index;
+            }
+
+            // publishes everything staged with a single store
+            void commitWrites() noexcept {
+                next_write_index.store(local_write_index, std::memory_order_release);
+                wakeConsumers();
+            }
+
+
+
+            /* Consumer functions, each consumer only ever passes its own number */
+
+            // returns a pointer to the next object this consumer can read, or null if it has read everything
+            const T* getNextRead(size_t consumer) const noexcept {
+                const ConsumerIndex &index = consumers[consumer];
+                const size_t read_index = index.next_read_index.load(std::memory_order_relaxed);
+                if (read_index == index.cached_write_index) {
+                    index.cached_write_index = next_write_index.load(std::memory_order_acquire);
+                    if (read_index == index.cached_write_index) {
+                        return nullptr;
+                    }
+                }
+                return &queue[read_index & mask];
+            }
+
+            // marks this consumer's next element as read
+            void updateReadIndex(size_t consumer) noexcept {
+                releaseReads(consumer, 1);
+            }
+
+            // same as LFQUEUE::peekReads(), up to 'n' ready elements next to each other in memory
+            size_t peekReads(size_t consumer, size_t n, const T **first) const noexcept {
+                const ConsumerIndex &index = consumers[consumer];
+                const size_t read_index = index.next_read_index.load(std::memory_order_relaxed);
+                if (read_index == index.cached_write_index) {
+                    index.cached_write_index = next_write_index.load(std::memory_order_acquire);
+                    if (read_index == index.cached_write_index) {
+                        return 0;
+                    }
+                }
+
+                const size_t ready_elements = index.cached_write_index - read_index;
+                const size_t contiguous_elements = (mask + 1) - (read_index & mask);
+                *first = &queue[read_index & mask];
+                return std::min(n, std::min(ready_elements, contiguous_elements));
+            }
+
+            // marks 'n' of this consumer's elements as read with a single store
+            void releaseReads(size_t consumer, size_t n) noexcept {
+                ConsumerIndex &index = consumers[consumer];
+                const size_t read_index = index.next_read_index.load(std::memory_order_relaxed);
+                if (UNLIKELY(n > index.cached_write_index - read_index)) {
+                    FATAL("Tried to release more elements than were peeked!");
+                }
+                index.next_read_index.store(read_index + n, std::memory_order_release);
+            }
+
+            // how many elements this consumer has read so far, i.e. the position of its next element since the queue was created
+            size_t readCount(size_t consumer) const noexcept {
+                return consumers[consumer].next_read_index.load(std::memory_order_relaxed);
+            }
+
+            // returns how many elements this consumer still has to read
+            size_t size(size_t consumer) const noexcept {
+                const size_t read_index = consumers[consumer].next_read_index.load(std::memory_order_acquire);
+                return next_write_index.load(std::memory_order_acquire) - read_index;
+            }
+
+            // returns how many elements the queue can hold
+            size_t capacity() const noexcept {
+                return mask + 1;
+            }
+
+            size_t numConsumers() const noexcept {
+                return consumers.size();
+            }
+    };
+
+}
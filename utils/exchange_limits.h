@@ -10,4 +10,9 @@ namespace Common {
     constexpr size_t ME_MAX_NUM_CLIENTS = 256; // max number of participants allowed
     constexpr size_t ME_MAX_ORDER_IDs = 1024 * 1024; // max number of orders possible for a single instrument
     constexpr size_t ME_MAX_PRICE_LEVELS = 256; // max depth of price levels for the order book 
+    constexpr size_t ME_ORDER_SESSION_RING_SIZE = 4 * 1024; // max number of unread messages each way in a client's shared memory order session
+
+    // address space reserved for the matching engine's order books and queues, each book is ~2.2GB (mostly cid_oid_to_order)
+    // note that only the pages that get touched actually use memory
+    constexpr size_t ME_ARENA_SIZE = 19ULL * 1024 * 1024 * 1024;
 }
\ No newline at end of file
@@ -0,0 +1,294 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__APPLE__)
+#include <mach/vm_statistics.h> // VM_FLAGS_SUPERPAGE_SIZE_2MB
+#endif
+
+#include "macros.h"
+#include "numa_utils.h"
+
+namespace Common {
+
+    constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+    struct ArenaConfig {
+        bool use_huge_pages = true; // try explicit huge pages first, then transparent huge pages, then regular pages
+        bool prefault = false; // touch every page as it gets handed out, so the hot path never takes a page fault
+        bool lock = false; // mlock() every allocation, so the kernel can never swap it out
+        int numa_node = -1; // NUMA node the memory should go on, usually numaNodeOfCore() of the thread using it, -1 for wherever it's touched first
+    };
+
+    // which kind of pages the arena actually ended up with
+    enum class ArenaPageType : int8_t {
+        REGULAR = 0,
+        TRANSPARENT_HUGE = 1, // regular mapping, but we asked the kernel to back it with huge pages (linux THP)
+        EXPLICIT_HUGE = 2 // MAP_HUGETLB on linux, superpages on macOS
+    };
+
+    inline std::string arenaPageTypeToString(ArenaPageType page_type) {
+        switch (page_type) {
+            case ArenaPageType::REGULAR:
+                return "REGULAR";
+            case ArenaPageType::TRANSPARENT_HUGE:
+                return "TRANSPARENT_HUGE";
+            case ArenaPageType::EXPLICIT_HUGE:
+                return "EXPLICIT_HUGE";
+        }
+
+        return "UNKNOWN";
+    }
+
+    /*
+        Big structures like the order books' hashmaps and the mempools are touched all over the place, on 4K pages that means
+        lots of TLB misses on the hot path. This arena reserves one big block of memory up front and hands out pieces of it,
+        and it tries to have that block backed by 2MB huge pages, so far fewer TLB entries cover the same memory.
+
+        How it works:
+        1. the constructor reserves the whole block with mmap(), trying in this order and keeping the first that works:
+           - explicit huge pages (MAP_HUGETLB on linux, which needs pages set aside in /proc/sys/vm/nr_hugepages)
+           - a regular mapping aligned to 2MB with madvise(MADV_HUGEPAGE), so transparent huge pages can back it
+           - a regular mapping, same as 'new' would give us
+        2. allocate() just bumps an offset, there is no free, everything goes away when the arena does
+        3. memory from mmap() starts out zeroed, and with 'prefault' we touch every page as it is handed out,
+           so the first access on the hot path doesn't take a page fault
+        4. with 'lock' every allocation is also mlock()'ed, which might fail if RLIMIT_MEMLOCK is too low (see lockFailed())
+        5. with a 'numa_node' the whole block is bound to that node before anything touches it,
+           so it doesn't matter that main (and not the component's pinned thread) is the one constructing things in it
+
+        NOTE: the arena has to outlive everything that was allocated from it,
+        and nothing from it may be 'delete'd, use arenaNew()/arenaDelete() below for objects
+    */
+    class HugePageArena final {
+        private:
+            char *region = nullptr; // what mmap() gave us, needed for munmap()
+            size_t region_size = 0;
+
+            char *base = nullptr; // start of the usable part of 'region', aligned to HugePageSize
+            size_t arena_capacity = 0;
+            size_t bytes_used = 0;
+
+            const ArenaConfig config;
+            ArenaPageType page_type = ArenaPageType::REGULAR;
+            bool lock_failed = false;
+            bool numa_bind_failed = false;
+
+            static size_t roundUp(size_t bytes, size_t alignment) noexcept {
+                return (bytes + alignment - 1) & ~(alignment - 1);
+            }
+
+            // tries each kind of mapping in turn, see the notes above
+            void reserve(size_t bytes) noexcept {
+#if defined(__linux__)
+                if (config.use_huge_pages) {
+                    // no MAP_NORESERVE here, so the huge pages are reserved right now and mmap() fails if there aren't enough,
+                    // instead of SIGBUS'ing later when we touch a page that isn't there
+                    region_size = roundUp(bytes, HugePageSize);
+                    void *mapping = mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                    if (mapping != MAP_FAILED) {
+                        region = base = static_cast<char *>(mapping);
+                        arena_capacity = region_size;
+                        page_type = ArenaPageType::EXPLICIT_HUGE;
+                        return;
+                    }
+                }
+#elif defined(__APPLE__) && defined(VM_FLAGS_SUPERPAGE_SIZE_2MB)
+                if (config.use_huge_pages) {
+                    // macOS takes the superpage size in place of the file descriptor
+                    region_size = roundUp(bytes, HugePageSize);
+                    void *mapping = mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANON, VM_FLAGS_SUPERPAGE_SIZE_2MB, 0);
+                    if (mapping != MAP_FAILED) {
+                        region = base = static_cast<char *>(mapping);
+                        arena_capacity = region_size;
+                        page_type = ArenaPageType::EXPLICIT_HUGE;
+                        return;
+                    }
+                }
+#endif
+
+                // reserve an extra huge page so we can line the start up with a huge page boundary
+                // MAP_NORESERVE since we only pay for the pages we touch, so reserving a lot up front is fine
+                region_size = roundUp(bytes, HugePageSize) + HugePageSize;
+                int flags = MAP_PRIVATE | MAP_ANON;
+#if defined(__linux__)
+                flags |= MAP_NORESERVE;
+#endif
+                void *mapping = mmap(nullptr, region_size, PROT_READ | PROT_WRITE, flags, -1, 0);
+                if (mapping == MAP_FAILED) {
+                    FATAL("HugePageArena could not reserve " + std::to_string(region_size) + " bytes: " + std::string(std::strerror(errno)));
+                }
+
+                region = static_cast<char *>(mapping);
+                base = reinterpret_cast<char *>(roundUp(reinterpret_cast<uintptr_t>(region), HugePageSize));
+                arena_capacity = region_size - static_cast<size_t>(base - region);
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+                if (config.use_huge_pages && madvise(base, arena_capacity, MADV_HUGEPAGE) == 0) {
+                    page_type = ArenaPageType::TRANSPARENT_HUGE;
+                }
+#endif
+            }
+
+            // faults in and/or locks the pages under a fresh allocation, depending on the config
+            void prepare(char *start, size_t bytes) noexcept {
+                if (bytes == 0) {
+                    return;
+                }
+
+                const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+                if (config.prefault) {
+                    // read and write back the same byte on each page, since the first/last page can be shared with a neighbour allocation
+                    for (char *page = start; page < start + bytes; page = reinterpret_cast<char *>(roundUp(reinterpret_cast<uintptr_t>(page) + 1, page_size))) {
+                        volatile char *touch = page;
+                        *touch = *touch;
+                    }
+                }
+
+                if (config.lock) {
+                    char *lock_start = reinterpret_cast<char *>(reinterpret_cast<uintptr_t>(start) & ~(page_size - 1));
+                    if (mlock(lock_start, static_cast<size_t>(start + bytes - lock_start)) != 0) {
+                        lock_failed = true;
+                    }
+                }
+            }
+
+        public:
+            /* Constructors */
+
+            // 'bytes' only reserves address space, pages only cost memory once they get touched (or prefaulted)
+            HugePageArena(size_t bytes, const ArenaConfig &config_param): config(config_param) {
+                reserve(bytes);
+
+                if (config.numa_node >= 0) {
+                    numa_bind_failed = !bindToNumaNode(base, arena_capacity, config.numa_node);
+                }
+            }
+
+            ~HugePageArena() {
+                munmap(region, region_size);
+                region = base = nullptr;
+            }
+
+            HugePageArena() = delete;
+            HugePageArena(const HugePageArena &) = delete;
+            HugePageArena(const HugePageArena &&) = delete;
+            HugePageArena &operator=(const HugePageArena &) = delete;
+            HugePageArena &operator=(const HugePageArena &&) = delete;
+
+
+
+            /* Arena functions */
+
+            // returns 'bytes' of zeroed memory aligned to 'alignment' (a power of two), only meant to be called at startup
+            void *allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) noexcept {
+                const size_t offset = roundUp(bytes_used, alignment);
+                if (UNLIKELY(offset + bytes > arena_capacity)) {
+                    FATAL("HugePageArena is out of memory! capacity: " + std::to_string(arena_capacity) +
+                        " used: " + std::to_string(bytes_used) + " requested: " + std::to_string(bytes));
+                }
+
+                char *allocation = base + offset;
+                bytes_used = offset + bytes;
+                prepare(allocation, bytes);
+
+                return allocation;
+            }
+
+            size_t bytesUsed() const noexcept {
+                return bytes_used;
+            }
+
+            size_t capacity() const noexcept {
+                return arena_capacity;
+            }
+
+            ArenaPageType pageType() const noexcept {
+                return page_type;
+            }
+
+            // true if any mlock() so far failed, usually because RLIMIT_MEMLOCK ('ulimit -l') is too low
+            bool lockFailed() const noexcept {
+                return lock_failed;
+            }
+
+            // the node the memory was asked to go on, -1 if none, use numaNodeOfAddress() to see where a page actually is
+            int numaNode() const noexcept {
+                return config.numa_node;
+            }
+
+            std::string toString() const {
+                return "HugePageArena[pages: " + arenaPageTypeToString(page_type) +
+                    " numa node: " + numaNodeToString(config.numa_node) + (numa_bind_failed ? " (mbind failed)" : "") +
+                    " capacity: " + std::to_string(arena_capacity) +
+                    " used: " + std::to_string(bytes_used) +
+                    " prefault: " + std::to_string(config.prefault) +
+                    " lock: " + std::to_string(config.lock) +
+                    (lock_failed ? " (mlock failed)" : "") + "]";
+            }
+    };
+
+    /*
+        Lets standard containers (the std::vectors inside MemPool and LFQUEUE) opt into an arena,
+        with a null arena it is just the regular std::allocator, so existing code doesn't change
+    */
+    template<typename T>
+    struct ArenaAllocator {
+        using value_type = T;
+
+        HugePageArena *arena = nullptr;
+
+        ArenaAllocator() noexcept = default;
+        explicit ArenaAllocator(HugePageArena *arena_param) noexcept: arena(arena_param) {}
+
+        template<typename U>
+        ArenaAllocator(const ArenaAllocator<U> &other) noexcept: arena(other.arena) {}
+
+        T* allocate(size_t n) {
+            if (arena) {
+                return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+            }
+            return std::allocator<T>().allocate(n);
+        }
+
+        // arena memory is only given back when the whole arena goes away
+        void deallocate(T *ptr, size_t n) noexcept {
+            if (!arena) {
+                std::allocator<T>().deallocate(ptr, n);
+            }
+        }
+
+        template<typename U>
+        bool operator==(const ArenaAllocator<U> &other) const noexcept {
+            return arena == other.arena;
+        }
+    };
+
+    // 'new' for objects that should live in an arena (if there is one), e.g. an order book with its big hashmaps
+    template<typename T, typename... T_Params>
+    T* arenaNew(HugePageArena *arena, T_Params&&... args) {
+        if (arena) {
+            return new(arena->allocate(sizeof(T), alignof(T))) T(std::forward<T_Params>(args)...);
+        }
+        return new T(std::forward<T_Params>(args)...);
+    }
+
+    // 'delete' for objects from arenaNew(), has to be given the same arena
+    template<typename T>
+    void arenaDelete(HugePageArena *arena, T *obj) {
+        if (arena) {
+            obj->~T();
+        } else {
+            delete obj;
+        }
+    }
+
+}
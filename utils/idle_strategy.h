@@ -0,0 +1,258 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h> // _mm_pause()
+#endif
+
+namespace Common {
+
+    // tells the cpu we are spinning, so it can save power and give the other hyperthread on the core more room
+    inline void cpuRelax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#elif defined(__aarch64__)
+        __asm__ __volatile__ ("yield");
+#endif
+    }
+
+    /*
+        What a thread does when its loop found no work
+
+        Sleeping for a fixed time after every bit of work means we either waste time sleeping while work piles up,
+        or burn a core when there is nothing to do. Instead, we back off gradually the longer there is nothing to do:
+        1. spin (with cpuRelax()) for the first 'max_spins' empty loops, work that shows up right away gets picked up right away
+        2. then std::this_thread::yield() for the next 'max_yields', letting other threads on this core run
+        3. then sleep, starting at 'min_sleep' and doubling every time up to 'max_sleep'
+        as soon as there is work again, reset() puts us back at step 1
+    */
+    class BackoffIdleStrategy final {
+        private:
+            const uint32_t max_spins;
+            const uint32_t max_yields;
+            const std::chrono::nanoseconds min_sleep;
+            const std::chrono::nanoseconds max_sleep;
+
+            uint32_t spins = 0;
+            uint32_t yields = 0;
+            std::chrono::nanoseconds sleep;
+
+        public:
+            BackoffIdleStrategy(uint32_t max_spins_param, uint32_t max_yields_param,
+                                std::chrono::nanoseconds min_sleep_param, std::chrono::nanoseconds max_sleep_param) noexcept:
+                                max_spins(max_spins_param), max_yields(max_yields_param),
+                                min_sleep(min_sleep_param), max_sleep(max_sleep_param), sleep(min_sleep_param) {}
+
+            BackoffIdleStrategy() = delete;
+            BackoffIdleStrategy(const BackoffIdleStrategy &) = delete;
+            BackoffIdleStrategy(const BackoffIdleStrategy &&) = delete;
+            BackoffIdleStrategy &operator=(const BackoffIdleStrategy &) = delete;
+            BackoffIdleStrategy &operator=(const BackoffIdleStrategy &&) = delete;
+
+            // call when the loop came up empty
+            void idle() noexcept {
+                if (spins < max_spins) {
+                    ++spins;
+                    cpuRelax();
+                } else if (yields < max_yields) {
+                    ++yields;
+                    std::this_thread::yield();
+                } else {
+                    std::this_thread::sleep_for(sleep);
+                    sleep = std::min(sleep * 2, max_sleep);
+                }
+            }
+
+            // call when the loop did some work
+            void reset() noexcept {
+                spins = yields = 0;
+                sleep = min_sleep;
+            }
+
+            // true once we are past spinning and yielding, i.e. the next idle() sleeps
+            bool isSleeping() const noexcept {
+                return spins >= max_spins && yields >= max_yields;
+            }
+    };
+
+    /*
+        Lets a consumer thread sleep in the kernel until one of its producers has something for it
+
+        The consumer parks with park(), and the producers call wake() every time they publish (the queues do it for us,
+        see LFQUEUE::setConsumerSignal()). wake() only goes into the kernel when the consumer is actually parked,
+        otherwise it is a single load of a cache line that only changes when the consumer parks or unparks.
+
+        note that we don't put a full fence between the producer's publish and its check for a parked consumer, since that
+        would cost every write even when nobody parks, so a write that races with the consumer going to sleep can be missed,
+        that's why park() always takes a timeout, which bounds how late such a write gets picked up
+    */
+    class ParkingSignal final {
+        private:
+            alignas(64) std::atomic<uint32_t> epoch = 0; // bumped by every wake() that finds the consumer parked, the futex word
+            std::atomic<uint32_t> parked = 0;
+
+        public:
+            ParkingSignal() = default;
+
+            ParkingSignal(const ParkingSignal &) = delete;
+            ParkingSignal(const ParkingSignal &&) = delete;
+            ParkingSignal &operator=(const ParkingSignal &) = delete;
+            ParkingSignal &operator=(const ParkingSignal &&) = delete;
+
+            // producer side, call after publishing
+            void wake() noexcept {
+                if (parked.load(std::memory_order_relaxed)) {
+                    epoch.fetch_add(1, std::memory_order_release);
+#if defined(__linux__)
+                    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&epoch), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+#endif
+                }
+            }
+
+            /*
+                consumer side, sleeps until a wake() or 'timeout', unless 'work_available()' says there is something to do
+                after we announced that we are parking, which closes the gap between the caller's last empty poll and the park
+            */
+            template<typename F>
+            void park(F &&work_available, std::chrono::nanoseconds timeout) noexcept {
+                const uint32_t observed_epoch = epoch.load(std::memory_order_acquire);
+                parked.store(1, std::memory_order_seq_cst);
+                if (!work_available()) {
+#if defined(__linux__)
+                    const timespec relative_timeout{static_cast<time_t>(timeout.count() / 1000000000),
+                                                    static_cast<long>(timeout.count() % 1000000000)};
+                    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&epoch), FUTEX_WAIT_PRIVATE, observed_epoch, &relative_timeout, nullptr, 0);
+#else
+                    // no futex on macOS, so we can only poll the epoch, in steps short enough to not add much latency
+                    const auto deadline = std::chrono::steady_clock::now() + timeout;
+                    while (epoch.load(std::memory_order_acquire) == observed_epoch && std::chrono::steady_clock::now() < deadline) {
+                        std::this_thread::sleep_for(std::chrono::microseconds(50));
+                    }
+#endif
+                }
+                parked.store(0, std::memory_order_relaxed);
+            }
+    };
+
+    // how a component's run() loop waits when it found nothing to do, picked per thread (see ThreadPlacement::idle_mode)
+    enum class IdleMode : uint8_t {
+        BUSY_SPIN = 0, // never gives the core up, lowest latency, burns 100% of a core
+        SPIN_YIELD = 1, // spins for a bit, then keeps yielding to whatever else wants to run on the core
+        BACKOFF = 2, // spins, yields, then sleeps for longer and longer (BackoffIdleStrategy)
+        PARK = 3 // spins, yields, then sleeps in the kernel until a producer wakes it up (ParkingSignal)
+    };
+
+    inline std::string idleModeToString(IdleMode mode) {
+        switch (mode) {
+            case IdleMode::BUSY_SPIN: return "busy_spin";
+            case IdleMode::SPIN_YIELD: return "spin_yield";
+            case IdleMode::BACKOFF: return "backoff";
+            case IdleMode::PARK: return "park";
+        }
+        return "UNKNOWN";
+    }
+
+    // the inverse of idleModeToString(), returns false if 'name' isn't one
+    inline bool idleModeFromString(const std::string &name, IdleMode *mode) {
+        for (const IdleMode candidate : {IdleMode::BUSY_SPIN, IdleMode::SPIN_YIELD, IdleMode::BACKOFF, IdleMode::PARK}) {
+            if (name == idleModeToString(candidate)) {
+                *mode = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /*
+        The idle strategy of a component's run() loop, the same loop can run in any IdleMode:
+
+            IdleStrategy idle_strategy(currentThreadPlacement().idle_mode, &parking_signal);
+            while (running) {
+                if (pollForWork()) {
+                    idle_strategy.reset();
+                } else {
+                    idle_strategy.idle([this]() { return hasWork(); });
+                }
+            }
+
+        'work_available' is only called in IdleMode::PARK, see ParkingSignal::park()
+        note that in IdleMode::PARK a loop that also reads sockets only notices new socket data when the park times out
+        (after 'max_park'), its queues' producers are the only ones that can wake it early
+    */
+    class IdleStrategy final {
+        private:
+            const IdleMode mode;
+            ParkingSignal *const parking_signal;
+            BackoffIdleStrategy backoff;
+            const std::chrono::nanoseconds max_park;
+
+            static constexpr uint32_t MAX_SPINS = 100;
+            static constexpr uint32_t MAX_YIELDS = 10;
+
+        public:
+            // a 'parking_signal' is only needed in IdleMode::PARK, without one that mode falls back to BACKOFF
+            IdleStrategy(IdleMode mode_param, ParkingSignal *parking_signal_param = nullptr,
+                         std::chrono::nanoseconds min_sleep = std::chrono::microseconds(1),
+                         std::chrono::nanoseconds max_sleep = std::chrono::milliseconds(1)) noexcept:
+                         mode((mode_param == IdleMode::PARK && !parking_signal_param) ? IdleMode::BACKOFF : mode_param),
+                         parking_signal(parking_signal_param),
+                         backoff(MAX_SPINS, (mode == IdleMode::SPIN_YIELD ? std::numeric_limits<uint32_t>::max() : MAX_YIELDS), min_sleep, max_sleep),
+                         max_park(max_sleep) {}
+
+            IdleStrategy() = delete;
+            IdleStrategy(const IdleStrategy &) = delete;
+            IdleStrategy(const IdleStrategy &&) = delete;
+            IdleStrategy &operator=(const IdleStrategy &) = delete;
+            IdleStrategy &operator=(const IdleStrategy &&) = delete;
+
+            IdleMode idleMode() const noexcept {
+                return mode;
+            }
+
+            // call when the loop came up empty
+            template<typename F>
+            void idle(F &&work_available) noexcept {
+                switch (mode) {
+                    case IdleMode::BUSY_SPIN:
+                        break;
+                    case IdleMode::SPIN_YIELD:
+                    case IdleMode::BACKOFF:
+                        backoff.idle();
+                        break;
+                    case IdleMode::PARK:
+                        // spin and yield like BACKOFF, but park instead of sleeping
+                        if (backoff.isSleeping()) {
+                            parking_signal->park(work_available, max_park);
+                        } else {
+                            backoff.idle();
+                        }
+                        break;
+                }
+            }
+
+            void idle() noexcept {
+                idle([]() { return false; });
+            }
+
+            // call when the loop did some work
+            void reset() noexcept {
+                if (mode != IdleMode::BUSY_SPIN) {
+                    backoff.reset();
+                }
+            }
+    };
+
+}
@@ -0,0 +1,716 @@
+#include "io_uring_transport.h"
+
+#if defined(__linux__)
+
+namespace Common {
+
+    // thin wrappers, glibc doesn't ship these and we don't want to pull in liburing for a handful of calls
+    static inline int ioUringSetup(unsigned entries, io_uring_params *params) {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    static inline int ioUringEnter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+    }
+
+    static inline int ioUringRegister(int fd, unsigned opcode, void *arg, unsigned nr_args) {
+        return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+    }
+
+    bool IOUringTransport::init(bool use_sq_poll, int sq_poll_cpu) noexcept {
+        // PART 1: create the ring
+        // with SQPOLL, a kernel thread watches the submission queue for us, so we don't even need io_uring_enter() to submit
+        sq_poll = use_sq_poll;
+        params = io_uring_params{};
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = 2 * IOUringQueueDepth; // multishot receives can post many completions per submission
+        if (sq_poll) {
+            params.flags |= IORING_SETUP_SQPOLL;
+            params.sq_thread_idle = 1000; // ms before the kernel thread goes to sleep
+            if (sq_poll_cpu >= 0) {
+                params.flags |= IORING_SETUP_SQ_AFF;
+                params.sq_thread_cpu = sq_poll_cpu;
+            }
+        }
+
+        ring_file_descriptor = ioUringSetup(IOUringQueueDepth, &params);
+        if (ring_file_descriptor < 0) {
+            LOG_WARN(logger, "%:% %() % io_uring_setup() failed. errno:% \n",
+                __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), strerror(errno)
+            );
+            return false;
+        }
+
+        // PART 2: map the submission queue, completion queue, and the submission entries into our address space
+        sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+        }
+
+        sq_ring_memory = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_file_descriptor, IORING_OFF_SQ_RING);
+        if (sq_ring_memory == MAP_FAILED) {
+            sq_ring_memory = nullptr;
+            return false;
+        }
+
+        if (params.features & IORING_FEAT_SINGLE_MMAP) {
+            cq_ring_memory = sq_ring_memory;
+        } else {
+            cq_ring_memory = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_file_descriptor, IORING_OFF_CQ_RING);
+            if (cq_ring_memory == MAP_FAILED) {
+                cq_ring_memory = nullptr;
+                return false;
+            }
+        }
+
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqes_memory = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_file_descriptor, IORING_OFF_SQES);
+        if (sqes_memory == MAP_FAILED) {
+            return false;
+        }
+        sqes = reinterpret_cast<io_uring_sqe *>(sqes_memory);
+
+        char *sq_base = reinterpret_cast<char *>(sq_ring_memory);
+        sq_head = reinterpret_cast<unsigned *>(sq_base + params.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned *>(sq_base + params.sq_off.tail);
+        sq_mask = reinterpret_cast<unsigned *>(sq_base + params.sq_off.ring_mask);
+        sq_flags = reinterpret_cast<unsigned *>(sq_base + params.sq_off.flags);
+        sq_array = reinterpret_cast<unsigned *>(sq_base + params.sq_off.array);
+        sqe_tail = *sq_tail;
+
+        char *cq_base = reinterpret_cast<char *>(cq_ring_memory);
+        cq_head = reinterpret_cast<unsigned *>(cq_base + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned *>(cq_base + params.cq_off.tail);
+        cq_mask = reinterpret_cast<unsigned *>(cq_base + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe *>(cq_base + params.cq_off.cqes);
+
+        if (!probeOpcodes()) {
+            return false;
+        }
+
+        // PART 3: hand the kernel the pool of buffers that multishot receives pick from
+        // note that we use IORING_OP_PROVIDE_BUFFERS rather than a registered buffer ring (IORING_REGISTER_PBUF_RING),
+        // the ring is cheaper to recycle into but it isn't reliable across the kernels we run on
+        void *buffers_memory = mmap(nullptr, static_cast<size_t>(IOUringRecvBufferCount) * IOUringRecvBufferSize, PROT_READ | PROT_WRITE,
+                                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+        if (buffers_memory == MAP_FAILED) {
+            LOG_WARN(logger, "%:% %() % failed to map io_uring receive buffers. errno:% \n",
+                __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), strerror(errno)
+            );
+            return false;
+        }
+        recv_buffers = reinterpret_cast<char *>(buffers_memory);
+
+        io_uring_sqe *sqe = getSqe();
+        sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe->fd = static_cast<int>(IOUringRecvBufferCount);
+        sqe->addr = reinterpret_cast<uint64_t>(recv_buffers);
+        sqe->len = IOUringRecvBufferSize;
+        sqe->off = 0; // id of the first buffer
+        sqe->buf_group = IOUringRecvBufferGroup;
+        sqe->user_data = encodeUserData(0, 0, IOUringOp::PROVIDE_BUFFERS);
+        submit();
+
+        // PART 4: the ring works, but multishot receives came later than io_uring_setup(), so try one before we rely on it
+        if (!probeMultishotRecv()) {
+            return false;
+        }
+
+        // PART 5: reserve an empty (sparse) fixed buffer table, sockets fill in their slot when they are added
+        io_uring_rsrc_register buffer_table{};
+        buffer_table.nr = IOUringMaxSockets;
+        buffer_table.flags = IORING_RSRC_REGISTER_SPARSE;
+        if (ioUringRegister(ring_file_descriptor, IORING_REGISTER_BUFFERS2, &buffer_table, sizeof(buffer_table)) < 0) {
+            LOG_WARN(logger, "%:% %() % IORING_REGISTER_BUFFERS2 failed, sends will not use fixed buffers. errno:% \n",
+                __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), strerror(errno)
+            );
+        }
+
+        free_slots.reserve(IOUringMaxSockets);
+        for (size_t i = IOUringMaxSockets; i > 0; --i) {
+            free_slots.push_back(i - 1);
+        }
+        paused_slots.reserve(IOUringMaxSockets);
+
+        LOG_INFO(logger, "%:% %() % io_uring ready. fd:% sq_entries:% cq_entries:% sq_poll:% \n",
+            __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+            ring_file_descriptor, params.sq_entries, params.cq_entries, sq_poll
+        );
+
+        return true;
+    }
+
+    // asks the kernel which operations it knows, every one we submit has to be there
+    bool IOUringTransport::probeOpcodes() noexcept {
+        alignas(io_uring_probe) char probe_memory[sizeof(io_uring_probe) + IORING_OP_LAST * sizeof(io_uring_probe_op)] = {};
+        auto probe = reinterpret_cast<io_uring_probe *>(probe_memory);
+        if (ioUringRegister(ring_file_descriptor, IORING_REGISTER_PROBE, probe, IORING_OP_LAST) < 0) {
+            LOG_WARN(logger, "%:% %() % IORING_REGISTER_PROBE failed. errno:% \n",
+                __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), strerror(errno)
+            );
+            return false;
+        }
+
+        for (const unsigned opcode : {IORING_OP_RECV, IORING_OP_SEND, IORING_OP_WRITE_FIXED, IORING_OP_PROVIDE_BUFFERS, IORING_OP_ASYNC_CANCEL}) {
+            if (opcode > probe->last_op || !(probe->ops[opcode].flags & IO_URING_OP_SUPPORTED)) {
+                LOG_WARN(logger, "%:% %() % io_uring opcode:% is not supported by this kernel \n",
+                    __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), opcode
+                );
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /*
+        the opcode probe can't tell us about flags, and a kernel that doesn't know IORING_RECV_MULTISHOT only says so
+        in the first completion, which would mark every client we accept as disconnected
+        so we write a byte into a socketpair, receive it the way armRecv() does, and check it lands in a provided buffer
+        with the receive still armed, then shut the socket down to end the receive
+        this also reaps the completion of the PROVIDE_BUFFERS submitted just before us
+    */
+    bool IOUringTransport::probeMultishotRecv() noexcept {
+        int probe_sockets[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, probe_sockets) < 0) {
+            LOG_WARN(logger, "%:% %() % socketpair() failed. errno:% \n",
+                __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), strerror(errno)
+            );
+            return false;
+        }
+
+        const char byte = 0;
+        io_uring_sqe *sqe = (write(probe_sockets[1], &byte, sizeof(byte)) == sizeof(byte)) ? getSqe() : nullptr;
+        bool supported = (sqe != nullptr);
+        bool received = false;
+        bool recv_armed = supported;
+        if (sqe) {
+            sqe->opcode = IORING_OP_RECV;
+            sqe->fd = probe_sockets[0];
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = IOUringRecvBufferGroup;
+            sqe->user_data = encodeUserData(0, 0, IOUringOp::RECV); // slot generations start at 1, so this is never a live socket
+            submit();
+        }
+
+        while (recv_armed) {
+            if (ioUringEnter(ring_file_descriptor, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+                supported = false;
+                break;
+            }
+
+            unsigned head = *cq_head;
+            const unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head) {
+                const io_uring_cqe &cqe = cqes[head & *cq_mask];
+                if (static_cast<IOUringOp>(cqe.user_data & 0xff) == IOUringOp::PROVIDE_BUFFERS) {
+                    supported = supported && (cqe.res >= 0);
+                    continue;
+                }
+
+                if (cqe.flags & IORING_CQE_F_BUFFER) {
+                    recycleRecvBuffer(static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT));
+                }
+                if (!received) {
+                    received = true;
+                    supported = supported && (cqe.res == sizeof(byte)) && (cqe.flags & IORING_CQE_F_BUFFER) && (cqe.flags & IORING_CQE_F_MORE);
+                    if (cqe.flags & IORING_CQE_F_MORE) {
+                        shutdown(probe_sockets[0], SHUT_RDWR);
+                    }
+                }
+                recv_armed = recv_armed && (cqe.flags & IORING_CQE_F_MORE);
+            }
+            __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        }
+        submit(); // the recycled buffers
+
+        close(probe_sockets[0]);
+        close(probe_sockets[1]);
+
+        if (!supported) {
+            LOG_WARN(logger, "%:% %() % io_uring multishot receives into provided buffers are not supported by this kernel \n",
+                __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str)
+            );
+        }
+        return supported;
+    }
+
+    IOUringTransport::~IOUringTransport() {
+        if (sqes) {
+            munmap(sqes, sqes_size);
+        }
+        if (cq_ring_memory && cq_ring_memory != sq_ring_memory) {
+            munmap(cq_ring_memory, cq_ring_size);
+        }
+        if (sq_ring_memory) {
+            munmap(sq_ring_memory, sq_ring_size);
+        }
+        if (ring_file_descriptor >= 0) {
+            close(ring_file_descriptor); // closing the ring also drops the registered buffers
+        }
+        if (recv_buffers) {
+            munmap(recv_buffers, static_cast<size_t>(IOUringRecvBufferCount) * IOUringRecvBufferSize);
+        }
+    }
+
+    // returns the next free submission queue entry, flushing the queue to the kernel first if it is full
+    io_uring_sqe *IOUringTransport::getSqe() noexcept {
+        if (UNLIKELY(sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= params.sq_entries)) {
+            submit();
+            if (sqe_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) >= params.sq_entries) {
+                return nullptr;
+            }
+        }
+
+        const unsigned index = sqe_tail & *sq_mask;
+        io_uring_sqe *sqe = &sqes[index];
+        memset(sqe, 0, sizeof(io_uring_sqe));
+        sq_array[index] = index;
+        ++sqe_tail;
+        ++pending_submissions;
+
+        return sqe;
+    }
+
+    // hands a provided buffer back to the kernel so the multishot receives can use it again
+    // this is just another entry in the submission queue, so it goes out with the rest of the batch
+    void IOUringTransport::recycleRecvBuffer(uint16_t buffer_id) noexcept {
+        io_uring_sqe *sqe = getSqe();
+        if (UNLIKELY(!sqe)) {
+            return;
+        }
+
+        sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe->fd = 1;
+        sqe->addr = reinterpret_cast<uint64_t>(recv_buffers + static_cast<size_t>(buffer_id) * IOUringRecvBufferSize);
+        sqe->len = IOUringRecvBufferSize;
+        sqe->off = buffer_id;
+        sqe->buf_group = IOUringRecvBufferGroup;
+        sqe->flags = IOSQE_CQE_SKIP_SUCCESS; // we only want to hear about it if it fails
+        sqe->user_data = encodeUserData(0, 0, IOUringOp::PROVIDE_BUFFERS);
+    }
+
+    void IOUringTransport::armRecv(size_t slot) noexcept {
+        SocketSlot &socket_slot = slots[slot];
+        io_uring_sqe *sqe = getSqe();
+        if (UNLIKELY(!sqe)) {
+            return; // we'll try again the next time we reap
+        }
+
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = socket_slot.socket->socket_file_descriptor;
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = IOUringRecvBufferGroup;
+        sqe->user_data = encodeUserData(slot, socket_slot.generation, IOUringOp::RECV);
+        socket_slot.recv_armed = true;
+    }
+
+    // asks the kernel to cancel the slot's 'op', the CANCEL completion comes back even if there was nothing left to cancel
+    bool IOUringTransport::cancel(size_t slot, IOUringOp op) noexcept {
+        SocketSlot &socket_slot = slots[slot];
+        io_uring_sqe *sqe = getSqe();
+        if (UNLIKELY(!sqe)) {
+            return false;
+        }
+
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->addr = encodeUserData(slot, socket_slot.generation, op);
+        sqe->user_data = encodeUserData(slot, socket_slot.generation, IOUringOp::CANCEL);
+        ++socket_slot.cancels_in_flight;
+
+        return true;
+    }
+
+    // starts driving this socket: arms its multishot receive and registers its send buffer
+    bool IOUringTransport::addSocket(TCPSocket *socket) noexcept {
+        if (UNLIKELY(free_slots.empty())) {
+            return false;
+        }
+
+        const size_t slot = free_slots.back();
+        free_slots.pop_back();
+
+        SocketSlot &socket_slot = slots[slot];
+        socket_slot.socket = socket;
+        ++socket_slot.generation;
+        socket_slot.send_in_flight = 0;
+        socket->io_uring_slot = static_cast<int>(slot);
+
+        // register the front of the send buffer as a fixed buffer, if we are over the locked memory limit this fails
+        // and the socket just falls back to regular (non-fixed) sends
+        iovec iov{socket->send_buffer, std::min(socket->send_buffer_size, IOUringFixedSendWindow)};
+        uint64_t tag = 0;
+        io_uring_rsrc_update2 update{};
+        update.offset = static_cast<uint32_t>(slot);
+        update.data = reinterpret_cast<uint64_t>(&iov);
+        update.tags = reinterpret_cast<uint64_t>(&tag);
+        update.nr = 1;
+        socket_slot.has_fixed_buffer = (ioUringRegister(ring_file_descriptor, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update)) >= 0);
+
+        LOG_INFO(logger, "%:% %() % io_uring added socket:% slot:% fixed_send_buffer:% \n",
+            __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+            socket->socket_file_descriptor, slot, socket_slot.has_fixed_buffer
+        );
+
+        armRecv(slot);
+        submit();
+
+        return true;
+    }
+
+    // stops driving this socket, the kernel may still be using its buffers though, so the caller must not delete it
+    // until its io_uring_slot goes back to -1, which happens in a later submitAndReap() once every completion for it is in
+    void IOUringTransport::removeSocket(TCPSocket *socket) noexcept {
+        if (socket->io_uring_slot < 0 || slots[static_cast<size_t>(socket->io_uring_slot)].closing) {
+            return;
+        }
+
+        const size_t slot = static_cast<size_t>(socket->io_uring_slot);
+        SocketSlot &socket_slot = slots[slot];
+        socket_slot.closing = true;
+
+        // the multishot receive keeps reading into provided buffers for as long as it is armed, and a send the kernel retries
+        // after EAGAIN reads straight out of send_buffer whenever the socket has room, so both have to finish before the
+        // socket (and the buffers it owns) can go away
+        bool cancelled = true;
+        if (socket_slot.recv_armed) {
+            cancelled = cancel(slot, IOUringOp::RECV) && cancelled;
+        }
+        if (socket_slot.send_in_flight) {
+            cancelled = cancel(slot, IOUringOp::SEND) && cancelled;
+        }
+
+        // if we couldn't get a submission entry, shutting the socket down ends them just the same
+        if (UNLIKELY(!cancelled)) {
+            shutdown(socket->socket_file_descriptor, SHUT_RDWR);
+        }
+
+        // nobody is going to read what we were holding for it
+        for (const auto &held : socket_slot.held_buffers) {
+            recycleRecvBuffer(held.buffer_id);
+        }
+        socket_slot.held_buffers.clear();
+
+        submit();
+        releaseIfIdle(slot);
+    }
+
+    // hands a closing slot's socket back (io_uring_slot goes to -1) once no operation or cancel is in flight for it
+    void IOUringTransport::releaseIfIdle(size_t slot) noexcept {
+        SocketSlot &socket_slot = slots[slot];
+        if (!socket_slot.closing || socket_slot.recv_armed || socket_slot.send_in_flight || socket_slot.cancels_in_flight) {
+            return;
+        }
+
+        // empty out the fixed buffer slot
+        if (socket_slot.has_fixed_buffer) {
+            iovec iov{nullptr, 0};
+            uint64_t tag = 0;
+            io_uring_rsrc_update2 update{};
+            update.offset = static_cast<uint32_t>(slot);
+            update.data = reinterpret_cast<uint64_t>(&iov);
+            update.tags = reinterpret_cast<uint64_t>(&tag);
+            update.nr = 1;
+            ioUringRegister(ring_file_descriptor, IORING_REGISTER_BUFFERS_UPDATE, &update, sizeof(update));
+        }
+
+        LOG_INFO(logger, "%:% %() % io_uring released socket:% slot:% \n",
+            __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+            socket_slot.socket->socket_file_descriptor, slot
+        );
+
+        socket_slot.socket->io_uring_slot = -1;
+        socket_slot.socket = nullptr;
+        ++socket_slot.generation; // anything that still shows up for this socket is now stale
+        socket_slot.has_fixed_buffer = false;
+        socket_slot.recv_paused = false;
+        socket_slot.peer_closed = false;
+        socket_slot.closing = false;
+        free_slots.push_back(slot);
+    }
+
+    // queues whatever is in the socket's send buffer, if a send isn't already in flight for it
+    void IOUringTransport::queueSend(TCPSocket *socket) noexcept {
+        if (socket->io_uring_slot < 0 || !socket->next_send_valid_index) {
+            return;
+        }
+
+        const size_t slot = static_cast<size_t>(socket->io_uring_slot);
+        SocketSlot &socket_slot = slots[slot];
+
+        // only one send in flight per socket so the kernel always sees the bytes in order
+        if (socket_slot.send_in_flight || socket_slot.closing) {
+            return;
+        }
+
+        io_uring_sqe *sqe = getSqe();
+        if (UNLIKELY(!sqe)) {
+            return;
+        }
+
+        sqe->fd = socket->socket_file_descriptor;
+        sqe->addr = reinterpret_cast<uint64_t>(socket->send_buffer);
+        sqe->user_data = encodeUserData(slot, socket_slot.generation, IOUringOp::SEND);
+
+        if (LIKELY(socket_slot.has_fixed_buffer)) {
+            // a fixed buffer send can only cover the registered window, anything after that goes out in the next send
+            socket_slot.send_in_flight = std::min(socket->next_send_valid_index, IOUringFixedSendWindow);
+            sqe->opcode = IORING_OP_WRITE_FIXED;
+            sqe->off = static_cast<uint64_t>(-1); // sockets have no file position
+            sqe->buf_index = static_cast<uint16_t>(slot);
+        } else {
+            socket_slot.send_in_flight = socket->next_send_valid_index;
+            sqe->opcode = IORING_OP_SEND;
+            sqe->msg_flags = MSG_NOSIGNAL;
+        }
+        sqe->len = static_cast<uint32_t>(socket_slot.send_in_flight);
+    }
+
+    // publishes our local submission tail and calls io_uring_enter() if there is anything the kernel needs to see
+    void IOUringTransport::submit() noexcept {
+        __atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+
+        unsigned flags = 0;
+        const unsigned ring_flags = __atomic_load_n(sq_flags, __ATOMIC_ACQUIRE);
+        if (sq_poll) {
+            // the kernel thread picks up the entries on its own, we only have to wake it up if it went idle
+            if (!(ring_flags & IORING_SQ_NEED_WAKEUP)) {
+                pending_submissions = 0;
+                return;
+            }
+            flags |= IORING_ENTER_SQ_WAKEUP;
+        }
+
+        // the kernel may also ask us to come in so it can post completions it has deferred
+        if (ring_flags & (IORING_SQ_TASKRUN | IORING_SQ_CQ_OVERFLOW)) {
+            flags |= IORING_ENTER_GETEVENTS;
+        }
+
+        if (!pending_submissions && !flags) {
+            return;
+        }
+
+        const int n = ioUringEnter(ring_file_descriptor, sq_poll ? 0 : pending_submissions, 0, flags);
+        if (UNLIKELY(n < 0 && errno != EAGAIN && errno != EBUSY && errno != EINTR)) {
+            LOG_WARN(logger, "%:% %() % io_uring_enter() failed. errno:% \n",
+                __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), strerror(errno)
+            );
+        }
+        pending_submissions = 0;
+    }
+
+    void IOUringTransport::handleCompletion(const io_uring_cqe &cqe, Nanos rx_time, bool *data_read) noexcept {
+        const auto op = static_cast<IOUringOp>(cqe.user_data & 0xff);
+        const size_t slot = (cqe.user_data >> 8) & 0xffffff;
+        const uint32_t generation = static_cast<uint32_t>(cqe.user_data >> 32);
+
+        // receive buffers must always go back to the kernel, even if the socket they were for is gone
+        const bool has_buffer = (cqe.flags & IORING_CQE_F_BUFFER);
+        const uint16_t buffer_id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+
+        if (UNLIKELY(op == IOUringOp::PROVIDE_BUFFERS)) {
+            if (cqe.res < 0) {
+                LOG_WARN(logger, "%:% %() % failed to provide receive buffers to the kernel. error:% \n",
+                    __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), strerror(-cqe.res)
+                );
+            }
+            return;
+        }
+
+        if (UNLIKELY(slot >= slots.size() || slots[slot].generation != generation || !slots[slot].socket)) {
+            if (has_buffer) {
+                recycleRecvBuffer(buffer_id);
+            }
+            return;
+        }
+
+        SocketSlot &socket_slot = slots[slot];
+        TCPSocket *socket = socket_slot.socket;
+
+        if (UNLIKELY(op == IOUringOp::CANCEL)) {
+            --socket_slot.cancels_in_flight;
+            releaseIfIdle(slot);
+            return;
+        }
+
+        // the socket is on its way out, all we care about is when the kernel is done with it
+        if (UNLIKELY(socket_slot.closing)) {
+            if (has_buffer) {
+                recycleRecvBuffer(buffer_id);
+            }
+            if (op == IOUringOp::RECV && !(cqe.flags & IORING_CQE_F_MORE)) {
+                socket_slot.recv_armed = false;
+            }
+            if (op == IOUringOp::SEND) {
+                socket_slot.send_in_flight = 0;
+            }
+            releaseIfIdle(slot);
+            return;
+        }
+
+        if (op == IOUringOp::RECV) {
+            const bool is_final = !(cqe.flags & IORING_CQE_F_MORE);
+            if (is_final) {
+                socket_slot.recv_armed = false;
+            }
+
+            if (cqe.res > 0 && has_buffer) {
+                // the bytes go behind anything we are already holding, then as much as fits is copied into the socket's own buffer,
+                // so the parsers see the exact same layout as before
+                socket_slot.held_buffers.push_back(HeldRecvBuffer{buffer_id, 0, static_cast<uint32_t>(cqe.res), rx_time});
+                if (deliverHeldBuffers(slot)) {
+                    *data_read = true;
+                }
+            } else if (has_buffer) {
+                recycleRecvBuffer(buffer_id);
+            }
+
+            // 0 bytes means the peer closed the connection, any other error except running out of buffers
+            // (or our own cancel, when we paused it) is fatal for the socket
+            if (cqe.res == 0 || (cqe.res < 0 && cqe.res != -ENOBUFS && cqe.res != -ECANCELED)) {
+                socket_slot.peer_closed = true;
+                if (socket_slot.held_buffers.empty()) {
+                    socket->receive_socket_disconnected = true;
+                }
+                return;
+            }
+
+            // the kernel ends a multishot receive when it can't continue it (e.g. we were out of buffers), so re-arm it
+            if (is_final && !socket_slot.recv_paused) {
+                armRecv(slot);
+            }
+        }
+
+        if (op == IOUringOp::SEND) {
+            const size_t in_flight = socket_slot.send_in_flight;
+            socket_slot.send_in_flight = 0;
+
+            if (UNLIKELY(cqe.res < 0)) {
+                if (cqe.res != -EAGAIN && cqe.res != -EINTR) {
+                    socket->send_socket_disconnected = true;
+                }
+                return; // the bytes are still at the front of the buffer, so the next queueSend() retries them
+            }
+
+            // drop what the kernel took from the front of the buffer and keep anything that was added while the send was in flight
+            const size_t n_sent = std::min(static_cast<size_t>(cqe.res), in_flight);
+            memmove(socket->send_buffer, socket->send_buffer + n_sent, socket->next_send_valid_index - n_sent);
+            socket->next_send_valid_index -= n_sent;
+            socket->updateSendBackPressure();
+
+            LOG_TRACE(logger, "%:% %() % io_uring send socket:% len:% \n",
+                __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+                socket->socket_file_descriptor, n_sent
+            );
+        }
+    }
+
+    // copies as much of the slot's held buffers into its socket's receive buffer as fits, calling the receive_callback
+    // for each piece, then pauses or resumes the multishot receive depending on whether anything is still held
+    bool IOUringTransport::deliverHeldBuffers(size_t slot) noexcept {
+        SocketSlot &socket_slot = slots[slot];
+        TCPSocket *socket = socket_slot.socket;
+
+        bool delivered = false;
+        while (!socket_slot.held_buffers.empty()) {
+            HeldRecvBuffer &held = socket_slot.held_buffers.front();
+            const size_t n_rcv = std::min(static_cast<size_t>(held.length), socket->receive_buffer.writable());
+            if (!n_rcv) {
+                break;
+            }
+
+            memcpy(socket->receive_buffer.writePtr(), recv_buffers + static_cast<size_t>(held.buffer_id) * IOUringRecvBufferSize + held.offset, n_rcv);
+            socket->receive_buffer.commitWrite(n_rcv);
+            held.offset += static_cast<uint32_t>(n_rcv);
+            held.length -= static_cast<uint32_t>(n_rcv);
+
+            const Nanos rx_time = held.rx_time;
+            if (!held.length) {
+                recycleRecvBuffer(held.buffer_id);
+                socket_slot.held_buffers.erase(socket_slot.held_buffers.begin());
+            }
+
+            LOG_TRACE(logger, "%: % %() % io_uring read socket: % len:% utime:% \n",
+                __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+                socket->socket_file_descriptor, socket->receive_buffer.readable(), rx_time
+            );
+
+            delivered = true;
+            socket->receive_callback(socket, rx_time);
+        }
+
+        if (!socket_slot.held_buffers.empty()) {
+            // the callback isn't keeping up, so like the epoll path we stop reading from this socket and let TCP flow control
+            // push back on the peer, whatever the multishot receive already read stays held until there is room for it
+            if (!socket_slot.recv_paused) {
+                LOG_WARN(logger, "%:% %() % io_uring receive buffer full, pausing reads. socket:% \n",
+                    __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), socket->socket_file_descriptor
+                );
+                socket_slot.recv_paused = true;
+                paused_slots.push_back(slot);
+                if (socket_slot.recv_armed) {
+                    cancel(slot, IOUringOp::RECV);
+                }
+            }
+        } else {
+            if (socket_slot.recv_paused) {
+                socket_slot.recv_paused = false;
+                if (!socket_slot.recv_armed && !socket_slot.peer_closed) {
+                    armRecv(slot);
+                }
+            }
+            if (socket_slot.peer_closed) {
+                socket->receive_socket_disconnected = true;
+            }
+        }
+
+        return delivered;
+    }
+
+    // submits everything queued in one go and processes all completions,
+    // calls the socket's receive_callback for each read, and returns true if any data was read
+    bool IOUringTransport::submitAndReap() noexcept {
+        submit();
+
+        bool data_read = false;
+
+        // give the paused sockets whatever room their callbacks made since the last time
+        if (UNLIKELY(!paused_slots.empty())) {
+            for (const size_t slot : paused_slots) {
+                if (slots[slot].socket && !slots[slot].closing && deliverHeldBuffers(slot)) {
+                    data_read = true;
+                }
+            }
+            paused_slots.erase(std::remove_if(paused_slots.begin(), paused_slots.end(), [this](size_t slot) {
+                return !slots[slot].recv_paused || slots[slot].closing;
+            }), paused_slots.end());
+        }
+
+        unsigned head = *cq_head;
+        const unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        if (head == tail) {
+            if (pending_submissions) {
+                submit();
+            }
+            return data_read;
+        }
+
+        const auto rx_time = getCurrentNanos();
+        for (; head != tail; ++head) {
+            handleCompletion(cqes[head & *cq_mask], rx_time, &data_read);
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+
+        // completions may have queued re-arms, push them out now rather than waiting for the next loop
+        if (pending_submissions) {
+            submit();
+        }
+
+        return data_read;
+    }
+}
+
+#endif
@@ -0,0 +1,172 @@
+#pragma once
+
+#if defined(__linux__)
+
+#include <array>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "tcp_socket.h"
+
+namespace Common {
+
+    constexpr unsigned IOUringQueueDepth = 4096; // number of submission queue entries, the completion queue is twice this
+    constexpr unsigned IOUringRecvBufferCount = 4096; // provided buffers shared by every multishot recv
+    constexpr unsigned IOUringRecvBufferSize = 16 * 1024; // size of each provided buffer
+    constexpr uint16_t IOUringRecvBufferGroup = 0;
+    constexpr size_t IOUringMaxSockets = 1024; // size of the registered (fixed) buffer table, one slot per socket
+    constexpr size_t IOUringFixedSendWindow = 256 * 1024; // how much of each socket's send buffer we register with the kernel
+
+    /*
+        An io_uring backed transport for TCPSockets
+
+        The regular path makes one recvmsg() and one or more send() syscalls for every socket on every loop iteration,
+        even when there is nothing to do. With io_uring, we instead:
+        1. arm a single 'multishot' receive per socket, the kernel keeps completing it every time data arrives, picking
+           a buffer out of a pool of 'provided' buffers that we handed to the kernel up front
+        2. register (pin) the front of each socket's send buffer as a 'fixed' buffer, so sends skip the page mapping work
+        3. batch every send we want to make in this loop iteration into the submission queue and hand them all to the
+           kernel with a single io_uring_enter()
+
+        Completions are read straight out of the shared completion ring, which doesn't need a syscall at all
+        so hundreds of client sessions cost a couple of syscalls per loop instead of hundreds
+
+        NOTE: only one thread may drive a transport (the same thread that owns the sockets)
+    */
+    class IOUringTransport final {
+        private:
+            // what a completion belongs to, packed into the low bits of the sqe/cqe user_data
+            enum class IOUringOp : uint8_t {
+                RECV = 1,
+                SEND = 2,
+                CANCEL = 3,
+                PROVIDE_BUFFERS = 4
+            };
+
+            // a provided buffer whose bytes didn't all fit in the socket's receive buffer yet, 'offset' is where the rest starts
+            struct HeldRecvBuffer {
+                uint16_t buffer_id = 0;
+                uint32_t offset = 0;
+                uint32_t length = 0;
+                Nanos rx_time = 0;
+            };
+
+            // bookkeeping for each socket we are driving
+            struct SocketSlot {
+                TCPSocket *socket = nullptr;
+                uint32_t generation = 0; // bumped every time the slot is reused, so late completions for an old socket are ignored
+                bool has_fixed_buffer = false;
+                size_t send_in_flight = 0; // bytes at the front of send_buffer the kernel is currently sending
+                bool recv_armed = false;
+
+                // the receive buffer was full, so we cancelled the multishot receive and hold on to what it already read
+                // in 'held_buffers' (in order), the receive is armed again once the receive_callback has made room for all of it
+                bool recv_paused = false;
+                bool peer_closed = false; // the peer hung up, but we only say so once the held bytes have been delivered
+                std::vector<HeldRecvBuffer> held_buffers;
+
+                // removeSocket() was called, the slot and its socket stay alive until the kernel is done with both
+                bool closing = false;
+                unsigned cancels_in_flight = 0;
+            };
+
+            int ring_file_descriptor = -1;
+            io_uring_params params{};
+
+            // submission queue, shared with the kernel
+            void *sq_ring_memory = nullptr;
+            size_t sq_ring_size = 0;
+            unsigned *sq_head = nullptr;
+            unsigned *sq_tail = nullptr;
+            unsigned *sq_mask = nullptr;
+            unsigned *sq_flags = nullptr;
+            unsigned *sq_array = nullptr;
+            io_uring_sqe *sqes = nullptr;
+            size_t sqes_size = 0;
+            unsigned sqe_tail = 0; // local tail, only published to the kernel on submit
+            unsigned pending_submissions = 0;
+
+            // completion queue, shared with the kernel
+            void *cq_ring_memory = nullptr;
+            size_t cq_ring_size = 0;
+            unsigned *cq_head = nullptr;
+            unsigned *cq_tail = nullptr;
+            unsigned *cq_mask = nullptr;
+            io_uring_cqe *cqes = nullptr;
+
+            // provided buffers for multishot receives, buffer id 'i' lives at recv_buffers + i * IOUringRecvBufferSize
+            char *recv_buffers = nullptr;
+
+            std::array<SocketSlot, IOUringMaxSockets> slots;
+            std::vector<size_t> free_slots;
+            std::vector<size_t> paused_slots; // slots holding bytes their socket had no room for
+
+            bool sq_poll = false;
+
+            std::string time_str;
+            Logger &logger;
+
+            static uint64_t encodeUserData(size_t slot, uint32_t generation, IOUringOp op) noexcept {
+                return (static_cast<uint64_t>(generation) << 32) | (static_cast<uint64_t>(slot) << 8) | static_cast<uint64_t>(op);
+            }
+
+            // returns the next free submission queue entry, flushing the queue to the kernel first if it is full
+            io_uring_sqe *getSqe() noexcept;
+
+            // hands a provided buffer back to the kernel so the multishot receives can use it again
+            void recycleRecvBuffer(uint16_t buffer_id) noexcept;
+
+            // io_uring_setup() working doesn't mean every operation we use does, these check the ones that came later
+            bool probeOpcodes() noexcept;
+            bool probeMultishotRecv() noexcept;
+
+            void armRecv(size_t slot) noexcept;
+            void handleCompletion(const io_uring_cqe &cqe, Nanos rx_time, bool *data_read) noexcept;
+
+            // asks the kernel to cancel the slot's 'op', the CANCEL completion comes back even if there was nothing left to cancel
+            bool cancel(size_t slot, IOUringOp op) noexcept;
+
+            // copies as much of the slot's held buffers into its socket's receive buffer as fits, calling the receive_callback
+            // for each piece, then pauses or resumes the multishot receive depending on whether anything is still held
+            // returns true if any data was delivered
+            bool deliverHeldBuffers(size_t slot) noexcept;
+
+            // hands a closing slot's socket back (io_uring_slot goes to -1) once no operation or cancel is in flight for it
+            void releaseIfIdle(size_t slot) noexcept;
+
+            // publishes our local submission tail and calls io_uring_enter() if there is anything the kernel needs to see
+            void submit() noexcept;
+
+        public:
+            explicit IOUringTransport(Logger &logger_obj): logger(logger_obj) {}
+
+            ~IOUringTransport();
+
+            IOUringTransport() = delete;
+            IOUringTransport(const IOUringTransport &) = delete;
+            IOUringTransport(const IOUringTransport &&) = delete;
+            IOUringTransport &operator=(const IOUringTransport &) = delete;
+            IOUringTransport &operator=(const IOUringTransport &&) = delete;
+
+            // sets up the rings, provided buffers, and fixed buffer table
+            // returns false if the kernel doesn't support something we need, so callers can fall back to the regular path
+            bool init(bool use_sq_poll = false, int sq_poll_cpu = -1) noexcept;
+
+            // starts driving this socket: arms its multishot receive and registers its send buffer
+            bool addSocket(TCPSocket *socket) noexcept;
+
+            // stops driving this socket, the kernel may still be using its buffers though, so the caller must not delete it
+            // until its io_uring_slot goes back to -1, which happens in a later submitAndReap() once every completion for it is in
+            void removeSocket(TCPSocket *socket) noexcept;
+
+            // queues whatever is in the socket's send buffer, if a send isn't already in flight for it
+            void queueSend(TCPSocket *socket) noexcept;
+
+            // submits everything queued in one go and processes all completions,
+            // calls the socket's receive_callback for each read, and returns true if any data was read
+            bool submitAndReap() noexcept;
+    };
+}
+
+#endif
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "macros.h"
+#include "performance_utils.h"
+#include "thread_utils.h"
+#include "time_utils.h"
+
+namespace Common {
+
+    /*
+        A log-linear (HDR style) histogram of measurements in timestamp counter ticks
+
+        Buckets 0-31 each hold one value, after that every power of two is split into 32 equally sized buckets,
+        so a bucket is never wider than ~3% of the values in it, no matter if we are measuring 40ns or 40ms.
+        Anything at or over 2^40 ticks (minutes) goes in the last bucket.
+
+        Only the thread that owns it records into it (see END_MEASURE()), so a record is a couple of plain loads and stores,
+        the counts are atomics only so the reporter thread can read them while we write (relaxed, no fences)
+    */
+    class LatencyHistogram final {
+        public:
+            static constexpr uint32_t SUB_BUCKET_BITS = 5;
+            static constexpr uint64_t SUB_BUCKET_COUNT = 1ULL << SUB_BUCKET_BITS;
+            static constexpr uint32_t MAX_VALUE_BITS = 40;
+            static constexpr size_t NUM_BUCKETS = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+        private:
+            std::array<std::atomic<uint64_t>, NUM_BUCKETS> counts = {};
+            std::atomic<uint64_t> max_value = 0;
+
+        public:
+            LatencyHistogram() = default;
+
+            LatencyHistogram(const LatencyHistogram &) = delete;
+            LatencyHistogram(const LatencyHistogram &&) = delete;
+            LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+            LatencyHistogram &operator=(const LatencyHistogram &&) = delete;
+
+            static size_t bucketIndex(uint64_t value) noexcept {
+                value = std::min<uint64_t>(value, (1ULL << MAX_VALUE_BITS) - 1);
+                if (value < SUB_BUCKET_COUNT) {
+                    return static_cast<size_t>(value);
+                }
+
+                // the top bit picks the group, the next SUB_BUCKET_BITS bits pick the bucket in it
+                const uint32_t top_bit = 63 - static_cast<uint32_t>(__builtin_clzll(value));
+                const uint32_t shift = top_bit - SUB_BUCKET_BITS;
+                return (shift + 1) * SUB_BUCKET_COUNT + static_cast<size_t>((value >> shift) - SUB_BUCKET_COUNT);
+            }
+
+            // the biggest value that lands in 'index', what we report for a percentile that falls in it
+            static uint64_t bucketHighestValue(size_t index) noexcept {
+                if (index < SUB_BUCKET_COUNT) {
+                    return index;
+                }
+
+                const uint64_t shift = index / SUB_BUCKET_COUNT - 1;
+                const uint64_t lowest = (SUB_BUCKET_COUNT + index % SUB_BUCKET_COUNT) << shift;
+                return lowest + (1ULL << shift) - 1;
+            }
+
+            void record(uint64_t value) noexcept {
+                std::atomic<uint64_t> &count = counts[bucketIndex(value)];
+                count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                if (value > max_value.load(std::memory_order_relaxed)) {
+                    max_value.store(value, std::memory_order_relaxed);
+                }
+            }
+
+            // adds a snapshot of our counts into 'out' (NUM_BUCKETS long), and returns our max
+            uint64_t addTo(std::vector<uint64_t> *out) const noexcept {
+                for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+                    (*out)[i] += counts[i].load(std::memory_order_relaxed);
+                }
+                return max_value.load(std::memory_order_relaxed);
+            }
+
+            // the value at 'percentile' (0-100) of a snapshot from addTo()
+            static uint64_t valueAtPercentile(const std::vector<uint64_t> &snapshot, uint64_t total, double percentile) noexcept {
+                if (!total) {
+                    return 0;
+                }
+
+                const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(static_cast<double>(total) * percentile / 100.0 + 0.5));
+                uint64_t seen = 0;
+                for (size_t i = 0; i < NUM_BUCKETS; ++i) {
+                    seen += snapshot[i];
+                    if (seen >= rank) {
+                        return bucketHighestValue(i);
+                    }
+                }
+                return bucketHighestValue(NUM_BUCKETS - 1);
+            }
+    };
+
+    constexpr size_t LATENCY_MAX_HISTOGRAMS = 256; // one per tag per thread that measures it
+
+    /*
+        Every histogram in the process, so the reporter can find them
+
+        A thread gets its own histogram for a tag the first time it measures that tag (see END_MEASURE()), so threads never
+        share one. Registering takes a slot with a fetch_add and then marks it ready, the reporter skips slots that aren't
+        ready yet. Histograms are never removed, the threads that measure things live for the whole program anyway.
+    */
+    class LatencyRegistry final {
+        private:
+            struct Entry {
+                const char *tag = nullptr;
+                LatencyHistogram *histogram = nullptr;
+                std::atomic<bool> ready = false;
+            };
+
+            std::array<Entry, LATENCY_MAX_HISTOGRAMS> entries;
+            std::atomic<size_t> num_entries = 0;
+
+        public:
+            LatencyRegistry() = default;
+
+            LatencyRegistry(const LatencyRegistry &) = delete;
+            LatencyRegistry(const LatencyRegistry &&) = delete;
+            LatencyRegistry &operator=(const LatencyRegistry &) = delete;
+            LatencyRegistry &operator=(const LatencyRegistry &&) = delete;
+
+            // note that the histogram gets allocated (and first touched) by the calling thread, so it lands on that thread's numa node
+            LatencyHistogram *registerHistogram(const char *tag) noexcept {
+                const size_t index = num_entries.fetch_add(1);
+                if (UNLIKELY(index >= LATENCY_MAX_HISTOGRAMS)) {
+                    FATAL("too many latency histograms, raise LATENCY_MAX_HISTOGRAMS");
+                }
+
+                Entry &entry = entries[index];
+                entry.tag = tag;
+                entry.histogram = new LatencyHistogram();
+                entry.ready.store(true, std::memory_order_release);
+                return entry.histogram;
+            }
+
+            template<typename Func>
+            void forEach(Func &&func) const {
+                const size_t count = std::min(num_entries.load(), LATENCY_MAX_HISTOGRAMS);
+                for (size_t i = 0; i < count; ++i) {
+                    if (entries[i].ready.load(std::memory_order_acquire)) {
+                        func(entries[i].tag, *entries[i].histogram);
+                    }
+                }
+            }
+    };
+
+    inline LatencyRegistry latency_registry;
+
+    /*
+        Periodically writes p50/p99/p99.9/max and counts of every tag, across all the threads that measure it, in nanoseconds
+
+        The numbers are for everything since the program started, and 'new' is how many measurements came in since the last report.
+        An empty file name writes to stdout instead. The destructor writes one last report.
+    */
+    class LatencyReporter final {
+        private:
+            const std::string file_name;
+            const std::chrono::milliseconds interval;
+            std::atomic<bool> running = true;
+            std::thread *reporter_thread = nullptr;
+            std::map<std::string, uint64_t> last_counts; // only touched by whoever is writing the report
+
+            void run() noexcept {
+                auto next_report = std::chrono::steady_clock::now() + interval;
+                while (running) {
+                    // wake up often enough that the destructor doesn't have to wait out a whole interval
+                    using namespace std::literals::chrono_literals;
+                    std::this_thread::sleep_for(std::min<std::chrono::milliseconds>(interval, 100ms));
+                    if (std::chrono::steady_clock::now() >= next_report) {
+                        writeReport();
+                        next_report += interval;
+                    }
+                }
+            }
+
+            void writeReport() noexcept {
+                const std::string text = report();
+                if (file_name.empty()) {
+                    std::cout << text << std::flush;
+                } else {
+                    std::ofstream file(file_name, std::ios::out | std::ios::app);
+                    file << text;
+                }
+            }
+
+        public:
+            // note that 'core_id' is the core the reporter's thread gets pinned to, -1 leaves it unpinned
+            LatencyReporter(const std::string &file_name_param, std::chrono::milliseconds interval_param, int core_id = -1):
+                            file_name(file_name_param), interval(interval_param) {
+                if (!file_name.empty()) {
+                    std::ofstream file(file_name, std::ios::out | std::ios::trunc);
+                }
+                reporter_thread = createAndStartThread(core_id, "latency_reporter", [this]() { run(); });
+                ASSERT(reporter_thread != nullptr, "Latency reporter thread did not start");
+            }
+
+            ~LatencyReporter() {
+                running = false;
+                reporter_thread->join();
+                delete reporter_thread;
+                writeReport();
+            }
+
+            LatencyReporter() = delete;
+            LatencyReporter(const LatencyReporter &) = delete;
+            LatencyReporter(const LatencyReporter &&) = delete;
+            LatencyReporter &operator=(const LatencyReporter &) = delete;
+            LatencyReporter &operator=(const LatencyReporter &&) = delete;
+
+            // one line per tag, the threads measuring the same tag get merged
+            std::string report() {
+                struct Merged {
+                    std::vector<uint64_t> counts = std::vector<uint64_t>(LatencyHistogram::NUM_BUCKETS, 0);
+                    uint64_t max = 0;
+                    size_t threads = 0;
+                };
+                std::map<std::string, Merged> tags;
+                latency_registry.forEach([&tags](const char *tag, const LatencyHistogram &histogram) {
+                    Merged &merged = tags[tag];
+                    merged.max = std::max(merged.max, histogram.addTo(&merged.counts));
+                    ++merged.threads;
+                });
+
+                std::string time_str;
+                std::ostringstream out;
+                out << getCurrentTimeStr(&time_str) << " latency report (ns)\n";
+                for (const auto &[tag, merged] : tags) {
+                    uint64_t total = 0;
+                    for (const uint64_t count : merged.counts) {
+                        total += count;
+                    }
+                    const auto toNanos = [](uint64_t ticks) { return tsc_clock.ticksToNanos(ticks); };
+
+                    out << "  " << tag
+                        << " count:" << total << " new:" << total - last_counts[tag]
+                        << " p50:" << toNanos(LatencyHistogram::valueAtPercentile(merged.counts, total, 50.0))
+                        << " p99:" << toNanos(LatencyHistogram::valueAtPercentile(merged.counts, total, 99.0))
+                        << " p99.9:" << toNanos(LatencyHistogram::valueAtPercentile(merged.counts, total, 99.9))
+                        << " max:" << toNanos(merged.max)
+                        << " threads:" << merged.threads << "\n";
+                    last_counts[tag] = total;
+                }
+                return out.str();
+            }
+    };
+
+}
+
+/*
+    START_MEASURE(TAG) ... END_MEASURE(TAG) records how long the code in between took into TAG's histogram for this thread
+
+    The first END_MEASURE() of a tag on a thread registers that thread's histogram (the thread_local), after that
+    it is an rdtscp() and a LatencyHistogram::record(), a few ns, no log line. A LatencyReporter writes out the numbers.
+*/
+#define START_MEASURE(TAG) const auto TAG = Common::rdtsc()
+
+#define END_MEASURE(TAG) \
+    do { \
+        const auto end = Common::rdtscp(); \
+        static thread_local Common::LatencyHistogram *const histogram = Common::latency_registry.registerHistogram(#TAG); \
+        histogram->record(end - TAG); \
+    } while (false)
@@ -4,11 +4,21 @@
 #include <iostream>
 #include <vector>
 #include <atomic>
+#include <algorithm>
+#include <bit>
 
 #include "macros.h"
+#include "huge_page_arena.h"
+#include "idle_strategy.h"
 
 namespace Common {
 
+    // size of a cache line on the machines we run on, anything that two threads write to should live on its own line
+    constexpr size_t CacheLineSize = 64;
+
+    // most elements a run loop takes out of a queue with one peekReads(), keeps one busy queue from starving the others
+    constexpr size_t LFQueueDrainBatchSize = 64;
+
     /*
         We want a way for different processes to communicate with each other and in such a way that multiple threads can read data concurrently.
         An application is that we can have several worker threads complete several tasks and send the results to the queue
@@ -18,20 +28,52 @@ namespace Common {
         Single Producer Single Consumer (SPSC) – that is, only one thread writes to the queue and only one thread consumes from the queue.
 
         Importantly, this queue does not use locks or mutexes, meaning that there will be less context switches, reducing latency
+
+        How we keep the two threads from slowing each other down:
+        1. the write index is only ever written by the producer and the read index only by the consumer,
+           each one sits on its own cache line so a write by one thread doesn't kick the other thread's line out of its cache
+        2. each side keeps a plain (non-atomic) copy of the other side's index and only re-reads the real one
+           when the copy says the queue is full/empty, so most operations never touch the other thread's cache line
+        3. the indices only ever count up, and the capacity is a power of two, so the slot is 'index & mask' instead of a '%'
+           and the number of elements is just 'write_index - read_index', no shared counter that both threads have to update
+        4. the producer 'releases' its writes when it moves the write index and the consumer 'acquires' them when it reads it
+           (and the other way around for the read index), which is all the ordering SPSC needs, no full (seq_cst) fences
+
+        Batching:
+        every updateWriteIndex()/updateReadIndex() is a store the other thread has to see, so when we have several elements
+        to move at once we can do all of them with a single store instead
+        - producer: reserveWrites()/commitWrites() for a span of slots, or stageWriteIndex() after each getNextWriteTo()
+          and one commitWrites() at the end, for when we don't know up front how many elements we'll write
+        - consumer: peekReads() gives a span of ready elements and releaseReads() hands all of them back at once
+
+        A consumer that parks when it runs out of work (IdleMode::PARK) hands its ParkingSignal to setConsumerSignal(),
+        and every publish (updateWriteIndex()/commitWrites()) wakes it up
     */
     template<typename T>
     class LFQUEUE final {
         private:
-            std::vector<T> queue; 
+            // read-only after construction, shared by both threads
+            std::vector<T, ArenaAllocator<T>> queue; 
+            size_t mask = 0;
 
-            std::atomic<size_t> next_read_index = 0;
-            std::atomic<size_t> next_write_index = 0;
-            std::atomic<size_t> num_elements = 0;
+            // written by the producer
+            alignas(CacheLineSize) std::atomic<size_t> next_write_index = 0;
+            size_t local_write_index = 0; // includes staged writes the consumer can't see yet
+            size_t cached_read_index = 0; // producer's copy of next_read_index
+            ParkingSignal *consumer_signal = nullptr; // set before the threads start, null if the consumer never parks
+
+            // written by the consumer
+            alignas(CacheLineSize) std::atomic<size_t> next_read_index = 0;
+            mutable size_t cached_write_index = 0; // consumer's copy of next_write_index, refreshed by getNextRead()
+            // note that alignas() also pads the end of the class out to a full cache line, so nothing else lands on this one
 
         public:
             /* Constructors */
 
-            LFQUEUE(size_t num_elements): queue(num_elements, T()) {};
+            // note that the capacity gets rounded up to the next power of two
+            // if an 'arena' is given, the elements live in it (e.g. on huge pages) instead of on the regular heap
+            LFQUEUE(size_t num_elements, HugePageArena *arena = nullptr): queue(std::bit_ceil(num_elements), T(), ArenaAllocator<T>(arena)),
+                                                                         mask(std::bit_ceil(num_elements) - 1) {};
 
             LFQUEUE() = delete; // Cannot instantiate the queue without passing in num_elements
             LFQUEUE(const LFQUEUE&) = delete; // Cannot copy the queue
@@ -39,44 +81,130 @@ namespace Common {
             LFQUEUE(const LFQUEUE&&) = delete; // Cannot use move constructor
             LFQUEUE& operator=(const LFQUEUE&&) = delete; // Cannot use move assignment
 
+            // the consumer's signal, has to be set before the producer and consumer threads start
+            void setConsumerSignal(ParkingSignal *signal) noexcept {
+                consumer_signal = signal;
+            }
+
 
 
             /* LFQueue public functions */
 
             // returns a pointer to the next object in the queue that the user can modify
+            // if the queue is full, this waits for the consumer to free up a slot instead of overwriting unread data
             T* getNextWriteTo() noexcept {
-                return &queue[next_write_index];
+                while (UNLIKELY(local_write_index - cached_read_index > mask)) {
+                    commitWrites(); // the consumer can't free up anything we haven't published yet
+                    cached_read_index = next_read_index.load(std::memory_order_acquire);
+                }
+                return &queue[local_write_index & mask];
             }
 
-            // finalizes the current write object as complete and increments the queue size
+            // finalizes the current write object as complete, which publishes it to the consumer
             void updateWriteIndex() noexcept {
-                next_write_index = (next_write_index + 1) % queue.size();
-                num_elements++;
+                ++local_write_index;
+                next_write_index.store(local_write_index, std::memory_order_release);
+                if (consumer_signal) {
+                    consumer_signal->wake();
+                }
+            }
+
+            // finalizes the current write object, but holds off on publishing it until the next commitWrites()
+            void stageWriteIndex() noexcept {
+                ++local_write_index;
+            }
+
+            // points 'first' at up to 'n' free slots that sit next to each other in memory and returns how many it got
+            // waits until at least one slot is free, note that it can return fewer than 'n' when the span reaches the end of the ring
+            size_t reserveWrites(size_t n, T **first) noexcept {
+                *first = getNextWriteTo();
+                const size_t free_slots = (mask + 1) - (local_write_index - cached_read_index);
+                const size_t contiguous_slots = (mask + 1) - (local_write_index & mask);
+                return std::min(n, std::min(free_slots, contiguous_slots));
+            }
+
+            // finalizes 'n' reserved slots, but holds off on publishing them until the next commitWrites()
+            // useful when one 'message' spans more than one reserveWrites(), e.g. when it wraps around the end of the queue
+            void stageWrites(size_t n) noexcept {
+                local_write_index += n;
+            }
+
+            // publishes 'n' reserved slots along with anything staged, all with a single store
+            void commitWrites(size_t n = 0) noexcept {
+                local_write_index += n;
+                next_write_index.store(local_write_index, std::memory_order_release);
+                if (consumer_signal) {
+                    consumer_signal->wake();
+                }
             }
 
             // returns a pointer to the next object that can be read
             // if the queue is empty, returns null
             const T* getNextRead() const noexcept { // <- NOTE: functions that do not modify state should be marked with 'const'
-                return (next_read_index == next_write_index ? nullptr : &queue[next_read_index]);
+                const size_t read_index = next_read_index.load(std::memory_order_relaxed); // only we write it
+                if (read_index == cached_write_index) {
+                    cached_write_index = next_write_index.load(std::memory_order_acquire);
+                    if (read_index == cached_write_index) {
+                        return nullptr;
+                    }
+                }
+                return &queue[read_index & mask];
             }
 
             // marks the element at 'next_read_index' as read and increments the queue
             void updateReadIndex() noexcept {
-                next_read_index = (next_read_index + 1) % queue.size();
+                const size_t read_index = next_read_index.load(std::memory_order_relaxed);
 
                 // after we read from the queue, we 'consume' the element
                 // if there are no elements left, and we just read, we have a problem
-                ASSERT(num_elements != 0, "Tried to read from an empty queue!");
-                num_elements--;
+                if (UNLIKELY(read_index == cached_write_index)) {
+                    cached_write_index = next_write_index.load(std::memory_order_acquire);
+                    ASSERT(read_index != cached_write_index, "Tried to read from an empty queue!");
+                }
+                next_read_index.store(read_index + 1, std::memory_order_release);
+            }
+
+            // points 'first' at up to 'n' ready elements that sit next to each other in memory and returns how many it got
+            // returns 0 if the queue is empty, call releaseReads() with the count once done with them
+            size_t peekReads(size_t n, const T **first) const noexcept {
+                const size_t read_index = next_read_index.load(std::memory_order_relaxed);
+                if (read_index == cached_write_index) {
+                    cached_write_index = next_write_index.load(std::memory_order_acquire);
+                    if (read_index == cached_write_index) {
+                        return 0;
+                    }
+                }
+
+                const size_t ready_elements = cached_write_index - read_index;
+                const size_t contiguous_elements = (mask + 1) - (read_index & mask);
+                *first = &queue[read_index & mask];
+                return std::min(n, std::min(ready_elements, contiguous_elements));
+            }
+
+            // marks 'n' elements as read with a single store
+            void releaseReads(size_t n) noexcept {
+                const size_t read_index = next_read_index.load(std::memory_order_relaxed);
+                if (UNLIKELY(n > cached_write_index - read_index)) {
+                    FATAL("Tried to release more elements than were peeked!");
+                }
+                next_read_index.store(read_index + n, std::memory_order_release);
             }
 
             // returns the size of the queue
+            // note that if the other thread is busy, this is a snapshot that may already be out of date by the time it is used
             size_t size() const noexcept {
-                return num_elements.load();
+                const size_t read_index = next_read_index.load(std::memory_order_acquire);
+                const size_t write_index = next_write_index.load(std::memory_order_acquire);
+                return write_index - read_index;
+            }
+
+            // returns how many elements the queue can hold
+            size_t capacity() const noexcept {
+                return mask + 1;
             }
 
     };
 
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+#include "logtype.h"
+
+namespace Common {
+
+    /*
+        Reads a log file written in LogMode::BINARY and writes the same text a LogMode::TEXT logger would have written
+        with 'timestamps', every line is prefixed with the nanoseconds since the epoch it was logged at (from its rdtsc() value)
+
+        returns false (after decoding as much as it could) if the file is not a binary log or is cut off, e.g. the process died mid-write
+    */
+    inline bool decodeLogFile(std::istream &in, std::ostream &out, bool timestamps, std::string *error) {
+        LogFileHeader file_header;
+        if (!in.read(reinterpret_cast<char *>(&file_header), sizeof(file_header)) || !file_header.isValid()) {
+            *error = "not a binary log file";
+            return false;
+        }
+
+        std::unordered_map<uint64_t, std::string> formats; // format string id -> its text
+        std::string args;
+        std::string line;
+
+        LogRecordHeader header;
+        while (in.read(reinterpret_cast<char *>(&header), sizeof(header))) {
+            args.resize(header.args_size);
+            if (!in.read(args.data(), static_cast<std::streamsize>(header.args_size))) {
+                *error = "file ends in the middle of a record";
+                return false;
+            }
+
+            if (header.type == LogRecordType::FORMAT_STRING) {
+                formats[header.format] = args;
+                continue;
+            }
+
+            const auto format = formats.find(header.format);
+            if (format == formats.end()) {
+                *error = "record uses a format string that was never written";
+                return false;
+            }
+
+            line.clear();
+            if (timestamps) {
+                line.push_back('[');
+                line.append(std::to_string(file_header.toNanos(header.rdtsc)));
+                line.append("] ");
+            }
+            if (!formatLogRecord(format->second.c_str(), args.data(), args.size(), &line)) {
+                *error = "record doesn't match its format string: " + format->second;
+                return false;
+            }
+            out << line;
+        }
+
+        if (in.gcount() != 0) {
+            *error = "file ends in the middle of a record";
+            return false;
+        }
+        return true;
+    }
+
+}
@@ -1,93 +1,295 @@
 #pragma once
 
+#include <array>
 #include <string>
-#include <fstream> // library for allowing writing to output files
+#include <unordered_set>
+#include <vector>
+#include <cerrno>
+#include <climits> // IOV_MAX
+#include <fcntl.h>
+#include <sys/uio.h> // writev()
+#include <unistd.h>
 #include "logtype.h"
+#include "idle_strategy.h"
+#include "performance_utils.h"
 #include <iostream>
 
 namespace Common {
 
+    class Logger;
+
+    /*
+        One I/O thread that writes out every Logger's records
+
+        Each Logger used to start its own writer thread, so the exchange alone had a handful of them competing with the pinned
+        hot threads. Now every Logger registers its (small) queue with a LogService, and the service's single thread goes round
+        all of them, moving each one's records into that Logger's own file (see Logger::drainQueue()).
+
+        Registering and unregistering happen without locks, so a Logger can come and go while the service thread is running:
+        - every Logger takes a slot in 'loggers'
+        - before the service thread drains a Logger it announces it in 'draining' and then checks the slot still holds it,
+          and a Logger that is going away empties its slot and then waits until 'draining' isn't it any more,
+          so one of the two always sees the other (both use seq_cst, see removeLogger())
+
+        Most programs just use defaultService(), which starts the first time a Logger is created
+    */
+    class LogService final {
+        private:
+            std::array<std::atomic<Logger *>, LOG_MAX_LOGGERS> loggers = {};
+            std::atomic<Logger *> draining = nullptr; // the logger the service thread is writing out right now, if any
+            std::atomic<bool> running = true;
+            std::thread *service_thread = nullptr;
+
+            // spins for a bit when every queue runs dry, then backs off to sleeping (up to 1ms) so we don't take a core away from the hot threads
+            BackoffIdleStrategy idle_strategy{100, 10, std::chrono::microseconds(1), std::chrono::milliseconds(1)};
+
+            // drains every registered logger once, returns false if none of them had anything
+            bool drainLoggers() noexcept;
+
+            void run() noexcept;
+
+        public:
+            // note that 'core_id' is the core the service's thread gets pinned to, -1 leaves it unpinned
+            explicit LogService(int core_id = -1) {
+                service_thread = createAndStartThread(core_id, "log_service", [this]() { run(); });
+                ASSERT(service_thread != nullptr, "Log service thread did not start");
+            }
+
+            ~LogService();
+
+            LogService(const LogService &) = delete;
+            LogService(const LogService &&) = delete;
+            LogService& operator=(const LogService &) = delete;
+            LogService& operator=(const LogService &&) = delete;
+
+            // takes a free slot for 'logger', the service starts writing out its queue right away
+            void addLogger(Logger *logger) noexcept {
+                for (auto &slot : loggers) {
+                    Logger *expected = nullptr;
+                    if (slot.compare_exchange_strong(expected, logger)) {
+                        return;
+                    }
+                }
+                FATAL("Log service has no room for another logger, raise LOG_MAX_LOGGERS");
+            }
+
+            // once this returns, the service thread is done with 'logger' and won't touch it again
+            void removeLogger(Logger *logger) noexcept {
+                for (auto &slot : loggers) {
+                    if (slot.load() == logger) {
+                        slot.store(nullptr);
+                    }
+                }
+                while (draining.load() == logger) {
+                    cpuRelax();
+                }
+            }
+
+            /*
+                the service every Logger uses unless it is given another one
+                note that the first call starts it, so call this with the core you want before creating any Logger
+                (later calls ignore 'core_id')
+            */
+            static LogService &defaultService(int core_id = -1) {
+                static LogService service(core_id);
+                return service;
+            }
+    };
+
     /*
         Logger object that will be used to log metrics and performance messages during the runtime
+
+        The main thread doesn't format anything, log() just copies the format string's address, an rdtsc() timestamp, and the raw
+        bytes of the arguments into the queue as one record (see logtype.h), which is a handful of memcpy()s instead of a queue write
+        per character. The logger thread turns the records into text, or in LogMode::BINARY writes them as they are for
+        tools/log_decoder to turn into text later.
+
+        A Logger doesn't have a thread of its own, the LogService it registers with takes records out of its queue in batches of
+        up to LOG_WRITE_BATCH_SIZE bytes and hands each batch to the kernel with a single writev() (binary records go straight
+        from the batch to the kernel with no copy in between). Below, 'the logger thread' is that service's thread.
+
+        NOTE: since only the format string's address is copied, format strings must live for the whole program (string literals do)
     */
     class Logger final { // note the use of final keyword which indicates this cannot be inherited
 
         private:
             const std::string filename;
-            std::ofstream file; // stream that writes to a file
-            LFQUEUE<LogElement> queue;
-            std::atomic<bool> running = true; // switch for keeping the logger thread active
-            std::thread *logger_thread = nullptr;
+            const LogMode mode;
+            int fd = -1; // the log file
+            LFQUEUE<char> queue; // records, byte by byte
+            LogService *service = nullptr; // whose thread writes our records out
+
+            friend class LogService;
+
+            // only touched by the logger thread
+            std::string pending; // records taken out of the queue, the last one might not be whole yet
+            std::string output; // text records (or binary format strings) we are about to write to the file
+            std::unordered_set<uint64_t> written_formats; // format strings already in the binary file
+
+            // pieces of 'pending' and 'output' to hand to writev(), binary records are written straight out of 'pending' with no copy
+            struct OutputSegment {
+                const std::string *source = nullptr;
+                size_t offset = 0;
+                size_t size = 0;
+            };
+            std::vector<OutputSegment> segments;
+            std::vector<iovec> iovecs;
+
+            // writes a record into the queue, a piece at a time if it wraps around the end of the queue
+            struct QueueWriter {
+                LFQUEUE<char> *queue = nullptr;
+
+                void write(const void *data, size_t n) noexcept {
+                    const char *bytes = static_cast<const char *>(data);
+                    while (n) {
+                        char *first = nullptr;
+                        const size_t reserved = queue->reserveWrites(n, &first);
+                        std::memcpy(first, bytes, reserved);
+                        queue->stageWrites(reserved);
+                        bytes += reserved;
+                        n -= reserved;
+                    }
+                }
+            };
+
+            // turns every complete record in 'pending' into what we write out (see 'segments'), returns how many bytes of 'pending' it used
+            // a partial record at the end is left for next time
+            size_t processPending() noexcept {
+                size_t offset = 0;
+                size_t run_start = 0; // binary records from here to 'offset' can be written straight out of 'pending'
+                while (pending.size() - offset >= sizeof(LogRecordHeader)) {
+                    const LogRecordHeader header = readLogValue<LogRecordHeader>(pending.data() + offset);
+                    const size_t record_size = sizeof(LogRecordHeader) + header.args_size;
+                    if (pending.size() - offset < record_size) {
+                        break;
+                    }
 
-        public:
+                    const char *format = reinterpret_cast<const char *>(header.format);
+                    if (mode == LogMode::TEXT) {
+                        if (UNLIKELY(!formatLogRecord(format, pending.data() + offset + sizeof(LogRecordHeader), header.args_size, &output))) {
+                            FATAL("log() was given a different number of variables than there are % keywords in: " + std::string(format));
+                        }
+                    } else if (written_formats.insert(header.format).second) {
+                        // the decoder can't read our memory, so the first time a format string shows up, write out its text before the record
+                        segments.push_back({&pending, run_start, offset - run_start});
+                        run_start = offset;
+
+                        const LogRecordHeader format_header{header.format, 0, static_cast<uint32_t>(std::strlen(format)), LogRecordType::FORMAT_STRING};
+                        segments.push_back({&output, output.size(), sizeof(format_header) + format_header.args_size});
+                        output.append(reinterpret_cast<const char *>(&format_header), sizeof(format_header));
+                        output.append(format, format_header.args_size);
+                    }
 
-            void flushQueue() noexcept {
-                while (running) {
-                    // next will be a pointer to the next queue object
-                    for (const LogElement* next = queue.getNextRead(); (queue.size() > 0) && (next != nullptr); next = queue.getNextRead() ) {
-
-                        // write to the file
-                        switch (next->type) {
-                            case LogType::CHAR:
-                                file << next->u.c; break;
-                            case LogType::INTEGER:
-                                file << next->u.i; break;
-                            case LogType::LONG_INTEGER:
-                                file << next->u.l; break;
-                            case LogType::LONG_LONG_INTEGER:
-                                file << next->u.ll; break;
-                            case LogType::UNSIGNED_INTEGER:
-                                file << next->u.u; break;
-                            case LogType::UNSIGNED_LONG_INTEGER:
-                                file << next->u.ul; break;
-                            case LogType::UNSIGNED_LONG_LONG_INTEGER:
-                                file << next->u.ull; break;
-                            case LogType::FLOAT:
-                                file << next->u.f; break;
-                            case LogType::DOUBLE:
-                                file << next->u.d; break;
+                    offset += record_size;
+                }
+
+                if (mode == LogMode::TEXT) {
+                    segments.push_back({&output, 0, output.size()});
+                } else {
+                    segments.push_back({&pending, run_start, offset - run_start});
+                }
+
+                return offset;
+            }
+
+            // writes all the segments to the file with as few writev() calls as possible
+            void writeSegments() noexcept {
+                iovecs.clear();
+                for (const OutputSegment &segment : segments) {
+                    if (segment.size) {
+                        iovecs.push_back({const_cast<char *>(segment.source->data() + segment.offset), segment.size});
+                    }
+                }
+                segments.clear();
+
+                size_t next = 0;
+                while (next < iovecs.size()) {
+                    const int count = static_cast<int>(std::min<size_t>(iovecs.size() - next, IOV_MAX));
+                    const ssize_t n = ::writev(fd, &iovecs[next], count);
+                    if (UNLIKELY(n < 0)) {
+                        if (errno == EINTR) {
+                            continue;
                         }
+                        std::cerr << "Logger could not write to " << filename << ": " << std::strerror(errno) << std::endl;
+                        break;
+                    }
 
-                        // update the queue and let the thread go on cooldown
-                        queue.updateReadIndex();
-                        using namespace std::chrono_literals;
-                        std::this_thread::sleep_for(1ms); 
+                    // the kernel might have taken only part of it, skip what it took and go again
+                    size_t written = static_cast<size_t>(n);
+                    while (next < iovecs.size() && written >= iovecs[next].iov_len) {
+                        written -= iovecs[next].iov_len;
+                        ++next;
+                    }
+                    if (written) {
+                        iovecs[next].iov_base = static_cast<char *>(iovecs[next].iov_base) + written;
+                        iovecs[next].iov_len -= written;
                     }
                 }
             }
 
-            explicit Logger(const std::string &file_name) : filename(file_name), queue(LOG_QUEUE_SIZE) {
+            // moves up to LOG_WRITE_BATCH_SIZE bytes out of the queue and writes them out, returns false if the queue was empty
+            bool drainQueue() noexcept {
+                size_t drained = 0;
+                const char *next = nullptr;
+                for (size_t n = queue.peekReads(LOG_WRITE_BATCH_SIZE - drained, &next); n; n = queue.peekReads(LOG_WRITE_BATCH_SIZE - drained, &next)) {
+                    pending.append(next, n);
+                    queue.releaseReads(n);
+                    drained += n;
+                }
+
+                if (!drained) {
+                    return false;
+                }
+
+                const size_t processed = processPending();
+                writeSegments();
+                pending.erase(0, processed);
+                output.clear();
+                return true;
+            }
+
+        public:
+
+            // note that without a 'service_param', the records are written out by LogService::defaultService()
+            explicit Logger(const std::string &file_name, LogMode mode_param = LogMode::TEXT, LogService *service_param = nullptr) :
+                            filename(file_name), mode(mode_param), queue(LOG_QUEUE_SIZE),
+                            service(service_param ? service_param : &LogService::defaultService()) {
                 // The filename and queue have been initialized
-                // now we have to create a new file corresponding to this logger and start the logging thread
+                // now we have to create a new file corresponding to this logger and hand it to the log service
 
                 // open the file
-                file.open(filename);
-                ASSERT(file.is_open(), "Could not open log file " + filename); // remember that macros.h was included in "logtype.h"
+                fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+                ASSERT(fd >= 0, "Could not open log file " + filename); // remember that macros.h was included in "logtype.h"
+
+                // binary files start with what the decoder needs to turn rdtsc() values into time
+                if (mode == LogMode::BINARY) {
+                    LogFileHeader file_header;
+                    file_header.nanos_per_tick = tsc_clock.nanosPerTick();
+                    file_header.base_ticks = rdtsc();
+                    file_header.base_nanos = tsc_clock.toNanos(file_header.base_ticks);
+
+                    output.assign(reinterpret_cast<const char *>(&file_header), sizeof(file_header));
+                    segments.push_back({&output, 0, output.size()});
+                    writeSegments();
+                    output.clear();
+                }
 
-                // start the logger thread
-                // note that we need: a core to pin on (optional), a thread name, func to execute, and its corresponding args (optional)
-                logger_thread = createAndStartThread(-1, "logger_thread", [this]() { flushQueue(); } ); // flushQueue will write all logs to the open file
-                ASSERT(logger_thread != nullptr, "Logger thread did not start");
+                // from here on the service's thread writes out whatever we log
+                service->addLogger(this);
             }
 
             ~Logger() {
                 std::cerr << "Closing logger... " << std::endl;
 
-                // First, we have to make sure that everything that should be logged is written (some apps skip this for performance)
-                while (queue.size()) {
-                    using namespace std::chrono_literals;
-                    std::cout << queue.size() << std::endl;
-                    std::this_thread::sleep_for(1s);
-                }
-
-                // Next, we should stop the logger's runtime to allow flushQueue to exit
-                running = false;
+                // First, we take ourselves off the service, once this returns its thread won't touch our queue again
+                service->removeLogger(this);
 
-                // Now, let the thread exit
-                logger_thread->join();
+                // Next, we write out whatever is still in the queue ourselves (some apps skip this for performance)
+                while (drainQueue()) {}
 
                 // Lastly, we close the logging file
-                file.close();
+                ::close(fd);
+                fd = -1;
             }
 
 
@@ -98,123 +300,102 @@ namespace Common {
             Logger& operator=(const Logger &) = delete; // copy assignment constructor
             Logger& operator=(const Logger &&) = delete; // move assignment constructor
 
-            
-            // main way to push to logger queue
-            void pushToLoggerQueue(const LogElement &log_element) noexcept {
-                *(queue.getNextWriteTo()) = log_element;
-                queue.updateWriteIndex();
-            } 
-
-            // Overload pushValue for different data types
-
-            // 1.1 char
-            void pushValue(const char value) noexcept {
-                pushToLoggerQueue(LogElement{LogType::CHAR, {.c = value}});
+            LogMode getMode() const noexcept {
+                return mode;
             }
 
-            // 1.2 char array
-            void pushValue(const char *value) {
-                while (*value) {
-                    pushValue(*value);
-                    ++value;
+            /*
+                API for main thread to use logger
+            */
+
+           // logging a format string, every '%' gets replaced by the next variable (use '%%' for a plain '%')
+           // note that this also logs plain strings, with no variables at all
+           template<typename... Vars>
+           void log(const char *format_string, const Vars &... vars) noexcept {
+                const LogRecordHeader header{reinterpret_cast<uint64_t>(format_string), rdtsc(),
+                                             static_cast<uint32_t>((encodedLogSize(vars) + ... + 0)), LogRecordType::ENTRY};
+                const size_t record_size = sizeof(header) + header.args_size;
+                if (UNLIKELY(record_size > queue.capacity())) {
+                    FATAL("log record of " + std::to_string(record_size) + " bytes doesn't fit in the logger's queue");
                 }
-            }
 
-            // 1.3 string
-            void pushValue(const std::string &value) noexcept {
-                pushValue(value.c_str());
-            }
+                // most of the time the whole record fits before the end of the queue, so we can write it straight in
+                char *first = nullptr;
+                if (LIKELY(queue.reserveWrites(record_size, &first) == record_size)) {
+                    LinearLogWriter writer{first};
+                    writer.write(&header, sizeof(header));
+                    (encodeLogValue(writer, vars), ...);
+                    queue.commitWrites(record_size);
+                } else {
+                    QueueWriter writer{&queue};
+                    writer.write(&header, sizeof(header));
+                    (encodeLogValue(writer, vars), ...);
+                    queue.commitWrites();
+                }
+           }
 
-            // int
-            void pushValue(const int value) noexcept {
-                pushToLoggerQueue(LogElement{LogType::INTEGER, {.i = value}});
-            }
 
-            // long int
-            void pushValue(const long int value) noexcept {
-                pushToLoggerQueue(LogElement{LogType::LONG_INTEGER, {.l = value}});
-            }
+    };
 
-            // long long int
-            void pushValue(const long long int value) noexcept {
-                pushToLoggerQueue(LogElement{LogType::LONG_LONG_INTEGER, {.ll = value}});
-            }
 
-            // unsigned int
-            void pushValue(const unsigned int value) noexcept {
-                pushToLoggerQueue(LogElement{LogType::UNSIGNED_INTEGER, {.u = value}});
-            }
 
-            // unsigned long int
-            void pushValue(const unsigned long int value) noexcept {
-                pushToLoggerQueue(LogElement{LogType::UNSIGNED_LONG_INTEGER, {.ul = value}});
-            }
+    /* LogService functions that need the whole Logger */
 
-            // unsigned long long int
-            void pushValue(const unsigned long long int value) noexcept {
-                pushToLoggerQueue(LogElement{LogType::UNSIGNED_LONG_LONG_INTEGER, {.ull = value}});
+    inline bool LogService::drainLoggers() noexcept {
+        bool drained = false;
+        for (auto &slot : loggers) {
+            Logger *logger = slot.load();
+            if (!logger) {
+                continue;
             }
 
-            // float
-            void pushValue(const float value) noexcept {
-                pushToLoggerQueue(LogElement{LogType::FLOAT, {.f = value}});
+            // announce which logger we are about to use, then make sure it didn't go away in the meantime (see removeLogger())
+            draining.store(logger);
+            if (slot.load() == logger) {
+                drained |= logger->drainQueue();
             }
-
-            // double
-            void pushValue(const double value) noexcept {
-                pushToLoggerQueue(LogElement{LogType::DOUBLE, {.d = value}});
+            draining.store(nullptr);
+        }
+        return drained;
+    }
+
+    inline void LogService::run() noexcept {
+        while (running) {
+            if (drainLoggers()) {
+                idle_strategy.reset();
+            } else {
+                idle_strategy.idle();
             }
+        }
 
-            /*
-                API for main thread to use logger
-            */
+        // anything logged after we were told to stop
+        while (drainLoggers()) {}
+    }
 
-           // logging a format string
-           template<typename T, typename... Vars>
-           void log(const char *format_string, const T &value, Vars... remaining_vars) noexcept {
-                // while we have more to log
-                while (*format_string) {
-
-                    // is this an escape/variable?
-                    if (*format_string == '%') {
-
-                        // if we want to actually log a '%' character, then, we would escape it by doing '%%', 
-                        // so we skip this one, and log the next '%' after this 
-                        if(UNLIKELY(*(format_string + 1) == '%')) {
-                            ++format_string;
-                        } else {
-                            pushValue(value);
-                            log(format_string + 1, remaining_vars...); // <- recursively call log to 'consume' this value
-                            return;
-                        }
-                    }
+    inline LogService::~LogService() {
+        running = false;
+        service_thread->join();
+    }
 
-                    pushValue(*format_string++); // <- notice how this is unreachable if there was a variable
-                }
-
-                FATAL("printf log() did not include enough % keywords to print out all variables");
-           }
-
-           // logging a plain string
-           // notice that this function will also be called when all variables are logged in the previous log() function
-           void log(const char *message) noexcept {
-                while(*message) {
-                    if (*message == '%') {
-                        if (UNLIKELY(*(message + 1) == '%')) {
-                            ++message; // <- follows same logic as above for escaping '%'
-                        } else {
-                            std::cout << *(message - 16) << *(message - 15) << *(message - 14) << *(message - 13) << *(message - 12) << *(message - 11) << *(message - 10) << *(message - 9) << *(message - 8) << *(message - 7) << *(message - 6) << *(message - 5) << *(message - 4) << *(message - 3) << *(message - 2) << *(message - 1) << std::endl; 
-                            FATAL("Found a printf keyword in the plain string log(), but variables were not provided");
-                        }
-                    }
-
-                    pushValue(*message++);
-                }
-           }
+}
 
 
-    };
 
+/*
+    Leveled logging, e.g. LOG_DEBUG(logger, "%:% %() % Sending % \n", __FILE__, __LINE__, __FUNCTION__, ...)
 
+    Calls below the build's LOG_MIN_LEVEL sit in a discarded 'if constexpr' branch, so they compile to nothing,
+    not even the arguments get evaluated (no getCurrentTimeStr(), no toString()). Note that they still have to compile,
+    so a log line can't rot in a build that strips it.
+*/
+#define LOG_AT_LEVEL(LEVEL, LOGGER, ...) \
+    do { \
+        if constexpr (Common::logLevelEnabled(LEVEL)) { \
+            (LOGGER).log(__VA_ARGS__); \
+        } \
+    } while (false)
 
-}
+#define LOG_TRACE(LOGGER, ...) LOG_AT_LEVEL(Common::LogLevel::TRACE, LOGGER, __VA_ARGS__)
+#define LOG_DEBUG(LOGGER, ...) LOG_AT_LEVEL(Common::LogLevel::DEBUG, LOGGER, __VA_ARGS__)
+#define LOG_INFO(LOGGER, ...) LOG_AT_LEVEL(Common::LogLevel::INFO, LOGGER, __VA_ARGS__)
+#define LOG_WARN(LOGGER, ...) LOG_AT_LEVEL(Common::LogLevel::WARN, LOGGER, __VA_ARGS__)
@@ -1,7 +1,14 @@
 #pragma once // This is better in case #ifndef LOG_TYPE conflicts with the name of the enum
 
 // include other header files so when we include this header file, these also get included
+#include <array>
 #include <cstdlib> // for size_t
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
 #include "macros.h"
 #include "lock_free_queue.h"
 #include "thread_utils.h"
@@ -9,27 +16,336 @@
 
 namespace Common {
     /*
-        This will represent the log entry that will hold information that the main thread will send to the I/O logging thread through LFQ
+        This file holds what the main thread sends to the I/O logging thread through the LFQ, and how it gets turned into text
+
+        Every log() call becomes one 'record' in the logger's queue of bytes:
+            [LogRecordHeader][tag][value][tag][value]...
+        - the header holds the address of the format string (which doubles as its id), the rdtsc() timestamp, and how many bytes of arguments follow
+        - each argument is its LogType tag followed by its raw bytes, strings are a 4 byte length followed by the characters (no null)
+          and protocol structs (see LogStruct below) are their LogStructId followed by the struct's packed bytes
+
+        Nothing gets formatted on the main thread, the logger thread (or the offline decoder for binary logs) does it with formatLogRecord()
     */
 
-    constexpr size_t LOG_QUEUE_SIZE = 8 * 1024 * 1024;
+    // note that one thread writes out every logger's queue (see LogService), so a busy logger waits on the others between batches
+    constexpr size_t LOG_QUEUE_SIZE = 1024 * 1024; // bytes of records a logger's queue can hold, log() waits if it fills up
+    constexpr size_t LOG_WRITE_BATCH_SIZE = 256 * 1024; // most bytes of records the log service takes out of one logger's queue for one write to its file
+    constexpr size_t LOG_MAX_LOGGERS = 64; // most loggers one LogService can write out at the same time
 
     enum class LogType : int8_t  {
         CHAR = 0,
         INTEGER = 1, LONG_INTEGER = 2, LONG_LONG_INTEGER = 3,
         UNSIGNED_INTEGER = 4, UNSIGNED_LONG_INTEGER = 5, UNSIGNED_LONG_LONG_INTEGER = 6,
-        FLOAT = 7, DOUBLE = 8
+        FLOAT = 7, DOUBLE = 8,
+        STRING = 9,
+        STRUCT = 10
 
     };
 
-    struct LogElement {
-        LogType type = LogType::CHAR; // default value of a CHAR
-        union {
-            char c; 
-            int i; long l; long long ll; 
-            unsigned u; unsigned long ul; unsigned long long ull; 
-            float f; double d;
-        } u; // can hold many different data types; in a union, only one can be active at any given time
+    // TEXT: the logger thread formats every record and writes text, same as it always has
+    // BINARY: the logger thread writes the records as they are, which is cheaper, and tools/log_decoder turns them into text later
+    enum class LogMode : int8_t {
+        TEXT = 0,
+        BINARY = 1
     };
     
-}
\ No newline at end of file
+    /*
+        How much a log line matters, see the LOG_TRACE()...LOG_WARN() macros in logger.h
+        - TRACE: every packet/message/book update on a hot path
+        - DEBUG: every order, fill and sequence check
+        - INFO: startup, shutdown and anything that happens once in a while
+        - WARN: something went wrong
+    */
+    enum class LogLevel : int8_t {
+        TRACE = 0,
+        DEBUG = 1,
+        INFO = 2,
+        WARN = 3
+    };
+
+// set by the build (see the root CMakeLists.txt), log calls below this level compile to nothing
+#if !defined(LOG_MIN_LEVEL)
+#define LOG_MIN_LEVEL 0
+#endif
+
+    constexpr LogLevel MIN_LOG_LEVEL = static_cast<LogLevel>(LOG_MIN_LEVEL);
+
+    constexpr bool logLevelEnabled(LogLevel level) noexcept {
+        return level >= MIN_LOG_LEVEL;
+    }
+    
+    enum class LogRecordType : uint8_t {
+        ENTRY = 0, // a log() call, the header is followed by its arguments
+        FORMAT_STRING = 1 // only in binary files, the text of the format string with id 'format', written before the first ENTRY that uses it
+    };
+
+    struct LogRecordHeader {
+        uint64_t format = 0; // address of the format string in the process that logged it
+        uint64_t rdtsc = 0; // when log() was called, in timestamp counter ticks
+        uint32_t args_size = 0; // how many bytes follow this header
+        LogRecordType type = LogRecordType::ENTRY;
+    };
+
+    // the first thing in a binary log file, it has what the decoder needs to turn rdtsc values back into time
+    struct LogFileHeader {
+        char magic[8] = {'E', 'X', 'B', 'L', 'O', 'G', '0', '1'};
+        double nanos_per_tick = 1.0;
+        uint64_t base_ticks = 0; // rdtsc() value at...
+        int64_t base_nanos = 0; // ...this many nanoseconds since the epoch
+
+        bool isValid() const noexcept {
+            return std::memcmp(magic, LogFileHeader().magic, sizeof(magic)) == 0;
+        }
+
+        int64_t toNanos(uint64_t ticks) const noexcept {
+            return base_nanos + static_cast<int64_t>(static_cast<double>(static_cast<int64_t>(ticks - base_ticks)) * nanos_per_tick);
+        }
+    };
+
+
+
+    /*
+        Protocol structs the logger takes as they are
+
+        Calling toString() on a hot path builds a std::stringstream and allocates, so instead log() copies the struct's bytes
+        into the record and the logger thread (or the decoder) calls toString() on its copy. A struct opts in next to where it is
+        defined with a LogStruct specialization and a registerLogStruct() call, e.g. in client_request.h:
+            template<> struct LogStruct<Exchange::MEClientRequest> : LogStructOf<LogStructId::ME_CLIENT_REQUEST> {};
+            inline const bool client_request_log_structs = registerLogStruct<Exchange::MEClientRequest>();
+
+        NOTE: the ids are written into binary files, so only ever add new ones at the end
+    */
+    enum class LogStructId : uint8_t {
+        ME_CLIENT_REQUEST = 0, OM_CLIENT_REQUEST = 1,
+        ME_CLIENT_RESPONSE = 2, OM_CLIENT_RESPONSE = 3,
+        ME_MARKET_UPDATE = 4, MDP_MARKET_UPDATE = 5,
+        OM_ORDER = 6, BBO = 7,
+        MDP_PACKET_HEADER = 8,
+        MAX = 9
+    };
+
+    template<typename T>
+    struct LogStruct {
+        static constexpr bool enabled = false;
+    };
+
+    template<LogStructId ID>
+    struct LogStructOf {
+        static constexpr bool enabled = true;
+        static constexpr LogStructId id = ID;
+    };
+
+    // what the logger thread needs to turn a struct's bytes back into text
+    struct LogStructFormatter {
+        uint32_t size = 0;
+        void (*format)(const char *bytes, std::string *out) = nullptr;
+    };
+
+    // filled in before main() runs by the registerLogStruct() calls in the headers that define the structs
+    inline std::array<LogStructFormatter, static_cast<size_t>(LogStructId::MAX)> log_struct_formatters = {};
+
+    // reads a value of type V that might not be aligned
+    template<typename V>
+    V readLogValue(const char *bytes) noexcept {
+        V value;
+        std::memcpy(&value, bytes, sizeof(V));
+        return value;
+    }
+
+    template<typename T>
+    bool registerLogStruct() noexcept {
+        static_assert(LogStruct<T>::enabled, "specialize LogStruct<T> before registering T");
+        static_assert(std::is_trivially_copyable_v<T>, "the logger copies structs byte by byte");
+        log_struct_formatters[static_cast<size_t>(LogStruct<T>::id)] = {
+            static_cast<uint32_t>(sizeof(T)),
+            [](const char *bytes, std::string *out) { out->append(readLogValue<T>(bytes).toString()); }
+        };
+        return true;
+    }
+
+
+
+    /* Encoding arguments (main thread) */
+
+    /*
+        Every type we can log maps to one of the LogTypes, the overloads here decide which one (just like the old pushValue() overloads did)
+        so e.g. a bool or a short becomes an int, and a std::string or a string literal becomes a STRING
+    */
+    inline char toLogValue(const char value) noexcept { return value; }
+    inline int toLogValue(const int value) noexcept { return value; }
+    inline long toLogValue(const long value) noexcept { return value; }
+    inline long long toLogValue(const long long value) noexcept { return value; }
+    inline unsigned toLogValue(const unsigned value) noexcept { return value; }
+    inline unsigned long toLogValue(const unsigned long value) noexcept { return value; }
+    inline unsigned long long toLogValue(const unsigned long long value) noexcept { return value; }
+    inline float toLogValue(const float value) noexcept { return value; }
+    inline double toLogValue(const double value) noexcept { return value; }
+    inline std::string_view toLogValue(const char *value) noexcept { return std::string_view(value); }
+    inline std::string_view toLogValue(const std::string &value) noexcept { return std::string_view(value); }
+
+    template<typename V>
+    constexpr LogType logTypeOf() noexcept {
+        if constexpr (std::is_same_v<V, char>) return LogType::CHAR;
+        else if constexpr (std::is_same_v<V, int>) return LogType::INTEGER;
+        else if constexpr (std::is_same_v<V, long>) return LogType::LONG_INTEGER;
+        else if constexpr (std::is_same_v<V, long long>) return LogType::LONG_LONG_INTEGER;
+        else if constexpr (std::is_same_v<V, unsigned>) return LogType::UNSIGNED_INTEGER;
+        else if constexpr (std::is_same_v<V, unsigned long>) return LogType::UNSIGNED_LONG_INTEGER;
+        else if constexpr (std::is_same_v<V, unsigned long long>) return LogType::UNSIGNED_LONG_LONG_INTEGER;
+        else if constexpr (std::is_same_v<V, float>) return LogType::FLOAT;
+        else if constexpr (std::is_same_v<V, double>) return LogType::DOUBLE;
+        else return LogType::STRING;
+    }
+
+    // how many bytes 'value' takes up in a record, including its tag
+    template<typename T>
+    size_t encodedLogSize(const T &value) noexcept {
+        if constexpr (LogStruct<T>::enabled) {
+            return sizeof(LogType) + sizeof(LogStructId) + sizeof(T);
+        } else {
+            const auto log_value = toLogValue(value);
+            if constexpr (std::is_same_v<decltype(log_value), const std::string_view>) {
+                return sizeof(LogType) + sizeof(uint32_t) + log_value.size();
+            } else {
+                return sizeof(LogType) + sizeof(log_value);
+            }
+        }
+    }
+
+    // writes 'value' with its tag through 'writer', anything with a write(const void *, size_t) works
+    template<typename Writer, typename T>
+    void encodeLogValue(Writer &writer, const T &value) noexcept {
+        if constexpr (LogStruct<T>::enabled) {
+            // no toString() here, just the bytes, the logger thread formats them
+            const LogType type = LogType::STRUCT;
+            const LogStructId id = LogStruct<T>::id;
+            writer.write(&type, sizeof(type));
+            writer.write(&id, sizeof(id));
+            writer.write(&value, sizeof(T));
+        } else {
+            const auto log_value = toLogValue(value);
+            const LogType type = logTypeOf<std::remove_const_t<decltype(log_value)>>();
+            writer.write(&type, sizeof(type));
+
+            if constexpr (std::is_same_v<decltype(log_value), const std::string_view>) {
+                const uint32_t length = static_cast<uint32_t>(log_value.size());
+                writer.write(&length, sizeof(length));
+                writer.write(log_value.data(), length);
+            } else {
+                writer.write(&log_value, sizeof(log_value));
+            }
+        }
+    }
+
+    // writes into plain memory that we know is big enough
+    struct LinearLogWriter {
+        char *next = nullptr;
+
+        void write(const void *data, size_t n) noexcept {
+            std::memcpy(next, data, n);
+            next += n;
+        }
+    };
+
+
+
+    /* Formatting records (logger thread / decoder) */
+
+    // appends the next argument in 'args' to 'out' and moves 'args' past it, returns false if it was cut off
+    inline bool formatLogValue(const char *&args, const char *args_end, std::string *out) {
+        if (args + sizeof(LogType) > args_end) {
+            return false;
+        }
+        const LogType type = readLogValue<LogType>(args);
+        args += sizeof(LogType);
+
+        // same output as the old 'file << value', i.e. floats and doubles with 6 significant digits
+        char number[64];
+        int length = 0;
+        size_t size = 0;
+        switch (type) {
+            case LogType::CHAR:
+                size = sizeof(char); if (args + size <= args_end) { out->push_back(*args); } break;
+            case LogType::INTEGER:
+                size = sizeof(int); if (args + size <= args_end) { length = snprintf(number, sizeof(number), "%d", readLogValue<int>(args)); } break;
+            case LogType::LONG_INTEGER:
+                size = sizeof(long); if (args + size <= args_end) { length = snprintf(number, sizeof(number), "%ld", readLogValue<long>(args)); } break;
+            case LogType::LONG_LONG_INTEGER:
+                size = sizeof(long long); if (args + size <= args_end) { length = snprintf(number, sizeof(number), "%lld", readLogValue<long long>(args)); } break;
+            case LogType::UNSIGNED_INTEGER:
+                size = sizeof(unsigned); if (args + size <= args_end) { length = snprintf(number, sizeof(number), "%u", readLogValue<unsigned>(args)); } break;
+            case LogType::UNSIGNED_LONG_INTEGER:
+                size = sizeof(unsigned long); if (args + size <= args_end) { length = snprintf(number, sizeof(number), "%lu", readLogValue<unsigned long>(args)); } break;
+            case LogType::UNSIGNED_LONG_LONG_INTEGER:
+                size = sizeof(unsigned long long); if (args + size <= args_end) { length = snprintf(number, sizeof(number), "%llu", readLogValue<unsigned long long>(args)); } break;
+            case LogType::FLOAT:
+                size = sizeof(float); if (args + size <= args_end) { length = snprintf(number, sizeof(number), "%g", readLogValue<float>(args)); } break;
+            case LogType::DOUBLE:
+                size = sizeof(double); if (args + size <= args_end) { length = snprintf(number, sizeof(number), "%g", readLogValue<double>(args)); } break;
+            case LogType::STRING: {
+                if (args + sizeof(uint32_t) > args_end) {
+                    return false;
+                }
+                const uint32_t string_length = readLogValue<uint32_t>(args);
+                args += sizeof(uint32_t);
+                size = string_length;
+                if (args + size <= args_end) {
+                    out->append(args, string_length);
+                }
+            }
+                break;
+            case LogType::STRUCT: {
+                if (args + sizeof(LogStructId) > args_end) {
+                    return false;
+                }
+                const size_t id = static_cast<size_t>(readLogValue<LogStructId>(args));
+                args += sizeof(LogStructId);
+                if (id >= log_struct_formatters.size() || !log_struct_formatters[id].format) {
+                    return false; // a struct this program doesn't know about
+                }
+                size = log_struct_formatters[id].size;
+                if (args + size <= args_end) {
+                    log_struct_formatters[id].format(args, out);
+                }
+            }
+                break;
+            default:
+                return false;
+        }
+
+        if (args + size > args_end) {
+            return false;
+        }
+        out->append(number, static_cast<size_t>(std::max(length, 0)));
+        args += size;
+        return true;
+    }
+
+    /*
+        turns a record back into the text the old logger would have written, appending it to 'out'
+        every '%' in 'format' is replaced by the next argument, and '%%' is a plain '%'
+        returns false if the number of '%'s and arguments don't match (the text up to that point is still appended)
+    */
+    inline bool formatLogRecord(const char *format, const char *args, size_t args_size, std::string *out) {
+        const char *args_end = args + args_size;
+
+        while (*format) {
+            if (*format == '%') {
+                if (UNLIKELY(*(format + 1) == '%')) {
+                    ++format; // escaped, print the second '%' like any other character
+                } else {
+                    if (UNLIKELY(args == args_end || !formatLogValue(args, args_end, out))) {
+                        return false; // more '%'s than arguments
+                    }
+                    ++format;
+                    continue;
+                }
+            }
+
+            out->push_back(*format++);
+        }
+
+        return args == args_end; // if not, there were more arguments than '%'s
+    }
+
+}
@@ -12,14 +12,53 @@ using std::endl;
 #define UNLIKELY(x) __builtin_expect(!!(x), 0)
 
 
-inline auto ASSERT(bool cond, const string &message) noexcept {
-    if (UNLIKELY(!cond)) {
-        cerr << "ASSERT: " << message << endl;
-        exit(EXIT_FAILURE);
-    }
+// set by the build (see the root CMakeLists.txt), 0 keeps every ASSERT's check but drops its message
+#if !defined(ASSERT_MESSAGES)
+#define ASSERT_MESSAGES 1
+#endif
+
+/*
+    ASSERT(cond, message) exits the program if 'cond' is false
+
+    It used to be a function, which meant the message (e.g. "..." + std::to_string(id) + x.toString()) was built,
+    and heap allocated, on every call even though the check almost never fails. As a macro the message is only
+    built once 'cond' has failed, and the failure path lives out of line (cold), so a passing check is just a compare
+    and a branch that is never taken.
+
+    NOTE: 'cond' is always evaluated, in every build, since some callers do real work in it (e.g. starting a thread)
+*/
+[[noreturn]] [[gnu::cold]] [[gnu::noinline]] inline void assertFailed(const char *condition, const char *file, int line, const string &message) noexcept {
+    cerr << "ASSERT: " << message << " (" << condition << " at " << file << ":" << line << ")" << endl;
+    exit(EXIT_FAILURE);
 }
 
-inline auto FATAL(const string &message) noexcept {
+[[noreturn]] [[gnu::cold]] [[gnu::noinline]] inline void assertFailed(const char *condition, const char *file, int line) noexcept {
+    cerr << "ASSERT: " << condition << " at " << file << ":" << line << endl;
+    exit(EXIT_FAILURE);
+}
+
+#if ASSERT_MESSAGES
+#define ASSERT(cond, message) \
+    do { \
+        if (!(cond)) [[unlikely]] { \
+            assertFailed(#cond, __FILE__, __LINE__, (message)); \
+        } \
+    } while (false)
+#else
+// the message still has to compile, it just never gets built
+#define ASSERT(cond, message) \
+    do { \
+        if (!(cond)) [[unlikely]] { \
+            if constexpr (false) { \
+                static_cast<void>(message); \
+            } \
+            assertFailed(#cond, __FILE__, __LINE__); \
+        } \
+    } while (false)
+#endif
+
+// note that callers check their condition themselves, e.g. if (UNLIKELY(...)) FATAL(...), so 'message' is only built on the way out
+[[noreturn]] [[gnu::cold]] inline void FATAL(const string &message) noexcept {
     cerr << "FATAL: " << message << endl;
 
     exit(EXIT_FAILURE);
@@ -4,49 +4,59 @@
 #include <vector>
 #include <string>
 #include <cstdint>
+#include <limits>
 
 #include "macros.h"
+#include "huge_page_arena.h"
 
 namespace Common {
 
     /* 
         we want to create a mempool such that we are not dynamically allocating memory during the program
         dynamically allocated memory has poor performance in low-latency C++ because of fragmentation, overhead, and multithreading locks
+
+        How it works:
+        1. 'storage' is just the T objects back to back, nothing else sits between them, so they are densely packed and aligned
+        2. the indices of the free blocks are kept on a separate stack, allocate() pops one and deallocate() pushes one,
+           both are O(1) no matter how fragmented the pool gets (we used to scan 'storage' for the next free block)
+        3. since the stack is last in first out, the block we hand out next is the one freed most recently, which is likely still in cache
+
+        NOTE: the free-list lives outside of the blocks on purpose, so a freed object is left untouched
+        (MarketOrderBook reads 'next_entry' of a price level right after it deallocates it when clearing)
+
+        Pass in an 'arena' to put the blocks (and the free stack) in it, e.g. on huge pages, instead of on the regular heap
+
+        Define MEMPOOL_DEBUG to also track which blocks are in use, which catches double frees (and frees of blocks that were
+        never allocated) right away, instead of the same block being handed out twice later on
     */
     template<typename T>
     class MemPool final {
         private: 
-            struct ObjectBlock {
-                T memory_block; // note that the order the members are in matters!
-                bool is_free;
-            };
-
-            std::vector<ObjectBlock> storage; 
-            size_t next_available_space = 0;
-
-            // updates the next index that an allocated object should be placed in the MemPool
-            void updateNextAvailableSpace() noexcept {
-                const size_t current_next_avail_space = next_available_space;
-
-                while (!storage[next_available_space].is_free) {
-                    ++next_available_space;
-
-                    // if we reached the end of the storage, loop back around to the front
-                    if (UNLIKELY(next_available_space == storage.size())) {
-                        next_available_space = 0;
-                    }
-
-                    // if we ever reach the same index as we had before, now we know storage is full
-                    if (UNLIKELY(next_available_space == current_next_avail_space)) {
-                        ASSERT(next_available_space != current_next_avail_space, "storage is full!");
-                        break;
-                    }
-                }
-            }
+            std::vector<T, ArenaAllocator<T>> storage; 
+
+            // stack of free block indices, the next one to hand out is at free_indices[num_free - 1]
+            std::vector<uint32_t, ArenaAllocator<uint32_t>> free_indices;
+            size_t num_free = 0;
+
+#if defined(MEMPOOL_DEBUG)
+            std::vector<bool> is_free; // only needed to catch double frees
+#endif
 
         public:
             // note that explicit keyword stops implicit conversions of the class MemPool (using a size_t where MemPool obj is expected) 
-            explicit MemPool(std::size_t num_elements): storage(num_elements, {T(), true}) {}
+            explicit MemPool(std::size_t num_elements, HugePageArena *arena = nullptr): storage(num_elements, T(), ArenaAllocator<T>(arena)),
+                                                        free_indices(num_elements, 0, ArenaAllocator<uint32_t>(arena)), num_free(num_elements)
+#if defined(MEMPOOL_DEBUG)
+                                                        , is_free(num_elements, true)
+#endif
+            {
+                ASSERT(num_elements <= std::numeric_limits<uint32_t>::max(), "MemPool can hold at most 2^32 - 1 blocks!");
+
+                // the top of the stack starts at block 0, so a fresh pool hands out blocks front to back
+                for (size_t i = 0; i < num_elements; ++i) {
+                    free_indices[i] = static_cast<uint32_t>(num_elements - 1 - i);
+                }
+            }
 
             // these need to be deleted so we can control how the MemPool class is used by the programmer and by the compiler
             MemPool() = delete; // default constructor
@@ -59,9 +69,18 @@ namespace Common {
             template<typename... T_Params>
             T* allocate(T_Params... args) noexcept {
                 // retrieve the free memory slot
-                // note that the ASSERT does not throw an exception, only prints to std::cerr, so the 'noexcept' keyword holds
-                auto next_free_obj_block = &(storage[next_available_space]);
-                ASSERT(next_free_obj_block->is_free, "mem pool block fetched during allocate() must be available!");
+                // note that FATAL does not throw an exception, only prints to std::cerr and exits, so the 'noexcept' keyword holds
+                if (UNLIKELY(num_free == 0)) {
+                    FATAL("storage is full!");
+                }
+                const uint32_t index = free_indices[--num_free];
+
+#if defined(MEMPOOL_DEBUG)
+                if (UNLIKELY(!is_free[index])) {
+                    FATAL("mem pool block fetched during allocate() must be available! index: " + std::to_string(index));
+                }
+                is_free[index] = false;
+#endif
 
                 /*
                     Three important points here:
@@ -71,29 +90,40 @@ namespace Common {
                     3. args are directly used here, so they don't need to be forwarded, 
                         if they were passed into another function then they would have to be
                 */
-                T* obj_memory_addr = &(next_free_obj_block->memory_block);
+                T* obj_memory_addr = &(storage[index]);
                 obj_memory_addr = new(obj_memory_addr) T(args...);
-                next_free_obj_block->is_free = false;
-
-                updateNextAvailableSpace();
 
                 return obj_memory_addr;
             }
 
             // way for user to remove from the MemPool
-            void deallocate(T* obj_to_delete) noexcept {
-                /*
-                    Explaining a few design choices here:
+            void deallocate(const T* obj_to_delete) noexcept {
+                // note that in C++, pointer subtraction yields the number of elements that exist in between the pointers
+                const auto index = obj_to_delete - storage.data();
+                if (UNLIKELY(index < 0 || static_cast<size_t>(index) >= storage.size())) {
+                    FATAL("object memory location was not within this MemPool!");
+                }
+                if (UNLIKELY(num_free == storage.size())) {
+                    FATAL("deallocate() called more times than allocate()!");
+                }
                     
-                    1. we made sure that the first element of our struct was the T object, so we can use this to 'lookup' the index
-                    2. note that in C++, pointer subtraction yields the number of elements that exist in between the pointers
-                */
-                auto delete_obj_mem_block_pointer = reinterpret_cast<const ObjectBlock*>(obj_to_delete);
-                int index_of_del_obj_block = delete_obj_mem_block_pointer - &storage[0];
-                ASSERT(index_of_del_obj_block >= 0 && static_cast<size_t>(index_of_del_obj_block) < storage.size(),
-                        "object memory location was not within this MemPool!");
+#if defined(MEMPOOL_DEBUG)
+                if (UNLIKELY(is_free[index])) {
+                    FATAL("double free of mem pool block! index: " + std::to_string(index));
+                }
+                is_free[index] = true;
+#endif
+
+                free_indices[num_free++] = static_cast<uint32_t>(index);
+            }
+
+            // returns how many more objects can be allocated before the pool is full
+            size_t available() const noexcept {
+                return num_free;
+            }
 
-                storage[index_of_del_obj_block].is_free = true;
+            size_t capacity() const noexcept {
+                return storage.size();
             }
 
     };
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "macros.h"
+
+namespace Common {
+
+    /*
+        A byte ring buffer whose memory is mapped twice, back to back
+
+        The same physical pages show up at [base, base + capacity) and again at [base + capacity, base + 2 * capacity),
+        so whatever is in the ring can always be read (or written) as one contiguous span starting at readPtr() (or writePtr()),
+        even when it wraps around the end. A parser never has to stitch a message back together that straddles the wrap point,
+        and we never have to memcpy the leftover partial message back to the front after a read to make room.
+
+        - the writer (e.g. recv()) gets writePtr() with writable() bytes of room, then calls commitWrite(n)
+        - the reader gets readPtr() with readable() bytes of data, then calls consume(n) for what it parsed
+
+        note that it is not thread safe, like the socket buffers it replaces it belongs to the one thread that drives the socket
+        also note that 'capacity' is rounded up to a power of two number of pages, since the mapping has to be page aligned
+    */
+    class MirroredRingBuffer final {
+        private:
+            char *base = nullptr;
+            size_t capacity = 0;
+            size_t read_index = 0; // both only ever go up, the position in the buffer is the index & (capacity - 1)
+            size_t write_index = 0;
+
+            // the pages backing the buffer, a file with no name that only lives as long as its mappings
+            static int createBackingFile(size_t size, std::string *error) noexcept {
+#if defined(__linux__)
+                const int fd = ::memfd_create("mirrored_ring_buffer", MFD_CLOEXEC);
+#else
+                // no memfd on macOS, so we make a named shared memory object and remove the name right away
+                static std::atomic<uint64_t> next_id = 0;
+                const std::string name = "/mirrored_ring." + std::to_string(::getpid()) + "." + std::to_string(next_id.fetch_add(1));
+                const int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+                if (fd >= 0) {
+                    ::shm_unlink(name.c_str());
+                }
+#endif
+                if (fd < 0 || ::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+                    *error = std::string("could not create the backing file: ") + std::strerror(errno);
+                    if (fd >= 0) {
+                        ::close(fd);
+                    }
+                    return -1;
+                }
+                return fd;
+            }
+
+        public:
+            explicit MirroredRingBuffer(size_t min_capacity) {
+                const size_t page_size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+                capacity = std::bit_ceil(std::max(min_capacity, page_size));
+
+                std::string error;
+                const int fd = createBackingFile(capacity, &error);
+                ASSERT(fd >= 0, "MirroredRingBuffer: " + error);
+
+                // reserve room for both copies first, so nothing else can end up between them, then map the file over each half
+                void *reserved = ::mmap(nullptr, 2 * capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                ASSERT(reserved != MAP_FAILED, "MirroredRingBuffer: could not reserve " + std::to_string(2 * capacity) + " bytes: " + std::strerror(errno));
+                base = static_cast<char *>(reserved);
+
+                const bool mapped = ::mmap(base, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED &&
+                                    ::mmap(base + capacity, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED;
+                ::close(fd); // the mappings keep the pages alive
+                ASSERT(mapped, "MirroredRingBuffer: could not map the buffer twice: " + std::string(std::strerror(errno)));
+            }
+
+            ~MirroredRingBuffer() {
+                ::munmap(base, 2 * capacity);
+                base = nullptr;
+            }
+
+            MirroredRingBuffer() = delete;
+            MirroredRingBuffer(const MirroredRingBuffer &) = delete;
+            MirroredRingBuffer(const MirroredRingBuffer &&) = delete;
+            MirroredRingBuffer &operator=(const MirroredRingBuffer &) = delete;
+            MirroredRingBuffer &operator=(const MirroredRingBuffer &&) = delete;
+
+            // where the next byte goes, writable() bytes from here on are free and contiguous
+            char *writePtr() noexcept {
+                return base + (write_index & (capacity - 1));
+            }
+
+            size_t writable() const noexcept {
+                return capacity - readable();
+            }
+
+            // 'n' bytes were written at writePtr()
+            void commitWrite(size_t n) noexcept {
+                write_index += n;
+            }
+
+            // the oldest unread byte, readable() bytes from here on are valid and contiguous
+            const char *readPtr() const noexcept {
+                return base + (read_index & (capacity - 1));
+            }
+
+            size_t readable() const noexcept {
+                return write_index - read_index;
+            }
+
+            // the first 'n' bytes at readPtr() have been parsed
+            void consume(size_t n) noexcept {
+                read_index += n;
+            }
+
+            // drops everything that's unread
+            void clear() noexcept {
+                read_index = write_index;
+            }
+
+            size_t size() const noexcept {
+                return capacity;
+            }
+    };
+
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <bit>
+#include <vector>
+
+#include "lock_free_queue.h"
+#include "macros.h"
+
+namespace Common {
+
+    /*
+        Multi Producer Single Consumer (MPSC) version of LFQUEUE
+
+        LFQUEUE only allows one thread to write to it, so if, say, we wanted several order server threads feeding
+        the matching engine, we would need a lock or an extra 'relay' thread that merges their queues. This queue lets
+        any number of threads write to it while still only one thread reads from it, and it still never locks or allocates
+
+        How it works:
+        1. every slot in the ring has a 'sequence' stamp next to the element, it tells whose turn it is on that slot
+           - sequence == position: the slot is free for the producer that claims 'position'
+           - sequence == position + 1: the producer is done writing, the consumer can read it
+           - the consumer sets it to 'position + capacity' once it's done, which frees the slot for the next lap around the ring
+        2. producers claim a position with a compare-and-swap on the shared write position, so no two producers get the same slot
+           once claimed, a producer can take its time filling the slot, nobody else will touch it
+        3. the consumer reads slots strictly in order, and only ever waits on the stamp of the slot it is at
+
+        NOTE: since the consumer goes in order, a producer that claims a slot and then stalls before publishing it
+        holds up everything written after it, so producers should always fill and publish right away
+    */
+    template<typename T>
+    class MPSCQueue final {
+        private:
+            struct Slot {
+                std::atomic<size_t> sequence = 0;
+                T element = T();
+            };
+
+            // read-only after construction, shared by all threads
+            std::vector<Slot> slots;
+            size_t mask = 0;
+
+            // the only thing producers share, every claim is a compare-and-swap on it
+            alignas(CacheLineSize) std::atomic<size_t> next_write_index = 0;
+
+            // only written by the consumer, atomic just so size() can be called from any thread
+            alignas(CacheLineSize) std::atomic<size_t> next_read_index = 0;
+
+        public:
+            /* Constructors */
+
+            // note that the capacity gets rounded up to the next power of two
+            explicit MPSCQueue(size_t num_elements): slots(std::bit_ceil(num_elements)), mask(std::bit_ceil(num_elements) - 1) {
+                for (size_t i = 0; i < slots.size(); ++i) {
+                    slots[i].sequence.store(i, std::memory_order_relaxed);
+                }
+            }
+
+            MPSCQueue() = delete;
+            MPSCQueue(const MPSCQueue &) = delete;
+            MPSCQueue &operator=(const MPSCQueue &) = delete;
+            MPSCQueue(const MPSCQueue &&) = delete;
+            MPSCQueue &operator=(const MPSCQueue &&) = delete;
+
+
+
+            /* Producer functions, safe to call from any number of threads */
+
+            // claims the next slot and returns a pointer to it, 'write_ticket' identifies the claim for updateWriteIndex()
+            // if the queue is full, this waits for the consumer to free up a slot instead of overwriting unread data
+            T* getNextWriteTo(size_t *write_ticket) noexcept {
+                size_t write_index = next_write_index.load(std::memory_order_relaxed);
+                while (true) {
+                    Slot &slot = slots[write_index & mask];
+                    const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+                    const auto lap_difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(write_index);
+
+                    if (lap_difference == 0) {
+                        // the slot is free, try to claim it, if another producer beat us to it the CAS reloads write_index for us
+                        if (next_write_index.compare_exchange_weak(write_index, write_index + 1, std::memory_order_relaxed)) {
+                            *write_ticket = write_index;
+                            return &slot.element;
+                        }
+                    } else {
+                        // either the consumer hasn't freed this slot from the previous lap yet (lap_difference < 0, the queue is full)
+                        // or another producer already claimed this position (lap_difference > 0), either way look at the latest position
+                        write_index = next_write_index.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            // marks the claimed slot as written, which publishes it to the consumer
+            void updateWriteIndex(size_t write_ticket) noexcept {
+                slots[write_ticket & mask].sequence.store(write_ticket + 1, std::memory_order_release);
+            }
+
+            // claims, writes, and publishes in one go
+            void push(const T &element) noexcept {
+                size_t write_ticket;
+                *getNextWriteTo(&write_ticket) = element;
+                updateWriteIndex(write_ticket);
+            }
+
+
+
+            /* Consumer functions, only one thread may call these */
+
+            // returns a pointer to the next object that can be read
+            // if the queue is empty (or the producer that claimed the next slot hasn't published it yet), returns null
+            const T* getNextRead() const noexcept {
+                const size_t read_index = next_read_index.load(std::memory_order_relaxed);
+                const Slot &slot = slots[read_index & mask];
+                return (slot.sequence.load(std::memory_order_acquire) == read_index + 1 ? &slot.element : nullptr);
+            }
+
+            // marks the element at 'next_read_index' as read and hands the slot back to the producers for the next lap
+            void updateReadIndex() noexcept {
+                const size_t read_index = next_read_index.load(std::memory_order_relaxed);
+                Slot &slot = slots[read_index & mask];
+
+                if (UNLIKELY(slot.sequence.load(std::memory_order_relaxed) != read_index + 1)) {
+                    FATAL("Tried to read from an empty queue!");
+                }
+
+                slot.sequence.store(read_index + mask + 1, std::memory_order_release);
+                next_read_index.store(read_index + 1, std::memory_order_relaxed);
+            }
+
+            // returns the size of the queue, including slots that are claimed but not yet published
+            size_t size() const noexcept {
+                const size_t read_index = next_read_index.load(std::memory_order_relaxed);
+                const size_t write_index = next_write_index.load(std::memory_order_relaxed);
+                return (write_index > read_index ? write_index - read_index : 0);
+            }
+
+            // returns how many elements the queue can hold
+            size_t capacity() const noexcept {
+                return mask + 1;
+            }
+    };
+
+}
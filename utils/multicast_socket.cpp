@@ -17,28 +17,107 @@ namespace Common {
     }
 
     bool MulticastSocket::sendAndRecv() noexcept {
-        const ssize_t n_rcv = recv(socket_file_descriptor, inbound_data.data() + next_receive_valid_index, McastBufferSize - next_receive_valid_index, MSG_DONTWAIT);
-        if (n_rcv > 0) {
-            next_receive_valid_index += n_rcv;
-            logger.log("%:% %() % read socket:% len:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), socket_file_descriptor,
-                        next_receive_valid_index);
-            receive_callback(this);
+        // a socket that only publishes has nothing to read, so it doesn't pay for the syscall
+        num_received_datagrams = 0;
+        if (receive_callback) {
+#if defined(__linux__)
+            const int n_rcv = recvmmsg(socket_file_descriptor, inbound_messages.data(), McastMaxBatchDatagrams, MSG_DONTWAIT, nullptr);
+            for (int i = 0; i < n_rcv; ++i) {
+                inbound_lengths[i] = inbound_messages[i].msg_len;
+            }
+            num_received_datagrams = (n_rcv > 0) ? static_cast<size_t>(n_rcv) : 0;
+#else
+            while (num_received_datagrams < McastMaxBatchDatagrams) {
+                const ssize_t n_rcv = recv(socket_file_descriptor, inbound_iovecs[num_received_datagrams].iov_base, McastMaxDatagramSize, MSG_DONTWAIT);
+                if (n_rcv <= 0) {
+                    break;
+                }
+                inbound_lengths[num_received_datagrams++] = static_cast<size_t>(n_rcv);
+            }
+#endif
+
+            if (num_received_datagrams) {
+                LOG_TRACE(logger, "%:% %() % read socket:% datagrams:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), socket_file_descriptor,
+                            num_received_datagrams);
+                receive_callback(this);
+            }
         }
 
         // Publish market data in the send buffer to the multicast stream.
-        if (next_send_valid_index > 0) {
-            ssize_t n = ::send(socket_file_descriptor, outbound_data.data(), next_send_valid_index, MSG_DONTWAIT | MSG_NOSIGNAL);
+        sendDatagrams();
+
+        return (num_received_datagrams > 0);
+    }
+
+    void MulticastSocket::send(const void *data, size_t len) noexcept {
+        memcpy(reserve(len), data, len);
+    }
+
+    char *MulticastSocket::reserve(size_t len) noexcept {
+        iovec &datagram = outbound_iovecs[num_outbound_datagrams];
+        ASSERT(datagram.iov_len + len <= McastMaxDatagramSize, "Mcast datagram filled up and finishDatagram() or sendAndRecv() not called.");
+        char *reserved = static_cast<char *>(datagram.iov_base) + datagram.iov_len;
+        datagram.iov_len += len;
+        return reserved;
+    }
 
-            logger.log("%:% %() % send socket:% len:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str), socket_file_descriptor, n);
+    void MulticastSocket::finishDatagram() noexcept {
+        if (!outbound_iovecs[num_outbound_datagrams].iov_len) {
+            return;
         }
-        next_send_valid_index = 0;
 
-        return (n_rcv > 0);
+        // out of slots, so the batch goes now, and if the kernel won't take any of it yet we wait until it does
+        // rather than drop what we already have, a gap would send every receiver into recovery
+        if (++num_outbound_datagrams == McastMaxBatchDatagrams) {
+            sendDatagrams();
+            while (UNLIKELY(num_outbound_datagrams == McastMaxBatchDatagrams)) {
+                sendDatagrams();
+            }
+        }
     }
 
-    void MulticastSocket::send(const void *data, size_t len) noexcept {
-        memcpy(outbound_data.data() + next_send_valid_index, data, len);
-        next_send_valid_index += len;
-        ASSERT(next_send_valid_index < McastBufferSize, "Mcast socket buffer filled up and sendAndRecv() not called.");
+    void MulticastSocket::sendDatagrams() noexcept {
+        // the datagram being built goes too (finishDatagram() calls us with every slot already finished)
+        if (num_outbound_datagrams < McastMaxBatchDatagrams && outbound_iovecs[num_outbound_datagrams].iov_len) {
+            ++num_outbound_datagrams;
+        }
+
+        size_t n_sent = 0;
+        while (n_sent < num_outbound_datagrams) {
+#if defined(__linux__)
+            const int n = sendmmsg(socket_file_descriptor, outbound_messages.data() + n_sent, num_outbound_datagrams - n_sent, MSG_DONTWAIT | MSG_NOSIGNAL);
+#else
+            const int n = (::send(socket_file_descriptor, outbound_iovecs[n_sent].iov_base, outbound_iovecs[n_sent].iov_len, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) ? -1 : 1;
+#endif
+            if (UNLIKELY(n <= 0)) {
+                // the kernel's send buffer is full, what it didn't take stays queued for the next sendAndRecv() / finishDatagram()
+                if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS || errno == EINTR) {
+                    break;
+                }
+
+                // anything else isn't going to get better by trying again, the receivers see the gap and recover from the snapshot
+                LOG_WARN(logger, "%:% %() % send socket:% dropped % datagrams. errno:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+                            socket_file_descriptor, num_outbound_datagrams - n_sent, strerror(errno));
+                n_sent = num_outbound_datagrams;
+                break;
+            }
+            n_sent += static_cast<size_t>(n);
+        }
+
+        if (n_sent) {
+            LOG_TRACE(logger, "%:% %() % send socket:% datagrams:% still queued:%\n", __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+                        socket_file_descriptor, n_sent, num_outbound_datagrams - n_sent);
+        }
+
+        // move the datagrams the kernel didn't take to the front slots, in order, and empty the rest
+        const size_t num_unsent = num_outbound_datagrams - n_sent;
+        for (size_t i = 0; i < num_unsent; ++i) {
+            memcpy(outbound_iovecs[i].iov_base, outbound_iovecs[n_sent + i].iov_base, outbound_iovecs[n_sent + i].iov_len);
+            outbound_iovecs[i].iov_len = outbound_iovecs[n_sent + i].iov_len;
+        }
+        for (size_t i = num_unsent; i < num_outbound_datagrams; ++i) {
+            outbound_iovecs[i].iov_len = 0;
+        }
+        num_outbound_datagrams = num_unsent;
     }
 }
\ No newline at end of file
@@ -1,20 +1,59 @@
 #pragma once
 
+#include <array>
 #include <functional>
+#include <sys/uio.h>
 
 #include "socket_utils.h"
 
 #include "logger.h"
 
 namespace Common {
-    constexpr size_t McastBufferSize = 64 * 1024 * 1024;
+    // the biggest payload a UDP datagram can carry (65507 bytes) rounded up, every datagram gets a slot this big
+    constexpr size_t McastMaxDatagramSize = 64 * 1024;
 
+    // how many datagrams one recvmmsg() (or sendmmsg()) call handles at most
+    constexpr size_t McastMaxBatchDatagrams = 32;
+
+    /*
+        A UDP multicast socket that reads and writes whole batches of datagrams with one syscall
+
+        - receiving: sendAndRecv() reads up to McastMaxBatchDatagrams datagrams with recvmmsg(), each into its own slot,
+          then calls receive_callback once for all of them, the callback goes through receivedDatagram(i) for i < num_received_datagrams
+        - sending: send() appends to the datagram being built, finishDatagram() closes it, and sendAndRecv() sends every finished
+          datagram (and the one being built) with sendmmsg(), a full batch goes out by itself
+          the datagrams the kernel has no room for right now stay queued in order and go out on the next call
+
+        note that a datagram always arrives whole or not at all, so there is never a partial message to carry over between reads
+        also note that macOS doesn't have recvmmsg()/sendmmsg(), there we loop recv()/send() over the same slots instead
+    */
     struct MulticastSocket {
         MulticastSocket(Logger &logger_param): logger(logger_param) {
-            outbound_data.resize(McastBufferSize);
-            inbound_data.resize(McastBufferSize);
+            outbound_data.resize(McastMaxBatchDatagrams * McastMaxDatagramSize);
+            inbound_data.resize(McastMaxBatchDatagrams * McastMaxDatagramSize);
+
+            // every slot's message header points at its own piece of the buffers, only the lengths change from call to call
+            for (size_t i = 0; i < McastMaxBatchDatagrams; ++i) {
+                inbound_iovecs[i] = iovec{inbound_data.data() + i * McastMaxDatagramSize, McastMaxDatagramSize};
+                outbound_iovecs[i] = iovec{outbound_data.data() + i * McastMaxDatagramSize, 0};
+#if defined(__linux__)
+                inbound_messages[i] = mmsghdr{};
+                inbound_messages[i].msg_hdr.msg_iov = &inbound_iovecs[i];
+                inbound_messages[i].msg_hdr.msg_iovlen = 1;
+                outbound_messages[i] = mmsghdr{};
+                outbound_messages[i].msg_hdr.msg_iov = &outbound_iovecs[i];
+                outbound_messages[i].msg_hdr.msg_iovlen = 1;
+#endif
+            }
         }
 
+        // the message headers point into our own buffers, so a copy would be reading and writing someone else's
+        MulticastSocket() = delete;
+        MulticastSocket(const MulticastSocket &) = delete;
+        MulticastSocket(const MulticastSocket &&) = delete;
+        MulticastSocket &operator=(const MulticastSocket &) = delete;
+        MulticastSocket &operator=(const MulticastSocket &&) = delete;
+
         // initialize multicast socket to read from or publish to a stream.
         int init(const std::string &ip, const std::string &interface, int port, bool is_listening);
 
@@ -24,22 +63,56 @@ namespace Common {
         // remove subscription to a multicast stream.
         void leave(const std::string &ip, int port);
 
-        // read data from the buffers and send any stored in the send buffers, if applicable
+        // read a batch of datagrams, if there is a receive_callback, and send all the finished datagrams
         bool sendAndRecv() noexcept;
 
-        // copy the given data into the send buffer
+        // copy the given data into the datagram being built
         void send(const void *data, size_t len) noexcept;
 
+        // room for 'len' more bytes in the datagram being built, for something like a header that only gets filled in
+        // once we know what went into the datagram, the pointer is good until the next finishDatagram()
+        char *reserve(size_t len) noexcept;
+
+        // closes the datagram being built, whatever is sent after this goes into the next one
+        void finishDatagram() noexcept;
+
+        // sends every datagram, the one being built included, whatever the kernel has no room for yet stays queued
+        void sendDatagrams() noexcept;
+
+        // finished datagrams the kernel hasn't taken yet, the owner should keep calling sendAndRecv() until there are none
+        bool hasPendingDatagrams() const noexcept {
+            return num_outbound_datagrams > 0;
+        }
+
+        // the i-th datagram of the batch the receive_callback was called for
+        const char *receivedDatagram(size_t i) const noexcept {
+            return inbound_data.data() + i * McastMaxDatagramSize;
+        }
+
+        size_t receivedDatagramLength(size_t i) const noexcept {
+            return inbound_lengths[i];
+        }
+
         int socket_file_descriptor = -1;
 
+        // one McastMaxDatagramSize slot per datagram, in both directions
         std::vector<char> outbound_data;
-        size_t next_send_valid_index = 0;
+        std::array<iovec, McastMaxBatchDatagrams> outbound_iovecs;
+        size_t num_outbound_datagrams = 0; // finished datagrams waiting to be sent, the one being built is the next slot
+
         std::vector<char> inbound_data;
-        size_t next_receive_valid_index = 0;
+        std::array<iovec, McastMaxBatchDatagrams> inbound_iovecs;
+        std::array<size_t, McastMaxBatchDatagrams> inbound_lengths;
+        size_t num_received_datagrams = 0;
+
+#if defined(__linux__)
+        std::array<mmsghdr, McastMaxBatchDatagrams> outbound_messages;
+        std::array<mmsghdr, McastMaxBatchDatagrams> inbound_messages;
+#endif
 
         std::function<void(MulticastSocket *s)> receive_callback = nullptr;
 
         std::string time_str;
         Logger &logger;
     };
-}
\ No newline at end of file
+}
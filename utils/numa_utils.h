@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+namespace Common {
+
+    /*
+        On hosts with more than one socket, each socket has its own memory (a NUMA node), and reading another socket's memory
+        is a lot slower than reading our own. Linux puts a page on the node of whichever thread touches it first, so memory
+        that main allocates and zeroes ends up on main's node, not on the node of the pinned thread that actually uses it.
+
+        These helpers let a component look up which node the core it is pinned to (see createAndStartThread()) belongs to,
+        ask for its memory to go on that node (HugePageArena does this with ArenaConfig::numa_node), and check where it landed.
+
+        We call the syscalls directly instead of going through libnuma, so nothing extra has to be installed or linked,
+        and on macOS (no NUMA) everything reports -1 and binding is a no-op
+    */
+
+    // returns the NUMA node that 'core_id' belongs to, or -1 if the thread isn't pinned (core_id < 0) or we can't tell
+    inline int numaNodeOfCore(int core_id) noexcept {
+#if defined(__linux__)
+        if (core_id < 0) {
+            return -1;
+        }
+
+        // every cpu's sysfs directory has a 'node<N>' link to the node it belongs to
+        std::error_code error;
+        const std::filesystem::path cpu_dir = "/sys/devices/system/cpu/cpu" + std::to_string(core_id);
+        for (const auto &entry : std::filesystem::directory_iterator(cpu_dir, error)) {
+            const std::string name = entry.path().filename().string();
+            if (name.size() > 4 && name.compare(0, 4, "node") == 0 && name.find_first_not_of("0123456789", 4) == std::string::npos) {
+                return std::stoi(name.substr(4));
+            }
+        }
+#endif
+        return -1;
+    }
+
+    // returns the NUMA node that the page holding 'address' is on, or -1 if it hasn't been touched yet or we can't tell
+    inline int numaNodeOfAddress(const void *address) noexcept {
+#if defined(__linux__) && defined(SYS_move_pages)
+        const uintptr_t page_size = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+        void *page = reinterpret_cast<void *>(reinterpret_cast<uintptr_t>(address) & ~(page_size - 1));
+        int status = -1;
+
+        // move_pages() with no target nodes doesn't move anything, it just reports where each page is
+        if (syscall(SYS_move_pages, 0, 1UL, &page, nullptr, &status, 0) == 0 && status >= 0) {
+            return status;
+        }
+#endif
+        return -1;
+    }
+
+    // asks the kernel to put the pages of [address, address + bytes) on 'node' when they are first touched
+    // note that this is a preference (MPOL_PREFERRED), if the node runs out of memory the pages go somewhere else instead of failing
+    inline bool bindToNumaNode(void *address, size_t bytes, int node) noexcept {
+#if defined(__linux__) && defined(SYS_mbind)
+        constexpr int MPOL_PREFERRED_MODE = 1; // MPOL_PREFERRED from <numaif.h>
+        constexpr size_t max_nodes = 64 * 16;
+
+        if (node < 0 || static_cast<size_t>(node) >= max_nodes) {
+            return false;
+        }
+
+        unsigned long node_mask[max_nodes / 64] = {};
+        node_mask[node / 64] = 1UL << (node % 64);
+        return syscall(SYS_mbind, address, bytes, MPOL_PREFERRED_MODE, node_mask, max_nodes, 0) == 0;
+#else
+        return false;
+#endif
+    }
+
+    inline std::string numaNodeToString(int node) {
+        return (node < 0 ? "unknown" : std::to_string(node));
+    }
+
+}
@@ -1,36 +1,161 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
+#include <ctime>
+#include <iostream>
+
+#if defined(__APPLE__)
 #include <mach/mach_time.h>
+#endif
 
-namespace Common {
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
 
-    // store upper bits of the "timestamp counter" variable in hi and the lower ones in lo
-    // this variable stores the number of clock cycles since the last reset or set epoch
-    // inline auto rdtsc() noexcept {
-    //     uint32_t lo, hi;
+namespace Common {
 
-    //     __asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
-    //     return ((uint64_t) hi << 32) | lo;
-    // }
+    /*
+        the "timestamp counter" is a register that counts clock cycles since the last reset
+        reading it is a single instruction, unlike asking the OS for the time which (at best) is a vDSO call
+        1. rdtsc() reads it right away, the cpu is free to run it a bit earlier or later than the code around it
+        2. rdtscp() waits for all the instructions before it to finish first, use it for the 'end' of a measurement
 
-    // rdtsc doesn't work on Mac since it is an x86 command :/
-    inline auto rdtsc() noexcept {
+        rdtsc is an x86 instruction, so on arm we read the generic timer (cntvct_el0) instead, and on Mac mach_absolute_time()
+    */
+    inline uint64_t rdtsc() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#elif defined(__aarch64__)
+        uint64_t ticks;
+        __asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (ticks));
+        return ticks;
+#elif defined(__APPLE__)
         return mach_absolute_time();
+#else
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+        return static_cast<uint64_t>(ts.tv_sec) * 1000000000ULL + ts.tv_nsec;
+#endif
     }
 
-}
+    inline uint64_t rdtscp() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned int core_id;
+        return __rdtscp(&core_id);
+#elif defined(__aarch64__)
+        uint64_t ticks;
+        __asm__ __volatile__ ("isb\n\tmrs %0, cntvct_el0" : "=r" (ticks) :: "memory");
+        return ticks;
+#else
+        return rdtsc();
+#endif
+    }
+
+    /*
+        Converts timestamp counter ticks into nanoseconds
+
+        At startup we check that the counter is 'invariant' (ticks at a constant rate no matter the power state of the core)
+        and then measure how many nanoseconds one tick is against CLOCK_MONOTONIC_RAW, which is not adjusted by NTP
+        We also remember what the wall clock said at that moment, so toNanos() gives back nanoseconds since the epoch
+        just like getCurrentNanos() does, but without going to the OS
+
+        NOTE: if the counter is not invariant, the numbers will drift when the cpu changes frequency, we print a warning for it
+    */
+    class TSCClock final {
+        private:
+            double nanos_per_tick = 1.0;
+            uint64_t base_ticks = 0;
+            int64_t base_nanos = 0;
+            bool invariant = false;
+
+            static int64_t monotonicRawNanos() noexcept {
+                timespec ts;
+                clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+                return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+            }
+
+            static int64_t wallClockNanos() noexcept {
+                return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()
+                ).count();
+            }
+
+            // cpuid leaf 0x80000007, bit 8 of edx is the 'invariant tsc' flag
+            static bool hasInvariantCounter() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+                unsigned int eax = 0, ebx = 0, ecx = 0, edx = 0;
+                if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+                    return false;
+                }
+                return (edx & (1u << 8));
+#else
+                return true; // the arm generic timer and mach_absolute_time() are fixed frequency by design
+#endif
+            }
+
+            void calibrate() noexcept {
+                constexpr int64_t calibration_nanos = 10 * 1000 * 1000; // 10ms is enough for the error to be in the ppm range
 
-#define START_MEASURE(TAG) const auto TAG = Common::rdtsc()
+                const int64_t start_nanos = monotonicRawNanos();
+                const uint64_t start_ticks = rdtscp();
+                int64_t end_nanos = start_nanos;
+                while (end_nanos - start_nanos < calibration_nanos) {
+                    end_nanos = monotonicRawNanos();
+                }
+                const uint64_t end_ticks = rdtscp();
 
-#define END_MEASURE(TAG, LOGGER) \
-    do { \
-        const auto end = Common::rdtsc(); \
-        LOGGER.log("% RDTSC "#TAG" %\n", Common::getCurrentTimeStr(&time_str), (end - TAG)); \
-    } while (false)
+                nanos_per_tick = static_cast<double>(end_nanos - start_nanos) / static_cast<double>(end_ticks - start_ticks);
+
+                // anchor the counter to the wall clock, reading the counter on both sides and taking the midpoint
+                const uint64_t before_ticks = rdtscp();
+                base_nanos = wallClockNanos();
+                const uint64_t after_ticks = rdtscp();
+                base_ticks = before_ticks + (after_ticks - before_ticks) / 2;
+            }
+
+        public:
+            TSCClock() noexcept {
+                invariant = hasInvariantCounter();
+                if (!invariant) {
+                    std::cerr << "TSCClock: cpu does not report an invariant TSC, tick to nanosecond conversions may drift" << std::endl;
+                }
+                calibrate();
+            }
+
+            TSCClock(const TSCClock &) = delete;
+            TSCClock(const TSCClock &&) = delete;
+            TSCClock &operator=(const TSCClock &) = delete;
+            TSCClock &operator=(const TSCClock &&) = delete;
+
+            // nanoseconds since the epoch for a tick count read with rdtsc()/rdtscp()
+            int64_t toNanos(uint64_t ticks) const noexcept {
+                return base_nanos + static_cast<int64_t>(static_cast<double>(static_cast<int64_t>(ticks - base_ticks)) * nanos_per_tick);
+            }
+
+            // length of a measurement (difference of two tick counts) in nanoseconds
+            int64_t ticksToNanos(uint64_t ticks) const noexcept {
+                return static_cast<int64_t>(static_cast<double>(ticks) * nanos_per_tick);
+            }
+
+            double nanosPerTick() const noexcept {
+                return nanos_per_tick;
+            }
+
+            bool isInvariant() const noexcept {
+                return invariant;
+            }
+    };
+
+    // calibrated once during static initialization, so the hot path never pays for it
+    inline const TSCClock tsc_clock;
+
+    // nanoseconds since the epoch, read off the timestamp counter instead of the system clock
+    inline int64_t getCurrentNanosTSC() noexcept {
+        return tsc_clock.toNanos(rdtsc());
+    }
+
+}
 
-#define TTT_MEASURE(TAG, LOGGER) \
-    do { \
-        const auto TAG = Common::getCurrentNanos(); \
-        LOGGER.log("% TTT "#TAG" %\n", Common::getCurrentTimeStr(&time_str), TAG); \
-    } while (false)
\ No newline at end of file
+// note that START_MEASURE()/END_MEASURE() are in latency_histogram.h, and the tick-to-trade hops (TRACE_HOP()) in trace.h
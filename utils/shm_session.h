@@ -0,0 +1,493 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "macros.h"
+
+namespace Common {
+
+    /*
+        Shared memory sessions between two processes on the same host
+
+        Over TCP loopback every message costs a send() and a recv() (two kernel crossings) and a trip through the network stack,
+        even though both ends are on the same machine. Here, each client instead gets a file in shared memory with a pair of
+        SPSC rings in it, one for its messages to the server and one for the server's replies, and both sides just read and write
+        the rings like they would an LFQUEUE.
+
+        To find each other:
+        - the server creates a directory file at 'path', with one 'connected' flag per client id
+        - a client creates its session file at 'path.<client id>', then sets its flag and bumps the directory's generation
+        - the server only rescans the flags when the generation changed, so checking for new clients is a single load
+        a client that goes away clears its flag the same way, a server that goes away is not noticed by its clients
+
+        a client that died without clearing its flag (killed, crashed, exit()ed past its destructor) leaves its pid behind,
+        so the next client with that id takes the flag over once it sees that process is gone, and every connect bumps the
+        client id's connect count, so the server reopens the session even if it never saw the old one go away
+
+        note that both processes have to be built from the same code, the records are copied byte for byte,
+        the headers carry the record sizes so a mismatch is refused instead of read as garbage
+    */
+
+    // where the session files go, the EXCHANGE_SHM_DIR environment variable overrides it
+    inline std::string shmDirectory() {
+        if (const char *dir = std::getenv("EXCHANGE_SHM_DIR")) {
+            return dir;
+        }
+#if defined(__linux__)
+        return "/dev/shm";
+#else
+        return "/tmp";
+#endif
+    }
+
+    // maps 'size' bytes of the file at 'path', creating (and zeroing) it if 'create' is set, nullptr with 'error' filled in if we couldn't
+    inline void *mapSharedFile(const std::string &path, size_t size, bool create, std::string *error) noexcept {
+        const int fd = ::open(path.c_str(), create ? (O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC) : (O_RDWR | O_CLOEXEC), 0600);
+        if (fd < 0) {
+            *error = "could not open " + path + ": " + std::strerror(errno);
+            return nullptr;
+        }
+
+        // a file somebody else created has to be big enough already, we never grow it from under them
+        struct stat file_stat;
+        if ((create && ::ftruncate(fd, static_cast<off_t>(size)) != 0) ||
+            (!create && (::fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < size))) {
+            *error = "could not size " + path + " to " + std::to_string(size) + " bytes";
+            ::close(fd);
+            return nullptr;
+        }
+
+        void *memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd); // the mapping keeps the file alive
+        if (memory == MAP_FAILED) {
+            *error = "could not map " + path + ": " + std::strerror(errno);
+            return nullptr;
+        }
+        return memory;
+    }
+
+    /*
+        An SPSC ring that lives in shared memory, the same protocol as LFQUEUE, but with no pointers in it
+        so it reads the same from every process that maps it
+
+        each side's index sits on its own cache line, next to its cached copy of the other side's index,
+        so we only touch the other side's line when our cached copy says the ring is full (or empty)
+    */
+    template<typename T, size_t CAPACITY>
+    struct ShmRing {
+        static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY has to be a power of two");
+        static_assert(std::is_trivially_copyable_v<T>, "records are copied between processes byte for byte");
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "a lock based atomic would not work across processes");
+
+        // producer's cache line
+        alignas(64) std::atomic<uint64_t> write_index = 0;
+        uint64_t cached_read_index = 0;
+
+        // consumer's cache line
+        alignas(64) std::atomic<uint64_t> read_index = 0;
+        uint64_t cached_write_index = 0;
+
+        alignas(64) std::array<T, CAPACITY> slots;
+
+        // nullptr if the consumer hasn't made room yet
+        T *getNextWriteTo() noexcept {
+            const uint64_t index = write_index.load(std::memory_order_relaxed);
+            if (index - cached_read_index == CAPACITY) {
+                cached_read_index = read_index.load(std::memory_order_acquire);
+                if (index - cached_read_index == CAPACITY) {
+                    return nullptr;
+                }
+            }
+            return &slots[index & (CAPACITY - 1)];
+        }
+
+        void updateWriteIndex() noexcept {
+            write_index.store(write_index.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // nullptr if there is nothing to read
+        const T *getNextRead() noexcept {
+            const uint64_t index = read_index.load(std::memory_order_relaxed);
+            if (index == cached_write_index) {
+                cached_write_index = write_index.load(std::memory_order_acquire);
+                if (index == cached_write_index) {
+                    return nullptr;
+                }
+            }
+            return &slots[index & (CAPACITY - 1)];
+        }
+
+        void updateReadIndex() noexcept {
+            read_index.store(read_index.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        size_t size() const noexcept {
+            return write_index.load(std::memory_order_acquire) - read_index.load(std::memory_order_acquire);
+        }
+    };
+
+    // the start of every session file
+    struct ShmSessionHeader {
+        char magic[8] = {'E', 'X', 'S', 'E', 'S', 'S', 'N', '1'};
+        uint64_t request_size = 0;
+        uint64_t response_size = 0;
+        uint64_t capacity = 0;
+        uint64_t client_id = 0;
+        int64_t client_pid = 0;
+
+        bool isValid() const noexcept {
+            return std::memcmp(magic, ShmSessionHeader().magic, sizeof(magic)) == 0;
+        }
+    };
+
+    /*
+        One client's session: requests go client -> server, responses go server -> client
+
+        the client creates the file (and deletes it when it goes away), the server opens the one the client made
+    */
+    template<typename Request, typename Response, size_t CAPACITY>
+    class ShmSession final {
+        public:
+            struct Layout {
+                ShmSessionHeader header;
+                ShmRing<Request, CAPACITY> requests;
+                ShmRing<Response, CAPACITY> responses;
+            };
+
+        private:
+            Layout *layout = nullptr;
+            const std::string path;
+            const bool owner = false;
+            std::string error;
+
+        public:
+            // 'create' is the client's side, it makes a new session for 'client_id', otherwise we open the one the client made
+            ShmSession(const std::string &path_param, uint64_t client_id, bool create) noexcept: path(path_param), owner(create) {
+                // a client that died leaves its file behind, and the server may still have it mapped, so we start a new one
+                // rather than truncate the one it is looking at
+                if (create) {
+                    ::unlink(path.c_str());
+                }
+
+                void *memory = mapSharedFile(path, sizeof(Layout), create, &error);
+                if (!memory) {
+                    return;
+                }
+
+                if (create) {
+                    layout = new (memory) Layout();
+                    layout->header.request_size = sizeof(Request);
+                    layout->header.response_size = sizeof(Response);
+                    layout->header.capacity = CAPACITY;
+                    layout->header.client_id = client_id;
+                    layout->header.client_pid = static_cast<int64_t>(::getpid());
+                    return;
+                }
+
+                const Layout *existing = static_cast<const Layout *>(memory);
+                if (!existing->header.isValid() || existing->header.request_size != sizeof(Request) ||
+                    existing->header.response_size != sizeof(Response) || existing->header.capacity != CAPACITY ||
+                    existing->header.client_id != client_id) {
+                    error = path + " is not a session for client " + std::to_string(client_id) + " built from this code";
+                    ::munmap(memory, sizeof(Layout));
+                    return;
+                }
+                layout = static_cast<Layout *>(memory);
+            }
+
+            ~ShmSession() {
+                if (layout) {
+                    ::munmap(layout, sizeof(Layout));
+                    if (owner) {
+                        ::unlink(path.c_str());
+                    }
+                }
+            }
+
+            ShmSession() = delete;
+            ShmSession(const ShmSession &) = delete;
+            ShmSession(const ShmSession &&) = delete;
+            ShmSession &operator=(const ShmSession &) = delete;
+            ShmSession &operator=(const ShmSession &&) = delete;
+
+            bool isOpen() const noexcept {
+                return layout != nullptr;
+            }
+
+            // why the session couldn't be created or opened
+            const std::string &errorString() const noexcept {
+                return error;
+            }
+
+            ShmRing<Request, CAPACITY> &requests() noexcept {
+                return layout->requests;
+            }
+
+            ShmRing<Response, CAPACITY> &responses() noexcept {
+                return layout->responses;
+            }
+
+            int64_t clientPid() const noexcept {
+                return layout->header.client_pid;
+            }
+    };
+
+    // states of a client id in the directory
+    constexpr uint32_t SHM_SESSION_FREE = 0;
+    constexpr uint32_t SHM_SESSION_CLAIMED = 1; // a client is still creating its session file
+    constexpr uint32_t SHM_SESSION_READY = 2;
+
+    // the server's directory file, which client ids have a session open right now
+    template<size_t MAX_CLIENTS>
+    struct ShmSessionDirectory {
+        char magic[8] = {'E', 'X', 'S', 'D', 'I', 'R', 'S', '2'};
+        uint64_t max_clients = MAX_CLIENTS;
+        int64_t server_pid = 0;
+        alignas(64) std::atomic<uint64_t> generation = 0; // its own cache line, the only thing the server polls, bumped on every connect and disconnect
+        alignas(64) std::array<std::atomic<uint32_t>, MAX_CLIENTS> connected{};
+        std::array<std::atomic<int64_t>, MAX_CLIENTS> client_pids{}; // who holds each client id, 0 while it is being claimed
+        std::array<std::atomic<uint64_t>, MAX_CLIENTS> connect_counts{}; // bumped every time a client id gets a new session
+
+        bool isValid() const noexcept {
+            return std::memcmp(magic, ShmSessionDirectory().magic, sizeof(magic)) == 0 && max_clients == MAX_CLIENTS;
+        }
+    };
+
+    // the server side, owns the directory at 'path' and opens every client's session as it connects
+    template<typename Request, typename Response, size_t CAPACITY, size_t MAX_CLIENTS>
+    class ShmSessionServer final {
+        public:
+            using Session = ShmSession<Request, Response, CAPACITY>;
+            using Directory = ShmSessionDirectory<MAX_CLIENTS>;
+
+        private:
+            Directory *directory = nullptr;
+            const std::string path;
+            std::string error;
+
+            uint64_t seen_generation = 0;
+            std::array<Session *, MAX_CLIENTS> sessions{};
+            std::array<uint64_t, MAX_CLIENTS> session_connect_counts{}; // the connect count each of 'sessions' was opened for
+            std::vector<size_t> connected_clients; // the client ids in 'sessions', so we don't walk all of them on every poll
+            std::vector<size_t> opened_clients; // the client ids the last poll() opened a new session for
+
+        public:
+            explicit ShmSessionServer(const std::string &path_param) noexcept: path(path_param) {
+                void *memory = mapSharedFile(path, sizeof(Directory), true, &error);
+                if (memory) {
+                    directory = new (memory) Directory();
+                    directory->server_pid = static_cast<int64_t>(::getpid());
+                }
+                connected_clients.reserve(MAX_CLIENTS);
+                opened_clients.reserve(MAX_CLIENTS);
+            }
+
+            ~ShmSessionServer() {
+                for (auto session : sessions) {
+                    delete session;
+                }
+                if (directory) {
+                    ::munmap(directory, sizeof(Directory));
+                    ::unlink(path.c_str());
+                }
+            }
+
+            ShmSessionServer() = delete;
+            ShmSessionServer(const ShmSessionServer &) = delete;
+            ShmSessionServer(const ShmSessionServer &&) = delete;
+            ShmSessionServer &operator=(const ShmSessionServer &) = delete;
+            ShmSessionServer &operator=(const ShmSessionServer &&) = delete;
+
+            bool isOpen() const noexcept {
+                return directory != nullptr;
+            }
+
+            const std::string &errorString() const noexcept {
+                return error;
+            }
+
+            // picks up clients that connected or went away since the last call, returns false if a session couldn't be opened
+            // the ids it opened a session for, whether first connects or reconnects, are in openedClients() until the next call
+            bool poll() noexcept {
+                opened_clients.clear();
+                const uint64_t generation = directory->generation.load(std::memory_order_acquire);
+                if (LIKELY(generation == seen_generation)) {
+                    return true;
+                }
+                seen_generation = generation;
+
+                bool ok = true;
+                for (size_t client_id = 0; client_id < MAX_CLIENTS; ++client_id) {
+                    const bool is_connected = directory->connected[client_id].load(std::memory_order_acquire) == SHM_SESSION_READY;
+                    const uint64_t connect_count = directory->connect_counts[client_id].load(std::memory_order_acquire);
+
+                    // the client went away and a new one took its id before we looked, the session we have is for a file nobody writes to anymore
+                    if (is_connected && sessions[client_id] && session_connect_counts[client_id] != connect_count) {
+                        delete sessions[client_id];
+                        sessions[client_id] = nullptr;
+                        connected_clients.erase(std::remove(connected_clients.begin(), connected_clients.end(), client_id), connected_clients.end());
+                    }
+
+                    if (is_connected && !sessions[client_id]) {
+                        auto session = new Session(path + "." + std::to_string(client_id), client_id, false);
+                        if (!session->isOpen()) {
+                            error = session->errorString();
+                            delete session;
+                            ok = false;
+                            continue;
+                        }
+                        sessions[client_id] = session;
+                        session_connect_counts[client_id] = connect_count;
+                        connected_clients.push_back(client_id);
+                        opened_clients.push_back(client_id);
+                    } else if (!is_connected && sessions[client_id]) {
+                        delete sessions[client_id];
+                        sessions[client_id] = nullptr;
+                        connected_clients.erase(std::remove(connected_clients.begin(), connected_clients.end(), client_id), connected_clients.end());
+                    }
+                }
+                return ok;
+            }
+
+            // nullptr if 'client_id' has no session open
+            Session *session(size_t client_id) noexcept {
+                return (client_id < MAX_CLIENTS) ? sessions[client_id] : nullptr;
+            }
+
+            const std::vector<size_t> &connectedClients() const noexcept {
+                return connected_clients;
+            }
+
+            // a new session is a new client process, which starts its sequence numbers over, so the caller has to as well
+            const std::vector<size_t> &openedClients() const noexcept {
+                return opened_clients;
+            }
+    };
+
+    // the client side, creates this client's session and registers it in the server's directory at 'path'
+    template<typename Request, typename Response, size_t CAPACITY, size_t MAX_CLIENTS>
+    class ShmSessionClient final {
+        public:
+            using Session = ShmSession<Request, Response, CAPACITY>;
+            using Directory = ShmSessionDirectory<MAX_CLIENTS>;
+
+        private:
+            Directory *directory = nullptr;
+            Session *session = nullptr;
+            const size_t client_id = 0;
+            std::string error;
+
+            // takes our client id's flag, either because it is free, or because the process that holds it doesn't exist anymore
+            // whoever swaps its own pid in owns the id, so two clients racing for a dead one's id can't both get it
+            bool claim(Directory *server_directory) noexcept {
+                const int64_t pid = static_cast<int64_t>(::getpid());
+                uint32_t expected = SHM_SESSION_FREE;
+                if (server_directory->connected[client_id].compare_exchange_strong(expected, SHM_SESSION_CLAIMED, std::memory_order_acq_rel)) {
+                    server_directory->client_pids[client_id].store(pid, std::memory_order_release);
+                    return true;
+                }
+
+                // a pid of 0 means someone is in the middle of claiming it
+                int64_t holder = server_directory->client_pids[client_id].load(std::memory_order_acquire);
+                if (holder == 0 || holder == pid || ::kill(static_cast<pid_t>(holder), 0) == 0 || errno != ESRCH) {
+                    return false;
+                }
+                if (!server_directory->client_pids[client_id].compare_exchange_strong(holder, pid, std::memory_order_acq_rel)) {
+                    return false;
+                }
+                server_directory->connected[client_id].store(SHM_SESSION_CLAIMED, std::memory_order_release);
+                return true;
+            }
+
+        public:
+            ShmSessionClient(const std::string &path, size_t client_id_param) noexcept: client_id(client_id_param) {
+                if (client_id >= MAX_CLIENTS) {
+                    error = "client id " + std::to_string(client_id) + " is out of range";
+                    return;
+                }
+
+                void *memory = mapSharedFile(path, sizeof(Directory), false, &error);
+                if (!memory) {
+                    error += ", is the server running?";
+                    return;
+                }
+                if (!static_cast<Directory *>(memory)->isValid()) {
+                    error = path + " is not a session directory built from this code";
+                    ::munmap(memory, sizeof(Directory));
+                    return;
+                }
+                Directory *server_directory = static_cast<Directory *>(memory);
+
+                // only one session per client id, the same as the server only accepting a client id on one socket
+                if (!claim(server_directory)) {
+                    error = "client id " + std::to_string(client_id) + " already has a session";
+                    ::munmap(memory, sizeof(Directory));
+                    return;
+                }
+
+                // the server only opens our session once it is READY, so it never sees a half written file
+                session = new Session(path + "." + std::to_string(client_id), client_id, true);
+                if (!session->isOpen()) {
+                    error = session->errorString();
+                    delete session;
+                    session = nullptr;
+                    server_directory->client_pids[client_id].store(0, std::memory_order_release);
+                    server_directory->connected[client_id].store(SHM_SESSION_FREE, std::memory_order_release);
+                    ::munmap(memory, sizeof(Directory));
+                    return;
+                }
+                directory = server_directory;
+                directory->connect_counts[client_id].fetch_add(1, std::memory_order_acq_rel);
+                directory->connected[client_id].store(SHM_SESSION_READY, std::memory_order_release);
+                directory->generation.fetch_add(1, std::memory_order_acq_rel);
+            }
+
+            ~ShmSessionClient() {
+                if (directory) {
+                    directory->client_pids[client_id].store(0, std::memory_order_release);
+                    directory->connected[client_id].store(SHM_SESSION_FREE, std::memory_order_release);
+                    directory->generation.fetch_add(1, std::memory_order_acq_rel);
+                    ::munmap(directory, sizeof(Directory));
+                }
+                delete session;
+            }
+
+            ShmSessionClient() = delete;
+            ShmSessionClient(const ShmSessionClient &) = delete;
+            ShmSessionClient(const ShmSessionClient &&) = delete;
+            ShmSessionClient &operator=(const ShmSessionClient &) = delete;
+            ShmSessionClient &operator=(const ShmSessionClient &&) = delete;
+
+            bool isConnected() const noexcept {
+                return directory != nullptr;
+            }
+
+            const std::string &errorString() const noexcept {
+                return error;
+            }
+
+            ShmRing<Request, CAPACITY> &requests() noexcept {
+                return session->requests();
+            }
+
+            ShmRing<Response, CAPACITY> &responses() noexcept {
+                return session->responses();
+            }
+    };
+
+}
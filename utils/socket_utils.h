@@ -3,7 +3,6 @@
 #include <iostream>
 #include <string>
 #include <unordered_set>
-#include <sys/event.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/socket.h>
@@ -14,7 +13,13 @@
 #include <ifaddrs.h>
 #include <sys/socket.h>
 #include <fcntl.h>
+
+// the TCPServer multiplexes its sockets with epoll on linux and kqueue everywhere else (macOS/BSD)
+#if defined(__linux__)
+#include <sys/epoll.h>
+#else
 #include <sys/event.h>
+#endif
 
 #include "logger.h"
 
@@ -84,6 +89,18 @@ namespace Common {
         return (op_successful != -1);
     }
 
+    inline bool setBusyPoll (int fd, int busy_poll_usecs) {
+        // SO_BUSY_POLL lets a blocking read/poll on this socket spin on the NIC's receive queue for up to 'busy_poll_usecs'
+        // before sleeping, this trades some cpu for skipping the interrupt -> softirq -> wakeup path on the way in
+        // note that raising it above net.core.busy_read needs CAP_NET_ADMIN, so callers should treat a failure as a warning
+#if defined(SO_BUSY_POLL)
+        int op_successful = setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, reinterpret_cast<void *>(&busy_poll_usecs), sizeof(busy_poll_usecs));
+        return (op_successful != -1);
+#else
+        return false;
+#endif
+    }
+
     inline bool wouldBlock() {
         // checks whether a socket operation would block or not
 
@@ -121,7 +138,7 @@ namespace Common {
         // 1.2 retrieves the ip address we want this socket to listen on
         const std::string ip = t_ip.empty() ? getIFaceIP(interface) : t_ip;
 
-        logger.log("%:% %() % ip:% interface:% port:% is_udp:% is_blocking:% is_listening:% ttl:% SOtime:% \n", 
+        LOG_INFO(logger, "%:% %() % ip:% interface:% port:% is_udp:% is_blocking:% is_listening:% ttl:% SOtime:% \n", 
             __FILE__, __LINE__, __FUNCTION__, 
             Common::getCurrentTimeStr(&time_str),
             ip, interface, port, is_udp, is_blocking, is_listening, ttl, needs_so_timestamp
@@ -145,7 +162,7 @@ namespace Common {
         const auto possible_err = getaddrinfo(ip.c_str(), std::to_string(port).c_str(), &hints, &result);
 
         if (possible_err) {
-            logger.log("getaddrinfo() failed, info: error: % errno: % \n", gai_strerror(possible_err), strerror(errno));
+            LOG_WARN(logger, "getaddrinfo() failed, info: error: % errno: % \n", gai_strerror(possible_err), strerror(errno));
         }
 
         
@@ -160,20 +177,20 @@ namespace Common {
             // 2.2 try to create the socket
             socket_file_descriptor = socket(socket_args->ai_family, socket_args->ai_socktype, socket_args->ai_protocol);
             if (socket_file_descriptor == -1) {
-                logger.log("socket() function failed. errno: % \n", strerror(errno));
+                LOG_WARN(logger, "socket() function failed. errno: % \n", strerror(errno));
                 return -1;
             }
 
             // 2.3 if the socket was created successfully, we should set it to be non-blocking and have no packet delays
             if (!is_blocking) {
                 if (!setNonBlocking(socket_file_descriptor)) {
-                    logger.log("setNonBlocking failed. errno: % \n", strerror(errno));
+                    LOG_WARN(logger, "setNonBlocking failed. errno: % \n", strerror(errno));
                     return -1;
                 }
 
                 // note that the delays only occur during TCP connections to ensure reliable delivery
                 if (!is_udp && !setNoDelay(socket_file_descriptor)) {
-                    logger.log("setNoDelay failed. errno: % \n", strerror(errno));
+                    LOG_WARN(logger, "setNoDelay failed. errno: % \n", strerror(errno));
                     return -1;
                 }
             }
@@ -184,21 +201,21 @@ namespace Common {
                 connect(socket_file_descriptor, socket_args->ai_addr, socket_args->ai_addrlen) == -1 &&
                 !wouldBlock()
             ) {
-                logger.log("connect() failed. errno: % \n", strerror(errno));
+                LOG_WARN(logger, "connect() failed. errno: % \n", strerror(errno));
                 return -1;
             }
 
             constexpr int MaxTCPServerBacklog = 1024;
             if (is_listening && setsockopt(socket_file_descriptor, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<void *>(&one), sizeof(one)) == -1) {
-                logger.log("setsockopt() failed. errno: % \n", strerror(errno));
+                LOG_WARN(logger, "setsockopt() failed. errno: % \n", strerror(errno));
                 return -1;
             }
             if (is_listening && bind(socket_file_descriptor, socket_args->ai_addr, socket_args->ai_addrlen) == -1) {
-                logger.log("bind() failed. errno: % \n", strerror(errno));
+                LOG_WARN(logger, "bind() failed. errno: % \n", strerror(errno));
                 return -1;
             }
             if (!is_udp && is_listening && listen(socket_file_descriptor, MaxTCPServerBacklog) == -1) {
-                logger.log("listen() failed. errno: % \n", strerror(errno));
+                LOG_WARN(logger, "listen() failed. errno: % \n", strerror(errno));
                 return -1;
             }
 
@@ -208,17 +225,17 @@ namespace Common {
                 const bool is_multicast = atoi(ip.c_str()) & 0xe0; 
 
                 if (is_multicast && !setMcastTTL(socket_file_descriptor, ttl)) {
-                    logger.log("setMcastTTL() failed. errno: % \n", strerror(errno));
+                    LOG_WARN(logger, "setMcastTTL() failed. errno: % \n", strerror(errno));
                     return -1;
                 }
                 if (!is_multicast && !setTTL(socket_file_descriptor, ttl)) {
-                    logger.log("setTTL() failed. errno: % \n", strerror(errno));
+                    LOG_WARN(logger, "setTTL() failed. errno: % \n", strerror(errno));
                     return -1;
                 }
             }
 
             if (needs_so_timestamp && !setSOTimestamp(socket_file_descriptor)) {
-                logger.log("setSOTimestamp() failed. errno: % \n", strerror(errno));
+                LOG_WARN(logger, "setSOTimestamp() failed. errno: % \n", strerror(errno));
                 return -1;
             }
 
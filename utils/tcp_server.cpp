@@ -3,44 +3,85 @@
 namespace Common {
 
     /*
-        we initialize a kqueue and add this server's socket to the kqueue
-        a kqueue is a way on how we can listen on many sockets at once and process events
+        we initialize an epoll (linux) or kqueue (macOS) instance and add this server's socket to it
+        both are ways on how we can listen on many sockets at once and process events
     */
     void TCPServer::listen(const std::string &interface, int port) {
 
         destroy();
+#if defined(__linux__)
+        epoll_file_descriptor = epoll_create1(0);
+        ASSERT(epoll_file_descriptor >= 0, "epoll_create1() failed error: " + std::string(std::strerror(errno)));
+#else
         kqueue_file_descriptor = kqueue();
         ASSERT(kqueue_file_descriptor >= 0, "kqueue() failed error: " + std::string(std::strerror(errno)));
+#endif
 
         ASSERT(listener_socket.connect("", interface, port, true) >= 0,
         "Listener socket failed to connect. interface: " + interface + " port: " + std::to_string(port) + 
         " error: " + std::string(std::strerror(errno)));
 
+#if defined(__linux__)
+        ASSERT(epoll_add(&listener_socket),
+        "Failed to add socket fd to epoll. error: " + std::string(std::strerror(errno)));
+
+        // the listener always stays on epoll, only the accepted client sockets are handed to io_uring
+        if (config.use_io_uring && !io_uring) {
+            io_uring = new IOUringTransport(logger);
+            if (!io_uring->init(config.io_uring_sq_poll, config.io_uring_sq_poll_cpu)) {
+                LOG_WARN(logger, "%:% %() % io_uring not available, falling back to epoll \n",
+                __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str)
+                );
+                delete io_uring;
+                io_uring = nullptr;
+            }
+        }
+#else
         ASSERT(kqueue_add(&listener_socket),
         "Failed to add socket fd to kqueue. error: " + std::string(std::strerror(errno)));
+#endif
     }
 
     // update all data structures with new state of incoming socket events
     void TCPServer::poll() noexcept {
-        const int max_events = 1 + sockets.size();
-        // check if any sockets need to be removed from the kqueue
+        const int max_events = std::min(1 + static_cast<int>(sockets.size()), MaxTCPServerEvents);
+        // check if any sockets need to be removed from the epoll/kqueue
         for (auto socket : disconnected_sockets) {
             del(socket);
         }
         disconnected_sockets.clear();
 
         // fetch a list of all the events we received
-        const int n = kevent(kqueue_file_descriptor, nullptr, 0, events, max_events, nullptr);
+        // in busy-poll mode we never let the kernel put this thread to sleep, we just check and come back next iteration
+#if defined(__linux__)
+        const int n = epoll_wait(epoll_file_descriptor, events, max_events, config.busy_poll ? 0 : config.poll_timeout_ms);
+#else
+        // note that tv_nsec has to stay under a second, kevent() fails with EINVAL otherwise
+        const int timeout_ms = (config.busy_poll ? 0 : config.poll_timeout_ms);
+        struct timespec timeout{timeout_ms / 1000, static_cast<long>((timeout_ms % 1000) * NANOS_TO_MILLIS)};
+        const int n = kevent(kqueue_file_descriptor, nullptr, 0, events, max_events, &timeout);
+#endif
 
         bool have_new_connection = false;
         for (int i = 0; i < n; ++i) {
+#if defined(__linux__)
+            const epoll_event &event = events[i];
+            auto socket = reinterpret_cast<TCPSocket *>(event.data.ptr);
+            const bool is_read_event = (event.events & EPOLLIN);
+            const bool is_write_event = (event.events & EPOLLOUT);
+            const bool is_error_event = (event.events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP));
+#else
             struct kevent &event = events[i];
             auto socket = reinterpret_cast<TCPSocket *>(event.udata);
+            const bool is_read_event = (event.filter == EVFILT_READ);
+            const bool is_write_event = (event.filter == EVFILT_WRITE);
+            const bool is_error_event = (event.flags & (EV_ERROR | EV_EOF));
+#endif
 
-            if (event.filter == EVFILT_READ) {
+            if (is_read_event) {
                 if (socket == &listener_socket) {
                     // indicates we have gotten a new connection, need to make a new receiving socket to process this
-                    logger.log("%:% %() % EVFILT_READ listener_socket:% \n", 
+                    LOG_TRACE(logger, "%:% %() % EVFILT_READ listener_socket:% \n", 
                     __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
                     socket->socket_file_descriptor
                     );
@@ -48,7 +89,7 @@ namespace Common {
                     continue;
                 }
 
-                logger.log("%:% %() % EVFILT_READ listener_socket:% \n", 
+                LOG_TRACE(logger, "%:% %() % EVFILT_READ listener_socket:% \n", 
                 __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
                 socket->socket_file_descriptor
                 );
@@ -59,21 +100,28 @@ namespace Common {
                 }
             }
 
-            // new socket for sending data
-            if (event.filter == EVFILT_WRITE) {
-                logger.log("%:% %() % EVFILT_WRITE listener_socket:% \n", 
+            // a socket that couldn't send everything has room again, we stop watching for it until it fills up again
+            if (is_write_event) {
+                LOG_TRACE(logger, "%:% %() % EVFILT_WRITE listener_socket:% \n", 
                 __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
                 socket->socket_file_descriptor
                 );
 
+                socket->send_blocked = false;
+#if defined(__linux__)
+                epoll_watch_write(socket, false);
+#else
+                socket->write_event_armed = false; // it was one shot
+#endif
+
                 if (std::find(send_sockets.begin(), send_sockets.end(), socket) == send_sockets.end()) {
                     send_sockets.push_back(socket);
                 }
             }
 
             // these sockets have an issue and need to be deactivated
-            if (event.flags & (EV_ERROR | EV_EOF)) {
-                logger.log("%:% %() % EV_ERROR or EV_EOF listener_socket:% \n", 
+            if (is_error_event) {
+                LOG_WARN(logger, "%:% %() % EV_ERROR or EV_EOF listener_socket:% \n", 
                 __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
                 socket->socket_file_descriptor
                 );
@@ -84,9 +132,10 @@ namespace Common {
             }
         }
 
-        // accept the new connection, create a socket for it, and register it in our kqueue and data structures
+        // accept the new connection, create a socket for it, and register it in our epoll/kqueue and data structures
+        // note that in edge-triggered mode we only hear about the listener once, so we have to keep accepting until it would block
         while (have_new_connection) {
-            logger.log("%:% %() % new connection! \n", 
+            LOG_INFO(logger, "%:% %() % new connection! \n", 
             __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str)
             );
 
@@ -100,15 +149,40 @@ namespace Common {
             ASSERT(setNonBlocking(file_descriptor) && setNoDelay(file_descriptor),
                 "Failed to set non-blocking or no-delay on socket: " + std::to_string(file_descriptor)
             );
-            logger.log("%:% %() % accepted socket:% \n", 
+            LOG_INFO(logger, "%:% %() % accepted socket:% \n", 
             __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
             file_descriptor
             );
 
-            TCPSocket *accepted_socket = new TCPSocket(logger);
+#if defined(__linux__)
+            // not fatal, the socket still works without it, we just lose the busy-polling on reads
+            if (config.socket_busy_poll_usecs > 0 && !setBusyPoll(file_descriptor, config.socket_busy_poll_usecs)) {
+                LOG_WARN(logger, "%:% %() % setBusyPoll() failed on socket:% usecs:% errno:% \n",
+                __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+                file_descriptor, config.socket_busy_poll_usecs, strerror(errno)
+                );
+            }
+#endif
+
+            TCPSocket *accepted_socket = new TCPSocket(logger, config.socket_receive_buffer_size, config.socket_send_buffer_size);
             accepted_socket->socket_file_descriptor = file_descriptor;
             accepted_socket->receive_callback = receive_callback;
+            if (config.socket_send_low_water_mark && config.socket_send_high_water_mark) {
+                accepted_socket->setSendWaterMarks(config.socket_send_low_water_mark, config.socket_send_high_water_mark);
+            }
+#if defined(__linux__)
+            // io_uring sockets never show up in epoll or in receieve_sockets, the transport does their reads and sends
+            if (io_uring && io_uring->addSocket(accepted_socket)) {
+                if (std::find(sockets.begin(), sockets.end(), accepted_socket) == sockets.end()) {
+                    sockets.push_back(accepted_socket);
+                }
+                continue;
+            }
+            ASSERT(epoll_add(accepted_socket), "unable to add socket. error: " + std::string(std::strerror(errno)));
+#else
             ASSERT(kqueue_add(accepted_socket), "unable to add socket. error: " + std::string(std::strerror(errno)));
+#endif
+            accepted_socket->wait_for_write_event = true; // watchBlockedSends() tells it when it can send again
             if (std::find(sockets.begin(), sockets.end(), accepted_socket) == sockets.end()) {
                 sockets.push_back(accepted_socket);
             }
@@ -119,22 +193,98 @@ namespace Common {
     }
 
     // for all read sockets, read all data, if available, trigger callback if any data was read
-    void TCPServer::sendAndReceive() noexcept {
+    bool TCPServer::sendAndReceive() noexcept {
 
         bool data_read = false;
         for (auto socket : receieve_sockets) {
+            // a client that isn't reading what we send it doesn't get to send us anything new until it catches up,
+            // its requests wait in the kernel, and once that fills up TCP flow control pushes back on the client itself
+            // note that we still keep the socket in receieve_sockets, so with edge-triggered events we don't miss what arrived meanwhile
+            if (UNLIKELY(socket->send_backed_up)) {
+                socket->flushSendBuffer();
+                continue;
+            }
+
             if (socket->sendAndReceive()) {
                 data_read = true;
             }
         }
+
+#if defined(__linux__)
+        // queue a send for every io_uring socket with pending data, then hand them all to the kernel in one go
+        if (io_uring) {
+            for (auto socket : sockets) {
+                io_uring->queueSend(socket);
+            }
+            if (io_uring->submitAndReap()) {
+                data_read = true;
+            }
+
+            // epoll used to tell us about hang-ups, for these sockets the completions do instead
+            for (auto socket : sockets) {
+                if ((socket->io_uring_slot >= 0) && (socket->receive_socket_disconnected || socket->send_socket_disconnected) &&
+                    std::find(disconnected_sockets.begin(), disconnected_sockets.end(), socket) == disconnected_sockets.end()) {
+                    disconnected_sockets.push_back(socket);
+                }
+            }
+
+            // the sockets the transport is done with are safe to free now
+            if (UNLIKELY(!closing_sockets.empty())) {
+                closing_sockets.erase(std::remove_if(closing_sockets.begin(), closing_sockets.end(), [](TCPSocket *socket) {
+                    if (socket->io_uring_slot >= 0) {
+                        return false;
+                    }
+                    delete socket;
+                    return true;
+                }), closing_sockets.end());
+            }
+        }
+#endif
+
         if (data_read) {
             receive_finished_callback();
         }
 
-        // for all send sockets, send any data we have stored in their send buffers
+        // for all send sockets (the ones that told us they have room again this poll), send any data we have stored in their send buffers
         for (auto socket : send_sockets) {
-            socket->sendAndReceive();
+            socket->flushSendBuffer();
+        }
+        send_sockets.clear();
+
+        watchBlockedSends();
+
+        return data_read;
+    }
+
+    // sends whatever the sockets have gather()ed since the last call, see TCPSocket::gather()
+    void TCPServer::sendGathered() noexcept {
+        for (auto socket : sockets) {
+            socket->sendGathered();
+        }
+
+        watchBlockedSends();
+    }
+
+    // asks to be told when sockets that couldn't send everything can take more, instead of retrying them every loop
+    void TCPServer::watchBlockedSends() noexcept {
+        for (auto socket : sockets) {
+            if (UNLIKELY(socket->send_blocked && socket->wait_for_write_event && !socket->write_event_armed)) {
+#if defined(__linux__)
+                const bool watching = epoll_watch_write(socket, true);
+#else
+                const bool watching = kqueue_watch_write(socket);
+#endif
+                // if we can't watch it, the socket has to go back to trying on every loop
+                if (UNLIKELY(!watching)) {
+                    LOG_WARN(logger, "%:% %() % unable to watch socket:% for room to send. error: % \n",
+                    __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
+                    socket->socket_file_descriptor, std::strerror(errno)
+                    );
+                    socket->wait_for_write_event = false;
+                    socket->write_event_armed = false;
+                }
+            }
         }
     }
 
-}
\ No newline at end of file
+}
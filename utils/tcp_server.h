@@ -1,20 +1,71 @@
 #pragma once
 
 #include "tcp_socket.h"
+#include "io_uring_transport.h"
 
 namespace Common {
+    constexpr int MaxTCPServerEvents = 1024;
+
+    // knobs for how the server waits on its sockets, the defaults are what a pinned gateway thread wants
+    struct TCPServerConfig {
+        // edge-triggered: a socket is only reported when new data arrives (EPOLLET / EV_CLEAR)
+        // level-triggered: a socket keeps being reported as long as there is unread data in it
+        bool edge_triggered = true;
+
+        // busy-poll: poll() never sleeps in the kernel, it checks for events and returns right away (zero timeout)
+        // otherwise poll() blocks for up to 'poll_timeout_ms' waiting for an event
+        bool busy_poll = true;
+        int poll_timeout_ms = 1;
+
+        // SO_BUSY_POLL budget (in microseconds) set on every accepted socket, 0 leaves the kernel default (linux only)
+        int socket_busy_poll_usecs = 50;
+        
+        // io_uring: accepted sockets are driven by an IOUringTransport instead of epoll + recvmsg()/send() (linux only)
+        // if the kernel doesn't support it, the server logs it and falls back to the regular path
+        bool use_io_uring = false;
+        bool io_uring_sq_poll = false; // let a kernel thread poll the submission queue, saves the io_uring_enter() on submit
+        int io_uring_sq_poll_cpu = -1; // core to pin that kernel thread to, -1 lets the kernel pick
+
+        // buffer sizes of every accepted socket, see TCPSocket
+        size_t socket_receive_buffer_size = TCPDefaultReceiveBufferSize;
+        size_t socket_send_buffer_size = TCPDefaultSendBufferSize;
+
+        // per socket back pressure: above the high water mark of unsent bytes we stop reading from that client,
+        // so it can't pile more work on us than it reads back, and we start again once it has drained to the low water mark
+        // 0 for either leaves the socket's own default (1/4 and 3/4 of its send buffer)
+        size_t socket_send_low_water_mark = 0;
+        size_t socket_send_high_water_mark = 0;
+    };
+
     struct TCPServer {
         
         public:
+#if defined(__linux__)
+            int epoll_file_descriptor = -1;
+#else
             int kqueue_file_descriptor = -1;
+#endif
             TCPSocket listener_socket;
 
-            struct kevent events[1024];
+            TCPServerConfig config;
+#if defined(__linux__)
+            IOUringTransport *io_uring = nullptr;
+#endif
+
+#if defined(__linux__)
+            struct epoll_event events[MaxTCPServerEvents];
+#else
+            struct kevent events[MaxTCPServerEvents];
+#endif
             std::vector<TCPSocket *> sockets;
             std::vector<TCPSocket *> receieve_sockets;
             std::vector<TCPSocket *> send_sockets;
             std::vector<TCPSocket *> disconnected_sockets;
 
+            // io_uring sockets we already removed, the kernel may still be reading or sending out of their buffers,
+            // so each one is only deleted once the transport hands it back (its io_uring_slot goes to -1)
+            std::vector<TCPSocket *> closing_sockets;
+
             std::function<void(TCPSocket *, Nanos rx_time)> receive_callback;
             std::function<void()> receive_finished_callback;
 
@@ -22,26 +73,34 @@ namespace Common {
             Logger &logger;
 
             auto defaultRecvCallback(TCPSocket *socket, Nanos rx_time) noexcept {
-                logger.log("%:% %() % TCPServer::defaultRecvCallback() socket:% len:% rx:% \n", 
+                LOG_TRACE(logger, "%:% %() % TCPServer::defaultRecvCallback() socket:% len:% rx:% \n", 
                 __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str),
-                socket->socket_file_descriptor, socket->next_receive_valid_index, rx_time
+                socket->socket_file_descriptor, socket->receive_buffer.readable(), rx_time
                 );
             }
 
             auto defaultRecvFinishedCallback() noexcept {
-                logger.log("%:% %() % TCPServer::defaultRecvFinishedCallback() \n", 
+                LOG_TRACE(logger, "%:% %() % TCPServer::defaultRecvFinishedCallback() \n", 
                 __FILE__, __LINE__, __FUNCTION__, Common::getCurrentTimeStr(&time_str)
                 );
             }
 
             // notice that the code will call TCPSocket(Logger &logger) constructor instead of doing a copy constructor
-            explicit TCPServer(Logger &logger_obj) : listener_socket(logger_obj), logger(logger_obj) {
+            // the listener only ever accepts, so it gets the smallest buffers there are
+            explicit TCPServer(Logger &logger_obj, const TCPServerConfig &config_param = TCPServerConfig()
+            ) : listener_socket(logger_obj, 0, 0), config(config_param), logger(logger_obj) {
                 receive_callback = [this](auto socket, auto rx_time) {
                     defaultRecvCallback(socket, rx_time);
                 };
                 receive_finished_callback = [this]() {
                     defaultRecvFinishedCallback();
                 };
+#if defined(__linux__)
+                // a completion can carry a whole provided buffer, a receive buffer smaller than that would have to hold on to part of every one
+                ASSERT(!config.use_io_uring || config.socket_receive_buffer_size >= IOUringRecvBufferSize,
+                    "io_uring needs socket_receive_buffer_size:" + std::to_string(config.socket_receive_buffer_size) +
+                    " to be at least " + std::to_string(IOUringRecvBufferSize));
+#endif
             }
 
             ~TCPServer() {
@@ -60,16 +119,29 @@ namespace Common {
                 for (auto socket : disconnected_sockets) {
                     unique_sockets.insert(socket);
                 }
+                for (auto socket : closing_sockets) {
+                    unique_sockets.insert(socket);
+                }
 
                 // Now delete each unique socket once
+                // tear the ring down first so the kernel is done with the socket buffers before we free them
+#if defined(__linux__)
+                delete io_uring;
+                io_uring = nullptr;
+#endif
                 for (auto socket : unique_sockets) {
                     delete socket;
                 }
             }
 
             auto destroy() {
+#if defined(__linux__)
+                close(epoll_file_descriptor);
+                epoll_file_descriptor = -1;
+#else
                 close(kqueue_file_descriptor);
                 kqueue_file_descriptor = -1;
+#endif
                 listener_socket.destroy();
             }
 
@@ -80,15 +152,38 @@ namespace Common {
             TCPServer &operator=(const TCPServer &&) = delete;
 
             /*
-                we initialize a kqueue and add this server's socket to the kqueue
-                a kqueue is a way on how we can listen on many sockets at once and process events
+                we initialize an epoll (linux) or kqueue (macOS) instance and add this server's socket to it
+                both are ways on how we can listen on many sockets at once and process events
             */
             void listen(const std::string &interface, int port);
 
+#if defined(__linux__)
+            bool epoll_add(TCPSocket *socket) {
+                // adds a socket to the epoll, EPOLLRDHUP lets us see the peer hanging up without having to read 0 bytes first
+                epoll_event ev{};
+                ev.events = EPOLLIN | EPOLLRDHUP | (config.edge_triggered ? static_cast<uint32_t>(EPOLLET) : 0u);
+                ev.data.ptr = reinterpret_cast<void *>(socket);
+                return (epoll_ctl(epoll_file_descriptor, EPOLL_CTL_ADD, socket->socket_file_descriptor, &ev) != -1);
+            }
+
+            bool epoll_del(TCPSocket *socket) {
+                // deletes a socket from the epoll
+                return (epoll_ctl(epoll_file_descriptor, EPOLL_CTL_DEL, socket->socket_file_descriptor, nullptr) != -1);
+            }
+
+            bool epoll_watch_write(TCPSocket *socket, bool watch) {
+                // adds (or takes away) EPOLLOUT, so we hear when a socket whose kernel buffer was full can take more
+                epoll_event ev{};
+                ev.events = EPOLLIN | EPOLLRDHUP | (config.edge_triggered ? static_cast<uint32_t>(EPOLLET) : 0u) | (watch ? static_cast<uint32_t>(EPOLLOUT) : 0u);
+                ev.data.ptr = reinterpret_cast<void *>(socket);
+                socket->write_event_armed = watch;
+                return (epoll_ctl(epoll_file_descriptor, EPOLL_CTL_MOD, socket->socket_file_descriptor, &ev) != -1);
+            }
+#else
             bool kqueue_add(TCPSocket *socket) {
                 // adds a socket to the kqueue
                 struct kevent ev;
-                EV_SET(&ev, socket->socket_file_descriptor, EVFILT_READ, EV_ADD | EV_CLEAR, 0, 0, reinterpret_cast<void *>(socket));
+                EV_SET(&ev, socket->socket_file_descriptor, EVFILT_READ, EV_ADD | (config.edge_triggered ? EV_CLEAR : 0), 0, 0, reinterpret_cast<void *>(socket));
                 return (kevent(kqueue_file_descriptor, &ev, 1, nullptr, 0, nullptr) != -1);
             }
 
@@ -99,19 +194,51 @@ namespace Common {
                 return (kevent(kqueue_file_descriptor, &ev, 1, nullptr, 0, nullptr) != -1);
             }
 
+            bool kqueue_watch_write(TCPSocket *socket) {
+                // a one shot EVFILT_WRITE, so we hear (once) when a socket whose kernel buffer was full can take more
+                // note that the kernel removes it by itself after it fires, and closing the socket removes it as well
+                struct kevent ev;
+                EV_SET(&ev, socket->socket_file_descriptor, EVFILT_WRITE, EV_ADD | EV_ONESHOT, 0, 0, reinterpret_cast<void *>(socket));
+                socket->write_event_armed = true;
+                return (kevent(kqueue_file_descriptor, &ev, 1, nullptr, 0, nullptr) != -1);
+            }
+#endif
+
             void del(TCPSocket *socket) {
-                // deletes a socket from the kqueue and removes it from our data structures
+                // deletes a socket from the epoll/kqueue and removes it from our data structures
+#if defined(__linux__)
+                const bool on_io_uring = (socket->io_uring_slot >= 0);
+                if (on_io_uring) {
+                    io_uring->removeSocket(socket);
+                } else {
+                    epoll_del(socket);
+                }
+#else
+                const bool on_io_uring = false;
                 kqueue_del(socket);
+#endif
                 sockets.erase(std::remove(sockets.begin(), sockets.end(), socket), sockets.end());
                 receieve_sockets.erase(std::remove(receieve_sockets.begin(), receieve_sockets.end(), socket), receieve_sockets.end());
                 send_sockets.erase(std::remove(send_sockets.begin(), send_sockets.end(), socket), send_sockets.end());
-                delete socket;
+
+                if (on_io_uring) {
+                    closing_sockets.push_back(socket); // sendAndReceive() deletes it once the kernel lets go of it
+                } else {
+                    delete socket;
+                }
             }
 
             // update all data structures with new state of incoming socket events
             void poll() noexcept; 
 
             // for all read sockets, read all data, if available, trigger callback if any data was read
-            void sendAndReceive() noexcept;
+            // returns whether any data was read, so callers know whether they can idle
+            bool sendAndReceive() noexcept;
+
+            // sends whatever the sockets have gather()ed since the last call, see TCPSocket::gather()
+            void sendGathered() noexcept;
+
+            // asks to be told when sockets that couldn't send everything can take more, instead of retrying them every loop
+            void watchBlockedSends() noexcept;
     };
 }
\ No newline at end of file
@@ -21,8 +21,8 @@ namespace Common {
         struct cmsghdr *cmsg = (struct cmsghdr *) &ctrl;
 
         struct iovec iov;
-        iov.iov_base = receive_buffer + next_receive_valid_index;
-        iov.iov_len = TCPBufferSize - next_receive_valid_index;
+        iov.iov_base = receive_buffer.writePtr();
+        iov.iov_len = receive_buffer.writable();
 
         msghdr msg;
         msg.msg_control = ctrl;
@@ -38,7 +38,7 @@ namespace Common {
         // UPDATE: this timing methods works well on linux and for udp in general, tcp it doesn't work as well, for now, we will just use our user time instead
         const auto n_rcv = recvmsg(socket_file_descriptor, &msg, MSG_DONTWAIT);
         if (n_rcv > 0) {
-            next_receive_valid_index += n_rcv;
+            receive_buffer.commitWrite(n_rcv);
 
             /*
             NOTE: For now, we will use our implementation of user time clocking as it works better for tcp
@@ -56,48 +56,152 @@ namespace Common {
 
             const auto user_time = getCurrentNanos();
 
-            logger.log("%: % %() % read socket: % len:% utime:% \n",
+            LOG_TRACE(logger, "%: % %() % read socket: % len:% utime:% \n",
                 __FILE__, __LINE__, __FUNCTION__,
                 Common::getCurrentTimeStr(&time_str),
-                socket_file_descriptor, next_receive_valid_index, user_time
+                socket_file_descriptor, receive_buffer.readable(), user_time
             );
 
             receive_callback(this, user_time);
         }
 
-        ssize_t n_send = std::min(TCPBufferSize, next_send_valid_index);
-        while (n_send > 0) {
-            auto n_send_this_msg = std::min(static_cast<ssize_t>(next_send_valid_index), n_send);
+        flushSendBuffer();
+
+        return (n_rcv > 0);
+    }
+
+    // sends as much of the send buffer as the kernel takes, and keeps the rest for next time
+    void TCPSocket::flushSendBuffer() noexcept {
+        // our owner tells us (by clearing send_blocked) once the kernel has room again, until then send() would just fail again
+        if (send_blocked && wait_for_write_event) {
+            return;
+        }
+        send_blocked = false;
+
+        size_t n_sent = 0;
+        while (n_sent < next_send_valid_index) {
             const int flags = MSG_DONTWAIT | MSG_NOSIGNAL;
-            auto n = ::send(socket_file_descriptor, send_buffer, n_send_this_msg, flags);
+            auto n = ::send(socket_file_descriptor, send_buffer + n_sent, next_send_valid_index - n_sent, flags);
 
             if (UNLIKELY(n < 0)) {
-                if (!wouldBlock()) {
+                if (wouldBlock()) {
+                    send_blocked = true;
+                } else {
                     send_socket_disconnected = true;
                 }
                 break;
             }
 
-            logger.log("%:% %() % send socket:% len:% \n",
+            LOG_TRACE(logger, "%:% %() % send socket:% len:% \n",
                 __FILE__, __LINE__, __FUNCTION__,
                 Common::getCurrentTimeStr(&time_str), socket_file_descriptor, n
             );
             
-            n_send -= n;
-            ASSERT(n == n_send_this_msg, "Don't support partial send lengths yet.");
+            // the kernel may take only part of what we gave it, in that case we just go again with the rest
+            n_sent += n;
         }
-        next_send_valid_index = 0;
 
-        return (n_rcv > 0);
+        // whatever didn't make it moves to the front, this only happens when the peer is behind, so it's off the fast path
+        if (n_sent) {
+            memmove(send_buffer, send_buffer + n_sent, next_send_valid_index - n_sent);
+            next_send_valid_index -= n_sent;
+            updateSendBackPressure();
+        }
     }
 
     // Writes provided data to send buffer
     void TCPSocket::send(const void *data, size_t length) noexcept {
         if (length > 0) {
+            // anything gathered before this has to go out first, or the peer would get the bytes out of order
+            if (UNLIKELY(num_gathered_parts)) {
+                sendGathered();
+            }
+
+            ASSERT(length <= sendBufferSpace(), "TCP send buffer filled up and sendAndReceive() not called.");
             memcpy(send_buffer + next_send_valid_index, data, length);
             next_send_valid_index += length;
+            updateSendBackPressure();
         }
 
         return;
     }
+
+    // remembers where the data is, it goes out (or gets copied) in sendGathered()
+    void TCPSocket::gather(const void *data, size_t length) noexcept {
+        if (length > 0) {
+            if (UNLIKELY(num_gathered_parts == gathered_parts.size())) {
+                sendGathered();
+            }
+
+            // the same limit as send(), so whatever the kernel doesn't take in sendGathered() always fits in the send buffer
+            ASSERT(length <= sendBufferSpace(), "TCP send buffer filled up and sendAndReceive() not called.");
+            gathered_parts[num_gathered_parts++] = iovec{const_cast<void *>(data), length};
+            gathered_bytes += length;
+        }
+    }
+
+    // sends everything gather()ed with one sendmsg(), whatever the kernel doesn't take is copied into the send buffer
+    void TCPSocket::sendGathered() noexcept {
+        if (!num_gathered_parts) {
+            return;
+        }
+
+        // we can only write straight out of the caller's memory if nothing is queued up ahead of it,
+        // and io_uring sockets always send out of the send buffer, the transport does that for us
+        size_t n_sent = 0;
+        if (!next_send_valid_index && io_uring_slot < 0 && !(send_blocked && wait_for_write_event)) {
+            msghdr msg{};
+            msg.msg_iov = gathered_parts.data();
+            msg.msg_iovlen = num_gathered_parts;
+
+            const auto n = ::sendmsg(socket_file_descriptor, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+            if (LIKELY(n >= 0)) {
+                n_sent = static_cast<size_t>(n);
+                LOG_TRACE(logger, "%:% %() % sendmsg socket:% parts:% len:% \n",
+                    __FILE__, __LINE__, __FUNCTION__,
+                    Common::getCurrentTimeStr(&time_str), socket_file_descriptor, num_gathered_parts, n
+                );
+            } else if (wouldBlock()) {
+                send_blocked = true;
+            } else {
+                send_socket_disconnected = true;
+            }
+        }
+
+        // keep the rest, starting from wherever the kernel stopped (which can be in the middle of a part)
+        for (size_t i = 0; i < num_gathered_parts; ++i) {
+            const iovec &part = gathered_parts[i];
+            if (n_sent >= part.iov_len) {
+                n_sent -= part.iov_len;
+                continue;
+            }
+
+            const size_t remaining = part.iov_len - n_sent;
+            memcpy(send_buffer + next_send_valid_index, static_cast<const char *>(part.iov_base) + n_sent, remaining);
+            next_send_valid_index += remaining;
+            n_sent = 0;
+        }
+
+        num_gathered_parts = 0;
+        gathered_bytes = 0;
+        updateSendBackPressure();
+    }
+
+    // re-checks 'send_backed_up' against the water marks, after anything was added to or sent from the send buffer
+    void TCPSocket::updateSendBackPressure() noexcept {
+        const size_t pending = pendingSendBytes();
+        if (UNLIKELY(!send_backed_up && pending > send_high_water_mark)) {
+            send_backed_up = true;
+            LOG_WARN(logger, "%:% %() % socket:% is backed up, % bytes waiting to be sent \n",
+                __FILE__, __LINE__, __FUNCTION__,
+                Common::getCurrentTimeStr(&time_str), socket_file_descriptor, pending
+            );
+        } else if (UNLIKELY(send_backed_up && pending <= send_low_water_mark)) {
+            send_backed_up = false;
+            LOG_INFO(logger, "%:% %() % socket:% caught up, % bytes waiting to be sent \n",
+                __FILE__, __LINE__, __FUNCTION__,
+                Common::getCurrentTimeStr(&time_str), socket_file_descriptor, pending
+            );
+        }
+    }
 }
\ No newline at end of file
@@ -1,28 +1,61 @@
 #pragma once
 
+#include <array>
 #include <functional>
+#include <sys/uio.h>
 #include "socket_utils.h"
 #include "logger.h"
+#include "mirrored_ring_buffer.h"
 #include <iostream>
 
 namespace Common {
 
-    constexpr size_t TCPBufferSize = 64 * 1024 * 1024;
+    // per socket, each side only has to hold what arrives (or gets queued) between two sendAndReceive() calls
+    // note that only the pages that get touched count towards the process' memory, so these are what a busy session costs
+    constexpr size_t TCPDefaultReceiveBufferSize = 1024 * 1024;
+    constexpr size_t TCPDefaultSendBufferSize = 1024 * 1024;
+
+    // how many pieces gather() can hold before it has to send them, an OMClientResponse is two (sequence number + body)
+    constexpr size_t TCPMaxGatherParts = 128;
 
     struct TCPSocket {
         // socket
         int socket_file_descriptor = -1;
 
         // send and receive buffers
+        // the receive buffer is a mirrored ring, so the receive callback reads every complete message in place at
+        // receive_buffer.readPtr() (even the ones that wrap around its end) and consume()s them, nothing has to be moved to the front
+        // the send buffer holds whatever the kernel hasn't taken yet, in order, starting at send_buffer[0]
+        const size_t send_buffer_size = 0;
         char *send_buffer = nullptr;
         size_t next_send_valid_index = 0;
-        char *receive_buffer = nullptr;
-        size_t next_receive_valid_index = 0;
+        MirroredRingBuffer receive_buffer;
+
+        // pieces of messages that gather() pointed us at, they go out with one sendmsg() in sendGathered() without being copied first
+        std::array<iovec, TCPMaxGatherParts> gathered_parts;
+        size_t num_gathered_parts = 0;
+        size_t gathered_bytes = 0;
+
+        // back pressure, once more than 'send_high_water_mark' bytes are waiting to go out the peer isn't keeping up with us
+        // and we say so (send_backed_up) until it has read enough of them to get us back under 'send_low_water_mark'
+        // note that the socket only keeps track, it's up to its owner what to do about it (a TCPServer stops reading from it)
+        size_t send_high_water_mark = 0;
+        size_t send_low_water_mark = 0;
+        bool send_backed_up = false;
+
+        // the kernel's buffer for this socket is full, we stop calling send() until it has room again
+        // only a socket whose owner watches for that (EPOLLOUT / EVFILT_WRITE) waits, a standalone socket just tries again next time
+        bool send_blocked = false;
+        bool wait_for_write_event = false;
+        bool write_event_armed = false;
 
         // status bools
         bool send_socket_disconnected = false;
         bool receive_socket_disconnected = false;
 
+        // slot in the owning IOUringTransport, -1 means this socket is on the regular recvmsg()/send() path
+        int io_uring_slot = -1;
+
         struct sockaddr_in inInAddr;
 
         // This is called a 'callback' in which we can store a function that matches the given template
@@ -33,15 +66,17 @@ namespace Common {
         std::string time_str;
         Logger &logger;
         void defaultCallback(TCPSocket *socket, Nanos rx_time) noexcept {
-            logger.log("% % %() % TCPSocket::defaultCallback() socket:% len:% rx:% \n",
+            LOG_TRACE(logger, "% % %() % TCPSocket::defaultCallback() socket:% len:% rx:% \n",
                 __FILE__, __LINE__, __FUNCTION__,
-                Common::getCurrentTimeStr(&time_str), socket->socket_file_descriptor, socket->next_receive_valid_index, rx_time
+                Common::getCurrentTimeStr(&time_str), socket->socket_file_descriptor, socket->receive_buffer.readable(), rx_time
             );
         }
 
-        explicit TCPSocket(Logger &logger_obj): logger(logger_obj) {
-            send_buffer = new char[TCPBufferSize];
-            receive_buffer = new char[TCPBufferSize];
+        explicit TCPSocket(Logger &logger_obj, size_t receive_buffer_size = TCPDefaultReceiveBufferSize,
+                           size_t send_buffer_size_param = TCPDefaultSendBufferSize
+                           ): send_buffer_size(send_buffer_size_param), receive_buffer(receive_buffer_size), logger(logger_obj) {
+            send_buffer = new char[send_buffer_size];
+            setSendWaterMarks(send_buffer_size / 4, send_buffer_size * 3 / 4);
             receive_callback = [this](auto socket, auto rx_time) {
                 defaultCallback(socket, rx_time);
             };
@@ -56,8 +91,6 @@ namespace Common {
 
             delete[] send_buffer;
             send_buffer = nullptr;
-            delete[] receive_buffer;
-            receive_buffer = nullptr;
         }
 
         TCPSocket() = delete;
@@ -77,6 +110,38 @@ namespace Common {
 
         // Writes provided data to send buffer
         void send(const void *data, size_t length) noexcept;
+
+        // like send(), but only remembers where 'data' is, it has to stay valid (and unchanged) until sendGathered() is called
+        // lets a caller hand us a header and a body that live in different places without copying either of them
+        void gather(const void *data, size_t length) noexcept;
+
+        // sends everything gather()ed with one sendmsg(), whatever the kernel doesn't take is copied into the send buffer
+        // note that if there are bytes in the send buffer already, the gathered ones have to queue up behind them
+        void sendGathered() noexcept;
+
+        // sends as much of the send buffer as the kernel takes, and keeps the rest for next time
+        void flushSendBuffer() noexcept;
+
+        // bytes that are waiting to be sent, buffered or gathered
+        size_t pendingSendBytes() const noexcept {
+            return next_send_valid_index + gathered_bytes;
+        }
+
+        // how many more bytes send() (or gather()) can take before the next sendAndReceive()
+        size_t sendBufferSpace() const noexcept {
+            return send_buffer_size - pendingSendBytes();
+        }
+
+        void setSendWaterMarks(size_t low_water_mark, size_t high_water_mark) noexcept {
+            ASSERT(low_water_mark <= high_water_mark && high_water_mark <= send_buffer_size,
+                "TCP send water marks have to be low <= high <= the send buffer size. low:" + std::to_string(low_water_mark) +
+                " high:" + std::to_string(high_water_mark) + " buffer:" + std::to_string(send_buffer_size));
+            send_low_water_mark = low_water_mark;
+            send_high_water_mark = high_water_mark;
+        }
+
+        // re-checks 'send_backed_up' against the water marks, after anything was added to or sent from the send buffer
+        void updateSendBackPressure() noexcept;
     };
 
 }
\ No newline at end of file
@@ -0,0 +1,74 @@
+#include "../broadcast_queue.h"
+#include "../thread_utils.h"
+#include "../time_utils.h"
+
+using namespace Common;
+
+struct DummyType {
+    int data[3];
+};
+
+// small queue on purpose, so the producer keeps getting gated by the slowest reader
+constexpr size_t QUEUE_SIZE = 1024;
+constexpr size_t NUM_CONSUMERS = 3;
+constexpr int NUM_ELEMENTS_TO_WRITE = 250 * 1000;
+
+// every 'read' thread should see every element the main thread writes, in order
+void readThreadTask(BroadcastQueue<DummyType>* queue, size_t consumer, std::atomic<bool>* start) {
+    while (!*start) {}
+
+    int i = 0;
+    while (i < NUM_ELEMENTS_TO_WRITE) {
+        const DummyType* read_objs = nullptr;
+        const size_t n = queue->peekReads(consumer, 16, &read_objs);
+        for (size_t j = 0; j < n; ++j, ++i) {
+            if (UNLIKELY(read_objs[j].data[0] != i || read_objs[j].data[1] != i * 10 || read_objs[j].data[2] != i * 100)) {
+                FATAL("Consumer " + std::to_string(consumer) + " read an object out of order! expected: " + std::to_string(i) +
+                    " got: " + std::to_string(read_objs[j].data[0]));
+            }
+        }
+        if (n) {
+            queue->releaseReads(consumer, n);
+        }
+    }
+
+    ASSERT(queue->size(consumer) == 0 && queue->readCount(consumer) == static_cast<size_t>(NUM_ELEMENTS_TO_WRITE),
+        "Consumer " + std::to_string(consumer) + " should have read everything");
+}
+
+int main() {
+    /*
+        Our test's structure will look like the following:
+            1. Create a test queue object of DummyType data with a few consumers
+            2. Start a thread per consumer, while main writes to the queue
+            3. Each consumer checks it got every single element in order, without anyone copying them to it
+            4. Print how long it took per element
+    */
+    auto test_queue = new BroadcastQueue<DummyType>(QUEUE_SIZE, NUM_CONSUMERS);
+    std::atomic<bool> start = false;
+
+    std::vector<std::thread *> read_threads;
+    for (size_t consumer = 0; consumer < NUM_CONSUMERS; ++consumer) {
+        read_threads.push_back(createAndStartThread(-1, "read thread " + std::to_string(consumer), readThreadTask, test_queue, consumer, &start));
+    }
+
+    const uint64_t start_ticks = rdtsc();
+    start = true;
+    for (int i = 0; i < NUM_ELEMENTS_TO_WRITE; ++i) {
+        *(test_queue->getNextWriteTo()) = DummyType{{i, i * 10, i * 100}};
+        test_queue->updateWriteIndex();
+    }
+
+    for (auto read_thread : read_threads) {
+        read_thread->join();
+        delete read_thread;
+    }
+    const uint64_t end_ticks = rdtscp();
+
+    std::cout << NUM_CONSUMERS << " consumers: " << static_cast<double>(tsc_clock.ticksToNanos(end_ticks - start_ticks)) / NUM_ELEMENTS_TO_WRITE
+              << " ns/element" << std::endl;
+    std::cout << "Main exiting!" << std::endl;
+
+    delete test_queue;
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <array>
+
+#include "../huge_page_arena.h"
+#include "../memory_pool.h"
+#include "../lock_free_queue.h"
+#include "../performance_utils.h"
+
+using namespace Common;
+
+struct ExampleType {
+    int data[2];
+};
+
+// something big with a destructor, like an order book
+struct BigType {
+    std::array<ExampleType *, 1024 * 1024> lookup;
+    bool *destroyed = nullptr;
+
+    explicit BigType(bool *destroyed_param): destroyed(destroyed_param) {}
+    ~BigType() {
+        *destroyed = true;
+    }
+};
+
+// true if [ptr, ptr + bytes) is somewhere inside the arena's memory
+bool inArena(const HugePageArena &arena, const void *first_allocation, const void *ptr, size_t bytes) {
+    const char *start = static_cast<const char *>(first_allocation);
+    const char *p = static_cast<const char *>(ptr);
+    return p >= start && p + bytes <= start + arena.capacity();
+}
+
+int main() {
+    /*
+        Our test's structure will look like the following:
+            1. Reserve an arena, asking for huge pages and prefaulting, and print which kind of pages we actually got
+               (run 'echo 64 | sudo tee /proc/sys/vm/nr_hugepages' first to see EXPLICIT_HUGE on linux)
+            2. Put a MemPool, an LFQUEUE, and a big object (through arenaNew()) in it, and check they all landed in the arena
+            3. Check that allocations are aligned, and that the mempool and queue still work out of arena memory
+            4. Time touching every element of a mempool on the regular heap vs in the arena
+    */
+    const ArenaConfig config{.use_huge_pages = true, .prefault = true, .lock = false};
+    HugePageArena arena(64 * 1024 * 1024, config);
+    std::cout << arena.toString() << std::endl;
+
+    const void *first_allocation = arena.allocate(1, 1);
+
+    const size_t num_elements = 1024 * 1024;
+    MemPool<ExampleType> arena_pool(num_elements, &arena);
+    LFQUEUE<ExampleType> arena_queue(1024, &arena);
+
+    bool destroyed = false;
+    BigType *big = arenaNew<BigType>(&arena, &destroyed);
+    ASSERT(inArena(arena, first_allocation, big, sizeof(BigType)), "arenaNew() should allocate from the arena");
+    ASSERT(reinterpret_cast<uintptr_t>(big) % alignof(BigType) == 0, "arenaNew() should respect alignment");
+    ASSERT(big->lookup[12345] == nullptr, "arena memory should start out zeroed");
+    arenaDelete(&arena, big);
+    ASSERT(destroyed, "arenaDelete() should run the destructor");
+
+    ExampleType *obj = arena_pool.allocate(ExampleType{{1, 2}});
+    ASSERT(inArena(arena, first_allocation, obj, sizeof(ExampleType)), "MemPool blocks should be in the arena");
+    ASSERT(obj->data[0] == 1 && obj->data[1] == 2, "MemPool should still work out of the arena");
+    arena_pool.deallocate(obj);
+
+    *arena_queue.getNextWriteTo() = ExampleType{{3, 4}};
+    arena_queue.updateWriteIndex();
+    const ExampleType *read_obj = arena_queue.getNextRead();
+    ASSERT(inArena(arena, first_allocation, read_obj, sizeof(ExampleType)), "LFQUEUE elements should be in the arena");
+    ASSERT(read_obj->data[0] == 3 && read_obj->data[1] == 4, "LFQUEUE should still work out of the arena");
+    arena_queue.updateReadIndex();
+
+    std::cout << "used " << arena.bytesUsed() << " of " << arena.capacity() << " bytes" << std::endl;
+
+    // random walk over every block, which is where 4K pages hurt the most (TLB misses)
+    MemPool<ExampleType> heap_pool(num_elements);
+    for (auto pool : {&heap_pool, &arena_pool}) {
+        std::vector<ExampleType *> blocks(num_elements);
+        for (size_t i = 0; i < num_elements; ++i) {
+            blocks[i] = pool->allocate(ExampleType{{static_cast<int>(i), 0}});
+        }
+
+        size_t index = 0;
+        const uint64_t start_ticks = rdtsc();
+        for (size_t i = 0; i < num_elements; ++i) {
+            index = (index * 1103515245 + 12345) & (num_elements - 1);
+            ++blocks[index]->data[1];
+        }
+        const uint64_t end_ticks = rdtscp();
+
+        std::cout << (pool == &heap_pool ? "heap" : "arena") << " random access: "
+                  << static_cast<double>(tsc_clock.ticksToNanos(end_ticks - start_ticks)) / num_elements << " ns/access" << std::endl;
+    }
+
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,99 @@
+#include <sys/resource.h>
+
+#include "../idle_strategy.h"
+#include "../lock_free_queue.h"
+#include "../thread_utils.h"
+#include "../time_utils.h"
+
+using namespace Common;
+
+constexpr int NUM_MESSAGES = 200;
+constexpr auto GAP_BETWEEN_MESSAGES = std::chrono::milliseconds(2);
+
+// cpu time (user + system) the calling thread has used so far
+inline double threadCpuMillis() {
+    rusage usage;
+#if defined(__linux__)
+    getrusage(RUSAGE_THREAD, &usage);
+#else
+    getrusage(RUSAGE_SELF, &usage);
+#endif
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+}
+
+/*
+    a producer writes one message every GAP_BETWEEN_MESSAGES, the consumer idles in 'mode' in between,
+    we print how long a message waited in the queue and how much cpu the consumer burned while waiting
+*/
+void runMode(IdleMode mode) {
+    LFQUEUE<Nanos> queue(1024);
+    ParkingSignal parking_signal;
+    queue.setConsumerSignal(&parking_signal);
+
+    std::vector<Nanos> waits;
+    double consumer_cpu_ms = 0;
+
+    auto consumer = createAndStartThread(-1, "idle_consumer_" + idleModeToString(mode), [&]() {
+        IdleStrategy idle_strategy(mode, &parking_signal);
+        ASSERT(idle_strategy.idleMode() == mode, "the mode shouldn't change when we pass a signal");
+
+        const double cpu_start = threadCpuMillis();
+        while (waits.size() < NUM_MESSAGES) {
+            const Nanos *sent_at = queue.getNextRead();
+            if (sent_at) {
+                waits.push_back(getCurrentNanos() - *sent_at);
+                queue.updateReadIndex();
+                idle_strategy.reset();
+            } else {
+                idle_strategy.idle([&queue]() { return queue.size() > 0; });
+            }
+        }
+        consumer_cpu_ms = threadCpuMillis() - cpu_start;
+    });
+
+    for (int i = 0; i < NUM_MESSAGES; ++i) {
+        std::this_thread::sleep_for(GAP_BETWEEN_MESSAGES);
+        *queue.getNextWriteTo() = getCurrentNanos();
+        queue.updateWriteIndex(); // <- wakes the consumer up if it is parked
+    }
+    consumer->join();
+    delete consumer;
+
+    std::sort(waits.begin(), waits.end());
+    std::cout << idleModeToString(mode) << ": queue wait p50 " << waits[waits.size() / 2] << "ns p99 " << waits[waits.size() * 99 / 100]
+              << "ns, consumer cpu " << consumer_cpu_ms << "ms over ~" << NUM_MESSAGES * GAP_BETWEEN_MESSAGES.count() << "ms" << std::endl;
+}
+
+int main() {
+    /*
+        Our test's structure will look like the following:
+            1. Check the modes round trip through their names and PARK without a signal falls back to BACKOFF
+            2. Check a park times out on its own, and that it doesn't sleep at all when there is already work
+            3. Run a slow producer against a consumer in every mode, a parked consumer should be nearly free and still wake up quickly
+    */
+    for (const IdleMode mode : {IdleMode::BUSY_SPIN, IdleMode::SPIN_YIELD, IdleMode::BACKOFF, IdleMode::PARK}) {
+        IdleMode parsed = IdleMode::BUSY_SPIN;
+        ASSERT(idleModeFromString(idleModeToString(mode), &parsed) && parsed == mode, "mode didn't round trip: " + idleModeToString(mode));
+    }
+    IdleMode parsed = IdleMode::BUSY_SPIN;
+    ASSERT(!idleModeFromString("sleepy", &parsed), "unknown modes should be rejected");
+    ASSERT(IdleStrategy(IdleMode::PARK).idleMode() == IdleMode::BACKOFF, "PARK without a signal should fall back to BACKOFF");
+
+    {
+        ParkingSignal parking_signal;
+        auto start = std::chrono::steady_clock::now();
+        parking_signal.park([]() { return false; }, std::chrono::milliseconds(5));
+        const auto parked_for = std::chrono::steady_clock::now() - start;
+        ASSERT(parked_for >= std::chrono::milliseconds(4), "the park should have lasted until its timeout");
+
+        start = std::chrono::steady_clock::now();
+        parking_signal.park([]() { return true; }, std::chrono::seconds(5));
+        ASSERT(std::chrono::steady_clock::now() - start < std::chrono::seconds(1), "we shouldn't park when there is work");
+    }
+
+    for (const IdleMode mode : {IdleMode::BUSY_SPIN, IdleMode::SPIN_YIELD, IdleMode::BACKOFF, IdleMode::PARK}) {
+        runMode(mode);
+    }
+
+    return 0;
+}
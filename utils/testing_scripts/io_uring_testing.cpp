@@ -0,0 +1,157 @@
+#include "../logger.h"
+#include "../tcp_server.h"
+#include "../time_utils.h"
+#include <iostream>
+
+// same echo test as server_testing.cpp, but the server drives its client sockets through io_uring (linux only)
+int main() {
+    using namespace Common;
+
+    // create logger and helpers for timing and tracking data flow
+    std::string time_str;
+    Logger logger("io_uring_testing.log");
+
+    auto tcpServerRecvCallback = [&](TCPSocket *socket, Nanos rx_time) noexcept {
+        logger.log("TCPServer::tcpServerRecvCallback() socket:% len:% rx:% \n",
+            socket->socket_file_descriptor, socket->receive_buffer.readable(), rx_time
+        );
+
+        const std::string reply = "TCPServer received msg: " + std::string(socket->receive_buffer.readPtr(), socket->receive_buffer.readable());
+        socket->receive_buffer.clear();
+        socket->send(reply.data(), reply.length());
+    };
+
+    auto tcpServerRecvFinishedCallback = [&]() noexcept {
+        logger.log("TCPServer::tcpServerRecvFinishedCallback() \n");
+    };
+
+    auto tcpClientRecvCallback = [&](TCPSocket *socket, Nanos rx_time) noexcept {
+        const std::string recv_msg = std::string(socket->receive_buffer.readPtr(), socket->receive_buffer.readable());
+        socket->receive_buffer.clear();
+
+        std::cout << "socket:" << socket->socket_file_descriptor << " got: " << recv_msg << std::endl;
+        logger.log("TCPServer::tcpClientRecvCallback() socket:% len:% rx:% msg:% \n",
+            socket->socket_file_descriptor, socket->receive_buffer.readable(), rx_time, recv_msg
+        );
+    };
+
+
+    // create, initialize, and connect the clients
+    const std::string interface = "lo";
+    const std::string ip = "127.0.0.1";
+    const int port = 12345;
+
+    TCPServerConfig config;
+    config.use_io_uring = true;
+
+    logger.log("creating io_uring TCPServer on interface:% port:% \n", interface, port);
+    TCPServer server(logger, config);
+    server.receive_callback = tcpServerRecvCallback;
+    server.receive_finished_callback = tcpServerRecvFinishedCallback;
+    server.listen(interface, port);
+    std::cout << "io_uring enabled: " << (server.io_uring != nullptr) << std::endl;
+
+    // --
+
+    std::vector<TCPSocket *> clients(3);
+
+    for (size_t i = 0; i < clients.size(); ++i) {
+        clients[i] = new TCPSocket(logger);
+        clients[i]->receive_callback = tcpClientRecvCallback;
+
+        logger.log("Connecting TCPClient - [%] on ip:% interface:% port:% \n", i, ip, interface, port);
+        clients[i]->connect(ip, interface, port, false);
+        server.poll();
+    }
+
+    using namespace std::literals::chrono_literals;
+
+    for (auto iter = 0; iter < 5; ++iter) {
+        for (size_t i = 0; i < clients.size(); ++i) {
+            const std::string client_msg = "Client-[" + std::to_string(i) + "] : Sending " + std::to_string(iter * 100 + i);
+            logger.log("Sending TCPClient-[%] % \n", i, client_msg);
+            clients[i]->send(client_msg.data(), client_msg.length());
+            clients[i]->sendAndReceive();
+
+            std::this_thread::sleep_for(100ms);
+            server.poll();
+            server.sendAndReceive(); // <- reads the message, echoes it back through a fixed buffer send
+
+            std::this_thread::sleep_for(100ms);
+            server.sendAndReceive(); // <- reaps the send completion
+            clients[i]->sendAndReceive();
+        }
+    }
+
+    // hang up one client and make sure the server notices through the completion queue
+    delete clients[0];
+    std::this_thread::sleep_for(100ms);
+    server.sendAndReceive();
+    server.poll();
+    std::cout << "server sockets after hang up: " << server.sockets.size() << std::endl;
+
+    // the kernel may still have been busy with that socket, so it is only freed once its last completion comes in
+    for (int i = 0; i < 100 && !server.closing_sockets.empty(); ++i) {
+        std::this_thread::sleep_for(1ms);
+        server.sendAndReceive();
+    }
+    ASSERT(server.closing_sockets.empty(), "the hung up socket should have been released");
+
+    // --
+
+    // a server with a receive buffer of just one provided buffer, whose callback doesn't consume anything for a while
+    // and after that only ever consumes whole 1000 byte messages, so most provided buffers only fit in part
+    // everything the client sends has to come out the other end whole and in order, nothing may be dropped while the buffer is full
+    TCPServerConfig slow_config;
+    slow_config.use_io_uring = true;
+    slow_config.socket_receive_buffer_size = IOUringRecvBufferSize;
+
+    constexpr size_t MESSAGE_SIZE = 1000;
+    bool consume = false;
+    size_t total_received = 0;
+    auto consumeMessages = [&](TCPSocket *socket) {
+        const size_t n = socket->receive_buffer.readable() / MESSAGE_SIZE * MESSAGE_SIZE;
+        for (size_t i = 0; i < n; ++i, ++total_received) {
+            ASSERT(socket->receive_buffer.readPtr()[i] == static_cast<char>(total_received % 251), "byte " + std::to_string(total_received) + " is wrong");
+        }
+        socket->receive_buffer.consume(n);
+    };
+
+    TCPServer slow_server(logger, slow_config);
+    slow_server.receive_callback = [&](TCPSocket *socket, Nanos) noexcept {
+        if (consume) {
+            consumeMessages(socket);
+        }
+    };
+    slow_server.receive_finished_callback = []() noexcept {};
+    slow_server.listen(interface, port + 1);
+
+    TCPSocket slow_client(logger);
+    slow_client.connect(ip, interface, port + 1, false);
+    slow_server.poll();
+
+    std::vector<char> payload(256 * MESSAGE_SIZE);
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<char>(i % 251);
+    }
+    slow_client.send(payload.data(), payload.size());
+    for (int i = 0; i < 100; ++i) {
+        slow_client.sendAndReceive();
+        slow_server.sendAndReceive();
+        std::this_thread::sleep_for(1ms);
+    }
+    std::cout << "bytes waiting in the full receive buffer: " << slow_server.sockets[0]->receive_buffer.readable() << std::endl;
+
+    // the application catches up outside of the callback, from here on the held bytes come in as fast as it consumes them
+    consume = true;
+    consumeMessages(slow_server.sockets[0]);
+    const Nanos start = getCurrentNanos();
+    while (total_received < payload.size()) {
+        slow_client.sendAndReceive();
+        slow_server.sendAndReceive();
+        ASSERT(getCurrentNanos() - start < 5 * NANOS_TO_SECONDS, "timed out, got " + std::to_string(total_received) + " bytes");
+    }
+    std::cout << "slow consumer got all " << total_received << " bytes in order" << std::endl;
+
+    return 0;
+};
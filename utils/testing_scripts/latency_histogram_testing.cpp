@@ -0,0 +1,83 @@
+#include <cmath>
+#include <vector>
+
+#include "../latency_histogram.h"
+
+using namespace Common;
+
+int main() {
+    /*
+        Our test's structure will look like the following:
+            1. Check that every value lands in a bucket whose highest value is within ~3% of it
+            2. Record 1..100000 into a histogram and check the percentiles come back within that precision
+            3. Measure the same tag from a few threads, and check the reporter merges them into one line
+            4. Time how long a START_MEASURE()/END_MEASURE() pair costs
+    */
+    for (uint64_t value = 0; value < (1ULL << 30); value = value * 5 / 4 + 1) {
+        const uint64_t highest = LatencyHistogram::bucketHighestValue(LatencyHistogram::bucketIndex(value));
+        ASSERT(highest >= value && static_cast<double>(highest - value) <= static_cast<double>(value) / 32.0,
+               "bucket for " + std::to_string(value) + " tops out at " + std::to_string(highest));
+    }
+    ASSERT(LatencyHistogram::bucketIndex(~0ULL) == LatencyHistogram::NUM_BUCKETS - 1, "huge values should land in the last bucket");
+
+    {
+        LatencyHistogram histogram;
+        constexpr uint64_t num_values = 100 * 1000;
+        for (uint64_t value = 1; value <= num_values; ++value) {
+            histogram.record(value);
+        }
+
+        std::vector<uint64_t> counts(LatencyHistogram::NUM_BUCKETS, 0);
+        ASSERT(histogram.addTo(&counts) == num_values, "max should be exact");
+        for (const double percentile : {50.0, 99.0, 99.9}) {
+            const double expected = percentile / 100.0 * num_values;
+            const double value = static_cast<double>(LatencyHistogram::valueAtPercentile(counts, num_values, percentile));
+            std::cout << "p" << percentile << ": " << value << " (expected ~" << expected << ")" << std::endl;
+            ASSERT(std::abs(value - expected) <= expected / 32.0, "percentile is off by more than a bucket");
+        }
+    }
+
+    {
+        LatencyReporter reporter("", std::chrono::seconds(60)); // stdout, and only the final report from the destructor
+
+        constexpr int num_threads = 3;
+        std::vector<std::thread *> threads;
+        for (int t = 0; t < num_threads; ++t) {
+            threads.push_back(createAndStartThread(-1, "measuring thread " + std::to_string(t), []() {
+                for (int i = 0; i < 1000; ++i) {
+                    START_MEASURE(Testing_threaded_measurement);
+                    END_MEASURE(Testing_threaded_measurement);
+                }
+            }));
+        }
+        for (auto thread : threads) {
+            thread->join();
+            delete thread;
+        }
+
+        const std::string report = reporter.report();
+        ASSERT(report.find("Testing_threaded_measurement count:3000 new:3000") != std::string::npos &&
+               report.find("threads:3") != std::string::npos, "the three threads' histograms should be merged:\n" + report);
+    }
+
+    // back to back measurements, so this is the cost of the macros themselves
+    constexpr int num_measurements = 10 * 1000 * 1000;
+    const uint64_t start_ticks = rdtsc();
+    for (int i = 0; i < num_measurements; ++i) {
+        START_MEASURE(Testing_empty_measurement);
+        END_MEASURE(Testing_empty_measurement);
+    }
+    const uint64_t end_ticks = rdtscp();
+    std::cout << "START_MEASURE()/END_MEASURE(): " << static_cast<double>(tsc_clock.ticksToNanos(end_ticks - start_ticks)) / num_measurements << " ns" << std::endl;
+
+    // note that most of the above is rdtsc()/rdtscp() themselves (a lot more on a VM), this is just what we add on top
+    LatencyHistogram histogram;
+    const uint64_t record_start_ticks = rdtsc();
+    for (int i = 0; i < num_measurements; ++i) {
+        histogram.record(static_cast<uint64_t>(i) & 4095);
+    }
+    const uint64_t record_end_ticks = rdtscp();
+    std::cout << "record(): " << static_cast<double>(tsc_clock.ticksToNanos(record_end_ticks - record_start_ticks)) / num_measurements << " ns" << std::endl;
+
+    return 0;
+}
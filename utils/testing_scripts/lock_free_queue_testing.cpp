@@ -1,5 +1,6 @@
 #include "../lock_free_queue.h"
 #include "../thread_utils.h"
+#include "../time_utils.h"
 
 using namespace Common;
 
@@ -7,61 +8,104 @@ struct DummyType {
     int data[3];
 };
 
+// the queue is big enough to hold every element, so the benchmark measures the queue itself and not back-pressure
+constexpr size_t QUEUE_SIZE = 16 * 1024 * 1024;
+constexpr int NUM_ELEMENTS_TO_WRITE = 10 * 1000 * 1000;
+constexpr size_t BATCH_SIZE = 16;
+
+// makes sure nothing got lost or reordered on the way
+inline void checkElement(const DummyType* read_obj, int i) {
+    if (UNLIKELY(read_obj->data[0] != i || read_obj->data[1] != i * 10 || read_obj->data[2] != i * 100)) {
+        FATAL("Read thread read an object out of order! expected: " + std::to_string(i) + " got: " + std::to_string(read_obj->data[0]));
+    }
+}
+
 // this will be the function that we want the 'read' thread to execute
-void readThreadTask(LFQUEUE<DummyType>* queue) {
-    // wait for the queue to populate
-    using namespace std::chrono_literals;
-    std::this_thread::sleep_for(5s);
-
-    // begin to read at the same rate at which the queue is being populated -> every 1 second
-    std::cout << "queue_size: " << queue->size() << std::endl;
-    while (queue->size()) {
-        const DummyType* read_obj = queue->getNextRead();
-        std::cout << "The read thread is reading an object! " 
-        << read_obj->data[0] << ", " << read_obj->data[1] << ", " << read_obj->data[2] 
-        << std::endl;
-        queue->updateReadIndex();
-
-        std::this_thread::sleep_for(1s);
+void readThreadTask(LFQUEUE<DummyType>* queue, bool batched, std::atomic<bool>* start, uint64_t* end_ticks) {
+    while (!*start) {}
+
+    // read everything the main thread writes, in order
+    int i = 0;
+    while (i < NUM_ELEMENTS_TO_WRITE) {
+        if (batched) {
+            // take whatever is ready (up to BATCH_SIZE) and hand it all back with one store
+            const DummyType* read_objs = nullptr;
+            const size_t n = queue->peekReads(BATCH_SIZE, &read_objs);
+            for (size_t j = 0; j < n; ++j, ++i) {
+                checkElement(&read_objs[j], i);
+            }
+            if (n) {
+                queue->releaseReads(n);
+            }
+        } else {
+            const DummyType* read_obj = queue->getNextRead();
+            if (read_obj) {
+                checkElement(read_obj, i++);
+                queue->updateReadIndex();
+            }
+        }
     }
+    *end_ticks = rdtscp();
 
-    std::cout << "read thread exiting" << std::endl;
+    ASSERT(queue->size() == 0, "Queue should be empty after reading everything");
 }
 
-int main() {
-    /*
-        Our test's structure will look like the following:
-            1. Create a test queue object of DummyType data
-            2. Start a thread that will read from the queue, while main writes to the queue
-            3. Join the read thread to main before exiting to ensure that the read terminates without 
-                throwing an ASSERT, indicating that read had an issue, particulary with concurrency
-
-        NOTE: We want to make sure that the read thread sleeps for 5 seconds to allow the write thread to populate the queue
-    */
-    const int NUM_ELEMENTS_TO_WRITE = 50;
-    LFQUEUE<DummyType> test_queue(20);
+void runBenchmark(bool batched) {
+    auto test_queue = new LFQUEUE<DummyType>(QUEUE_SIZE);
+    std::atomic<bool> start = false;
+    uint64_t end_ticks = 0;
 
     // start the read task
-    auto read_thread = createAndStartThread(-1, "read thread", readThreadTask, &test_queue);
+    auto read_thread = createAndStartThread(-1, "read thread", readThreadTask, test_queue, batched, &start, &end_ticks);
 
     // start populating the queue, so the read thread can read it
-    for (int i = 0; i < NUM_ELEMENTS_TO_WRITE; ++i) {
-        const DummyType write_obj({i, i * 10, i * 100});
-        *(test_queue.getNextWriteTo()) = write_obj; // Note that nothing is on the heap, so when the memory under the pointer is overwritten, the stack is deallocated
-
-        std::cout << "Main created a write object: " 
-        << write_obj.data[0] << ", " << write_obj.data[1] << ", " << write_obj.data[2] 
-        << std::endl;
-        test_queue.updateWriteIndex();
-
-        using namespace std::chrono_literals;
-        std::this_thread::sleep_for(1s);
+    const uint64_t start_ticks = rdtsc();
+    start = true;
+    int i = 0;
+    while (i < NUM_ELEMENTS_TO_WRITE) {
+        if (batched) {
+            // reserve a span of slots, fill them, and publish them all with one store
+            DummyType* write_objs = nullptr;
+            const size_t n = test_queue->reserveWrites(std::min(BATCH_SIZE, static_cast<size_t>(NUM_ELEMENTS_TO_WRITE - i)), &write_objs);
+            for (size_t j = 0; j < n; ++j, ++i) {
+                write_objs[j] = DummyType{{i, i * 10, i * 100}};
+            }
+            test_queue->commitWrites(n);
+        } else {
+            *(test_queue->getNextWriteTo()) = DummyType{{i, i * 10, i * 100}};
+            test_queue->updateWriteIndex();
+            ++i;
+        }
     }
+    const uint64_t write_end_ticks = rdtscp();
 
     // Make sure the read completes before returning
     read_thread->join();
+    delete read_thread;
+
+    std::cout << (batched ? "batched" : "one at a time") << std::endl;
+    std::cout << "  writes: " << static_cast<double>(tsc_clock.ticksToNanos(write_end_ticks - start_ticks)) / NUM_ELEMENTS_TO_WRITE << " ns/element" << std::endl;
+    std::cout << "  end to end: " << static_cast<double>(tsc_clock.ticksToNanos(end_ticks - start_ticks)) / NUM_ELEMENTS_TO_WRITE << " ns/element" << std::endl;
+
+    delete test_queue;
+}
+
+int main() {
+    /*
+        Our test's structure will look like the following:
+            1. Create a test queue object of DummyType data
+            2. Start a thread that will read from the queue, while main writes to the queue as fast as it can
+            3. Join the read thread to main before exiting to ensure that the read terminates without 
+                throwing a FATAL, indicating that read had an issue, particulary with concurrency
+            4. Print how long it took per element, from the first write to the last read
+            5. Do it all again, but moving elements in batches with reserveWrites()/commitWrites() and peekReads()/releaseReads()
+
+        NOTE: both threads spin, so pin them to different (isolated) cores for meaningful numbers
+    */
+    runBenchmark(false);
+    runBenchmark(true);
 
     std::cout << "Main exiting!" << std::endl;
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,8 +1,14 @@
-#include "../logger.h"
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
 
-int main() {
-    using namespace Common;
+#include "../logger.h"
+#include "../log_decoder.h"
+#include "../../exchange/market_publisher/market_update.h" // note that this one needs the repo's root on the include path (-I../..)
 
+// logs the same lines to whichever logger it is given
+void logSampleData(Common::Logger &logger) {
     // sample data we want to log
 
     char c = 'a';
@@ -13,10 +19,6 @@ int main() {
     const char* c_string = "testing c-style strings";
     std::string cpp_string = "testing cpp-style strings";
 
-    // create a logger on the stack
-    // note that if we allocated heap memory here, then, any member variables would also be allocated on the heap...
-    Logger logger("logging_example.log");
-
     // try logging small arithmetic types
     logger.log("Logging a char: %, an int: %, and a ul: % \n", c, i, ul);
 
@@ -27,5 +29,111 @@ int main() {
     logger.log("trying to log a c-style string: % \n", c_string);
     logger.log("trying to log a cpp-style string: % \n", cpp_string);
 
+    // escaping and plain strings
+    logger.log("100%% of the variables: %%% \n", i);
+    logger.log("a plain string \n");
+
+    // protocol structs get copied as they are and formatted with their toString() on the logger thread
+    const Exchange::MEMarketUpdate market_update{Exchange::MarketUpdateType::ADD, 7, 1, Side::BUY, 100, 50, 2};
+    const Exchange::MDPMarketUpdate mdp_market_update{42, market_update};
+    logger.log("market update: % sent as: % \n", market_update, mdp_market_update);
+}
+
+std::string readFile(const std::string &file_name) {
+    std::ifstream file(file_name, std::ios::in | std::ios::binary);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+int main() {
+    using namespace Common;
+
+    /*
+        Our test's structure will look like the following:
+            1. Log the same lines with a TEXT logger and a BINARY logger
+            2. Decode the binary file (like tools/log_decoder does) and check it matches the text file exactly
+            3. Have several threads log at once through one LogService and check every line lands in its own thread's file
+            4. Check that leveled log calls below LOG_MIN_LEVEL don't even evaluate their arguments (try building with -DLOG_MIN_LEVEL=2)
+            5. Time how long log() takes on the calling thread for a typical line
+    */
+    {
+        // create loggers on the stack
+        // note that if we allocated heap memory here, then, any member variables would also be allocated on the heap...
+        Logger text_logger("logging_example.log");
+        Logger binary_logger("logging_example.bin", LogMode::BINARY);
+
+        logSampleData(text_logger);
+        logSampleData(binary_logger);
+    } // <- the destructors make sure everything is written out
+
+    std::ifstream binary_file("logging_example.bin", std::ios::in | std::ios::binary);
+    std::stringstream decoded;
+    std::string error;
+    ASSERT(decodeLogFile(binary_file, decoded, false, &error), "could not decode the binary log: " + error);
+    ASSERT(decoded.str() == readFile("logging_example.log"), "decoded binary log should match the text log");
+    std::cout << decoded.str();
+
+    {
+        // one service thread writes out all of these loggers, each of which is only used by its own thread
+        LogService service;
+        constexpr int num_threads = 4, lines_per_thread = 100 * 1000;
+        std::vector<std::thread> threads;
+        for (int t = 0; t < num_threads; ++t) {
+            threads.emplace_back([&service, t]() {
+                Logger thread_logger("logging_service_" + std::to_string(t) + ".log", LogMode::TEXT, &service);
+                for (int line = 0; line < lines_per_thread; ++line) {
+                    thread_logger.log("thread % line % \n", t, line);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        for (int t = 0; t < num_threads; ++t) {
+            std::istringstream lines(readFile("logging_service_" + std::to_string(t) + ".log"));
+            std::string line;
+            int next_line = 0;
+            while (std::getline(lines, line)) {
+                ASSERT(line == "thread " + std::to_string(t) + " line " + std::to_string(next_line) + " ", "unexpected line in thread " + std::to_string(t) + "'s log: " + line);
+                ++next_line;
+            }
+            ASSERT(next_line == lines_per_thread, "thread " + std::to_string(t) + "'s log is missing lines");
+        }
+        std::cout << num_threads << " threads logged through one service" << std::endl;
+    }
+
+    {
+        Logger level_logger("logging_levels.log");
+        int evaluated = 0;
+        auto countEvaluation = [&evaluated]() { return ++evaluated; };
+        LOG_TRACE(level_logger, "trace % \n", countEvaluation());
+        LOG_DEBUG(level_logger, "debug % \n", countEvaluation());
+        LOG_INFO(level_logger, "info % \n", countEvaluation());
+        LOG_WARN(level_logger, "warn % \n", countEvaluation());
+
+        const int expected = logLevelEnabled(LogLevel::TRACE) + logLevelEnabled(LogLevel::DEBUG) + logLevelEnabled(LogLevel::INFO) + logLevelEnabled(LogLevel::WARN);
+        ASSERT(evaluated == expected, "log calls below LOG_MIN_LEVEL should not evaluate their arguments");
+        std::cout << "LOG_MIN_LEVEL " << LOG_MIN_LEVEL << " kept " << evaluated << " of 4 leveled log calls" << std::endl;
+    }
+
+    // a typical line from the matching engine
+    constexpr int num_lines = 1000 * 1000;
+    for (const LogMode mode : {LogMode::TEXT, LogMode::BINARY}) {
+        auto benchmark_logger = new Logger(mode == LogMode::TEXT ? "logging_benchmark.log" : "logging_benchmark.bin", mode);
+        std::string time_str = "12:34:56.123456789";
+
+        const uint64_t start_ticks = rdtsc();
+        for (int line = 0; line < num_lines; ++line) {
+            benchmark_logger->log("%:% %() % Processing order id:% price:% qty:% \n", __FILE__, __LINE__, __FUNCTION__, time_str, line, 100L, 10U);
+        }
+        const uint64_t end_ticks = rdtscp();
+        delete benchmark_logger; // waits for the logger thread to write everything out
+
+        std::cout << (mode == LogMode::TEXT ? "text" : "binary") << " log(): "
+                  << static_cast<double>(tsc_clock.ticksToNanos(end_ticks - start_ticks)) / num_lines << " ns/line" << std::endl;
+    }
+
     return 0;
 }
\ No newline at end of file
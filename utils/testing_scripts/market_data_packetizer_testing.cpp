@@ -0,0 +1,127 @@
+#include "../logger.h"
+#include "../multicast_socket.h"
+#include "../time_utils.h"
+#include "../../exchange/market_publisher/market_data_packetizer.h"
+#include <iostream>
+
+using namespace Common;
+using namespace Exchange;
+
+constexpr size_t MTU = MDP_DEFAULT_MTU;
+constexpr size_t UPDATES_PER_PACKET = 42; // (1500 - 28 - 18) / 34
+
+int main() {
+    /*
+        Our test's structure will look like the following:
+            1. Check how many updates fit in a packet at the ethernet and the jumbo frame MTU
+            2. Packetize a burst bigger than one packet and flush() it like the publisher does at the end of a batch,
+               check it splits into full packets at the MTU and a short last one, with the right headers and updates
+            3. Packetize a batch of more packets than a sendmmsg() takes, check the socket sends the full batch by itself
+            4. Check every packet we got passes the consumer's check (MDPPacketHeader::fromDatagram()), and a truncated one doesn't
+    */
+    Logger logger("market_data_packetizer_testing.log");
+    const std::string ip = "233.252.14.6";
+    const int port = 20006;
+
+    // PART 1: updates per packet
+    ASSERT(MarketDataPacketizer::updatesPerPacket(MTU) == UPDATES_PER_PACKET,
+        "expected " + std::to_string(UPDATES_PER_PACKET) + " updates per packet, got " + std::to_string(MarketDataPacketizer::updatesPerPacket(MTU)));
+    ASSERT(MarketDataPacketizer::updatesPerPacket(9000) == 263, "expected 263 updates per jumbo packet");
+    for (const size_t mtu : {MTU, size_t{9000}}) {
+        const size_t n = MarketDataPacketizer::updatesPerPacket(mtu);
+        ASSERT(MDP_IP_UDP_OVERHEAD + sizeof(MDPPacketHeader) + n * sizeof(MEMarketUpdate) <= mtu, "a full packet has to fit in the MTU");
+        ASSERT(MDP_IP_UDP_OVERHEAD + sizeof(MDPPacketHeader) + (n + 1) * sizeof(MEMarketUpdate) > mtu, "one more update should not fit");
+    }
+
+    MulticastSocket listener(logger);
+    ASSERT(listener.init(ip, "lo", port, true) >= 0, "unable to create the listening socket: " + std::string(std::strerror(errno)));
+    ASSERT(listener.join(ip), "unable to join " + ip + ": " + std::string(std::strerror(errno)));
+    const int receive_buffer = 8 * 1024 * 1024;
+    setsockopt(listener.socket_file_descriptor, SOL_SOCKET, SO_RCVBUF, &receive_buffer, sizeof(receive_buffer));
+
+    MulticastSocket publisher(logger);
+    ASSERT(publisher.init(ip, "lo", port, false) >= 0, "unable to create the publishing socket: " + std::string(std::strerror(errno)));
+
+    std::vector<std::string> packets;
+    listener.receive_callback = [&](MulticastSocket *socket) noexcept {
+        for (size_t i = 0; i < socket->num_received_datagrams; ++i) {
+            packets.emplace_back(socket->receivedDatagram(i), socket->receivedDatagramLength(i));
+        }
+    };
+    auto receive = [&](size_t num_packets) {
+        const Nanos start = getCurrentNanos();
+        while (packets.size() < num_packets) {
+            publisher.sendAndRecv(); // anything the kernel had no room for yet
+            listener.sendAndRecv();
+            ASSERT(getCurrentNanos() - start < 5 * NANOS_TO_SECONDS, "timed out, got " + std::to_string(packets.size()) + " packets");
+        }
+    };
+
+    // checks packet 'i' carries 'num_updates' updates numbered from 'first_seq_number', each update's order id is its sequence number
+    auto checkPacket = [&](size_t i, size_t first_seq_number, size_t num_updates) {
+        const auto header = MDPPacketHeader::fromDatagram(packets[i].data(), packets[i].size());
+        ASSERT(header, "packet " + std::to_string(i) + " of " + std::to_string(packets[i].size()) + " bytes should be whole");
+        ASSERT(header->first_seq_number == first_seq_number && header->num_updates == num_updates,
+            "packet " + std::to_string(i) + " has the wrong header: " + header->toString());
+        ASSERT(packets[i].size() + MDP_IP_UDP_OVERHEAD <= MTU, "packet " + std::to_string(i) + " doesn't fit in the MTU");
+        for (size_t j = 0; j < num_updates; ++j) {
+            MEMarketUpdate update;
+            memcpy(&update, packets[i].data() + sizeof(MDPPacketHeader) + j * sizeof(MEMarketUpdate), sizeof(MEMarketUpdate));
+            ASSERT(update.order_id == first_seq_number + j, "packet " + std::to_string(i) + " has the wrong update at " + std::to_string(j));
+        }
+    };
+
+    MarketDataPacketizer packetizer(&publisher, MTU);
+    size_t next_seq_number = 1;
+    auto addUpdates = [&](size_t n) {
+        for (size_t i = 0; i < n; ++i, ++next_seq_number) {
+            MEMarketUpdate update;
+            update.type = MarketUpdateType::ADD;
+            update.order_id = next_seq_number;
+            packetizer.add(next_seq_number, update);
+        }
+    };
+
+    // PART 2: a burst of 100 updates, then the end of the batch
+    addUpdates(100);
+    packetizer.flush();
+    publisher.sendAndRecv();
+    receive(3);
+    checkPacket(0, 1, UPDATES_PER_PACKET);
+    checkPacket(1, 1 + UPDATES_PER_PACKET, UPDATES_PER_PACKET);
+    checkPacket(2, 1 + 2 * UPDATES_PER_PACKET, 100 - 2 * UPDATES_PER_PACKET);
+
+    // a quiet market, one update in the batch still goes out right away
+    addUpdates(1);
+    packetizer.flush();
+    packetizer.flush(); // nothing left to finish, so this doesn't send an empty packet
+    publisher.sendAndRecv();
+    receive(4);
+    checkPacket(3, 101, 1);
+
+    // PART 3: more full packets than one sendmmsg() sends, the socket sends the first McastMaxBatchDatagrams on its own
+    const size_t num_packets = McastMaxBatchDatagrams + 8;
+    const size_t first_seq_number = next_seq_number;
+    addUpdates(num_packets * UPDATES_PER_PACKET);
+    // nobody called sendAndRecv() on the publisher yet, so whatever arrives went out when its slots filled up
+    const Nanos start = getCurrentNanos();
+    while (packets.size() == 4) {
+        listener.sendAndRecv();
+        ASSERT(getCurrentNanos() - start < 5 * NANOS_TO_SECONDS, "a full batch should have been sent by itself");
+    }
+    packetizer.flush();
+    publisher.sendAndRecv();
+    receive(4 + num_packets);
+    for (size_t i = 0; i < num_packets; ++i) {
+        checkPacket(4 + i, first_seq_number + i * UPDATES_PER_PACKET, UPDATES_PER_PACKET);
+    }
+
+    // PART 4: the consumer drops packets that don't match their header
+    ASSERT(!MDPPacketHeader::fromDatagram(packets[0].data(), packets[0].size() - 1), "a truncated packet should be dropped");
+    ASSERT(!MDPPacketHeader::fromDatagram(packets[0].data(), sizeof(MDPPacketHeader) - 1), "a packet shorter than its header should be dropped");
+    ASSERT(!MDPPacketHeader::fromDatagram(packets[3].data(), packets[3].size() + sizeof(MEMarketUpdate)), "a packet with extra bytes should be dropped");
+
+    std::cout << "got " << packets.size() << " packets, every one whole and in order" << std::endl;
+
+    return 0;
+}
@@ -1,4 +1,7 @@
+#include <set>
+
 #include "../memory_pool.h"
+#include "../performance_utils.h"
 
 // Object type that a user would want to store into the MemPool
 struct ExampleType {
@@ -28,8 +31,46 @@ int main() {
             << " who's first element is: " << allocated_data->data[0]
             << " and will now be deallocated" << std::endl;
 
-        new_mem_pool.deallocate(allocated_data); // commenting this out will yield: ASSERT: storage is full!
+        new_mem_pool.deallocate(allocated_data); // commenting this out will yield: FATAL: storage is full!
+    }
+
+    /*
+        Now fragment a big pool the way the order books do: fill it up, free every other block,
+        and check that allocating again hands back exactly the freed blocks, each one only once.
+        This used to be a scan through 'storage' for every allocate(), now it is a pop off the free stack.
+
+        Compile with -DMEMPOOL_DEBUG and free one of the blocks twice to see the double free get caught.
+    */
+    const int big_pool_size = 1000 * 1000;
+    auto big_pool = new MemPool<ExampleType>(big_pool_size);
+
+    std::vector<ExampleType*> blocks(big_pool_size);
+    for (int i = 0; i < big_pool_size; ++i) {
+        blocks[i] = big_pool->allocate(ExampleType{{i, i}});
     }
+    ASSERT(big_pool->available() == 0, "pool should be full");
+
+    std::set<ExampleType*> freed;
+    for (int i = 0; i < big_pool_size; i += 2) {
+        big_pool->deallocate(blocks[i]);
+        freed.insert(blocks[i]);
+    }
+
+    const uint64_t start_ticks = rdtsc();
+    for (int i = 0; i < big_pool_size / 2; ++i) {
+        blocks[i] = big_pool->allocate(ExampleType{{-i, -i}});
+    }
+    const uint64_t end_ticks = rdtscp();
+
+    for (int i = 0; i < big_pool_size / 2; ++i) {
+        ASSERT(freed.erase(blocks[i]) == 1, "allocate() handed out a block that wasn't free, or handed out a block twice!");
+    }
+    ASSERT(freed.empty() && big_pool->available() == 0, "every freed block should have been handed out again");
+
+    std::cout << "allocate() from a fragmented pool: " << static_cast<double>(tsc_clock.ticksToNanos(end_ticks - start_ticks)) / (big_pool_size / 2)
+              << " ns/allocation" << std::endl;
+
+    delete big_pool;
     
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "../mirrored_ring_buffer.h"
+#include "../time_utils.h"
+
+using namespace Common;
+
+// an odd size, so messages keep landing across the wrap point
+struct Message {
+    uint64_t seq_number = 0;
+    char payload[45] = {};
+};
+
+constexpr int NUM_MESSAGES = 1000 * 1000;
+
+int main() {
+    /*
+        Our test's structure will look like the following:
+            1. Check both halves of the mapping really are the same memory
+            2. Stream messages through in uneven chunks (like recv() hands them to us), parse them in place and check every one,
+               including the ones that straddle the end of the buffer
+            3. Time parsing in place against the old way, memcpy-ing the leftover partial message to the front after every read
+    */
+    MirroredRingBuffer ring(1);
+    const size_t capacity = ring.size();
+    ASSERT(capacity >= 4096 && (capacity & (capacity - 1)) == 0, "the capacity should be rounded up to a power of two number of pages");
+
+    // write across the end, the bytes have to show up at the start as well
+    ring.commitWrite(capacity - 2);
+    ring.consume(capacity - 2);
+    std::memcpy(ring.writePtr(), "wrap", 4);
+    ring.commitWrite(4);
+    ASSERT(std::memcmp(ring.readPtr(), "wrap", 4) == 0 && std::memcmp(ring.readPtr() - (capacity - 2), "ap", 2) == 0,
+           "the second mapping should alias the first");
+    ring.consume(4);
+
+    MirroredRingBuffer stream(64 * 1024);
+    std::vector<char> source(NUM_MESSAGES * sizeof(Message));
+    for (int i = 0; i < NUM_MESSAGES; ++i) {
+        Message message;
+        message.seq_number = i;
+        std::memset(message.payload, 'a' + (i % 26), sizeof(message.payload));
+        std::memcpy(source.data() + i * sizeof(Message), &message, sizeof(Message));
+    }
+
+    // 'recv()' a chunk of up to 'chunk' bytes, parse everything complete in it, repeat
+    auto streamThrough = [&](size_t chunk, bool compact) {
+        std::vector<char> linear(stream.size());
+        size_t linear_valid = 0;
+
+        size_t sent = 0;
+        uint64_t expected = 0;
+        while (expected < NUM_MESSAGES) {
+            const size_t n = std::min(chunk, source.size() - sent);
+            const char *received = nullptr;
+            size_t received_length = 0;
+            if (compact) {
+                const size_t take = std::min(n, linear.size() - linear_valid);
+                std::memcpy(linear.data() + linear_valid, source.data() + sent, take);
+                linear_valid += take;
+                sent += take;
+                received = linear.data();
+                received_length = linear_valid;
+            } else {
+                const size_t take = std::min(n, stream.writable());
+                std::memcpy(stream.writePtr(), source.data() + sent, take);
+                stream.commitWrite(take);
+                sent += take;
+                received = stream.readPtr();
+                received_length = stream.readable();
+            }
+
+            size_t i = 0;
+            for (; i + sizeof(Message) <= received_length; i += sizeof(Message), ++expected) {
+                const Message *message = reinterpret_cast<const Message *>(received + i);
+                if (UNLIKELY(message->seq_number != expected || message->payload[44] != 'a' + static_cast<char>(expected % 26))) {
+                    FATAL("message " + std::to_string(expected) + " came out wrong");
+                }
+            }
+
+            if (compact) {
+                std::memcpy(linear.data(), linear.data() + i, linear_valid - i);
+                linear_valid -= i;
+            } else {
+                stream.consume(i);
+            }
+        }
+    };
+
+    for (const size_t chunk : {size_t(1), size_t(100), size_t(1500), size_t(60000)}) {
+        for (const bool compact : {true, false}) {
+            const auto start = getCurrentNanos();
+            streamThrough(chunk, compact);
+            const auto elapsed = getCurrentNanos() - start;
+            std::cout << (compact ? "memcpy compaction" : "mirrored ring    ") << " chunk:" << chunk
+                      << " " << elapsed / NUM_MESSAGES << "ns per message" << std::endl;
+        }
+    }
+    ASSERT(stream.readable() == 0, "everything should have been parsed");
+
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "../mpsc_queue.h"
+#include "../thread_utils.h"
+#include "../time_utils.h"
+
+using namespace Common;
+
+struct DummyType {
+    int producer_id;
+    int data;
+};
+
+// small queue on purpose, so the producers keep running into a full queue and have to wait for the reader
+constexpr size_t QUEUE_SIZE = 4096;
+constexpr int NUM_PRODUCERS = 4;
+constexpr int NUM_ELEMENTS_PER_PRODUCER = 250 * 1000;
+
+// each 'write' thread pushes its own id along with a counter, so the reader can check nothing got lost or reordered
+void writeThreadTask(MPSCQueue<DummyType>* queue, int producer_id, std::atomic<bool>* start) {
+    while (!*start) {}
+
+    for (int i = 0; i < NUM_ELEMENTS_PER_PRODUCER; ++i) {
+        size_t write_ticket;
+        DummyType* write_obj = queue->getNextWriteTo(&write_ticket);
+        *write_obj = DummyType{producer_id, i};
+        queue->updateWriteIndex(write_ticket);
+    }
+}
+
+int main() {
+    /*
+        Our test's structure will look like the following:
+            1. Create a test queue object of DummyType data
+            2. Start several threads that all write to the queue at the same time, while main reads from it
+            3. Check that every producer's elements come out in the order that producer wrote them, and that none go missing
+            4. Print how long it took per element
+
+        NOTE: elements from different producers can be interleaved in any order, only the order per producer is guaranteed
+    */
+    auto test_queue = new MPSCQueue<DummyType>(QUEUE_SIZE);
+    std::atomic<bool> start = false;
+
+    std::vector<std::thread *> write_threads;
+    for (int producer_id = 0; producer_id < NUM_PRODUCERS; ++producer_id) {
+        write_threads.push_back(createAndStartThread(-1, "write thread " + std::to_string(producer_id), writeThreadTask, test_queue, producer_id, &start));
+    }
+
+    std::vector<int> next_expected(NUM_PRODUCERS, 0);
+    const uint64_t start_ticks = rdtsc();
+    start = true;
+
+    for (int num_read = 0; num_read < NUM_PRODUCERS * NUM_ELEMENTS_PER_PRODUCER; ) {
+        const DummyType* read_obj = test_queue->getNextRead();
+        if (!read_obj) {
+            continue;
+        }
+
+        if (UNLIKELY(read_obj->data != next_expected[read_obj->producer_id])) {
+            FATAL("Producer " + std::to_string(read_obj->producer_id) + " element out of order! expected: " +
+                std::to_string(next_expected[read_obj->producer_id]) + " got: " + std::to_string(read_obj->data));
+        }
+        ++next_expected[read_obj->producer_id];
+        test_queue->updateReadIndex();
+        ++num_read;
+    }
+    const uint64_t end_ticks = rdtscp();
+
+    for (auto write_thread : write_threads) {
+        write_thread->join();
+        delete write_thread;
+    }
+
+    ASSERT(test_queue->size() == 0, "Queue should be empty after reading everything");
+    std::cout << NUM_PRODUCERS << " producers: " << static_cast<double>(tsc_clock.ticksToNanos(end_ticks - start_ticks)) / (NUM_PRODUCERS * NUM_ELEMENTS_PER_PRODUCER)
+              << " ns/element" << std::endl;
+    std::cout << "Main exiting!" << std::endl;
+
+    delete test_queue;
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "../logger.h"
+#include "../multicast_socket.h"
+#include "../time_utils.h"
+#include <iostream>
+
+using namespace Common;
+
+constexpr int NUM_DATAGRAMS = 1000;
+
+int main() {
+    /*
+        Our test's structure will look like the following:
+            1. Publish NUM_DATAGRAMS datagrams of different sizes, finishing each one, so full batches go out by themselves,
+               and read each batch back on a listening socket as it goes out, like a receiver that keeps up with the feed
+            2. Check every datagram arrives whole and in order, and that they come in batches rather than one per receive_callback
+    */
+    Logger logger("multicast_socket_testing.log");
+    const std::string ip = "233.252.14.5";
+    const int port = 20005;
+
+    MulticastSocket listener(logger);
+    ASSERT(listener.init(ip, "lo", port, true) >= 0, "unable to create the listening socket: " + std::string(std::strerror(errno)));
+    ASSERT(listener.join(ip), "unable to join " + ip + ": " + std::string(std::strerror(errno)));
+
+    // the kernel drops whatever doesn't fit in the socket's buffer, make sure everything we send does
+    const int receive_buffer = 8 * 1024 * 1024;
+    setsockopt(listener.socket_file_descriptor, SOL_SOCKET, SO_RCVBUF, &receive_buffer, sizeof(receive_buffer));
+
+    int next_expected = 0;
+    size_t num_callbacks = 0;
+    size_t largest_batch = 0;
+    listener.receive_callback = [&](MulticastSocket *socket) noexcept {
+        ++num_callbacks;
+        largest_batch = std::max(largest_batch, socket->num_received_datagrams);
+        for (size_t i = 0; i < socket->num_received_datagrams; ++i, ++next_expected) {
+            // datagram k holds (k % 100) + 1 copies of k
+            const size_t length = socket->receivedDatagramLength(i);
+            ASSERT(length == ((next_expected % 100) + 1) * sizeof(int), "datagram " + std::to_string(next_expected) + " has the wrong length:" + std::to_string(length));
+            for (size_t j = 0; j < length / sizeof(int); ++j) {
+                int value;
+                memcpy(&value, socket->receivedDatagram(i) + j * sizeof(int), sizeof(int));
+                ASSERT(value == next_expected, "datagram " + std::to_string(next_expected) + " has the wrong contents");
+            }
+        }
+    };
+
+    MulticastSocket publisher(logger);
+    ASSERT(publisher.init(ip, "lo", port, false) >= 0, "unable to create the publishing socket: " + std::string(std::strerror(errno)));
+
+    // PART 1: publish, the publisher never reads, so its sendAndRecv() only sends
+    for (int k = 0; k < NUM_DATAGRAMS; ++k) {
+        for (int j = 0; j <= k % 100; ++j) {
+            publisher.send(&k, sizeof(k));
+        }
+        publisher.finishDatagram();
+
+        // the batch that just filled up went out by itself, so we read it back now rather than let the datagrams pile up
+        // in the listener's buffer, where the kernel would drop whatever doesn't fit
+        if ((k + 1) % McastMaxBatchDatagrams == 0) {
+            ASSERT(!publisher.sendAndRecv(), "a publisher doesn't read");
+            listener.sendAndRecv();
+        }
+    }
+    ASSERT(!publisher.sendAndRecv(), "a publisher doesn't read");
+
+    // PART 2: read the rest back
+    const Nanos start = getCurrentNanos();
+    while (next_expected < NUM_DATAGRAMS) {
+        publisher.sendAndRecv(); // whatever the kernel had no room for yet goes out now
+        listener.sendAndRecv();
+        ASSERT(getCurrentNanos() - start < 5 * NANOS_TO_SECONDS, "timed out, got " + std::to_string(next_expected) + " datagrams");
+    }
+
+    std::cout << "got " << next_expected << " datagrams in " << num_callbacks << " batches, the largest had " << largest_batch << std::endl;
+    ASSERT(largest_batch > 1, "datagrams should be read in batches");
+
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include "../numa_utils.h"
+#include "../huge_page_arena.h"
+#include "../thread_utils.h"
+
+using namespace Common;
+
+int main() {
+    /*
+        Our test's structure will look like the following:
+            1. Print which numa node each core belongs to (on macOS, or a single socket machine, this is all 'unknown' or 0)
+            2. Reserve an arena bound to the node of core 0, touch it from a thread pinned to the last core,
+               and check that the memory still landed on core 0's node
+            3. Check that an unpinned core and an untouched page both come back as -1
+
+        NOTE: step 2 only really shows something on a host with more than one numa node
+    */
+    const int num_cores = static_cast<int>(std::thread::hardware_concurrency());
+    for (int core = 0; core < num_cores; ++core) {
+        std::cout << "core " << core << " is on numa node " << numaNodeToString(numaNodeOfCore(core)) << std::endl;
+    }
+
+    const int node = numaNodeOfCore(0);
+    const ArenaConfig config{.use_huge_pages = false, .prefault = false, .lock = false, .numa_node = node};
+    HugePageArena arena(16 * 1024 * 1024, config);
+    std::cout << arena.toString() << std::endl;
+
+    char *memory = static_cast<char *>(arena.allocate(8 * 1024 * 1024));
+    ASSERT(numaNodeOfAddress(memory) == -1, "memory nobody touched yet shouldn't be on any node");
+
+    // first-touch from a thread on another core, the binding should win over where the touch came from
+    auto touch_thread = createAndStartThread(num_cores - 1, "touch thread", [memory]() {
+        std::memset(memory, 1, 8 * 1024 * 1024);
+    });
+    touch_thread->join();
+    delete touch_thread;
+
+    std::cout << "memory bound to node " << numaNodeToString(node) << " landed on node " << numaNodeToString(numaNodeOfAddress(memory)) << std::endl;
+    if (node >= 0) {
+        ASSERT(numaNodeOfAddress(memory) == node, "memory should be on the node it was bound to");
+    }
+
+    ASSERT(numaNodeOfCore(-1) == -1, "an unpinned thread doesn't have a node");
+
+    return 0;
+}
\ No newline at end of file
@@ -12,11 +12,11 @@ int main() {
     
     auto tcpServerRecvCallback = [&](TCPSocket *socket, Nanos rx_time) noexcept {
         logger.log("TCPServer::tcpServerRecvCallback() socket:% len:% rx:% \n",
-            socket->socket_file_descriptor, socket->next_receive_valid_index, rx_time
+            socket->socket_file_descriptor, socket->receive_buffer.readable(), rx_time
         );
 
-        const std::string reply = "TCPServer received msg: " + std::string(socket->receive_buffer, socket->next_receive_valid_index);
-        socket->next_receive_valid_index = 0;
+        const std::string reply = "TCPServer received msg: " + std::string(socket->receive_buffer.readPtr(), socket->receive_buffer.readable());
+        socket->receive_buffer.clear();
         socket->send(reply.data(), reply.length());
     };
     
@@ -25,11 +25,11 @@ int main() {
     };
     
     auto tcpClientRecvCallback = [&](TCPSocket *socket, Nanos rx_time) noexcept {
-        const std::string recv_msg = std::string(socket->receive_buffer, socket->next_receive_valid_index);
-        socket->next_receive_valid_index = 0;
+        const std::string recv_msg = std::string(socket->receive_buffer.readPtr(), socket->receive_buffer.readable());
+        socket->receive_buffer.clear();
 
         logger.log("TCPServer::tcpClientRecvCallback() socket:% len:% rx:% msg:% \n",
-            socket->socket_file_descriptor, socket->next_receive_valid_index, rx_time, recv_msg
+            socket->socket_file_descriptor, socket->receive_buffer.readable(), rx_time, recv_msg
         );
     };
 
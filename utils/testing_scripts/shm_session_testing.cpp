@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <vector>
+#include <sys/wait.h>
+
+#include "../shm_session.h"
+#include "../time_utils.h"
+#include "../idle_strategy.h"
+
+using namespace Common;
+
+struct Ping {
+    uint64_t seq_number = 0;
+    int64_t sent_at = 0;
+};
+
+constexpr size_t RING_SIZE = 1024;
+constexpr size_t MAX_CLIENTS = 4;
+constexpr int NUM_ROUND_TRIPS = 100 * 1000;
+
+typedef ShmSessionServer<Ping, Ping, RING_SIZE, MAX_CLIENTS> PingServer;
+typedef ShmSessionClient<Ping, Ping, RING_SIZE, MAX_CLIENTS> PingClient;
+
+// the client process, sends a ping, waits for the server to echo it, NUM_ROUND_TRIPS times, exits with 0 if every echo was right
+int runClient(const std::string &path, size_t client_id) {
+    PingClient client(path, client_id);
+    if (!client.isConnected()) {
+        std::cerr << "client: " << client.errorString() << std::endl;
+        return 1;
+    }
+
+    std::vector<int64_t> round_trips;
+    round_trips.reserve(NUM_ROUND_TRIPS);
+
+    // spins first, but yields if the server doesn't answer, so this still finishes when both processes share one core
+    IdleStrategy idle_strategy(IdleMode::SPIN_YIELD);
+    for (int i = 0; i < NUM_ROUND_TRIPS; ++i) {
+        Ping *ping = client.requests().getNextWriteTo();
+        ping->seq_number = i;
+        ping->sent_at = getCurrentNanos();
+        client.requests().updateWriteIndex();
+
+        const Ping *echo = nullptr;
+        while (!(echo = client.responses().getNextRead())) {
+            idle_strategy.idle();
+        }
+        idle_strategy.reset();
+        if (echo->seq_number != static_cast<uint64_t>(i)) {
+            std::cerr << "client: expected echo " << i << " got " << echo->seq_number << std::endl;
+            return 1;
+        }
+        round_trips.push_back(getCurrentNanos() - echo->sent_at);
+        client.responses().updateReadIndex();
+    }
+
+    std::sort(round_trips.begin(), round_trips.end());
+    std::cout << "shm round trip p50 " << round_trips[round_trips.size() / 2] << "ns p99 " << round_trips[round_trips.size() * 99 / 100]
+              << "ns p99.9 " << round_trips[round_trips.size() * 999 / 1000] << "ns" << std::endl;
+    return 0;
+}
+
+int main() {
+    /*
+        Our test's structure will look like the following:
+            1. Check a client can't connect before the server is up, or with a client id that is out of range
+            2. Fork a client process, echo its pings back from this process and time the round trips
+            3. Check a second session for the same client id is refused while the first one is connected
+            4. Check the server notices the client going away and its session file is gone
+            5. Check a client that went away and came back between two polls gets its new session read, not the old one
+            6. Check a client that died without cleaning up doesn't keep its client id from the next one
+            7. Sequence a client's pings like the order server does, check a reconnected client starting over at 1 is accepted
+    */
+    const std::string path = shmDirectory() + "/shm_session_testing." + std::to_string(::getpid());
+    {
+        PingClient early(path, 0);
+        ASSERT(!early.isConnected(), "there is no server to connect to yet");
+    }
+
+    PingServer server(path);
+    ASSERT(server.isOpen(), server.errorString());
+    {
+        PingClient out_of_range(path, MAX_CLIENTS);
+        ASSERT(!out_of_range.isConnected(), "client ids past MAX_CLIENTS should be refused");
+    }
+
+    const size_t client_id = 2;
+    const pid_t child = fork();
+    if (child == 0) {
+        _exit(runClient(path, client_id));
+    }
+
+    // wait for the client's session to show up
+    while (server.connectedClients().empty()) {
+        ASSERT(server.poll(), server.errorString());
+        std::this_thread::yield();
+    }
+    ASSERT(server.connectedClients().front() == client_id && server.session(client_id)->clientPid() == child, "the wrong client connected");
+
+    {
+        PingClient duplicate(path, client_id);
+        ASSERT(!duplicate.isConnected(), "a client id should only have one session");
+    }
+
+    // echo everything back until the client is gone
+    int echoed = 0;
+    IdleStrategy idle_strategy(IdleMode::SPIN_YIELD);
+    while (!server.connectedClients().empty()) {
+        server.poll();
+        auto session = server.session(client_id);
+        if (!session || !session->requests().size()) {
+            idle_strategy.idle();
+            continue;
+        }
+        idle_strategy.reset();
+        for (const Ping *ping = session->requests().getNextRead(); ping; ping = session->requests().getNextRead()) {
+            *session->responses().getNextWriteTo() = *ping;
+            session->responses().updateWriteIndex();
+            session->requests().updateReadIndex();
+            ++echoed;
+        }
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0, "the client process failed");
+    ASSERT(echoed == NUM_ROUND_TRIPS, "echoed " + std::to_string(echoed) + " pings");
+    ASSERT(access((path + "." + std::to_string(client_id)).c_str(), F_OK) != 0, "the client should have removed its session file");
+
+    // sends one ping with 'seq_number' from 'client' and checks the server reads exactly that off the client's session
+    auto checkSessionIsRead = [&](PingClient &client, uint64_t seq_number) {
+        client.requests().getNextWriteTo()->seq_number = seq_number;
+        client.requests().updateWriteIndex();
+        ASSERT(server.poll(), server.errorString());
+        ASSERT(server.openedClients().size() == 1 && server.openedClients().front() == client_id, "poll() should report the session it opened");
+        auto session = server.session(client_id);
+        ASSERT(session && session->clientPid() == ::getpid(), "the server should have the new client's session open");
+        const Ping *ping = session->requests().getNextRead();
+        ASSERT(ping && ping->seq_number == seq_number, "the server should read the new client's ping");
+        session->requests().updateReadIndex();
+    };
+
+    // PART 5: leave and come back without the server polling in between
+    {
+        PingClient first(path, client_id);
+        ASSERT(first.isConnected(), first.errorString());
+        checkSessionIsRead(first, 1);
+    }
+    {
+        PingClient second(path, client_id);
+        ASSERT(second.isConnected(), second.errorString());
+        checkSessionIsRead(second, 2);
+    }
+
+    // PART 6: a client process that _exit()s skips its destructor, so its client id is still marked as taken
+    const pid_t crashed = fork();
+    if (crashed == 0) {
+        PingClient client(path, client_id);
+        _exit(client.isConnected() ? 0 : 1);
+    }
+    waitpid(crashed, &status, 0);
+    ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0, "the crashing client process couldn't connect");
+    {
+        PingClient replacement(path, client_id);
+        ASSERT(replacement.isConnected(), "a dead client's id should be taken over: " + replacement.errorString());
+        checkSessionIsRead(replacement, 3);
+    }
+
+    // PART 7: the order server's sequence number checks, each client's requests and responses count from 1 per session
+    size_t next_expected_seq_number = 1;
+    size_t next_outgoing_seq_number = 1;
+    auto sequencePings = [&]() {
+        ASSERT(server.poll(), server.errorString());
+        for (const size_t opened_client_id : server.openedClients()) {
+            ASSERT(opened_client_id == client_id, "only one client should have connected");
+            next_expected_seq_number = 1;
+            next_outgoing_seq_number = 1;
+        }
+        auto session = server.session(client_id);
+        ASSERT(session, "the server should have the client's session open");
+        for (const Ping *ping = session->requests().getNextRead(); ping; ping = session->requests().getNextRead()) {
+            ASSERT(ping->seq_number == next_expected_seq_number,
+                "expected seq number " + std::to_string(next_expected_seq_number) + " but received " + std::to_string(ping->seq_number));
+            ++next_expected_seq_number;
+            session->responses().getNextWriteTo()->seq_number = next_outgoing_seq_number++;
+            session->responses().updateWriteIndex();
+            session->requests().updateReadIndex();
+        }
+    };
+    // sends 'n' pings numbered from 1 like a fresh order gateway, checks every response comes back numbered from 1 too
+    auto tradeFromStart = [&](PingClient &client, uint64_t n) {
+        for (uint64_t seq_number = 1; seq_number <= n; ++seq_number) {
+            client.requests().getNextWriteTo()->seq_number = seq_number;
+            client.requests().updateWriteIndex();
+        }
+        sequencePings();
+        for (uint64_t seq_number = 1; seq_number <= n; ++seq_number) {
+            const Ping *response = client.responses().getNextRead();
+            ASSERT(response && response->seq_number == seq_number, "the client expected response seq number " + std::to_string(seq_number));
+            client.responses().updateReadIndex();
+        }
+        ASSERT(server.poll() && server.openedClients().empty(), "a poll with nothing new shouldn't report any session");
+    };
+    {
+        PingClient before_restart(path, client_id);
+        ASSERT(before_restart.isConnected(), before_restart.errorString());
+        tradeFromStart(before_restart, 5);
+    }
+    {
+        PingClient after_restart(path, client_id);
+        ASSERT(after_restart.isConnected(), after_restart.errorString());
+        tradeFromStart(after_restart, 3);
+    }
+
+    return 0;
+}
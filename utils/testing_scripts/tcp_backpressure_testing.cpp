@@ -0,0 +1,122 @@
+#include "../logger.h"
+#include "../tcp_server.h"
+#include "../time_utils.h"
+#include <iostream>
+
+using namespace Common;
+
+// what the server sends, the header and the body live in different places, like the OrderServer's responses
+struct Body {
+    uint64_t seq_number = 0;
+    char payload[48] = {};
+};
+
+constexpr size_t MESSAGE_SIZE = sizeof(uint64_t) + sizeof(Body);
+constexpr size_t BATCH_SIZE = 64;
+
+int main() {
+    /*
+        Our test's structure will look like the following:
+            1. Connect a client that then stops reading, and make its socket's kernel buffers small so they fill up quickly
+            2. Gather messages to it in batches until the kernel can't take any more, so sends are partial and then blocked,
+               check the socket waits for EPOLLOUT / EVFILT_WRITE instead of retrying, and that it went over its high water mark
+            3. Check the server stops reading that client while it is backed up
+            4. Let the client read again, check every message shows up once, whole and in order, and that the server starts
+               reading the client again after the socket drained below its low water mark
+    */
+    Logger logger("tcp_backpressure_testing.log");
+
+    TCPServerConfig config;
+    config.socket_send_buffer_size = 4 * 1024 * 1024;
+    config.socket_send_low_water_mark = 64 * 1024;
+    config.socket_send_high_water_mark = 512 * 1024;
+
+    TCPServer server(logger, config);
+    TCPSocket *server_side = nullptr;
+    size_t requests_read = 0;
+    server.receive_callback = [&](TCPSocket *socket, Nanos) noexcept {
+        server_side = socket;
+        requests_read += socket->receive_buffer.readable();
+        socket->receive_buffer.clear();
+    };
+    server.receive_finished_callback = []() noexcept {};
+    server.listen("lo", 12346);
+
+    TCPSocket client(logger);
+    uint64_t next_expected = 0;
+    client.receive_callback = [&](TCPSocket *socket, Nanos) noexcept {
+        size_t i = 0;
+        const char *received = socket->receive_buffer.readPtr();
+        for (; i + MESSAGE_SIZE <= socket->receive_buffer.readable(); i += MESSAGE_SIZE) {
+            uint64_t header;
+            Body body;
+            memcpy(&header, received + i, sizeof(header));
+            memcpy(&body, received + i + sizeof(header), sizeof(body));
+            if (header != next_expected || body.seq_number != next_expected || body.payload[47] != static_cast<char>(next_expected)) {
+                FATAL("message " + std::to_string(next_expected) + " came out wrong, header:" + std::to_string(header));
+            }
+            ++next_expected;
+        }
+        socket->receive_buffer.consume(i);
+    };
+
+    ASSERT(client.connect("127.0.0.1", "lo", 12346, false) >= 0, "client could not connect");
+    const int small = 16 * 1024;
+    setsockopt(client.socket_file_descriptor, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+
+    // PART 1: say hello, so the server has a socket for us
+    client.send("hello", 5);
+    while (!server_side) {
+        client.sendAndReceive();
+        server.poll();
+        server.sendAndReceive();
+    }
+    ASSERT(requests_read == 5, "the server should have read the hello");
+    setsockopt(server_side->socket_file_descriptor, SOL_SOCKET, SO_SNDBUF, &small, sizeof(small));
+
+    // PART 2: the client doesn't read, so eventually the kernel stops taking our bytes
+    std::array<uint64_t, BATCH_SIZE> headers;
+    std::array<Body, BATCH_SIZE> bodies;
+    uint64_t next_seq = 0;
+    while (!server_side->send_blocked || !server_side->send_backed_up) {
+        ASSERT(server_side->sendBufferSpace() >= BATCH_SIZE * MESSAGE_SIZE, "the socket should have backed up long before it filled up");
+        for (size_t i = 0; i < BATCH_SIZE; ++i, ++next_seq) {
+            headers[i] = next_seq;
+            bodies[i].seq_number = next_seq;
+            bodies[i].payload[47] = static_cast<char>(next_seq);
+            server_side->gather(&headers[i], sizeof(uint64_t));
+            server_side->gather(&bodies[i], sizeof(Body));
+        }
+        server.sendGathered();
+
+        // the batch is either with the kernel or copied, so we can reuse the arrays
+        headers.fill(~0ull);
+        bodies.fill(Body{});
+    }
+    ASSERT(server_side->write_event_armed, "a blocked socket should be waiting for a write event");
+    ASSERT(server_side->pendingSendBytes() > config.socket_send_high_water_mark, "the socket should be over its high water mark");
+    std::cout << "backed up after " << next_seq << " messages, " << server_side->pendingSendBytes() << " bytes waiting" << std::endl;
+
+    // PART 3: while it is backed up, the client's new requests wait
+    client.send("more!", 5);
+    client.sendAndReceive(); // note that this reads a little too, that is fine
+    for (int i = 0; i < 100; ++i) {
+        server.poll();
+        server.sendAndReceive();
+    }
+    ASSERT(requests_read == 5, "the server should not read from a backed up client");
+
+    // PART 4: the client catches up
+    const Nanos start = getCurrentNanos();
+    while (next_expected < next_seq || requests_read < 10) {
+        client.sendAndReceive();
+        server.poll();
+        server.sendAndReceive();
+        ASSERT(getCurrentNanos() - start < 10 * NANOS_TO_SECONDS, "timed out, got " + std::to_string(next_expected) + " of " + std::to_string(next_seq));
+    }
+    ASSERT(!server_side->send_backed_up && !server_side->send_blocked && !server_side->pendingSendBytes(), "the socket should have drained");
+    ASSERT(next_expected == next_seq, "the client should have received every message once");
+    std::cout << "all " << next_expected << " messages arrived in order" << std::endl;
+
+    return 0;
+}
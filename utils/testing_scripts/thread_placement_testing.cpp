@@ -0,0 +1,83 @@
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "../thread_utils.h"
+
+using namespace Common;
+
+int main() {
+    /*
+        Our test's structure will look like the following:
+            1. Round trip a few kernel cpu lists
+            2. Load a placement file and check bad lines are rejected
+            3. Check validate() refuses cores we can't run on and SCHED_FIFO threads sharing a core
+            4. Start a thread through the config and print the placement report
+    */
+    for (const std::string list : {"0", "2-5,8", "0-1,3,5-7"}) {
+        std::set<int> cores;
+        ASSERT(parseCpuList(list, &cores) && cpuListToString(cores) == list, "cpu list didn't round trip: " + list);
+    }
+    std::set<int> cores;
+    ASSERT(!parseCpuList("3-1", &cores) && !parseCpuList("a", &cores), "bad cpu lists should be rejected");
+    std::cout << "allowed cores: " << cpuListToString(allowedCores()) << ", isolated cores: " << cpuListToString(isolatedCores()) << std::endl;
+
+    const std::string file_name = "/tmp/thread_placement_testing.cfg";
+    auto writeFile = [&file_name](const std::string &contents) {
+        std::ofstream file(file_name, std::ios::trunc);
+        file << contents;
+    };
+
+    {
+        writeFile("# thread name  core  [fifo <priority>]  [idle <mode>]\n"
+                  "worker 0 idle park\n"
+                  "\n"
+                  "hot_worker 0 fifo 80 # shares core 0 with 'worker'\n");
+        ThreadPlacementConfig config;
+        std::string error;
+        ASSERT(config.load(file_name, &error), error);
+        ASSERT(config.coreOf("worker") == 0 && config.placementOf("hot_worker").fifo_priority == 80, "placements weren't loaded");
+        ASSERT(config.placementOf("worker").idle_mode == IdleMode::PARK && config.placementOf("hot_worker").idle_mode == IdleMode::BUSY_SPIN,
+               "idle modes weren't loaded");
+        ASSERT(config.coreOf("somebody_else") == -1 && config.placementOf("worker", 3).core_id == 3, "unknown threads stay unpinned, callers override");
+
+        std::string report;
+        ASSERT(!config.validate(&report) && report.find("share core 0") != std::string::npos, "a SCHED_FIFO thread sharing a core should fail:\n" + report);
+        std::cout << report;
+
+        for (const std::string bad : {"worker\n", "worker 0 fifo\n", "worker 0 fifo 100\n", "worker 0 rr 10\n", "worker 0 fifo 10 extra\n",
+                                  "worker 0 idle\n", "worker 0 idle sleepy\n"}) {
+            writeFile(bad);
+            ThreadPlacementConfig bad_config;
+            ASSERT(!bad_config.load(file_name, &error), "should have been rejected: " + bad);
+        }
+    }
+
+    {
+        ThreadPlacementConfig config;
+        config.set("far_away", {100000, 0});
+        std::string report;
+        ASSERT(!config.validate(&report), "a core we can't run on should fail");
+        std::cout << report;
+    }
+    std::remove(file_name.c_str());
+
+    // the first core we may run on, through the process-wide config, note that SCHED_FIFO needs privileges so it may only show up as an error
+    const int core_id = *allowedCores().begin();
+    threadPlacementConfig().set("placed_worker", {core_id, 10});
+    auto thread = createAndStartThread(-1, "placed_worker", [core_id]() {
+#if defined(__linux__)
+        ASSERT(sched_getcpu() == core_id, "the thread should be running on its core");
+#endif
+    });
+    ASSERT(thread != nullptr, "placed_worker didn't start");
+    thread->join();
+    delete thread;
+
+    const std::string report = threadPlacementReport();
+    std::cout << report;
+    ASSERT(report.find("placed_worker") != std::string::npos && report.find("requested:core " + std::to_string(core_id) + " SCHED_FIFO 10") != std::string::npos,
+           "the report should have placed_worker");
+
+    return 0;
+}
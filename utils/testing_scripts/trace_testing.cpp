@@ -0,0 +1,101 @@
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+#include "../trace_reader.h"
+
+using namespace Common;
+
+int main() {
+    /*
+        Our test's structure will look like the following:
+            1. Point the tracer at a fresh directory
+            2. Have threads play the trading client sending orders, the exchange, and the trading client getting the
+               responses, each tracing its part of the same orders' journeys (and the exchange a few market data updates)
+            3. Join the rings and check every hop was paired up once per order, plus tick to trade
+            4. Time how long a TRACE_HOP() costs, then clean up the rings
+    */
+    char directory_template[] = "/tmp/trace_testing.XXXXXX";
+    const std::string directory = ::mkdtemp(directory_template);
+    ::setenv("EXCHANGE_TRACE_DIR", directory.c_str(), 1);
+
+    constexpr uint32_t client_id = 7;
+    constexpr uint64_t num_orders = 1000;
+
+    auto client = createAndStartThread(-1, "trading client", []() {
+        for (uint64_t order_id = 1; order_id <= num_orders; ++order_id) {
+            TRACE_HOP(T10_TradeEngine_LFQueue_write, client_id, order_id);
+            TRACE_HOP(T11_OrderGateway_LFQueue_read, client_id, order_id);
+            TRACE_HOP(T12_OrderGateway_TCP_write, client_id, order_id);
+        }
+    });
+    client->join();
+    delete client;
+
+    auto exchange = createAndStartThread(-1, "exchange", []() {
+        for (uint64_t order_id = 1; order_id <= num_orders; ++order_id) {
+            const int64_t rx_time = getCurrentNanosTSC();
+            TRACE_HOP_AT(T1_OrderServer_TCP_read, client_id, order_id, rx_time);
+            TRACE_HOP(T2_OrderServer_LFQueue_write, client_id, order_id);
+            TRACE_HOP(T3_MatchingEngine_LFQueue_read, client_id, order_id);
+            TRACE_HOP(T4t_MatchingEngine_LFQueue_write, client_id, order_id);
+            TRACE_HOP(T4_MatchingEngine_LFQueue_write, TRACE_MARKET_DATA, order_id);
+        }
+    });
+    exchange->join();
+    delete exchange;
+
+    // note that createAndStartThread() waits a second for the thread to start, so the hops between threads look very slow here
+    auto client_responses = createAndStartThread(-1, "trading client responses", []() {
+        for (uint64_t order_id = 1; order_id <= num_orders; ++order_id) {
+            TRACE_HOP(T7t_OrderGateway_TCP_read, client_id, order_id);
+            TRACE_HOP(T8t_OrderGateway_LFQueue_write, client_id, order_id);
+            TRACE_HOP(T9t_TradeEngine_LFQueue_read, client_id, order_id);
+        }
+    });
+    client_responses->join();
+    delete client_responses;
+
+    const std::vector<std::string> rings = findTraceRings(directory);
+    ASSERT(rings.size() == 3, "expected a ring per thread, found " + std::to_string(rings.size()));
+
+    std::vector<TraceEvent> events;
+    for (const std::string &ring : rings) {
+        std::string error;
+        ASSERT(readTraceRing(ring, &events, &error), ring + ": " + error);
+    }
+    ASSERT(events.size() == num_orders * 11, "read " + std::to_string(events.size()) + " records");
+
+    std::ostringstream report;
+    joinTraces(events, false, report);
+    std::cout << report.str();
+
+    const std::string count = " count:" + std::to_string(num_orders) + " ";
+    for (const std::string pair : {"T10_TradeEngine_LFQueue_write -> T11_OrderGateway_LFQueue_read",
+                                   "T12_OrderGateway_TCP_write -> T1_OrderServer_TCP_read",
+                                   "T3_MatchingEngine_LFQueue_read -> T4t_MatchingEngine_LFQueue_write",
+                                   "T8t_OrderGateway_LFQueue_write -> T9t_TradeEngine_LFQueue_read",
+                                   "T10_TradeEngine_LFQueue_write -> T9t_TradeEngine_LFQueue_read (tick to trade)"}) {
+        ASSERT(report.str().find(pair + count) != std::string::npos, "missing or miscounted: " + pair);
+    }
+    // nobody traced T5t/T6t, so there's nothing to measure T7t from (and market data that only has T4 has no pairs)
+    ASSERT(report.str().find("-> T7t_OrderGateway_TCP_read") == std::string::npos, "T7t shouldn't have been paired");
+    ASSERT(report.str().find("T4_MatchingEngine_LFQueue_write ->") == std::string::npos, "T4 shouldn't have been paired");
+
+    // the hot path, note that the first hop creates this thread's ring so it isn't timed
+    TRACE_HOP(T3_MatchingEngine_LFQueue_read, client_id, 0);
+    constexpr int num_hops = 10 * 1000 * 1000;
+    const uint64_t start_ticks = rdtsc();
+    for (int i = 1; i <= num_hops; ++i) {
+        TRACE_HOP(T3_MatchingEngine_LFQueue_read, client_id, static_cast<uint64_t>(i));
+    }
+    const uint64_t end_ticks = rdtscp();
+    std::cout << "TRACE_HOP(): " << static_cast<double>(tsc_clock.ticksToNanos(end_ticks - start_ticks)) / num_hops << " ns" << std::endl;
+
+    for (const std::string &ring : findTraceRings(directory)) {
+        ::unlink(ring.c_str());
+    }
+    ::rmdir(directory.c_str());
+
+    return 0;
+}
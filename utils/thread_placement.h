@@ -0,0 +1,381 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+#include "macros.h"
+#include "idle_strategy.h"
+
+namespace Common {
+
+    /*
+        Where each component's thread runs
+
+        Every thread we start goes through createAndStartThread() with a name ("Exchange/MatchingEngine", "log_service", ...),
+        the ThreadPlacementConfig maps those names to the core the thread gets pinned to, optionally a SCHED_FIFO priority
+        so nothing that isn't real-time can preempt it, and what its loop does when it has no work (see IdleMode, busy_spin
+        by default). It is read from a file with a line per thread:
+
+            # thread name                   core    [fifo <priority 1-99>] [idle <busy_spin|spin_yield|backoff|park>]
+            Exchange/MatchingEngine         2       fifo 80
+            Exchange/OrderServer            3       fifo 80
+            Exchange/SnapshotSynthesizer    -1      idle park
+            log_service                     0
+
+        Ideally the hot threads' cores are kept away from everything else with the isolcpus= (or nohz_full=) kernel parameter,
+        validate() checks the config against that, and against the cores this process is allowed to run on at all
+
+        note that a SCHED_FIFO thread that busy polls never gives its core up, so two of them on one core would starve each other,
+        and on a core that isn't isolated it starves the kernel's per-cpu threads, which is why validate() is picky about those
+    */
+
+    struct ThreadPlacement {
+        int core_id = -1; // -1 leaves the thread unpinned
+        int fifo_priority = 0; // 0 leaves it on the default (SCHED_OTHER) policy
+        IdleMode idle_mode = IdleMode::BUSY_SPIN; // only used by the threads that run an IdleStrategy
+
+        std::string toString() const {
+            std::string result = (core_id >= 0 ? "core " + std::to_string(core_id) : "unpinned");
+            if (fifo_priority > 0) {
+                result += " SCHED_FIFO " + std::to_string(fifo_priority);
+            }
+            return result + " idle " + idleModeToString(idle_mode);
+        }
+    };
+
+    // parses a kernel cpu list like "2-5,8" (the format of /sys/devices/system/cpu/isolated), returns false if it isn't one
+    inline bool parseCpuList(const std::string &list, std::set<int> *cores) {
+        std::stringstream ranges(list);
+        std::string range;
+        while (std::getline(ranges, range, ',')) {
+            range.erase(0, range.find_first_not_of(" \n"));
+            range.erase(range.find_last_not_of(" \n") + 1);
+            if (range.empty()) {
+                continue;
+            }
+
+            int first = -1, last = -1;
+            char dash = 0;
+            std::stringstream bounds(range);
+            if (!(bounds >> first) || first < 0) {
+                return false;
+            }
+            last = first;
+            if (bounds >> dash && (dash != '-' || !(bounds >> last) || last < first)) {
+                return false;
+            }
+            for (int core = first; core <= last; ++core) {
+                cores->insert(core);
+            }
+        }
+        return true;
+    }
+
+    // the inverse of parseCpuList()
+    inline std::string cpuListToString(const std::set<int> &cores) {
+        std::string result;
+        for (auto it = cores.begin(); it != cores.end();) {
+            const int first = *it;
+            int last = first;
+            while (++it != cores.end() && *it == last + 1) {
+                ++last;
+            }
+            if (!result.empty()) {
+                result.push_back(',');
+            }
+            result.append(std::to_string(first));
+            if (last > first) {
+                result.push_back('-');
+                result.append(std::to_string(last));
+            }
+        }
+        return (result.empty() ? "none" : result);
+    }
+
+    // cores taken away from the scheduler with isolcpus=, empty if there aren't any (or we are not on linux)
+    inline std::set<int> isolatedCores() {
+        std::set<int> cores;
+#if defined(__linux__)
+        std::ifstream isolated("/sys/devices/system/cpu/isolated");
+        std::string list;
+        if (std::getline(isolated, list)) {
+            parseCpuList(list, &cores);
+        }
+#endif
+        return cores;
+    }
+
+    // cores the calling thread is allowed to run on (taskset, cgroups, ...)
+    inline std::set<int> allowedCores() {
+        std::set<int> cores;
+#if defined(__linux__)
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+            for (int core = 0; core < CPU_SETSIZE; ++core) {
+                if (CPU_ISSET(core, &cpu_set)) {
+                    cores.insert(core);
+                }
+            }
+            return cores;
+        }
+#endif
+        for (int core = 0; core < static_cast<int>(std::thread::hardware_concurrency()); ++core) {
+            cores.insert(core);
+        }
+        return cores;
+    }
+
+    class ThreadPlacementConfig final {
+        private:
+            std::map<std::string, ThreadPlacement> placements; // thread name -> placement
+
+        public:
+            ThreadPlacementConfig() = default;
+
+            ThreadPlacementConfig(const ThreadPlacementConfig &) = delete;
+            ThreadPlacementConfig(const ThreadPlacementConfig &&) = delete;
+            ThreadPlacementConfig &operator=(const ThreadPlacementConfig &) = delete;
+            ThreadPlacementConfig &operator=(const ThreadPlacementConfig &&) = delete;
+
+            void set(const std::string &thread_name, const ThreadPlacement &placement) {
+                placements[thread_name] = placement;
+            }
+
+            // reads the file format described at the top, returns false (and what was wrong with it in 'error') if it can't
+            bool load(const std::string &file_name, std::string *error) {
+                std::ifstream file(file_name);
+                if (!file.is_open()) {
+                    *error = "could not open " + file_name;
+                    return false;
+                }
+
+                std::string line;
+                for (int line_number = 1; std::getline(file, line); ++line_number) {
+                    line = line.substr(0, line.find('#'));
+                    std::stringstream fields(line);
+                    std::string thread_name, option, idle_mode;
+                    ThreadPlacement placement;
+                    if (!(fields >> thread_name)) {
+                        continue; // empty or a comment
+                    }
+
+                    bool valid = (fields >> placement.core_id) && placement.core_id >= -1;
+                    while (valid && fields >> option) {
+                        if (option == "fifo") {
+                            valid = (fields >> placement.fifo_priority) && placement.fifo_priority >= 1 && placement.fifo_priority <= 99;
+                        } else if (option == "idle") {
+                            valid = (fields >> idle_mode) && idleModeFromString(idle_mode, &placement.idle_mode);
+                        } else {
+                            valid = false;
+                        }
+                    }
+                    if (!valid) {
+                        *error = file_name + ":" + std::to_string(line_number) +
+                                 " should be '<thread name> <core> [fifo <priority 1-99>] [idle <busy_spin|spin_yield|backoff|park>]': " + line;
+                        return false;
+                    }
+                    placements[thread_name] = placement;
+                }
+                return true;
+            }
+
+            // the placement of 'thread_name', an explicit 'core_id' (>= 0) from the caller takes precedence over the config's
+            ThreadPlacement placementOf(const std::string &thread_name, int core_id = -1) const {
+                const auto found = placements.find(thread_name);
+                ThreadPlacement placement = (found != placements.end() ? found->second : ThreadPlacement{});
+                if (core_id >= 0) {
+                    placement.core_id = core_id;
+                }
+                return placement;
+            }
+
+            int coreOf(const std::string &thread_name) const {
+                return placementOf(thread_name).core_id;
+            }
+
+            /*
+                checks the placements against the machine, writing a line per problem to 'report'
+                returns false if the config can't work: a core we aren't allowed to run on, or SCHED_FIFO threads sharing a core
+                things that only cost latency (a core that isn't isolated, threads sharing a core) are just warnings
+            */
+            bool validate(std::string *report) const {
+                const std::set<int> allowed = allowedCores();
+                const std::set<int> isolated = isolatedCores();
+                std::map<int, std::vector<std::string>> threads_on_core;
+                bool valid = true;
+
+                for (const auto &[thread_name, placement] : placements) {
+                    if (placement.core_id < 0) {
+                        continue;
+                    }
+                    threads_on_core[placement.core_id].push_back(thread_name);
+
+                    if (!allowed.count(placement.core_id)) {
+                        *report += "ERROR: " + thread_name + " is on core " + std::to_string(placement.core_id) +
+                                   " but this process may only run on cores " + cpuListToString(allowed) + "\n";
+                        valid = false;
+                    } else if (!isolated.empty() && !isolated.count(placement.core_id)) {
+                        *report += "WARNING: " + thread_name + " is on core " + std::to_string(placement.core_id) +
+                                   " which isn't isolated (isolated cores: " + cpuListToString(isolated) + ")" +
+                                   (placement.fifo_priority > 0 ? ", with SCHED_FIFO it will starve the kernel's threads on that core" : "") + "\n";
+                    }
+                }
+
+                if (isolated.empty() && !threads_on_core.empty()) {
+                    *report += "WARNING: no cores are isolated (isolcpus=), the pinned threads still share their cores with everything else\n";
+                }
+
+                for (const auto &[core_id, thread_names] : threads_on_core) {
+                    if (thread_names.size() < 2) {
+                        continue;
+                    }
+                    size_t num_fifo = 0;
+                    std::string names;
+                    for (const std::string &thread_name : thread_names) {
+                        num_fifo += (placements.at(thread_name).fifo_priority > 0);
+                        names += (names.empty() ? "" : ", ") + thread_name;
+                    }
+                    if (num_fifo > 0) {
+                        *report += "ERROR: " + names + " share core " + std::to_string(core_id) + " and some of them are SCHED_FIFO, they would starve the others\n";
+                        valid = false;
+                    } else {
+                        *report += "WARNING: " + names + " share core " + std::to_string(core_id) + "\n";
+                    }
+                }
+
+                return valid;
+            }
+    };
+
+    // the placement every createAndStartThread() in this process looks its thread up in, load it before starting any threads
+    inline ThreadPlacementConfig &threadPlacementConfig() {
+        static ThreadPlacementConfig config;
+        return config;
+    }
+
+    /*
+        loads the file named by the THREAD_PLACEMENT_FILE environment variable (nothing is pinned if it isn't set) into
+        threadPlacementConfig() and validates it, returns validate()'s warnings, a file that can't be read or can't work is FATAL
+        note that this has to run before any thread is started, including the log service
+    */
+    inline std::string loadThreadPlacementFromEnvironment() {
+        const char *file_name = std::getenv("THREAD_PLACEMENT_FILE");
+        if (!file_name) {
+            return "";
+        }
+
+        std::string error;
+        ASSERT(threadPlacementConfig().load(file_name, &error), error);
+
+        std::string report;
+        ASSERT(threadPlacementConfig().validate(&report), "thread placement in " + std::string(file_name) + " can't work:\n" + report);
+        return report;
+    }
+
+    // where a thread actually ended up, as seen from the thread itself right after it was placed
+    struct ThreadPlacementRecord {
+        std::string thread_name;
+        ThreadPlacement requested;
+        long tid = -1;
+        int running_on_core = -1;
+        std::string affinity;
+        std::string policy;
+        std::string error; // what couldn't be applied, if anything
+    };
+
+    // every placed thread, only written to while threads start up so a mutex is fine here
+    class ThreadPlacementRegistry final {
+        private:
+            mutable std::mutex mutex;
+            std::vector<ThreadPlacementRecord> records;
+
+        public:
+            ThreadPlacementRegistry() = default;
+
+            ThreadPlacementRegistry(const ThreadPlacementRegistry &) = delete;
+            ThreadPlacementRegistry(const ThreadPlacementRegistry &&) = delete;
+            ThreadPlacementRegistry &operator=(const ThreadPlacementRegistry &) = delete;
+            ThreadPlacementRegistry &operator=(const ThreadPlacementRegistry &&) = delete;
+
+            // call from the thread being recorded
+            void recordCurrentThread(const std::string &thread_name, const ThreadPlacement &requested, const std::string &error) {
+                ThreadPlacementRecord record;
+                record.thread_name = thread_name;
+                record.requested = requested;
+                record.error = error;
+#if defined(__linux__)
+                record.tid = static_cast<long>(syscall(SYS_gettid));
+                record.running_on_core = sched_getcpu();
+
+                cpu_set_t cpu_set;
+                CPU_ZERO(&cpu_set);
+                std::set<int> cores;
+                if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0) {
+                    for (int core = 0; core < CPU_SETSIZE; ++core) {
+                        if (CPU_ISSET(core, &cpu_set)) {
+                            cores.insert(core);
+                        }
+                    }
+                }
+                record.affinity = cpuListToString(cores);
+#else
+                record.affinity = "n/a";
+#endif
+
+                int policy = 0;
+                sched_param param{};
+                pthread_getschedparam(pthread_self(), &policy, &param);
+                record.policy = (policy == SCHED_FIFO ? "SCHED_FIFO " + std::to_string(param.sched_priority) :
+                                 policy == SCHED_RR ? "SCHED_RR " + std::to_string(param.sched_priority) : "SCHED_OTHER");
+
+                std::lock_guard<std::mutex> lock(mutex);
+                records.push_back(std::move(record));
+            }
+
+            std::string report() const {
+                std::lock_guard<std::mutex> lock(mutex);
+                std::string result = "Thread placement:\n";
+                for (const ThreadPlacementRecord &record : records) {
+                    result += "  " + record.thread_name + " tid:" + std::to_string(record.tid) +
+                              " requested:" + record.requested.toString() +
+                              " affinity:" + record.affinity +
+                              " running on:" + std::to_string(record.running_on_core) +
+                              " policy:" + record.policy +
+                              (record.error.empty() ? "" : " ERROR: " + record.error) + "\n";
+                }
+                return result;
+            }
+    };
+
+    inline ThreadPlacementRegistry thread_placement_registry;
+
+    // the placement of the calling thread, set by createAndStartThread() before it runs the thread's task
+    inline thread_local ThreadPlacement current_thread_placement;
+
+    inline const ThreadPlacement &currentThreadPlacement() noexcept {
+        return current_thread_placement;
+    }
+
+    // where every thread started so far actually runs, meant to be printed once everything is up
+    inline std::string threadPlacementReport() {
+        return thread_placement_registry.report();
+    }
+
+}
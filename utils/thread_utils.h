@@ -5,7 +5,8 @@
 #include <atomic> // access to thread-safe variables
 #include <unistd.h> // access to functions such as sleep()
 #include <sys/syscall.h> // access to CPU flags
-#include "thread_utils_pin_cores.h" // helper functions to allow access to macOS kernel API
+#include "thread_utils_pin_cores.h" // pthread_setaffinity_np(), natively on linux and through a shim on macOS
+#include "thread_placement.h" // which core (and scheduling policy) each named thread gets
 #include <thread>
 
 namespace Common {
@@ -19,6 +20,25 @@ namespace Common {
         return (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0);
     }
 
+    // switches this thread to SCHED_FIFO at 'priority' (1-99), note that this needs root or CAP_SYS_NICE on linux
+    inline bool setThreadFifoPriority(int priority, std::string *error) noexcept {
+        sched_param param{};
+        param.sched_priority = priority;
+        const int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (result != 0) {
+            *error = "could not set SCHED_FIFO " + std::to_string(priority) + ": " + std::strerror(result);
+        }
+        return result == 0;
+    }
+
+    /*
+        Starts a thread running func_task_for_thread(func_task_args...), returns nullptr if it could not be pinned
+
+        the thread is pinned to 'core_id', or if that is -1, to the core threadPlacementConfig() has for 'thread_name' (if any),
+        and gets the SCHED_FIFO priority (and idle mode, see currentThreadPlacement()) the config has for it,
+        where it actually ended up goes into threadPlacementReport()
+        note that a priority we aren't allowed to set doesn't stop the thread, it just runs as SCHED_OTHER (and the report says so)
+    */
     template<typename T, typename... Params>
     inline auto createAndStartThread(
         int core_id,
@@ -37,16 +57,24 @@ namespace Common {
             1. Pin itself to a core to help CPU avoid context switching
             2. Begin the task specified by the func_task
         */
+        const ThreadPlacement placement = threadPlacementConfig().placementOf(thread_name, core_id);
         auto thread_init = [&] {
             // if the thread failed to pin to a valid core, return and indicate that the thread failed
-            if (core_id >= 0 && !pinThreadToCore(core_id)) {
+            if (placement.core_id >= 0 && !pinThreadToCore(placement.core_id)) {
                 std::cerr << "Failed to set core affinity for " << thread_name << " " << pthread_self() 
-                << " to core " << core_id << std::endl;
+                << " to core " << placement.core_id << std::endl;
 
                 pin_failed = true;
                 return;
             }
 
+            std::string placement_error;
+            if (placement.fifo_priority > 0 && !setThreadFifoPriority(placement.fifo_priority, &placement_error)) {
+                std::cerr << thread_name << ": " << placement_error << std::endl;
+            }
+            thread_placement_registry.recordCurrentThread(thread_name, placement, placement_error);
+            current_thread_placement = placement; // e.g. for the thread's IdleStrategy
+
             // The thread was pinned successfully, now, we can assign the task to the thread
             running = true;
             std::forward<T>(func_task_for_thread) ((std::forward<Params>(func_task_args))...); 
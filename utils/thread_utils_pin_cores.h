@@ -1,16 +1,26 @@
 #pragma once 
 
 /*
+    Pinning threads to cores and giving them a real-time scheduling policy
+
+    On linux these come straight from glibc (pthread_setaffinity_np(), cpu_set_t, sched_getcpu()),
+    macOS has no core affinity API, so there we fall back to the shim below
+
     CREDITS TO: yshen@hybridkernel.com, Binding Threads to Cores on OSX
     This code helps to pin threads to specific cores on OSX
 */
 
-#define SYSCTL_CORE_COUNT   "machdep.cpu.core_count"
-
 #include <iostream>
 #include <cstring>
 #include <atomic> // access to thread-safe variables
 #include <unistd.h> // access to functions such as sleep()
+#include <pthread.h>
+#include <sched.h> // cpu_set_t, SCHED_FIFO
+
+#if defined(__APPLE__)
+
+#define SYSCTL_CORE_COUNT   "machdep.cpu.core_count"
+
 #include <sys/syscall.h> // access to CPU flags
 #include <mach/mach.h> // access to macOS kernel API
 
@@ -27,6 +37,7 @@ CPU_SET(int num, cpu_set_t *cs) { cs->count |= (1 << num); }
 static inline int
 CPU_ISSET(int num, cpu_set_t *cs) { return (cs->count & (1 << num)); }
 
+// note that this is only a hint on macOS, threads with the same affinity tag get scheduled on the same L2, nothing is enforced
 inline int pthread_setaffinity_np(
     pthread_t thread, 
     size_t cpu_size,
@@ -44,4 +55,9 @@ inline int pthread_setaffinity_np(
   thread_policy_set(mach_thread, THREAD_AFFINITY_POLICY,
                     (thread_policy_t)&policy, 1);
   return 0;
-}
\ No newline at end of file
+}
+
+// macOS can't tell us which core we are running on
+inline int sched_getcpu() { return -1; }
+
+#endif
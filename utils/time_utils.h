@@ -53,7 +53,7 @@ namespace Common {
 
         char nanos_str[24];
         snprintf(nanos_str, 24, "%.8s.%09lld", ctime(&time) + 11, // first part of the regex strips away the month, year, day of the week from the result of ctime() which provides human-readable time
-                std::chrono::duration_cast<std::chrono::nanoseconds>(clock.time_since_epoch()).count() % NANOS_TO_SECONDS // second part is 9 digits, Unix epoch -> nanoseconds -> integer value -> only digits right of decimal
+                static_cast<long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock.time_since_epoch()).count() % NANOS_TO_SECONDS) // second part is 9 digits, Unix epoch -> nanoseconds -> integer value -> only digits right of decimal
         );
         time_str->assign(nanos_str);
 
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <string>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "macros.h"
+#include "performance_utils.h"
+
+// every how many'th order (and market data update) gets traced, 1 traces everything and 0 compiles the tracer out
+// CMake sets it (0 in release builds), the default here is for the testing scripts
+#if !defined(TRACE_SAMPLE_EVERY)
+#define TRACE_SAMPLE_EVERY 1
+#endif
+
+namespace Common {
+
+    /*
+        Tick-to-trade tracing
+
+        Every hop an order makes (trade engine -> order gateway -> order server -> FIFO sequencer -> matching engine and back)
+        writes a TraceRecord into a ring owned by the thread it happens on, with the id of the order it belongs to:
+        - orders and their responses are identified by client id + the client's order id, which both the requests and the
+          responses already carry, so nothing extra has to go over the wire
+        - market data updates are identified by their incremental sequence number (client id TRACE_MARKET_DATA)
+
+        The rings are files in traceDirectory() (/dev/shm by default, so they are just shared memory) that we mmap(),
+        which means they are still there for tools/trace_join to read after the exchange and the clients have exited,
+        and it can join the rings of every process on the box into one journey per order (see trace_reader.h).
+
+        Sampling is by id (see shouldTrace()), so every hop, in every process, agrees on which orders get traced.
+
+        NOTE: the timestamps are getCurrentNanosTSC(), each process calibrates its own TSCClock, so hops in different
+        processes can be off from each other by about as much as the calibration error (well under a microsecond)
+    */
+
+    enum class TraceHop : uint8_t {
+        INVALID = 0,
+
+        // an order's trip to the exchange and its response's trip back
+        T10_TradeEngine_LFQueue_write = 1,
+        T11_OrderGateway_LFQueue_read = 2,
+        T12_OrderGateway_TCP_write = 3,
+        T1_OrderServer_TCP_read = 4,
+        T2_OrderServer_LFQueue_write = 5,
+        T3_MatchingEngine_LFQueue_read = 6,
+        T4t_MatchingEngine_LFQueue_write = 7,
+        T5t_OrderServer_LFQueue_read = 8,
+        T6t_OrderServer_TCP_write = 9,
+        T7t_OrderGateway_TCP_read = 10,
+        T8t_OrderGateway_LFQueue_write = 11,
+        T9t_TradeEngine_LFQueue_read = 12,
+
+        // a market data update's trip from the matching engine to a client's order book
+        T4_MatchingEngine_LFQueue_write = 13,
+        T5_MarketDataPublisher_LFQueue_read = 14,
+        T6_MarketDataPublisher_UDP_write = 15,
+        T7_MarketDataConsumer_UDP_read = 16,
+        T8_MarketDataConsumer_LFQueue_write = 17,
+
+        MAX = 18
+    };
+
+    inline std::string_view traceHopToString(TraceHop hop) noexcept {
+        constexpr std::array<std::string_view, static_cast<size_t>(TraceHop::MAX)> names = {
+            "INVALID",
+            "T10_TradeEngine_LFQueue_write", "T11_OrderGateway_LFQueue_read", "T12_OrderGateway_TCP_write",
+            "T1_OrderServer_TCP_read", "T2_OrderServer_LFQueue_write", "T3_MatchingEngine_LFQueue_read",
+            "T4t_MatchingEngine_LFQueue_write", "T5t_OrderServer_LFQueue_read", "T6t_OrderServer_TCP_write",
+            "T7t_OrderGateway_TCP_read", "T8t_OrderGateway_LFQueue_write", "T9t_TradeEngine_LFQueue_read",
+            "T4_MatchingEngine_LFQueue_write", "T5_MarketDataPublisher_LFQueue_read", "T6_MarketDataPublisher_UDP_write",
+            "T7_MarketDataConsumer_UDP_read", "T8_MarketDataConsumer_LFQueue_write"
+        };
+        const size_t index = static_cast<size_t>(hop);
+        return (index < names.size() ? names[index] : "UNKNOWN");
+    }
+
+    constexpr uint32_t TRACE_MARKET_DATA = std::numeric_limits<uint32_t>::max(); // 'client id' of market data journeys
+    constexpr size_t TRACE_RING_SIZE = 64 * 1024; // records per thread, the oldest get overwritten
+
+    struct TraceRecord {
+        int64_t nanos = 0; // getCurrentNanosTSC() when the hop happened
+        uint64_t id = 0; // the client's order id, or the market data sequence number
+        uint32_t client_id = 0;
+        TraceHop hop = TraceHop::INVALID;
+    };
+
+    // the start of every ring file, followed by TRACE_RING_SIZE records
+    struct TraceRingHeader {
+        char magic[8] = {'E', 'X', 'T', 'R', 'A', 'C', 'E', '1'};
+        uint64_t capacity = TRACE_RING_SIZE;
+        int64_t pid = 0;
+        uint64_t thread_index = 0; // order in which the process' threads first traced something
+        alignas(64) std::atomic<uint64_t> next_index = 0; // its own cache line, records written so far, the last 'capacity' of them are in the ring
+
+        bool isValid() const noexcept {
+            return std::memcmp(magic, TraceRingHeader().magic, sizeof(magic)) == 0;
+        }
+    };
+
+    constexpr size_t TRACE_RING_FILE_SIZE = sizeof(TraceRingHeader) + TRACE_RING_SIZE * sizeof(TraceRecord);
+
+    // where the ring files go, the EXCHANGE_TRACE_DIR environment variable overrides it
+    inline std::string traceDirectory() {
+        if (const char *dir = std::getenv("EXCHANGE_TRACE_DIR")) {
+            return dir;
+        }
+#if defined(__linux__)
+        return "/dev/shm";
+#else
+        return "/tmp";
+#endif
+    }
+
+    // only ever written to by the thread that created it
+    class TraceRing final {
+        private:
+            TraceRingHeader *header = nullptr;
+            TraceRecord *records = nullptr;
+
+        public:
+            // note that a ring we couldn't create just drops its records, tracing should never take the process down
+            TraceRing(const std::string &path, uint64_t thread_index) noexcept {
+                const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+                if (fd < 0 || ::ftruncate(fd, static_cast<off_t>(TRACE_RING_FILE_SIZE)) != 0) {
+                    std::cerr << "TraceRing: could not create " << path << ": " << std::strerror(errno) << std::endl;
+                    if (fd >= 0) {
+                        ::close(fd);
+                    }
+                    return;
+                }
+
+                void *memory = ::mmap(nullptr, TRACE_RING_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                ::close(fd); // the mapping keeps the file alive
+                if (memory == MAP_FAILED) {
+                    std::cerr << "TraceRing: could not map " << path << ": " << std::strerror(errno) << std::endl;
+                    return;
+                }
+
+                header = new (memory) TraceRingHeader();
+                header->pid = static_cast<int64_t>(::getpid());
+                header->thread_index = thread_index;
+                records = reinterpret_cast<TraceRecord *>(static_cast<char *>(memory) + sizeof(TraceRingHeader));
+            }
+
+            // the mapping (and the file) outlive the thread on purpose, so the records can still be read after it exits
+            ~TraceRing() = default;
+
+            TraceRing() = delete;
+            TraceRing(const TraceRing &) = delete;
+            TraceRing(const TraceRing &&) = delete;
+            TraceRing &operator=(const TraceRing &) = delete;
+            TraceRing &operator=(const TraceRing &&) = delete;
+
+            void record(const TraceRecord &trace_record) noexcept {
+                if (UNLIKELY(!header)) {
+                    return;
+                }
+                const uint64_t index = header->next_index.load(std::memory_order_relaxed);
+                records[index & (TRACE_RING_SIZE - 1)] = trace_record;
+                header->next_index.store(index + 1, std::memory_order_release);
+            }
+    };
+    static_assert((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0, "TRACE_RING_SIZE has to be a power of two");
+
+    // the calling thread's ring, created the first time the thread traces something
+    inline TraceRing &threadTraceRing() noexcept {
+        static std::atomic<uint64_t> next_thread_index = 0;
+        thread_local TraceRing ring = [] {
+            const uint64_t thread_index = next_thread_index.fetch_add(1);
+            return TraceRing(traceDirectory() + "/exchange_trace." + std::to_string(::getpid()) + "." + std::to_string(thread_index), thread_index);
+        }();
+        return ring;
+    }
+
+    // the same answer for the same id on every hop of every process, so a sampled order is traced end to end
+    inline bool shouldTrace(uint32_t client_id, uint64_t id) noexcept {
+        if constexpr (TRACE_SAMPLE_EVERY == 0) {
+            return false;
+        } else if constexpr (TRACE_SAMPLE_EVERY == 1) {
+            return true;
+        } else {
+            // splitmix64 finalizer, so ids that go up by one don't all land on the same sample
+            uint64_t x = id ^ (static_cast<uint64_t>(client_id) << 32);
+            x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+            x ^= (x >> 31);
+            return x % TRACE_SAMPLE_EVERY == 0;
+        }
+    }
+
+    // records that 'hop' happened at 'nanos', for when the time was taken before we knew the id (e.g. on a socket read)
+    inline void traceHopAt(TraceHop hop, uint32_t client_id, uint64_t id, int64_t nanos) noexcept {
+        if (shouldTrace(client_id, id)) {
+            threadTraceRing().record({nanos, id, client_id, hop});
+        }
+    }
+
+    inline void traceHop(TraceHop hop, uint32_t client_id, uint64_t id) noexcept {
+        if (shouldTrace(client_id, id)) {
+            threadTraceRing().record({getCurrentNanosTSC(), id, client_id, hop});
+        }
+    }
+
+}
+
+// e.g. TRACE_HOP(T3_MatchingEngine_LFQueue_read, request->client_id, request->order_id)
+#define TRACE_HOP(HOP, CLIENT_ID, ID) Common::traceHop(Common::TraceHop::HOP, CLIENT_ID, ID)
+#define TRACE_HOP_AT(HOP, CLIENT_ID, ID, NANOS) Common::traceHopAt(Common::TraceHop::HOP, CLIENT_ID, ID, NANOS)
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <algorithm>
+#include <dirent.h>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "trace.h"
+#include "latency_histogram.h"
+
+namespace Common {
+
+    // a TraceRecord along with the process it was recorded in
+    struct TraceEvent {
+        TraceRecord record;
+        int64_t pid = 0;
+    };
+
+    // the pid in a ring file's name (exchange_trace.<pid>.<thread index>), -1 if it doesn't have one
+    inline int64_t traceRingPid(const std::string &path) {
+        const size_t name_start = path.rfind('/') == std::string::npos ? 0 : path.rfind('/') + 1;
+        const size_t pid_start = path.find('.', name_start);
+        if (pid_start == std::string::npos) {
+            return -1;
+        }
+        char *end = nullptr;
+        const int64_t pid = std::strtoll(path.c_str() + pid_start + 1, &end, 10);
+        return (end && *end == '.') ? pid : -1;
+    }
+
+    // every 'exchange_trace.*' ring file in 'directory'
+    inline std::vector<std::string> findTraceRings(const std::string &directory) {
+        std::vector<std::string> paths;
+        DIR *dir = ::opendir(directory.c_str());
+        if (!dir) {
+            return paths;
+        }
+        while (const dirent *entry = ::readdir(dir)) {
+            const std::string name = entry->d_name;
+            if (name.rfind("exchange_trace.", 0) == 0) {
+                paths.push_back(directory + "/" + name);
+            }
+        }
+        ::closedir(dir);
+        std::sort(paths.begin(), paths.end());
+        return paths;
+    }
+
+    /*
+        Appends the records still in the ring file at 'path' to 'events', oldest first
+
+        note that the ring can still be written to while we read it (the process may still be running), in which case the
+        oldest few records could be overwritten under us, that's fine for a report but don't expect it to be exact
+    */
+    inline bool readTraceRing(const std::string &path, std::vector<TraceEvent> *events, std::string *error) {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            *error = "could not open: " + std::string(std::strerror(errno));
+            return false;
+        }
+        void *memory = ::mmap(nullptr, TRACE_RING_FILE_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (memory == MAP_FAILED) {
+            *error = "could not map: " + std::string(std::strerror(errno));
+            return false;
+        }
+
+        const auto header = static_cast<const TraceRingHeader *>(memory);
+        const bool valid = header->isValid() && header->capacity == TRACE_RING_SIZE;
+        if (valid) {
+            const auto records = reinterpret_cast<const TraceRecord *>(static_cast<const char *>(memory) + sizeof(TraceRingHeader));
+            const uint64_t end = header->next_index.load(std::memory_order_acquire);
+            const uint64_t begin = (end > TRACE_RING_SIZE ? end - TRACE_RING_SIZE : 0);
+            for (uint64_t index = begin; index < end; ++index) {
+                events->push_back({records[index & (TRACE_RING_SIZE - 1)], header->pid});
+            }
+        } else {
+            *error = "not a trace ring";
+        }
+
+        ::munmap(memory, TRACE_RING_FILE_SIZE);
+        return valid;
+    }
+
+    /*
+        Joins the trace events of every process into one journey per order (or market data update) and reports
+        the latency of every hop along the way, as well as end to end:
+        - T10 -> T9t is tick to trade for an order, from the trade engine sending it to the trade engine getting the response
+        - T4 -> T8 is how long a market data update takes to get from the matching engine into a client's order book
+
+        every hop is measured from the latest earlier occurence of the hop before it, preferring one in the same process
+        so that e.g. a fill (T4t) is measured from the request that caused it (T3), and each client's market data
+        consumer is measured against itself, not against another client that happened to read the same update first
+
+        note that a hop in another process can look like it happened before the one it follows when the two processes'
+        clocks disagree by more than the hop took, we count those as 0 (see 'NOTE' in trace.h)
+
+        'per_order' also writes out the hops of every journey, one line each
+    */
+    inline void joinTraces(std::vector<TraceEvent> events, bool per_order, std::ostream &out) {
+        // the hop that comes right before each hop, INVALID for the first hop of a journey
+        std::array<TraceHop, static_cast<size_t>(TraceHop::MAX)> previous_hop;
+        previous_hop.fill(TraceHop::INVALID);
+        auto chain = [&previous_hop](std::initializer_list<TraceHop> hops) {
+            TraceHop previous = TraceHop::INVALID;
+            for (const TraceHop hop : hops) {
+                previous_hop[static_cast<size_t>(hop)] = previous;
+                previous = hop;
+            }
+        };
+        chain({TraceHop::T10_TradeEngine_LFQueue_write, TraceHop::T11_OrderGateway_LFQueue_read, TraceHop::T12_OrderGateway_TCP_write,
+               TraceHop::T1_OrderServer_TCP_read, TraceHop::T2_OrderServer_LFQueue_write, TraceHop::T3_MatchingEngine_LFQueue_read,
+               TraceHop::T4t_MatchingEngine_LFQueue_write, TraceHop::T5t_OrderServer_LFQueue_read, TraceHop::T6t_OrderServer_TCP_write,
+               TraceHop::T7t_OrderGateway_TCP_read, TraceHop::T8t_OrderGateway_LFQueue_write, TraceHop::T9t_TradeEngine_LFQueue_read});
+        chain({TraceHop::T4_MatchingEngine_LFQueue_write, TraceHop::T5_MarketDataPublisher_LFQueue_read, TraceHop::T6_MarketDataPublisher_UDP_write,
+               TraceHop::T7_MarketDataConsumer_UDP_read, TraceHop::T8_MarketDataConsumer_LFQueue_write});
+
+        struct Latencies {
+            std::vector<uint64_t> counts = std::vector<uint64_t>(LatencyHistogram::NUM_BUCKETS, 0);
+            uint64_t total = 0;
+            uint64_t max = 0;
+        };
+        std::map<std::string, Latencies> latencies; // "from -> to" -> how long it took
+
+        // the latest 'hop' before events[index] in the same journey, the same process if possible, nullptr if there isn't one
+        auto findBefore = [](const std::vector<TraceEvent> &journey, size_t index, TraceHop hop) -> const TraceEvent * {
+            const TraceEvent *found = nullptr;
+            for (size_t i = index; i-- > 0;) {
+                if (journey[i].record.hop == hop) {
+                    if (journey[i].pid == journey[index].pid) {
+                        return &journey[i];
+                    }
+                    if (!found) {
+                        found = &journey[i];
+                    }
+                }
+            }
+            return found;
+        };
+        auto addLatency = [&latencies](const TraceEvent &from, const TraceEvent &to, const std::string &suffix) {
+            Latencies &pair = latencies[std::string(traceHopToString(from.record.hop)) + " -> " +
+                                        std::string(traceHopToString(to.record.hop)) + suffix];
+            const uint64_t nanos = static_cast<uint64_t>(std::max<int64_t>(to.record.nanos - from.record.nanos, 0));
+            ++pair.counts[LatencyHistogram::bucketIndex(nanos)];
+            ++pair.total;
+            pair.max = std::max(pair.max, nanos);
+        };
+
+        // group the events into journeys, each one in the order it happened
+        std::map<std::pair<uint32_t, uint64_t>, std::vector<TraceEvent>> journeys; // (client id, id) -> its events
+        for (const TraceEvent &event : events) {
+            journeys[{event.record.client_id, event.record.id}].push_back(event);
+        }
+        events.clear();
+
+        for (auto &[journey_key, journey] : journeys) {
+            std::stable_sort(journey.begin(), journey.end(), [](const TraceEvent &lhs, const TraceEvent &rhs) {
+                return lhs.record.nanos < rhs.record.nanos;
+            });
+
+            for (size_t i = 0; i < journey.size(); ++i) {
+                const TraceEvent &event = journey[i];
+                const TraceHop previous = previous_hop[static_cast<size_t>(event.record.hop)];
+                if (previous == TraceHop::INVALID) {
+                    continue;
+                }
+                if (const TraceEvent *from = findBefore(journey, i, previous)) {
+                    addLatency(*from, event, "");
+                }
+
+                if (event.record.hop == TraceHop::T9t_TradeEngine_LFQueue_read) {
+                    if (const TraceEvent *from = findBefore(journey, i, TraceHop::T10_TradeEngine_LFQueue_write)) {
+                        addLatency(*from, event, " (tick to trade)");
+                    }
+                } else if (event.record.hop == TraceHop::T8_MarketDataConsumer_LFQueue_write) {
+                    if (const TraceEvent *from = findBefore(journey, i, TraceHop::T4_MatchingEngine_LFQueue_write)) {
+                        addLatency(*from, event, " (market data)");
+                    }
+                }
+            }
+
+            if (per_order) {
+                const auto &[client_id, id] = journey_key;
+                out << (client_id == TRACE_MARKET_DATA ? "market data seq:" + std::to_string(id)
+                                                        : "client:" + std::to_string(client_id) + " order:" + std::to_string(id));
+                for (const TraceEvent &event : journey) {
+                    out << " " << traceHopToString(event.record.hop) << "(pid " << event.pid << "):+"
+                        << (event.record.nanos - journey.front().record.nanos) << "ns";
+                }
+                out << "\n";
+            }
+        }
+
+        for (const auto &[name, pair] : latencies) {
+            out << name
+                << " count:" << pair.total
+                << " p50:" << LatencyHistogram::valueAtPercentile(pair.counts, pair.total, 50.0)
+                << " p99:" << LatencyHistogram::valueAtPercentile(pair.counts, pair.total, 99.0)
+                << " p99.9:" << LatencyHistogram::valueAtPercentile(pair.counts, pair.total, 99.9)
+                << " max:" << pair.max << " (ns)\n";
+        }
+    }
+
+}